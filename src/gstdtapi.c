@@ -26,16 +26,20 @@
 
 #include <gst/gst.h>
 #include "gstdtapisink.h"
+#include "gstdtapisrc.h"
+#include "gstdtapitestsrc.h"
 
 static gboolean
 plugin_init (GstPlugin * plugin)
 {
-  return gst_dtapisink_plugin_init (plugin);
+  return gst_dtapisink_plugin_init (plugin) &&
+      gst_dtapisrc_plugin_init (plugin) &&
+      gst_dtapitestsrc_plugin_init (plugin);
 }
 
 GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
     GST_VERSION_MINOR,
-    "dtapi",
+    dtapi,
     "GStreamer DekTec DTAPI plugins",
     plugin_init, VERSION, "LGPL", "DTAPI", "http://github.com/wmanley/gst-dtapi")
 
@@ -0,0 +1,423 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * gstdtapicarousel.c: SI carousel sent in place of null packets
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include "gstdtapicarousel.h"
+
+#define SYNC_BYTE 0x47
+#define NULL_PID 0x1fff
+#define TS_PACKET_SIZE 188
+#define TS_PAYLOAD_SIZE 184
+
+#define TABLE_ID_TDT 0x70
+#define TABLE_ID_TOT 0x73
+
+/* NIT, SDT, BAT, TDT and TOT sections are all limited to 1024 bytes */
+#define MAX_SECTION_SIZE 1024
+
+/* Days between the MJD epoch and the Unix one */
+#define MJD_UNIX_EPOCH 40587
+
+typedef struct
+{
+  guint pid;
+  guint interval_us;
+  guint64 next_due;
+
+  /* Every section in the table, split into ready to go packets.  All that
+     changes when they're sent is the CC and, for the TDT and TOT, the
+     time. */
+  guint8 *packets;
+  guint n_packets;
+  guint8 cc;
+} Table;
+
+struct _GstDTAPICarousel
+{
+  Table tables[GST_DTAPI_CAROUSEL_N_TABLES];
+
+  /* The table being sent and the next of its packets to go */
+  int sending;
+  guint next_packet;
+
+  /* UTC_time as last encoded, so we only work it out once a second */
+  gint64 utc_s;
+  guint8 utc[5];
+};
+
+static const guint default_interval_ms[GST_DTAPI_CAROUSEL_N_TABLES] = {
+  GST_DTAPI_CAROUSEL_DEFAULT_NIT_INTERVAL,
+  GST_DTAPI_CAROUSEL_DEFAULT_SDT_INTERVAL,
+  GST_DTAPI_CAROUSEL_DEFAULT_TDT_INTERVAL
+};
+
+static guint32 crc_table[256];
+
+static void
+crc_init (void)
+{
+  static gsize done = 0;
+
+  if (g_once_init_enter (&done)) {
+    guint32 i, j, crc;
+
+    for (i = 0; i < 256; i++) {
+      crc = i << 24;
+      for (j = 0; j < 8; j++)
+        crc = (crc << 1) ^ (crc & 0x80000000 ? 0x04c11db7 : 0);
+      crc_table[i] = crc;
+    }
+    g_once_init_leave (&done, 1);
+  }
+}
+
+/* The MPEG-2 CRC over a section, less its last 4 bytes, written into them */
+static void
+set_crc (guint8 * section, gsize len)
+{
+  guint32 crc = 0xffffffff;
+  gsize i;
+
+  for (i = 0; i < len - 4; i++)
+    crc = (crc << 8) ^ crc_table[(crc >> 24) ^ section[i]];
+  section[len - 4] = crc >> 24;
+  section[len - 3] = crc >> 16;
+  section[len - 2] = crc >> 8;
+  section[len - 1] = crc;
+}
+
+static int
+table_for_id (guint8 table_id)
+{
+  switch (table_id) {
+    case 0x40:
+    case 0x41:
+      return GST_DTAPI_CAROUSEL_NIT;
+    case 0x42:
+    case 0x46:
+    case 0x4a:
+      return GST_DTAPI_CAROUSEL_SDT;
+    case TABLE_ID_TDT:
+    case TABLE_ID_TOT:
+      return GST_DTAPI_CAROUSEL_TDT;
+    default:
+      return -1;
+  }
+}
+
+/* Appends section to table's packets, starting a new packet for it */
+static void
+packetize (Table * table, const guint8 * section, gsize len)
+{
+  guint n = (len + 1 + TS_PAYLOAD_SIZE - 1) / TS_PAYLOAD_SIZE;
+  guint8 *p;
+  gsize done = 0;
+  guint i;
+
+  table->packets = (guint8 *) g_realloc (table->packets,
+      (table->n_packets + n) * TS_PACKET_SIZE);
+  p = table->packets + table->n_packets * TS_PACKET_SIZE;
+  memset (p, 0xff, n * TS_PACKET_SIZE);
+
+  for (i = 0; i < n; i++, p += TS_PACKET_SIZE) {
+    guint8 *payload = p + 4;
+    gsize room = TS_PAYLOAD_SIZE;
+
+    p[0] = SYNC_BYTE;
+    p[1] = (i == 0 ? 0x40 : 0) | (table->pid >> 8);
+    p[2] = table->pid & 0xff;
+    p[3] = 0x10;
+    if (i == 0) {
+      /* pointer_field */
+      *payload++ = 0;
+      room--;
+    }
+    room = MIN (room, len - done);
+    memcpy (payload, section + done, room);
+    done += room;
+  }
+  table->n_packets += n;
+}
+
+GstDTAPICarousel *
+gst_dtapi_carousel_new (const guint8 * sections, gsize len, gchar ** error)
+{
+  static const guint pids[GST_DTAPI_CAROUSEL_N_TABLES] = {
+    0x10, 0x11, 0x14
+  };
+  GstDTAPICarousel *carousel = g_new0 (GstDTAPICarousel, 1);
+  guint8 section[MAX_SECTION_SIZE];
+  gsize pos = 0;
+  int i;
+
+  crc_init ();
+
+  for (i = 0; i < GST_DTAPI_CAROUSEL_N_TABLES; i++) {
+    carousel->tables[i].pid = pids[i];
+    carousel->tables[i].interval_us = default_interval_ms[i] * 1000;
+  }
+  carousel->sending = -1;
+  carousel->utc_s = -1;
+
+  while (pos < len) {
+    gsize section_len;
+    int table;
+
+    if (len - pos < 3) {
+      *error = g_strdup_printf ("truncated section at byte %" G_GSIZE_FORMAT,
+          pos);
+      goto fail;
+    }
+    section_len = 3 + (((sections[pos + 1] & 0x0f) << 8) | sections[pos + 2]);
+    table = table_for_id (sections[pos]);
+    if (table < 0) {
+      *error = g_strdup_printf ("can't carousel table_id 0x%02x",
+          sections[pos]);
+      goto fail;
+    }
+    if (section_len > MAX_SECTION_SIZE || section_len > len - pos) {
+      *error = g_strdup_printf ("bad section_length at byte %" G_GSIZE_FORMAT,
+          pos);
+      goto fail;
+    }
+    /* The time is rewritten in place so these mustn't span packets */
+    if (sections[pos] == TABLE_ID_TOT && section_len + 1 > TS_PAYLOAD_SIZE) {
+      *error = g_strdup ("TOT doesn't fit in one packet");
+      goto fail;
+    }
+
+    memcpy (section, sections + pos, section_len);
+    /* Everything but the TDT has a CRC */
+    if (section[0] != TABLE_ID_TDT && section_len >= 8)
+      set_crc (section, section_len);
+    packetize (&carousel->tables[table], section, section_len);
+    pos += section_len;
+  }
+
+  return carousel;
+
+fail:
+  gst_dtapi_carousel_free (carousel);
+  return NULL;
+}
+
+void
+gst_dtapi_carousel_free (GstDTAPICarousel * carousel)
+{
+  int i;
+
+  for (i = 0; i < GST_DTAPI_CAROUSEL_N_TABLES; i++)
+    g_free (carousel->tables[i].packets);
+  g_free (carousel);
+}
+
+void
+gst_dtapi_carousel_set_interval (GstDTAPICarousel * carousel,
+    GstDTAPICarouselTable table, guint interval_ms)
+{
+  g_return_if_fail (table < GST_DTAPI_CAROUSEL_N_TABLES);
+
+  carousel->tables[table].interval_us = interval_ms * 1000;
+}
+
+void
+gst_dtapi_carousel_reset (GstDTAPICarousel * carousel)
+{
+  int i;
+
+  for (i = 0; i < GST_DTAPI_CAROUSEL_N_TABLES; i++)
+    carousel->tables[i].next_due = 0;
+  carousel->sending = -1;
+}
+
+static guint8
+bcd (guint v)
+{
+  return ((v / 10) << 4) | (v % 10);
+}
+
+/* Sets the UTC_time of the TDT or TOT in packet p */
+static void
+set_time (GstDTAPICarousel * carousel, guint8 * p, gint64 utc_us)
+{
+  gint64 s = utc_us / G_USEC_PER_SEC;
+  guint8 *section = p + 5;
+
+  if (s != carousel->utc_s) {
+    guint day_s = s % 86400;
+    guint mjd = MJD_UNIX_EPOCH + s / 86400;
+
+    carousel->utc[0] = mjd >> 8;
+    carousel->utc[1] = mjd & 0xff;
+    carousel->utc[2] = bcd (day_s / 3600);
+    carousel->utc[3] = bcd (day_s / 60 % 60);
+    carousel->utc[4] = bcd (day_s % 60);
+    carousel->utc_s = s;
+  }
+  memcpy (section + 3, carousel->utc, 5);
+  if (section[0] == TABLE_ID_TOT)
+    set_crc (section, 3 + (((section[1] & 0x0f) << 8) | section[2]));
+}
+
+/* Microseconds the first pos bytes take at rate_bps, in two parts so it
+   can't overflow */
+static guint64
+stream_time (guint64 pos, int rate_bps)
+{
+  return pos / rate_bps * 8 * G_USEC_PER_SEC +
+      pos % rate_bps * 8 * G_USEC_PER_SEC / rate_bps;
+}
+
+/* Picks the table that has been due longest, if any is */
+static int
+next_table (GstDTAPICarousel * carousel, guint64 now)
+{
+  int i, best = -1;
+
+  for (i = 0; i < GST_DTAPI_CAROUSEL_N_TABLES; i++) {
+    Table *t = &carousel->tables[i];
+
+    if (t->n_packets > 0 && t->next_due <= now &&
+        (best < 0 || t->next_due < carousel->tables[best].next_due))
+      best = i;
+  }
+  return best;
+}
+
+static gboolean
+is_carousel_pid (GstDTAPICarousel * carousel, guint pid)
+{
+  int i;
+
+  for (i = 0; i < GST_DTAPI_CAROUSEL_N_TABLES; i++) {
+    if (carousel->tables[i].pid == pid && carousel->tables[i].n_packets > 0)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+gboolean
+gst_dtapi_carousel_needs_fill (GstDTAPICarousel * carousel,
+    const guint8 * data, gsize len, guint packet_size, guint64 offset,
+    int rate_bps)
+{
+  guint header = packet_size == 192 ? 4 : 0;
+  guint64 packet = (offset + packet_size - 1) / packet_size;
+  guint64 first_due = G_MAXUINT64;
+  gsize i;
+  int t;
+
+  if (rate_bps <= 0)
+    return FALSE;
+
+  /* A null packet gets filled if it goes out once something is due */
+  if (carousel->sending >= 0)
+    first_due = 0;
+  for (t = 0; t < GST_DTAPI_CAROUSEL_N_TABLES; t++) {
+    if (carousel->tables[t].n_packets > 0)
+      first_due = MIN (first_due, carousel->tables[t].next_due);
+  }
+
+  for (i = packet * packet_size - offset; i + packet_size <= len;
+      i += packet_size) {
+    const guint8 *h = data + i + header;
+    guint pid;
+
+    if (h[0] != SYNC_BYTE)
+      continue;
+    pid = ((h[1] & 0x1f) << 8) | h[2];
+    if (pid == NULL_PID) {
+      if (stream_time (offset + i, rate_bps) >= first_due)
+        return TRUE;
+    } else if (is_carousel_pid (carousel, pid))
+      return TRUE;
+  }
+  return FALSE;
+}
+
+guint
+gst_dtapi_carousel_fill (GstDTAPICarousel * carousel, guint8 * data,
+    gsize len, guint packet_size, guint64 offset, int rate_bps,
+    gint64 utc_us)
+{
+  /* M2TS style 192 byte packets have a 4 byte timestamp in front */
+  guint header = packet_size == 192 ? 4 : 0;
+  guint64 packet = (offset + packet_size - 1) / packet_size;
+  guint inserted = 0;
+  gsize i;
+
+  if (rate_bps <= 0)
+    return 0;
+
+  /* Packets split between buffers have been partly written already so are
+     left alone */
+  for (i = packet * packet_size - offset; i + packet_size <= len;
+      i += packet_size) {
+    guint8 *h = data + i + header;
+    guint pid;
+    guint64 now;
+    Table *t;
+
+    if (h[0] != SYNC_BYTE)
+      continue;
+    pid = ((h[1] & 0x1f) << 8) | h[2];
+    if (pid != NULL_PID) {
+      if (!is_carousel_pid (carousel, pid))
+        continue;
+      h[1] = NULL_PID >> 8;
+      h[2] = NULL_PID & 0xff;
+      h[3] = 0x10;
+      memset (h + 4, 0xff, TS_PAYLOAD_SIZE);
+    }
+
+    now = stream_time (offset + i, rate_bps);
+    if (carousel->sending < 0) {
+      carousel->sending = next_table (carousel, now);
+      if (carousel->sending < 0)
+        continue;
+      carousel->next_packet = 0;
+      t = &carousel->tables[carousel->sending];
+      /* Keep to the interval unless we've fallen a whole one behind */
+      t->next_due += t->interval_us;
+      if (t->next_due < now)
+        t->next_due = now + t->interval_us;
+    }
+
+    t = &carousel->tables[carousel->sending];
+    memcpy (h, t->packets + carousel->next_packet * TS_PACKET_SIZE,
+        TS_PACKET_SIZE);
+    h[3] = (h[3] & 0xf0) | t->cc;
+    t->cc = (t->cc + 1) & 0x0f;
+    if (carousel->sending == GST_DTAPI_CAROUSEL_TDT)
+      set_time (carousel, h, utc_us + (gint64) stream_time (i, rate_bps));
+    inserted++;
+
+    if (++carousel->next_packet == t->n_packets)
+      carousel->sending = -1;
+  }
+
+  return inserted;
+}
@@ -0,0 +1,80 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * gstdtapicarousel.h: SI carousel sent in place of null packets
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_DTAPI_CAROUSEL_H__
+#define __GST_DTAPI_CAROUSEL_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Sections are sent a table at a time, each table on its own interval */
+typedef enum
+{
+  GST_DTAPI_CAROUSEL_NIT,       /* NIT actual and other on PID 0x10 */
+  GST_DTAPI_CAROUSEL_SDT,       /* SDT actual and other and BAT on PID 0x11 */
+  GST_DTAPI_CAROUSEL_TDT,       /* TDT and TOT on PID 0x14 */
+  GST_DTAPI_CAROUSEL_N_TABLES
+} GstDTAPICarouselTable;
+
+/* Repetition intervals in ms, well within the TR 101 211 maximums */
+#define GST_DTAPI_CAROUSEL_DEFAULT_NIT_INTERVAL 2000
+#define GST_DTAPI_CAROUSEL_DEFAULT_SDT_INTERVAL 1000
+#define GST_DTAPI_CAROUSEL_DEFAULT_TDT_INTERVAL 10000
+
+typedef struct _GstDTAPICarousel GstDTAPICarousel;
+
+/* sections is any number of complete sections back to back, as they would
+   appear in a TS.  Their CRCs are filled in here, so they needn't be right.
+   Returns NULL and sets *error if they can't be parsed or include a table
+   that isn't one of the above. */
+GstDTAPICarousel *gst_dtapi_carousel_new (const guint8 * sections, gsize len,
+    gchar ** error);
+void gst_dtapi_carousel_free (GstDTAPICarousel * carousel);
+
+void gst_dtapi_carousel_set_interval (GstDTAPICarousel * carousel,
+    GstDTAPICarouselTable table, guint interval_ms);
+
+/* The output has started again from offset 0: everything is due now */
+void gst_dtapi_carousel_reset (GstDTAPICarousel * carousel);
+
+/* Whether gst_dtapi_carousel_fill would change anything in data, i.e. it
+   has packets on the carousel's PIDs, or null packets and something is
+   due.  Only reads data, so the caller can leave copying it until it's
+   needed. */
+gboolean gst_dtapi_carousel_needs_fill (GstDTAPICarousel * carousel,
+    const guint8 * data, gsize len, guint packet_size, guint64 offset,
+    int rate_bps);
+
+/* Replaces null packets in len bytes of data with whatever of the carousel
+   is due, in place.  Packets on the carousel's PIDs are nulled first so
+   stale tables from upstream don't go out alongside it.  offset is the
+   position of data[0] in the output, which must be packet aligned from
+   offset 0 and is taken to go out at exactly rate_bps, at which time it is
+   utc_us (microseconds since the epoch).  Returns the number of packets
+   inserted. */
+guint gst_dtapi_carousel_fill (GstDTAPICarousel * carousel, guint8 * data,
+    gsize len, guint packet_size, guint64 offset, int rate_bps,
+    gint64 utc_us);
+
+G_END_DECLS
+#endif /* __GST_DTAPI_CAROUSEL_H__ */
@@ -0,0 +1,284 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * gstdtapidelay.c: disk backed delay line
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/* For sync_file_range */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "gstdtapidelay.h"
+
+/* Data is written to the file in blocks of this size, which must be a
+   multiple of the page size */
+#define BLOCK_SIZE (64 * 1024)
+/* How far ahead of the read position to ask for pages to be read in, in
+   case they've been pushed out of the page cache since they were written */
+#define READAHEAD_BLOCKS 16
+
+struct _GstDTAPIDelay
+{
+  int fd;
+  /* The whole file, read only */
+  guint8 *map;
+  gsize size;
+  gsize hold;
+  /* What's skipped is a whole number of these so packets stay whole */
+  guint packet_size;
+
+  /* The block being filled, page aligned */
+  guint8 *block;
+  gsize block_len;
+
+  /* Free running byte counts of what has gone into the file and what has
+     been consumed.  written is always a whole number of blocks except after
+     gst_dtapi_delay_release. */
+  guint64 written;
+  guint64 read;
+};
+
+static gsize
+delay_size (gsize hold)
+{
+  /* Room for a block being written while hold bytes and a block being read
+     are in the file */
+  return (hold + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE + 2 * BLOCK_SIZE;
+}
+
+GstDTAPIDelay *
+gst_dtapi_delay_new (const gchar * location, gsize hold, guint packet_size,
+    gchar ** error)
+{
+  GstDTAPIDelay *delay = g_new0 (GstDTAPIDelay, 1);
+  gchar *tmp_name = NULL;
+  GError *err = NULL;
+  int ret;
+
+  delay->fd = -1;
+  delay->hold = hold;
+  delay->size = delay_size (hold);
+  delay->packet_size = packet_size ? packet_size : 4;
+
+  if (location) {
+    delay->fd = open (location, O_RDWR | O_CREAT | O_TRUNC, 0600);
+  } else {
+    /* Nobody else needs to see it, and this way it goes when we do */
+    delay->fd = g_file_open_tmp ("dtapisink-delay-XXXXXX", &tmp_name, &err);
+    if (delay->fd >= 0)
+      unlink (tmp_name);
+  }
+  if (delay->fd < 0) {
+    *error = g_strdup_printf ("Can't open %s: %s",
+        location ? location : "temporary file",
+        err ? err->message : g_strerror (errno));
+    goto fail;
+  }
+
+  /* Allocate it all now, so we can't run out of space later */
+  if ((ret = posix_fallocate (delay->fd, 0, delay->size)) != 0) {
+    *error = g_strdup_printf ("Can't allocate %" G_GSIZE_FORMAT
+        " bytes for the delay: %s", delay->size, g_strerror (ret));
+    goto fail;
+  }
+
+  delay->map = (guint8 *) mmap (NULL, delay->size, PROT_READ, MAP_SHARED,
+      delay->fd, 0);
+  if (delay->map == MAP_FAILED) {
+    delay->map = NULL;
+    *error = g_strdup_printf ("Can't map the delay: %s", g_strerror (errno));
+    goto fail;
+  }
+  madvise (delay->map, delay->size, MADV_SEQUENTIAL);
+
+  if ((ret = posix_memalign ((void **) &delay->block, sysconf (_SC_PAGESIZE),
+              BLOCK_SIZE)) != 0) {
+    delay->block = NULL;
+    *error = g_strdup_printf ("Can't allocate the delay: %s",
+        g_strerror (ret));
+    goto fail;
+  }
+
+  g_free (tmp_name);
+  if (err)
+    g_error_free (err);
+  return delay;
+
+fail:
+  g_free (tmp_name);
+  if (err)
+    g_error_free (err);
+  gst_dtapi_delay_free (delay);
+  return NULL;
+}
+
+void
+gst_dtapi_delay_free (GstDTAPIDelay * delay)
+{
+  if (delay->map)
+    munmap (delay->map, delay->size);
+  if (delay->fd >= 0)
+    close (delay->fd);
+  free (delay->block);
+  g_free (delay);
+}
+
+gboolean
+gst_dtapi_delay_set_hold (GstDTAPIDelay * delay, gsize hold)
+{
+  guint64 fill = delay->written - delay->read;
+
+  if (delay_size (hold) > delay->size)
+    return FALSE;
+
+  delay->hold = hold;
+  /* A shorter delay means skipping what would have gone out in between */
+  if (fill > hold) {
+    gsize skip = fill - hold;
+    gst_dtapi_delay_consume (delay, skip - skip % delay->packet_size);
+  }
+  return TRUE;
+}
+
+gsize
+gst_dtapi_delay_get_max_hold (GstDTAPIDelay * delay)
+{
+  return delay->size - 2 * BLOCK_SIZE;
+}
+
+gsize
+gst_dtapi_delay_get_fill (GstDTAPIDelay * delay)
+{
+  return delay->written + delay->block_len - delay->read;
+}
+
+/* Writes out the block being filled.  The blocks are whole pages so the
+   kernel never has to read what was there first.  Only a block written by
+   gst_dtapi_delay_release can be short, and so wrap. */
+static gboolean
+write_block (GstDTAPIDelay * delay, gchar ** error)
+{
+  gsize done = 0;
+  ssize_t n;
+
+  while (done < delay->block_len) {
+    gsize offset = (delay->written + done) % delay->size;
+
+    n = pwrite (delay->fd, delay->block + done,
+        MIN (delay->block_len - done, delay->size - offset), offset);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0) {
+      *error = g_strdup_printf ("Writing to the delay failed: %s",
+          g_strerror (errno));
+      return FALSE;
+    }
+    /* Start writeback now rather than letting dirty pages pile up */
+    sync_file_range (delay->fd, offset, n, SYNC_FILE_RANGE_WRITE);
+    done += n;
+  }
+
+  delay->written += delay->block_len;
+  delay->block_len = 0;
+  return TRUE;
+}
+
+gssize
+gst_dtapi_delay_write (GstDTAPIDelay * delay, const guint8 * data, gsize len,
+    gchar ** error)
+{
+  gsize done = 0;
+
+  while (done < len) {
+    guint64 fill = delay->written + delay->block_len - delay->read;
+    gsize n = MIN (len - done, BLOCK_SIZE - delay->block_len);
+
+    n = MIN (n, delay->size - fill);
+    if (n == 0)
+      break;
+    memcpy (delay->block + delay->block_len, data + done, n);
+    delay->block_len += n;
+    done += n;
+    if (delay->block_len == BLOCK_SIZE && !write_block (delay, error))
+      return -1;
+  }
+  return done;
+}
+
+gsize
+gst_dtapi_delay_peek (GstDTAPIDelay * delay, const guint8 ** data)
+{
+  guint64 fill = delay->written - delay->read;
+  gsize offset = delay->read % delay->size;
+  gsize len;
+
+  if (fill <= delay->hold)
+    return 0;
+  len = MIN (fill - delay->hold, delay->size - offset);
+  *data = delay->map + offset;
+  return len - len % 4;
+}
+
+void
+gst_dtapi_delay_consume (GstDTAPIDelay * delay, gsize len)
+{
+  guint64 first = delay->read / BLOCK_SIZE, last;
+
+  delay->read += len;
+  last = delay->read / BLOCK_SIZE;
+
+  /* Drop the blocks we've finished with from the page cache.  They'll have
+     been written back long ago, so this doesn't wait. */
+  for (; first < last; first++) {
+    gsize offset = first * BLOCK_SIZE % delay->size;
+
+    madvise (delay->map + offset, BLOCK_SIZE, MADV_DONTNEED);
+    posix_fadvise (delay->fd, offset, BLOCK_SIZE, POSIX_FADV_DONTNEED);
+    /* and ask for what's coming to be read back in if it has gone */
+    offset = (first + 1 + READAHEAD_BLOCKS) * BLOCK_SIZE % delay->size;
+    posix_fadvise (delay->fd, offset, BLOCK_SIZE, POSIX_FADV_WILLNEED);
+  }
+}
+
+gboolean
+gst_dtapi_delay_release (GstDTAPIDelay * delay, gchar ** error)
+{
+  delay->hold = 0;
+  return delay->block_len == 0 || write_block (delay, error);
+}
+
+void
+gst_dtapi_delay_clear (GstDTAPIDelay * delay)
+{
+  /* Back to the start so the blocks line up with the file again */
+  delay->written = 0;
+  delay->read = 0;
+  delay->block_len = 0;
+}
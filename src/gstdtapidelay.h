@@ -0,0 +1,80 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * gstdtapidelay.h: disk backed delay line
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_DTAPI_DELAY_H__
+#define __GST_DTAPI_DELAY_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* A byte ring in a file that holds on to everything written to it until
+   hold more bytes have been written after it.  Data goes into the file with
+   whole page writes, so it never has to be read back in first, and comes
+   out of a read-only mapping of it, so it can be handed on without a copy.
+   Pages are dropped from the page cache once they've been read and read
+   ahead of being needed, so the memory it uses stays bounded however long
+   the delay. */
+typedef struct _GstDTAPIDelay GstDTAPIDelay;
+
+/* location is the file to use, which is truncated.  If it's NULL an
+   anonymous file is made in the temporary directory.  packet_size (188, 192,
+   204 or 0 if unknown) keeps packets whole when the delay is shortened.
+   Returns NULL and sets *error on failure. */
+GstDTAPIDelay *gst_dtapi_delay_new (const gchar * location, gsize hold,
+    guint packet_size, gchar ** error);
+void gst_dtapi_delay_free (GstDTAPIDelay * delay);
+
+/* Anything held for more than hold bytes is skipped.  Returns FALSE if
+   there isn't room for hold, in which case nothing changes. */
+gboolean gst_dtapi_delay_set_hold (GstDTAPIDelay * delay, gsize hold);
+
+/* The most gst_dtapi_delay_set_hold will accept.  It never changes, so it
+   can be kept by another thread to decide whether a new delay needs a
+   bigger file. */
+gsize gst_dtapi_delay_get_max_hold (GstDTAPIDelay * delay);
+
+/* How much the line is holding: everything written to it that hasn't been
+   consumed yet */
+gsize gst_dtapi_delay_get_fill (GstDTAPIDelay * delay);
+
+/* Writes as much of data as there is room for.  Returns the number of bytes
+   written or -1 and sets *error if the file couldn't be written. */
+gssize gst_dtapi_delay_write (GstDTAPIDelay * delay, const guint8 * data,
+    gsize len, gchar ** error);
+
+/* Returns the length of the contiguous region at *data that is due, a
+   multiple of 4 bytes at a 4 byte aligned address.  It stays valid until
+   it's consumed. */
+gsize gst_dtapi_delay_peek (GstDTAPIDelay * delay, const guint8 ** data);
+void gst_dtapi_delay_consume (GstDTAPIDelay * delay, gsize len);
+
+/* Makes everything due, e.g. at the end of the stream.  Only
+   gst_dtapi_delay_clear can follow.  Returns FALSE and sets *error if the
+   file couldn't be written. */
+gboolean gst_dtapi_delay_release (GstDTAPIDelay * delay, gchar ** error);
+
+/* Throws away everything held */
+void gst_dtapi_delay_clear (GstDTAPIDelay * delay);
+
+G_END_DECLS
+#endif /* __GST_DTAPI_DELAY_H__ */
@@ -0,0 +1,159 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * gstdtapidevice.cpp: attaching to DekTec hardware
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "gstdtapidevice.h"
+
+template <class Device, class Channel> static gchar *
+attach (Device * dvc, Channel * channel, gint64 serial, int type_number,
+    int port)
+{
+  DTAPI_RESULT result;
+
+  if (serial != 0) {
+    if ((result = dvc->AttachToSerial (serial)) != DTAPI_OK)
+      return g_strdup_printf ("No DekTec device with serial number %"
+          G_GINT64_FORMAT " in system: %s", serial,
+          gst_dtapi_result_to_string (result));
+  } else if ((result = dvc->AttachToType (type_number)) != DTAPI_OK) {
+    return g_strdup_printf ("No DekTec %d in system: %s", type_number,
+        gst_dtapi_result_to_string (result));
+  }
+
+  if ((result = channel->AttachToPort (dvc, port)) != DTAPI_OK) {
+    dvc->Detach ();
+    return g_strdup_printf ("Can't attach to port %d: %s", port,
+        gst_dtapi_result_to_string (result));
+  }
+
+  return NULL;
+}
+
+gchar *
+gst_dtapi_attach (DtDevice * dvc, DtOutpChannel * channel, gint64 serial,
+    int type_number, int port)
+{
+  return attach (dvc, channel, serial, type_number, port);
+}
+
+gchar *
+gst_dtapi_attach (DtDevice * dvc, DtInpChannel * channel, gint64 serial,
+    int type_number, int port)
+{
+  return attach (dvc, channel, serial, type_number, port);
+}
+
+gchar *
+gst_dtapi_attach (GstDTAPIDevice * dvc, GstDTAPIOutpChannel * channel,
+    gint64 serial, int type_number, int port)
+{
+  return attach (dvc, channel, serial, type_number, port);
+}
+
+const char *
+gst_dtapi_result_to_string (DTAPI_RESULT result)
+{
+  switch (result) {
+  case DTAPI_OK:
+    return "Success";
+  case DTAPI_E_DEV_DRIVER:
+    return "Unclassified failure in device driver";
+  case DTAPI_E_INSUF_LOAD:
+    return "For modulators: FIFO load is insufficient to start modulation";
+  case DTAPI_E_INVALID_LEVEL:
+    return "The output level specified in SetOutputLevel is invalid for the "
+           "attached hardware function";
+  case DTAPI_E_INVALID_MODE:
+    return "The specified transmit-control state is invalid or incompatible "
+           "with the attached hardware function";
+    // FIXME: This is for SetModControl:
+    return "Modulation type is incompatible with modulator";
+  case DTAPI_E_MODPARS_NOT_SET:
+    return "For modulators: modulation parameters have not been set but are "
+           "required for starting modulation";
+  case DTAPI_E_MODTYPE_UNSUP:
+    return "For modulators: modulation type is not supported";
+  case DTAPI_E_NO_IPPARS:
+    return "For TS-over-IP channels: cannot set transmission state because "
+           "IP parameters have not been specified yet";
+  case DTAPI_E_NO_TSRATE:
+    // FIXME: This is for SetTxControl:
+    return "For modulators: TS rate has not been set but is required for "
+           "starting modulation";
+    // FIXME: And this is for Write:
+    return "For TS-over-IP channels: cannot write data because Transport-"
+           "Stream rate has not been specified, or is too low";
+  case DTAPI_E_NOT_ATTACHED:
+    return "Channel object is not attached to a hardware function";
+  case DTAPI_E_INVALID_BUF:
+    return "The buffer is not aligned to a 32-bit word boundary";
+  case DTAPI_E_INVALID_SIZE:
+    return "The specified transfer size is negative or not a multiple of four";
+  case DTAPI_E_IDLE:
+    // FIXME: This is for write
+    return "Cannot write data because transmission-control state is"
+           "DTAPI_TXCTRL_IDLE";
+    // FIXME: And this is for SetModControl:
+    return "Transmit-control state is not DTAPI_TXCTRL_IDLE; The requested "
+           "modulation parameters can only be set in idle state";
+  case DTAPI_E_INVALID_BANDWIDTH:
+      return "Invalid value for bandwidth field";
+  case DTAPI_E_INVALID_CONSTEL:
+      return "Invalid value for constellation field";
+  case DTAPI_E_INVALID_FHMODE:
+      return "Invalid value for frame-header mode field";
+  case DTAPI_E_INVALID_GUARD:
+      return "Invalid value for guard-interval field";
+  case DTAPI_E_INVALID_INTERLVNG:
+      return "Invalid value for interleaving field";
+  case DTAPI_E_INVALID_J83ANNEX:
+  case DTAPI_E_INVALID_ROLLOFF:
+      return "Invalid value for J.83 annex";
+  case DTAPI_E_INVALID_PILOTS:
+      return "Pilots cannot be specified in C=1 mode";
+  case DTAPI_E_INVALID_RATE:
+      return "Invalid value for convolutional rate or FEC code rate";
+  case DTAPI_E_INVALID_TRANSMODE:
+      return "Invalid value for transmission-mode field";
+  case DTAPI_E_INVALID_USEFRAMENO:
+      return "Invalid value for use-frame-numbering field";
+  case DTAPI_E_NOT_SUPPORTED:
+      return "The device does not include a modulator";
+  default:
+    return "Unknown error";
+  }
+}
+
+gboolean
+gst_dtapi_result_is_transient (DTAPI_RESULT result)
+{
+  switch (result) {
+  case DTAPI_E_DEV_DRIVER:
+  case DTAPI_E_NOT_ATTACHED:
+    return TRUE;
+  default:
+    return FALSE;
+  }
+}
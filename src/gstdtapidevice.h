@@ -0,0 +1,53 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * gstdtapidevice.h: attaching to DekTec hardware
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_DTAPI_DEVICE_H__
+#define __GST_DTAPI_DEVICE_H__
+
+#include <gst/gst.h>
+#include "DTAPI.h"
+#include "gstdtapiprofile.h"
+
+/* These are C++ only as they deal in DTAPI objects */
+
+/* Attaches dvc to the device with serial number serial or, if serial is 0,
+   to the first of type type_number (215 for a DTU-215 and so on), then
+   channel to port on it.  Returns NULL or, on failure, a description for
+   the error message that the caller must free.  Nothing is left attached
+   on failure. */
+gchar *gst_dtapi_attach (DtDevice * dvc, DtOutpChannel * channel,
+    gint64 serial, int type_number, int port);
+gchar *gst_dtapi_attach (DtDevice * dvc, DtInpChannel * channel,
+    gint64 serial, int type_number, int port);
+/* As above but with the calls timed in the objects' profile */
+gchar *gst_dtapi_attach (GstDTAPIDevice * dvc, GstDTAPIOutpChannel * channel,
+    gint64 serial, int type_number, int port);
+
+const char *gst_dtapi_result_to_string (DTAPI_RESULT result);
+
+/* TRUE for errors that mean the device or its driver has gone away from
+   under us (e.g. the USB cable was knocked) rather than that we asked it for
+   something it can't do.  Detaching and attaching again may fix the former
+   but never the latter. */
+gboolean gst_dtapi_result_is_transient (DTAPI_RESULT result);
+
+#endif /* __GST_DTAPI_DEVICE_H__ */
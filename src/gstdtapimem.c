@@ -0,0 +1,113 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * gstdtapimem.c: memory that stays put for the data path
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/mman.h>
+#include "gstdtapimem.h"
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+/* In front of every allocation, so free knows how it was made */
+typedef union
+{
+  struct
+  {
+    gsize mapped;               /* 0 if from g_malloc */
+    GstDTAPIMemFlags flags;
+  } h;
+  guint8 pad[64];
+} Header;
+
+gpointer
+gst_dtapi_mem_alloc (gsize size, GstDTAPIMemFlags flags,
+    GstDTAPIMemFlags * got)
+{
+  Header *header = NULL;
+  gboolean huge = (flags & GST_DTAPI_MEM_HUGEPAGES) != 0;
+  gsize mapped;
+
+  size += sizeof (Header);
+
+  if (flags == 0) {
+    header = (Header *) g_malloc (size);
+    header->h.mapped = 0;
+    header->h.flags = (GstDTAPIMemFlags) 0;
+    goto done;
+  }
+
+  mapped = huge ?
+      (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE : size;
+#ifdef MAP_HUGETLB
+  if (huge) {
+    header = (Header *) mmap (NULL, mapped, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (header == MAP_FAILED)
+      header = NULL;
+  }
+#endif
+  if (header == NULL) {
+    flags = (GstDTAPIMemFlags) (flags & ~GST_DTAPI_MEM_HUGEPAGES);
+    header = (Header *) mmap (NULL, mapped, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (header == MAP_FAILED)
+      g_error ("%s: failed to map %" G_GSIZE_FORMAT " bytes", G_STRLOC,
+          mapped);
+#ifdef MADV_HUGEPAGE
+    /* No huge pages reserved, transparent ones are the next best thing */
+    if (huge && madvise (header, mapped, MADV_HUGEPAGE) == 0)
+      flags = (GstDTAPIMemFlags) (flags | GST_DTAPI_MEM_HUGEPAGES);
+#endif
+  }
+
+  /* mlock faults every page in as well */
+  if ((flags & GST_DTAPI_MEM_LOCKED) && mlock (header, mapped) != 0)
+    flags = (GstDTAPIMemFlags) (flags & ~GST_DTAPI_MEM_LOCKED);
+
+  header->h.mapped = mapped;
+  header->h.flags = flags;
+
+done:
+  if (got)
+    *got = header->h.flags;
+  return header + 1;
+}
+
+void
+gst_dtapi_mem_free (gpointer mem)
+{
+  Header *header;
+
+  if (mem == NULL)
+    return;
+
+  header = (Header *) mem - 1;
+  if (header->h.mapped == 0) {
+    g_free (header);
+    return;
+  }
+  if (header->h.flags & GST_DTAPI_MEM_LOCKED)
+    munlock (header, header->h.mapped);
+  munmap (header, header->h.mapped);
+}
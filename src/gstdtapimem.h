@@ -0,0 +1,48 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * gstdtapimem.h: memory that stays put for the data path
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_DTAPI_MEM_H__
+#define __GST_DTAPI_MEM_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  /* mlock'ed, so touching it never page faults */
+  GST_DTAPI_MEM_LOCKED = 1 << 0,
+  /* Backed by huge pages if there are any to be had, which cuts TLB misses
+     for large buffers */
+  GST_DTAPI_MEM_HUGEPAGES = 1 << 1
+} GstDTAPIMemFlags;
+
+/* Returns size bytes, aligned as g_malloc's are.  With no flags it comes
+   from g_malloc.  Anything asked for in flags that can't be done
+   (e.g. RLIMIT_MEMLOCK is too low) is quietly left out; *got, if not NULL,
+   is set to what was done. */
+gpointer gst_dtapi_mem_alloc (gsize size, GstDTAPIMemFlags flags,
+    GstDTAPIMemFlags * got);
+void gst_dtapi_mem_free (gpointer mem);
+
+G_END_DECLS
+#endif /* __GST_DTAPI_MEM_H__ */
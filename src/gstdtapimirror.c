@@ -0,0 +1,362 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * gstdtapimirror.c: record of what was transmitted
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/* For O_DIRECT */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "gstdtapimirror.h"
+
+/* The queue is N_BLOCKS of BLOCK_SIZE, which is how much the disk can fall
+   behind before we start dropping: about 2.5 s at 50 Mbit/s */
+#define BLOCK_SIZE (256 * 1024)
+#define N_BLOCKS 64
+/* What O_DIRECT needs buffers, offsets and lengths to be multiples of */
+#define DIRECT_ALIGN 4096
+
+typedef struct
+{
+  guint8 *data;
+  gsize len;
+  /* When the first byte went in */
+  gint64 time;
+} Block;
+
+struct _GstDTAPIMirror
+{
+  gchar *location;
+  guint64 max_size;
+  guint max_files;
+
+  guint8 *memory;
+  Block blocks[N_BLOCKS];
+
+  GThread *thread;
+  GMutex lock;
+  GCond cond;
+
+  /* Protected by lock.  The caller fills blocks[fill] and the queued
+     blocks before it are waiting for the thread. */
+  guint fill;
+  guint queued;
+  gboolean stopping;
+  gchar *error;
+  gboolean error_reported;
+  GstDTAPIMirrorStats stats;
+
+  /* The thread's */
+  int fd;
+  int idx_fd;
+  gboolean direct;
+  guint file_index;
+  guint64 file_offset;
+};
+
+static void
+close_file (GstDTAPIMirror * mirror)
+{
+  if (mirror->fd >= 0)
+    close (mirror->fd);
+  if (mirror->idx_fd >= 0)
+    close (mirror->idx_fd);
+  mirror->fd = mirror->idx_fd = -1;
+}
+
+static gboolean
+open_file (GstDTAPIMirror * mirror, guint index, gchar ** error)
+{
+  gchar *name = g_strdup_printf ("%s.%06u", mirror->location, index);
+  gchar *idx_name = g_strdup_printf ("%s.idx", name);
+  gboolean ok = FALSE;
+
+  close_file (mirror);
+
+  /* Keeps what we write out of the page cache, which would only be pushing
+     out things that will be needed again.  Not every filesystem has it. */
+  mirror->direct = TRUE;
+  mirror->fd = open (name, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+  if (mirror->fd < 0 && errno == EINVAL) {
+    mirror->direct = FALSE;
+    mirror->fd = open (name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  }
+  if (mirror->fd < 0) {
+    *error = g_strdup_printf ("Can't open %s: %s", name, g_strerror (errno));
+    goto out;
+  }
+  mirror->idx_fd = open (idx_name, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND,
+      0644);
+  if (mirror->idx_fd < 0) {
+    *error = g_strdup_printf ("Can't open %s: %s", idx_name,
+        g_strerror (errno));
+    goto out;
+  }
+
+  mirror->file_index = index;
+  mirror->file_offset = 0;
+  ok = TRUE;
+
+  g_mutex_lock (&mirror->lock);
+  mirror->stats.files++;
+  g_mutex_unlock (&mirror->lock);
+
+  if (mirror->max_files > 0 && index >= mirror->max_files) {
+    g_free (name);
+    g_free (idx_name);
+    name = g_strdup_printf ("%s.%06u", mirror->location,
+        index - mirror->max_files);
+    idx_name = g_strdup_printf ("%s.idx", name);
+    unlink (name);
+    unlink (idx_name);
+  }
+
+out:
+  g_free (name);
+  g_free (idx_name);
+  return ok;
+}
+
+/* Writes a block to the end of the current file, or a new one if it
+   wouldn't fit, and indexes it.  Only the last block can be short, in
+   which case it's padded for O_DIRECT and the padding truncated off. */
+static gboolean
+write_block (GstDTAPIMirror * mirror, Block * block, gchar ** error)
+{
+  gsize len = block->len, padded, done = 0;
+  guint64 entry[2];
+  ssize_t n;
+
+  if (mirror->file_offset > 0 &&
+      mirror->file_offset + len > mirror->max_size &&
+      !open_file (mirror, mirror->file_index + 1, error))
+    return FALSE;
+
+  padded = (len + DIRECT_ALIGN - 1) / DIRECT_ALIGN * DIRECT_ALIGN;
+  memset (block->data + len, 0, padded - len);
+
+  while (done < padded) {
+    n = pwrite (mirror->fd, block->data + done, padded - done,
+        mirror->file_offset + done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0 && errno == EINVAL && mirror->direct) {
+      /* Some filesystems only say so when it comes to it */
+      mirror->direct = FALSE;
+      fcntl (mirror->fd, F_SETFL, fcntl (mirror->fd, F_GETFL) & ~O_DIRECT);
+      continue;
+    }
+    if (n < 0) {
+      *error = g_strdup_printf ("Writing to %s.%06u failed: %s",
+          mirror->location, mirror->file_index, g_strerror (errno));
+      return FALSE;
+    }
+    done += n;
+  }
+  if (padded != len &&
+      ftruncate (mirror->fd, mirror->file_offset + len) != 0) {
+    *error = g_strdup_printf ("Truncating %s.%06u failed: %s",
+        mirror->location, mirror->file_index, g_strerror (errno));
+    return FALSE;
+  }
+
+  entry[0] = GUINT64_TO_LE ((guint64) block->time);
+  entry[1] = GUINT64_TO_LE (mirror->file_offset);
+  if (write (mirror->idx_fd, entry, sizeof (entry)) != sizeof (entry)) {
+    *error = g_strdup_printf ("Writing to %s.%06u.idx failed: %s",
+        mirror->location, mirror->file_index, g_strerror (errno));
+    return FALSE;
+  }
+
+  mirror->file_offset += len;
+  return TRUE;
+}
+
+static gpointer
+mirror_thread (gpointer user_data)
+{
+  GstDTAPIMirror *mirror = (GstDTAPIMirror *) user_data;
+  gchar *error = NULL;
+  Block *block;
+  gboolean ok;
+
+  g_mutex_lock (&mirror->lock);
+  for (;;) {
+    while (mirror->queued == 0 && !mirror->stopping)
+      g_cond_wait (&mirror->cond, &mirror->lock);
+    if (mirror->queued == 0)
+      break;
+    block = &mirror->blocks[(mirror->fill + N_BLOCKS - mirror->queued) %
+        N_BLOCKS];
+    g_mutex_unlock (&mirror->lock);
+
+    ok = write_block (mirror, block, &error);
+
+    g_mutex_lock (&mirror->lock);
+    if (!ok) {
+      mirror->error = error;
+      break;
+    }
+    mirror->stats.written += block->len;
+    block->len = 0;
+    mirror->queued--;
+  }
+  g_mutex_unlock (&mirror->lock);
+
+  close_file (mirror);
+  return NULL;
+}
+
+GstDTAPIMirror *
+gst_dtapi_mirror_new (const gchar * location, guint64 max_size,
+    guint max_files, gchar ** error)
+{
+  GstDTAPIMirror *mirror = g_new0 (GstDTAPIMirror, 1);
+  GError *err = NULL;
+  int ret, i;
+
+  mirror->location = g_strdup (location);
+  mirror->max_size = max_size;
+  mirror->max_files = max_files;
+  mirror->fd = mirror->idx_fd = -1;
+  g_mutex_init (&mirror->lock);
+  g_cond_init (&mirror->cond);
+
+  if ((ret = posix_memalign ((void **) &mirror->memory, DIRECT_ALIGN,
+              (gsize) BLOCK_SIZE * N_BLOCKS)) != 0) {
+    mirror->memory = NULL;
+    *error = g_strdup_printf ("Can't allocate the mirror: %s",
+        g_strerror (ret));
+    goto fail;
+  }
+  for (i = 0; i < N_BLOCKS; i++)
+    mirror->blocks[i].data = mirror->memory + (gsize) i * BLOCK_SIZE;
+
+  /* Here rather than in the thread so a bad location is found straight
+     away */
+  if (!open_file (mirror, 0, error))
+    goto fail;
+
+  mirror->thread = g_thread_try_new ("dtapi-mirror", mirror_thread, mirror,
+      &err);
+  if (mirror->thread == NULL) {
+    *error = g_strdup_printf ("Can't start the mirror: %s", err->message);
+    g_error_free (err);
+    goto fail;
+  }
+  return mirror;
+
+fail:
+  gst_dtapi_mirror_free (mirror);
+  return NULL;
+}
+
+/* Hands the block being filled to the thread, or drops it if the thread
+   is too far behind.  Returns FALSE if the thread has failed. */
+static gboolean
+push_block (GstDTAPIMirror * mirror, gchar ** error)
+{
+  Block *block = &mirror->blocks[mirror->fill];
+  gboolean ok = TRUE;
+
+  g_mutex_lock (&mirror->lock);
+  if (mirror->queued < N_BLOCKS - 1) {
+    mirror->queued++;
+    mirror->fill = (mirror->fill + 1) % N_BLOCKS;
+    g_cond_signal (&mirror->cond);
+  } else {
+    mirror->stats.dropped += block->len;
+    block->len = 0;
+  }
+  if (G_UNLIKELY (mirror->error && !mirror->error_reported)) {
+    *error = g_strdup (mirror->error);
+    mirror->error_reported = TRUE;
+    ok = FALSE;
+  }
+  g_mutex_unlock (&mirror->lock);
+  return ok;
+}
+
+void
+gst_dtapi_mirror_free (GstDTAPIMirror * mirror)
+{
+  gchar *error = NULL;
+
+  if (mirror->thread) {
+    if (mirror->blocks[mirror->fill].len > 0)
+      push_block (mirror, &error);
+    g_free (error);
+
+    g_mutex_lock (&mirror->lock);
+    mirror->stopping = TRUE;
+    g_cond_signal (&mirror->cond);
+    g_mutex_unlock (&mirror->lock);
+    g_thread_join (mirror->thread);
+  }
+
+  close_file (mirror);
+  free (mirror->memory);
+  g_mutex_clear (&mirror->lock);
+  g_cond_clear (&mirror->cond);
+  g_free (mirror->error);
+  g_free (mirror->location);
+  g_free (mirror);
+}
+
+gboolean
+gst_dtapi_mirror_write (GstDTAPIMirror * mirror, const guint8 * data,
+    gsize len, gchar ** error)
+{
+  Block *block;
+  gsize n;
+
+  while (len > 0) {
+    block = &mirror->blocks[mirror->fill];
+    if (block->len == 0)
+      block->time = g_get_real_time ();
+    n = MIN (len, BLOCK_SIZE - block->len);
+    memcpy (block->data + block->len, data, n);
+    block->len += n;
+    data += n;
+    len -= n;
+    if (block->len == BLOCK_SIZE && !push_block (mirror, error))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+void
+gst_dtapi_mirror_get_stats (GstDTAPIMirror * mirror,
+    GstDTAPIMirrorStats * stats)
+{
+  g_mutex_lock (&mirror->lock);
+  *stats = mirror->stats;
+  g_mutex_unlock (&mirror->lock);
+}
@@ -0,0 +1,65 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * gstdtapimirror.h: record of what was transmitted
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_DTAPI_MIRROR_H__
+#define __GST_DTAPI_MIRROR_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Keeps a copy of everything written to it in a series of files, each
+   location.NNNNNN, starting a new one every max_size bytes and deleting
+   the oldest once there are more than max_files (unless that's 0).  The
+   caller's data is copied into a queue of blocks which a thread of its own
+   writes out, with O_DIRECT where the filesystem allows, so a slow disk
+   never holds the caller up: if the queue fills, data is dropped instead.
+
+   Next to each file is location.NNNNNN.idx, the wall clock time each block
+   was started at (in us since the epoch) and its offset in the file, as
+   pairs of little endian 64 bit integers. */
+typedef struct _GstDTAPIMirror GstDTAPIMirror;
+
+typedef struct
+{
+  /* Bytes that have reached the files and that had to be dropped */
+  guint64 written;
+  guint64 dropped;
+  guint files;
+} GstDTAPIMirrorStats;
+
+/* Returns NULL and sets *error if the first file can't be opened */
+GstDTAPIMirror *gst_dtapi_mirror_new (const gchar * location,
+    guint64 max_size, guint max_files, gchar ** error);
+/* Writes out everything queued first */
+void gst_dtapi_mirror_free (GstDTAPIMirror * mirror);
+
+/* Queues data to be written.  Returns FALSE and sets *error, once, if the
+   thread has given up because the files couldn't be written. */
+gboolean gst_dtapi_mirror_write (GstDTAPIMirror * mirror,
+    const guint8 * data, gsize len, gchar ** error);
+
+void gst_dtapi_mirror_get_stats (GstDTAPIMirror * mirror,
+    GstDTAPIMirrorStats * stats);
+
+G_END_DECLS
+#endif /* __GST_DTAPI_MIRROR_H__ */
@@ -0,0 +1,739 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * gstdtapimodpars.cpp: modulation parameters for the supported standards
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "gstdtapimodpars.h"
+
+/* DVB-S2 BCH information bits per FEC frame (EN 302 307 tables 5a and 5b).
+   The short frame code rates are nominal and 9/10 doesn't exist. */
+typedef struct {
+  int code_rate;
+  int k_bch_normal;
+  int k_bch_short;
+} DvbS2FrameInfo;
+
+static const DvbS2FrameInfo dvbs2_frames[] = {
+  {DTAPI_MOD_1_4,  16008, 3072},
+  {DTAPI_MOD_1_3,  21408, 5232},
+  {DTAPI_MOD_2_5,  25728, 6312},
+  {DTAPI_MOD_1_2,  32208, 7032},
+  {DTAPI_MOD_3_5,  38688, 9552},
+  {DTAPI_MOD_2_3,  43040, 10632},
+  {DTAPI_MOD_3_4,  48408, 11712},
+  {DTAPI_MOD_4_5,  51648, 12432},
+  {DTAPI_MOD_5_6,  53840, 13152},
+  {DTAPI_MOD_8_9,  57472, 14232},
+  {DTAPI_MOD_9_10, 58192, 0},
+};
+
+static gboolean
+code_rate_to_fraction (int code_rate, int* num, int* den)
+{
+  switch (code_rate) {
+  case DTAPI_MOD_1_2:  *num = 1; *den = 2;  return TRUE;
+  case DTAPI_MOD_2_3:  *num = 2; *den = 3;  return TRUE;
+  case DTAPI_MOD_3_4:  *num = 3; *den = 4;  return TRUE;
+  case DTAPI_MOD_4_5:  *num = 4; *den = 5;  return TRUE;
+  case DTAPI_MOD_5_6:  *num = 5; *den = 6;  return TRUE;
+  case DTAPI_MOD_6_7:  *num = 6; *den = 7;  return TRUE;
+  case DTAPI_MOD_7_8:  *num = 7; *den = 8;  return TRUE;
+  case DTAPI_MOD_1_4:  *num = 1; *den = 4;  return TRUE;
+  case DTAPI_MOD_1_3:  *num = 1; *den = 3;  return TRUE;
+  case DTAPI_MOD_2_5:  *num = 2; *den = 5;  return TRUE;
+  case DTAPI_MOD_3_5:  *num = 3; *den = 5;  return TRUE;
+  case DTAPI_MOD_8_9:  *num = 8; *den = 9;  return TRUE;
+  case DTAPI_MOD_9_10: *num = 9; *den = 10; return TRUE;
+  default:
+    return FALSE;
+  }
+}
+
+/* Is code_rate one of the rates listed (terminated by -1)? */
+static gboolean
+code_rate_in (int code_rate, const int* rates)
+{
+  for (; *rates != -1; rates++) {
+    if (*rates == code_rate)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+static int
+constellation_bits (GstDTAPIConstellation constellation)
+{
+  switch (constellation) {
+  case GST_DTAPI_CONSTELLATION_QPSK:   return 2;
+  case GST_DTAPI_CONSTELLATION_QAM16:  return 4;
+  case GST_DTAPI_CONSTELLATION_QAM32:  return 5;
+  case GST_DTAPI_CONSTELLATION_QAM64:  return 6;
+  case GST_DTAPI_CONSTELLATION_QAM128: return 7;
+  case GST_DTAPI_CONSTELLATION_QAM256: return 8;
+  case GST_DTAPI_CONSTELLATION_8PSK:   return 3;
+  case GST_DTAPI_CONSTELLATION_16APSK: return 4;
+  case GST_DTAPI_CONSTELLATION_32APSK: return 5;
+  case GST_DTAPI_CONSTELLATION_8VSB:   return 2;
+  case GST_DTAPI_CONSTELLATION_16VSB:  return 4;
+  default:                             return 0;
+  }
+}
+
+static int
+bandwidth_mhz (int mod_param)
+{
+  switch (mod_param & DTAPI_MOD_DVBT_BW_MSK) {
+  case DTAPI_MOD_DVBT_5MHZ: return 5;
+  case DTAPI_MOD_DVBT_6MHZ: return 6;
+  case DTAPI_MOD_DVBT_7MHZ: return 7;
+  case DTAPI_MOD_DVBT_8MHZ: return 8;
+  default:                  return 0;
+  }
+}
+
+/* Returns the denominator of the guard interval fraction */
+static int
+guard_denominator (int mod_param)
+{
+  switch (mod_param & DTAPI_MOD_DVBT_GU_MSK) {
+  case DTAPI_MOD_DVBT_G_1_32: return 32;
+  case DTAPI_MOD_DVBT_G_1_16: return 16;
+  case DTAPI_MOD_DVBT_G_1_8:  return 8;
+  case DTAPI_MOD_DVBT_G_1_4:  return 4;
+  default:                    return 0;
+  }
+}
+
+/* Useful bitrate of a DVB-T stream carrying bits_per_carrier bits on every
+   data carrier, as in EN 300 744 Annex A.  The elementary period is
+   7/(8 * bandwidth) us and there are always 1512 data carriers for every 2048
+   samples, whatever the transmission mode, so that drops out. */
+static int
+dvbt_ts_rate (int mod_param, int bits_per_carrier, int code_rate)
+{
+  gint64 bw_mhz, guard, num, den;
+  int cr_num, cr_den;
+
+  bw_mhz = bandwidth_mhz (mod_param);
+  guard = guard_denominator (mod_param);
+  if (bw_mhz == 0 || guard == 0 ||
+      !code_rate_to_fraction (code_rate, &cr_num, &cr_den))
+    return 0;
+
+  num = 8000000 * bw_mhz * 1512 * bits_per_carrier * cr_num * 188 * guard;
+  den = 7 * 2048 * (gint64) cr_den * 204 * (guard + 1);
+  return (int) (num / den);
+}
+
+/* J.83 annex B doesn't use the 188/204 RS framing of annexes A and C.  An
+   FEC frame is 60 (64-QAM) or 88 (256-QAM) RS(128,122) blocks of 7 bit
+   symbols plus a 42 or 40 bit sync trailer, and is trellis coded at 14/15
+   or 19/20 respectively. */
+static int
+j83b_ts_rate (GstDTAPIConstellation constellation, gint64 symbol_rate)
+{
+  switch (constellation) {
+  case GST_DTAPI_CONSTELLATION_QAM64:
+    return (int) (symbol_rate * 6 * 14 * (60 * 122 * 7)
+                  / (15 * (60 * 128 * 7 + 42)));
+  case GST_DTAPI_CONSTELLATION_QAM256:
+    return (int) (symbol_rate * 8 * 19 * (88 * 122 * 7)
+                  / (20 * (88 * 128 * 7 + 40)));
+  default:
+    return 0;
+  }
+}
+
+/* ATSC A/53: 832 symbol segments of which 4 are segment sync, 313 segments
+   per field of which one is field sync, and each data segment carries one
+   187 byte packet (the sync byte is implied) */
+#define ATSC_SYMBOL_RATE 10762238
+
+static int
+atsc_ts_rate (GstDTAPIConstellation constellation)
+{
+  gint64 rate = (gint64) ATSC_SYMBOL_RATE * 188 * 8 * 312 / (832 * 313);
+  return constellation == GST_DTAPI_CONSTELLATION_16VSB ? 2 * rate : rate;
+}
+
+/* ISDB-T with all 13 segments in layer A.  Each segment has 96 data carriers
+   per 252 us symbol in mode 1 at 6 MHz, doubling with each mode as the
+   symbols get longer, so as with DVB-T the mode drops out. */
+static int
+isdbt_ts_rate (const GstDTAPIModPars * pars)
+{
+  gint64 bw_mhz, guard, bits, num, den;
+  int cr_num, cr_den;
+
+  bw_mhz = bandwidth_mhz (pars->mod_param);
+  guard = guard_denominator (pars->mod_param);
+  bits = constellation_bits (pars->constellation);
+  if (bw_mhz == 0 || guard == 0 ||
+      !code_rate_to_fraction (pars->code_rate, &cr_num, &cr_den))
+    return 0;
+
+  num = 13 * 96 * bits * cr_num * 188 * guard * bw_mhz * 1000000;
+  den = 252 * 6 * (gint64) cr_den * 204 * (guard + 1);
+  return (int) (num / den);
+}
+
+/* DVB-S2 in normal (non-ISSY, CRC-8 replacing the sync byte) TS mode: each
+   PLFRAME carries K_bch - 80 bits of user packets after the BBHEADER and
+   takes a 90 symbol PLHEADER, the slots of 90 symbols and, with pilots, 36
+   pilot symbols after every 16 slots bar the last. */
+static int
+dvbs2_ts_rate (const GstDTAPIModPars * pars)
+{
+  int bits = constellation_bits (pars->constellation);
+  int k_bch = 0;
+  gint64 slots, frame_symbols;
+  size_t i;
+
+  for (i = 0; i < G_N_ELEMENTS (dvbs2_frames); i++) {
+    if (dvbs2_frames[i].code_rate == pars->code_rate) {
+      k_bch = pars->short_frames ? dvbs2_frames[i].k_bch_short
+                                 : dvbs2_frames[i].k_bch_normal;
+      break;
+    }
+  }
+  if (k_bch == 0 || bits == 0)
+    return 0;
+
+  slots = (pars->short_frames ? 16200 : 64800) / (90 * bits);
+  frame_symbols = 90 + slots * 90;
+  if (pars->pilots)
+    frame_symbols += ((slots - 1) / 16) * 36;
+
+  return (int) ((gint64) pars->symbol_rate * (k_bch - 80) / frame_symbols);
+}
+
+static int
+dvbt2_bandwidth (int mod_param)
+{
+  switch (mod_param & DTAPI_MOD_DVBT_BW_MSK) {
+  case DTAPI_MOD_DVBT_5MHZ: return DTAPI_DVBT2_5MHZ;
+  case DTAPI_MOD_DVBT_6MHZ: return DTAPI_DVBT2_6MHZ;
+  case DTAPI_MOD_DVBT_7MHZ: return DTAPI_DVBT2_7MHZ;
+  case DTAPI_MOD_DVBT_8MHZ: return DTAPI_DVBT2_8MHZ;
+  default:                  return -1;
+  }
+}
+
+static int
+dvbt2_modulation (GstDTAPIConstellation constellation)
+{
+  switch (constellation) {
+  case GST_DTAPI_CONSTELLATION_QPSK:   return DTAPI_DVBT2_QPSK;
+  case GST_DTAPI_CONSTELLATION_QAM16:  return DTAPI_DVBT2_QAM16;
+  case GST_DTAPI_CONSTELLATION_QAM64:  return DTAPI_DVBT2_QAM64;
+  case GST_DTAPI_CONSTELLATION_QAM256: return DTAPI_DVBT2_QAM256;
+  default:                             return -1;
+  }
+}
+
+static int
+dvbt2_code_rate (int code_rate)
+{
+  switch (code_rate) {
+  case DTAPI_MOD_1_2: return DTAPI_DVBT2_COD_1_2;
+  case DTAPI_MOD_3_5: return DTAPI_DVBT2_COD_3_5;
+  case DTAPI_MOD_2_3: return DTAPI_DVBT2_COD_2_3;
+  case DTAPI_MOD_3_4: return DTAPI_DVBT2_COD_3_4;
+  case DTAPI_MOD_4_5: return DTAPI_DVBT2_COD_4_5;
+  case DTAPI_MOD_5_6: return DTAPI_DVBT2_COD_5_6;
+  default:            return -1;
+  }
+}
+
+/* The DVB-T2 frame structure (L1 signalling, FEC blocks per frame, dummy
+   cells...) is complicated enough that we let DTAPI work out the number of
+   FEC blocks and data symbols, and from those the rate. */
+static DTAPI_RESULT
+fill_dvbt2_pars (const GstDTAPIModPars * pars, DtDvbT2Pars & t2)
+{
+  DtDvbT2ParamInfo info;
+  DTAPI_RESULT result;
+  int i, blocks;
+
+  t2.Init ();
+  t2.m_Bandwidth = dvbt2_bandwidth (pars->mod_param);
+  t2.m_FftMode = pars->t2_fft_mode;
+  t2.m_GuardInterval = pars->t2_guard;
+  t2.m_PilotPattern = pars->t2_pilot_pattern;
+
+  if (pars->t2_num_plps <= 1) {
+    t2.m_NumPlps = 1;
+    t2.m_Plps[0].Init ();
+    t2.m_Plps[0].m_Modulation = dvbt2_modulation (pars->constellation);
+    t2.m_Plps[0].m_CodeRate = dvbt2_code_rate (pars->code_rate);
+    t2.m_Plps[0].m_FecType = pars->t2_fec_type;
+
+    result = t2.OptimisePlpNumBlocks (info, t2.m_Plps[0].m_NumBlocks,
+                                      t2.m_NumDataSyms);
+    if (result != DTAPI_OK)
+      return result;
+    return t2.CheckValidity ();
+  }
+
+  /* Each PLP gets its share of the cells in the frame.  The number of FEC
+     blocks it would need to fill the frame on its own scales linearly with
+     that, so ask DTAPI for that and scale it down. */
+  t2.m_NumPlps = pars->t2_num_plps;
+  for (i = 0; i < pars->t2_num_plps; i++) {
+    DtDvbT2Pars alone = t2;
+    const GstDTAPIPlpPars *plp = &pars->t2_plps[i];
+
+    t2.m_Plps[i].Init ();
+    t2.m_Plps[i].m_Id = i;
+    t2.m_Plps[i].m_Modulation = dvbt2_modulation (plp->constellation);
+    t2.m_Plps[i].m_CodeRate = dvbt2_code_rate (plp->code_rate);
+    t2.m_Plps[i].m_FecType = pars->t2_fec_type;
+
+    alone.m_NumPlps = 1;
+    alone.m_Plps[0] = t2.m_Plps[i];
+    result = alone.OptimisePlpNumBlocks (info, blocks, t2.m_NumDataSyms);
+    if (result != DTAPI_OK)
+      return result;
+    t2.m_Plps[i].m_NumBlocks = MAX (1, blocks * plp->share / 100);
+  }
+  return t2.CheckValidity ();
+}
+
+static int
+dvbt2_ts_rate (const GstDTAPIModPars * pars, int plp)
+{
+  DtDvbT2Pars t2;
+  int rate;
+
+  if (fill_dvbt2_pars (pars, t2) != DTAPI_OK)
+    return 0;
+  if (DtapiModPars2TsRate (rate, t2, plp) != DTAPI_OK)
+    return 0;
+  return rate;
+}
+
+static int
+isdbt_modulation (GstDTAPIConstellation constellation)
+{
+  switch (constellation) {
+  case GST_DTAPI_CONSTELLATION_QPSK:  return DTAPI_ISDBT_MOD_QPSK;
+  case GST_DTAPI_CONSTELLATION_QAM16: return DTAPI_ISDBT_MOD_QAM16;
+  case GST_DTAPI_CONSTELLATION_QAM64: return DTAPI_ISDBT_MOD_QAM64;
+  default:                            return -1;
+  }
+}
+
+static int
+isdbt_code_rate (int code_rate)
+{
+  switch (code_rate) {
+  case DTAPI_MOD_1_2: return DTAPI_ISDBT_RATE_1_2;
+  case DTAPI_MOD_2_3: return DTAPI_ISDBT_RATE_2_3;
+  case DTAPI_MOD_3_4: return DTAPI_ISDBT_RATE_3_4;
+  case DTAPI_MOD_5_6: return DTAPI_ISDBT_RATE_5_6;
+  case DTAPI_MOD_7_8: return DTAPI_ISDBT_RATE_7_8;
+  default:            return -1;
+  }
+}
+
+static void
+fill_isdbt_pars (const GstDTAPIModPars * pars, DtIsdbtPars & isdbt)
+{
+  int i;
+
+  isdbt.m_DoMux = true;
+  isdbt.m_BType = DTAPI_ISDBT_BTYPE_TV;
+  isdbt.m_PartialRx = false;
+
+  switch (pars->mod_param & DTAPI_MOD_DVBT_BW_MSK) {
+  case DTAPI_MOD_DVBT_6MHZ: isdbt.m_Bandwidth = DTAPI_ISDBT_BW_6MHZ; break;
+  case DTAPI_MOD_DVBT_7MHZ: isdbt.m_Bandwidth = DTAPI_ISDBT_BW_7MHZ; break;
+  default:                  isdbt.m_Bandwidth = DTAPI_ISDBT_BW_8MHZ; break;
+  }
+  switch (pars->mod_param & DTAPI_MOD_DVBT_MD_MSK) {
+  case DTAPI_MOD_DVBT_2K: isdbt.m_Mode = 1; break;
+  case DTAPI_MOD_DVBT_4K: isdbt.m_Mode = 2; break;
+  default:                isdbt.m_Mode = 3; break;
+  }
+  switch (pars->mod_param & DTAPI_MOD_DVBT_GU_MSK) {
+  case DTAPI_MOD_DVBT_G_1_32: isdbt.m_Guard = DTAPI_ISDBT_GUARD_1_32; break;
+  case DTAPI_MOD_DVBT_G_1_16: isdbt.m_Guard = DTAPI_ISDBT_GUARD_1_16; break;
+  case DTAPI_MOD_DVBT_G_1_8:  isdbt.m_Guard = DTAPI_ISDBT_GUARD_1_8;  break;
+  default:                    isdbt.m_Guard = DTAPI_ISDBT_GUARD_1_4;  break;
+  }
+
+  for (i = 0; i < 3; i++)
+    isdbt.m_LayerPars[i].m_NumSegments = 0;
+  isdbt.m_LayerPars[0].m_NumSegments = 13;
+  isdbt.m_LayerPars[0].m_ModType = isdbt_modulation (pars->constellation);
+  isdbt.m_LayerPars[0].m_CodeRate = isdbt_code_rate (pars->code_rate);
+  isdbt.m_LayerPars[0].m_TimeInterleave = 0;
+}
+
+static int
+qam_mod_type (GstDTAPIConstellation constellation)
+{
+  switch (constellation) {
+  case GST_DTAPI_CONSTELLATION_QAM16:  return DTAPI_MOD_QAM16;
+  case GST_DTAPI_CONSTELLATION_QAM32:  return DTAPI_MOD_QAM32;
+  case GST_DTAPI_CONSTELLATION_QAM64:  return DTAPI_MOD_QAM64;
+  case GST_DTAPI_CONSTELLATION_QAM128: return DTAPI_MOD_QAM128;
+  case GST_DTAPI_CONSTELLATION_QAM256: return DTAPI_MOD_QAM256;
+  default:                             return -1;
+  }
+}
+
+static int
+dvbs2_mod_type (GstDTAPIConstellation constellation)
+{
+  switch (constellation) {
+  case GST_DTAPI_CONSTELLATION_QPSK:   return DTAPI_MOD_DVBS2_QPSK;
+  case GST_DTAPI_CONSTELLATION_8PSK:   return DTAPI_MOD_DVBS2_8PSK;
+  case GST_DTAPI_CONSTELLATION_16APSK: return DTAPI_MOD_DVBS2_16APSK;
+  case GST_DTAPI_CONSTELLATION_32APSK: return DTAPI_MOD_DVBS2_32APSK;
+  default:                             return -1;
+  }
+}
+
+static int
+dvbt_constellation_bits (GstDTAPIConstellation constellation)
+{
+  switch (constellation) {
+  case GST_DTAPI_CONSTELLATION_QPSK:  return DTAPI_MOD_DVBT_QPSK;
+  case GST_DTAPI_CONSTELLATION_QAM16: return DTAPI_MOD_DVBT_QAM16;
+  default:                            return DTAPI_MOD_DVBT_QAM64;
+  }
+}
+
+void
+gst_dtapi_mod_pars_init (GstDTAPIModPars * pars)
+{
+  pars->standard = GST_DTAPI_STANDARD_DVBT;
+  pars->constellation = GST_DTAPI_CONSTELLATION_QAM64;
+  pars->code_rate = DTAPI_MOD_2_3;
+  pars->mod_param = DTAPI_MOD_DVBT_8MHZ | DTAPI_MOD_DVBT_NATIVE
+                  | DTAPI_MOD_DVBT_G_1_32 | DTAPI_MOD_DVBT_8K;
+  pars->symbol_rate = 6900000;
+  pars->pilots = FALSE;
+  pars->short_frames = FALSE;
+  pars->t2_fft_mode = DTAPI_DVBT2_FFT_32K;
+  pars->t2_guard = DTAPI_DVBT2_GI_1_128;
+  pars->t2_pilot_pattern = DTAPI_DVBT2_PP_7;
+  pars->t2_fec_type = DTAPI_DVBT2_LDPC_64K;
+  pars->t2_num_plps = 1;
+}
+
+const char *
+gst_dtapi_mod_pars_validate (const GstDTAPIModPars * pars)
+{
+  static const int dvbt_rates[] = {DTAPI_MOD_1_2, DTAPI_MOD_2_3,
+      DTAPI_MOD_3_4, DTAPI_MOD_5_6, DTAPI_MOD_7_8, -1};
+  static const int dvbt2_rates[] = {DTAPI_MOD_1_2, DTAPI_MOD_3_5,
+      DTAPI_MOD_2_3, DTAPI_MOD_3_4, DTAPI_MOD_4_5, DTAPI_MOD_5_6, -1};
+  GstDTAPIConstellation c = pars->constellation;
+
+  switch (pars->standard) {
+  case GST_DTAPI_STANDARD_DVBT:
+    if (c != GST_DTAPI_CONSTELLATION_QPSK && c != GST_DTAPI_CONSTELLATION_QAM16
+        && c != GST_DTAPI_CONSTELLATION_QAM64)
+      return "DVB-T requires QPSK, QAM 16 or QAM 64";
+    if (!code_rate_in (pars->code_rate, dvbt_rates))
+      return "Invalid code rate for DVB-T";
+    break;
+  case GST_DTAPI_STANDARD_J83A:
+  case GST_DTAPI_STANDARD_J83C:
+    if (c < GST_DTAPI_CONSTELLATION_QAM16 || c > GST_DTAPI_CONSTELLATION_QAM256)
+      return "J.83 requires a QAM constellation";
+    if (pars->symbol_rate <= 0)
+      return "J.83 requires a symbol rate";
+    break;
+  case GST_DTAPI_STANDARD_J83B:
+    if (c != GST_DTAPI_CONSTELLATION_QAM64 && c != GST_DTAPI_CONSTELLATION_QAM256)
+      return "J.83 annex B requires QAM 64 or QAM 256";
+    if (pars->symbol_rate <= 0)
+      return "J.83 requires a symbol rate";
+    break;
+  case GST_DTAPI_STANDARD_ATSC:
+    if (c != GST_DTAPI_CONSTELLATION_8VSB && c != GST_DTAPI_CONSTELLATION_16VSB)
+      return "ATSC requires 8-VSB or 16-VSB";
+    break;
+  case GST_DTAPI_STANDARD_ISDBT:
+    if (isdbt_modulation (c) == -1)
+      return "ISDB-T requires QPSK, QAM 16 or QAM 64";
+    if (isdbt_code_rate (pars->code_rate) == -1)
+      return "Invalid code rate for ISDB-T";
+    if (bandwidth_mhz (pars->mod_param) < 6)
+      return "ISDB-T requires a bandwidth of 6, 7 or 8 MHz";
+    break;
+  case GST_DTAPI_STANDARD_DVBS2: {
+    int num, den;
+    if (dvbs2_mod_type (c) == -1)
+      return "DVB-S2 requires QPSK, 8PSK, 16APSK or 32APSK";
+    if (pars->symbol_rate <= 0)
+      return "DVB-S2 requires a symbol rate";
+    if (dvbs2_ts_rate (pars) == 0 ||
+        !code_rate_to_fraction (pars->code_rate, &num, &den))
+      return "Invalid code rate for DVB-S2";
+    /* The higher order constellations don't define the low code rates */
+    if ((c == GST_DTAPI_CONSTELLATION_8PSK && num * 5 < den * 3) ||
+        (c == GST_DTAPI_CONSTELLATION_16APSK && num * 3 < den * 2) ||
+        (c == GST_DTAPI_CONSTELLATION_32APSK && num * 4 < den * 3))
+      return "Code rate is too low for the DVB-S2 constellation";
+    break;
+  }
+  case GST_DTAPI_STANDARD_DVBT2:
+    if (pars->t2_num_plps > 1) {
+      int i, total = 0;
+
+      if (pars->t2_num_plps > GST_DTAPI_MAX_PLPS)
+        return "Too many PLPs";
+      for (i = 0; i < pars->t2_num_plps; i++) {
+        const GstDTAPIPlpPars *plp = &pars->t2_plps[i];
+        if (dvbt2_modulation (plp->constellation) == -1)
+          return "DVB-T2 PLPs require QPSK, QAM 16, QAM 64 or QAM 256";
+        if (!code_rate_in (plp->code_rate, dvbt2_rates))
+          return "Invalid code rate for DVB-T2 PLP";
+        if (plp->share <= 0)
+          return "Every DVB-T2 PLP needs a share of the frame";
+        total += plp->share;
+      }
+      if (total > 100)
+        return "DVB-T2 PLP shares add up to more than 100%";
+      break;
+    }
+    if (dvbt2_modulation (c) == -1)
+      return "DVB-T2 requires QPSK, QAM 16, QAM 64 or QAM 256";
+    if (!code_rate_in (pars->code_rate, dvbt2_rates))
+      return "Invalid code rate for DVB-T2";
+    break;
+  default:
+    return "Unknown standard";
+  }
+  return NULL;
+}
+
+gboolean
+gst_dtapi_mod_pars_equal (const GstDTAPIModPars * a,
+    const GstDTAPIModPars * b)
+{
+  int i;
+
+  if (a->standard != b->standard ||
+      a->constellation != b->constellation ||
+      a->code_rate != b->code_rate ||
+      a->mod_param != b->mod_param ||
+      a->symbol_rate != b->symbol_rate ||
+      !a->pilots != !b->pilots ||
+      !a->short_frames != !b->short_frames ||
+      a->t2_fft_mode != b->t2_fft_mode ||
+      a->t2_guard != b->t2_guard ||
+      a->t2_pilot_pattern != b->t2_pilot_pattern ||
+      a->t2_fec_type != b->t2_fec_type ||
+      MAX (a->t2_num_plps, 1) != MAX (b->t2_num_plps, 1))
+    return FALSE;
+
+  for (i = 0; a->t2_num_plps > 1 && i < a->t2_num_plps; i++) {
+    if (a->t2_plps[i].constellation != b->t2_plps[i].constellation ||
+        a->t2_plps[i].code_rate != b->t2_plps[i].code_rate ||
+        a->t2_plps[i].share != b->t2_plps[i].share)
+      return FALSE;
+  }
+  return TRUE;
+}
+
+int
+gst_dtapi_mod_pars_capacity (const GstDTAPIModPars * pars)
+{
+  switch (pars->standard) {
+  case GST_DTAPI_STANDARD_DVBT:
+    return dvbt_ts_rate (pars->mod_param, constellation_bits (pars->constellation),
+                         pars->code_rate);
+  case GST_DTAPI_STANDARD_J83A:
+  case GST_DTAPI_STANDARD_J83C:
+    return (int) ((gint64) pars->symbol_rate
+                  * constellation_bits (pars->constellation) * 188 / 204);
+  case GST_DTAPI_STANDARD_J83B:
+    return j83b_ts_rate (pars->constellation, pars->symbol_rate);
+  case GST_DTAPI_STANDARD_ATSC:
+    return atsc_ts_rate (pars->constellation);
+  case GST_DTAPI_STANDARD_ISDBT:
+    return isdbt_ts_rate (pars);
+  case GST_DTAPI_STANDARD_DVBS2:
+    return dvbs2_ts_rate (pars);
+  case GST_DTAPI_STANDARD_DVBT2: {
+    int i, total = 0;
+    for (i = 0; i < MAX (pars->t2_num_plps, 1); i++)
+      total += dvbt2_ts_rate (pars, i);
+    return total;
+  }
+  default:
+    return 0;
+  }
+}
+
+int
+gst_dtapi_mod_pars_plp_capacity (const GstDTAPIModPars * pars, int plp)
+{
+  if (pars->standard != GST_DTAPI_STANDARD_DVBT2 ||
+      plp >= MAX (pars->t2_num_plps, 1))
+    return 0;
+  return dvbt2_ts_rate (pars, plp);
+}
+
+int
+gst_dtapi_mod_pars_ts_rate (const GstDTAPIModPars * pars, int ts_rate_bps)
+{
+  int capacity = gst_dtapi_mod_pars_capacity (pars);
+  if (ts_rate_bps == 0 || ts_rate_bps > capacity)
+    return capacity;
+  return ts_rate_bps;
+}
+
+DTAPI_RESULT
+gst_dtapi_mod_pars_apply (const GstDTAPIModPars * pars, DtOutpChannel * out)
+{
+  DTAPI_RESULT result;
+
+  switch (pars->standard) {
+  case GST_DTAPI_STANDARD_DVBT:
+    return out->SetModControl (DTAPI_MOD_DVBT, pars->code_rate,
+        pars->mod_param | dvbt_constellation_bits (pars->constellation), -1);
+  case GST_DTAPI_STANDARD_J83A:
+  case GST_DTAPI_STANDARD_J83B:
+  case GST_DTAPI_STANDARD_J83C: {
+    int annex = pars->standard == GST_DTAPI_STANDARD_J83A ? DTAPI_MOD_J83_A
+              : pars->standard == GST_DTAPI_STANDARD_J83B ? DTAPI_MOD_J83_B
+              : DTAPI_MOD_J83_C;
+    result = out->SetModControl (qam_mod_type (pars->constellation), annex,
+        pars->standard == GST_DTAPI_STANDARD_J83B ? DTAPI_MOD_QAMB_I128_J1D
+                                                  : -1, -1);
+    if (result != DTAPI_OK)
+      return result;
+    return out->SetSymSampleRate (pars->symbol_rate);
+  }
+  case GST_DTAPI_STANDARD_ATSC:
+    return out->SetModControl (DTAPI_MOD_ATSC,
+        pars->constellation == GST_DTAPI_CONSTELLATION_16VSB
+            ? DTAPI_MOD_ATSC_VSB16 : DTAPI_MOD_ATSC_VSB8, -1, -1);
+  case GST_DTAPI_STANDARD_ISDBT: {
+    DtIsdbtPars isdbt;
+    fill_isdbt_pars (pars, isdbt);
+    return out->SetModControl (isdbt);
+  }
+  case GST_DTAPI_STANDARD_DVBS2:
+    result = out->SetModControl (dvbs2_mod_type (pars->constellation),
+        pars->code_rate,
+        (pars->pilots ? DTAPI_MOD_S2_PILOTS : DTAPI_MOD_S2_NOPILOTS)
+        | (pars->short_frames ? DTAPI_MOD_S2_SHORTFRM : DTAPI_MOD_S2_LONGFRM),
+        0 /* gold code */);
+    if (result != DTAPI_OK)
+      return result;
+    return out->SetSymSampleRate (pars->symbol_rate);
+  case GST_DTAPI_STANDARD_DVBT2: {
+    DtDvbT2Pars t2;
+    if ((result = fill_dvbt2_pars (pars, t2)) != DTAPI_OK)
+      return result;
+    if (pars->t2_num_plps > 1) {
+      /* One TS input FIFO per PLP */
+      DtMplpPars mplp;
+      int i;
+
+      mplp.m_Enabled = true;
+      for (i = 0; i < pars->t2_num_plps; i++) {
+        mplp.m_PlpInps[i].m_DataType = DTAPI_PLPINP_TS188;
+        mplp.m_PlpInps[i].m_FifoIdx = i;
+      }
+      return out->SetModControl (t2, mplp);
+    }
+    return out->SetModControl (t2);
+  }
+  default:
+    return DTAPI_E_MODTYPE_UNSUP;
+  }
+}
+
+gboolean
+gst_dtapi_mod_pars_update (GstDTAPIModPars * pars, int mod_type,
+    int par_xtra_0, int par_xtra_1, int par_xtra_2)
+{
+  switch (mod_type) {
+  case DTAPI_MOD_DVBT:
+    pars->standard = GST_DTAPI_STANDARD_DVBT;
+    pars->code_rate = par_xtra_0;
+    switch (par_xtra_1 & DTAPI_MOD_DVBT_CO_MSK) {
+    case DTAPI_MOD_DVBT_QPSK:
+      pars->constellation = GST_DTAPI_CONSTELLATION_QPSK; break;
+    case DTAPI_MOD_DVBT_QAM16:
+      pars->constellation = GST_DTAPI_CONSTELLATION_QAM16; break;
+    default:
+      pars->constellation = GST_DTAPI_CONSTELLATION_QAM64; break;
+    }
+    pars->mod_param = par_xtra_1 & ~DTAPI_MOD_DVBT_CO_MSK;
+    return TRUE;
+  case DTAPI_MOD_QAM16:
+  case DTAPI_MOD_QAM32:
+  case DTAPI_MOD_QAM64:
+  case DTAPI_MOD_QAM128:
+  case DTAPI_MOD_QAM256:
+    pars->constellation =
+        mod_type == DTAPI_MOD_QAM16 ? GST_DTAPI_CONSTELLATION_QAM16
+      : mod_type == DTAPI_MOD_QAM32 ? GST_DTAPI_CONSTELLATION_QAM32
+      : mod_type == DTAPI_MOD_QAM64 ? GST_DTAPI_CONSTELLATION_QAM64
+      : mod_type == DTAPI_MOD_QAM128 ? GST_DTAPI_CONSTELLATION_QAM128
+      : GST_DTAPI_CONSTELLATION_QAM256;
+    pars->standard = par_xtra_0 == DTAPI_MOD_J83_B ? GST_DTAPI_STANDARD_J83B
+                   : par_xtra_0 == DTAPI_MOD_J83_C ? GST_DTAPI_STANDARD_J83C
+                   : GST_DTAPI_STANDARD_J83A;
+    return TRUE;
+  case DTAPI_MOD_ATSC:
+    pars->standard = GST_DTAPI_STANDARD_ATSC;
+    pars->constellation =
+        (par_xtra_0 & DTAPI_MOD_ATSC_VSB_MSK) == DTAPI_MOD_ATSC_VSB16
+        ? GST_DTAPI_CONSTELLATION_16VSB : GST_DTAPI_CONSTELLATION_8VSB;
+    return TRUE;
+  case DTAPI_MOD_DVBS2_QPSK:
+  case DTAPI_MOD_DVBS2_8PSK:
+  case DTAPI_MOD_DVBS2_16APSK:
+  case DTAPI_MOD_DVBS2_32APSK:
+    pars->standard = GST_DTAPI_STANDARD_DVBS2;
+    pars->constellation =
+        mod_type == DTAPI_MOD_DVBS2_QPSK ? GST_DTAPI_CONSTELLATION_QPSK
+      : mod_type == DTAPI_MOD_DVBS2_8PSK ? GST_DTAPI_CONSTELLATION_8PSK
+      : mod_type == DTAPI_MOD_DVBS2_16APSK ? GST_DTAPI_CONSTELLATION_16APSK
+      : GST_DTAPI_CONSTELLATION_32APSK;
+    pars->code_rate = par_xtra_0;
+    pars->pilots =
+        (par_xtra_1 & DTAPI_MOD_S2_PILOTS_MSK) == DTAPI_MOD_S2_PILOTS;
+    pars->short_frames =
+        (par_xtra_1 & DTAPI_MOD_S2_FRM_MSK) == DTAPI_MOD_S2_SHORTFRM;
+    return TRUE;
+  case DTAPI_MOD_ISDBT:
+  case DTAPI_MOD_DVBT2:
+    /* These are configured with a structure rather than the ParXtra values so
+       there's nothing useful to read back.  What we set is what we've got. */
+    return TRUE;
+  default:
+    return FALSE;
+  }
+}
@@ -0,0 +1,136 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * gstdtapimodpars.h: modulation parameters for the supported standards
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_DTAPI_MOD_PARS_H__
+#define __GST_DTAPI_MOD_PARS_H__
+
+#include <gst/gst.h>
+#include "DTAPI.h"
+
+/* These are C++ only as they deal in DTAPI objects */
+
+typedef enum {
+  GST_DTAPI_STANDARD_DVBT,
+  GST_DTAPI_STANDARD_J83A, /* a.k.a. DVB-C */
+  GST_DTAPI_STANDARD_J83B,
+  GST_DTAPI_STANDARD_J83C,
+  GST_DTAPI_STANDARD_ATSC,
+  GST_DTAPI_STANDARD_ISDBT,
+  GST_DTAPI_STANDARD_DVBS2,
+  GST_DTAPI_STANDARD_DVBT2
+} GstDTAPIStandard;
+
+/* Not every constellation is valid for every standard,
+   gst_dtapi_mod_pars_validate will tell you which */
+typedef enum {
+  GST_DTAPI_CONSTELLATION_QPSK,
+  GST_DTAPI_CONSTELLATION_QAM16,
+  GST_DTAPI_CONSTELLATION_QAM32,
+  GST_DTAPI_CONSTELLATION_QAM64,
+  GST_DTAPI_CONSTELLATION_QAM128,
+  GST_DTAPI_CONSTELLATION_QAM256,
+  GST_DTAPI_CONSTELLATION_8PSK,
+  GST_DTAPI_CONSTELLATION_16APSK,
+  GST_DTAPI_CONSTELLATION_32APSK,
+  GST_DTAPI_CONSTELLATION_8VSB,
+  GST_DTAPI_CONSTELLATION_16VSB
+} GstDTAPIConstellation;
+
+#define GST_DTAPI_MAX_PLPS 8
+
+/* A DVB-T2 PLP when there is more than one of them */
+typedef struct _GstDTAPIPlpPars
+{
+  GstDTAPIConstellation constellation;
+  int code_rate;
+  /* Percentage of the frame given over to this PLP */
+  int share;
+} GstDTAPIPlpPars;
+
+typedef struct _GstDTAPIModPars
+{
+  GstDTAPIStandard standard;
+  GstDTAPIConstellation constellation;
+
+  /* One of DTAPI_MOD_1_2 etc.  Used by every standard with a convolutional
+     or LDPC code. */
+  int code_rate;
+
+  /* DVB-T ParXtra1 bits except the constellation, which lives above.  The
+     bandwidth, guard interval and transmission mode are reused for ISDB-T
+     (as mode 1, 2 and 3) and the bandwidth for DVB-T2. */
+  int mod_param;
+
+  /* J.83 and DVB-S2, in symbols per second */
+  int symbol_rate;
+
+  /* DVB-S2 */
+  gboolean pilots;
+  gboolean short_frames;
+
+  /* DVB-T2.  These take DTAPI_DVBT2_* values directly. */
+  int t2_fft_mode;
+  int t2_guard;
+  int t2_pilot_pattern;
+  int t2_fec_type;
+
+  /* DVB-T2 multi-PLP.  With t2_num_plps <= 1 there is a single PLP using
+     the constellation and code_rate above and t2_plps is ignored. */
+  int t2_num_plps;
+  GstDTAPIPlpPars t2_plps[GST_DTAPI_MAX_PLPS];
+} GstDTAPIModPars;
+
+void gst_dtapi_mod_pars_init (GstDTAPIModPars * pars);
+
+/* Returns NULL if the parameters make sense together or a description of
+   the problem if they don't */
+const char *gst_dtapi_mod_pars_validate (const GstDTAPIModPars * pars);
+
+/* Whether a and b describe the same modulation.  The PLPs are only compared
+   when there is more than one of them, as otherwise they're ignored. */
+gboolean gst_dtapi_mod_pars_equal (const GstDTAPIModPars * a,
+    const GstDTAPIModPars * b);
+
+/* Channel capacity in bits per second of 188 byte TS packets */
+int gst_dtapi_mod_pars_capacity (const GstDTAPIModPars * pars);
+
+/* Capacity of a single DVB-T2 PLP in bits per second */
+int gst_dtapi_mod_pars_plp_capacity (const GstDTAPIModPars * pars, int plp);
+
+/* The TS rate that goes out when ts_rate_bps is asked for: anything short
+   of the capacity is null stuffed by the modulator, anything more than it
+   won't fit and 0 means the capacity */
+int gst_dtapi_mod_pars_ts_rate (const GstDTAPIModPars * pars,
+    int ts_rate_bps);
+
+/* Calls SetModControl (and SetSymSampleRate where relevant).  The channel
+   must be in DTAPI_TXCTRL_IDLE.  For multi-PLP DVB-T2 the data for PLP n is
+   then expected in the channel's FIFO n. */
+DTAPI_RESULT gst_dtapi_mod_pars_apply (const GstDTAPIModPars * pars,
+    DtOutpChannel * out);
+
+/* Update from the values read back from DtOutpChannel::GetModControl.
+   Returns FALSE if the modulation type isn't one we can represent. */
+gboolean gst_dtapi_mod_pars_update (GstDTAPIModPars * pars, int mod_type,
+    int par_xtra_0, int par_xtra_1, int par_xtra_2);
+
+#endif /* __GST_DTAPI_MOD_PARS_H__ */
@@ -0,0 +1,184 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * gstdtapimodprofile.cpp: named sets of modulator settings
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+#include "gstdtapimodprofile.h"
+
+static void
+assign_bits (int *out, int mask, int value)
+{
+  *out = (*out & ~mask) | (value & mask);
+}
+
+/* Puts a value into the profile the way setting the property of the same
+   name on dtapisink would.  Returns FALSE if the key isn't a setting a
+   profile can have. */
+static gboolean
+set_key (GstDTAPIModProfile * profile, const gchar * key, const GValue * value)
+{
+  GstDTAPIModPars *mod = &profile->mod;
+
+  if (strcmp (key, "bitrate") == 0)
+    profile->ts_rate_bps = g_value_get_int (value);
+  else if (strcmp (key, "frequency") == 0)
+    profile->frequency = g_value_get_int64 (value);
+  else if (strcmp (key, "output-power") == 0)
+    /* In 0.1 dBm, as SetOutputLevel wants it */
+    profile->output_power = g_value_get_double (value) * 10;
+  else if (strcmp (key, "standard") == 0)
+    mod->standard = (GstDTAPIStandard) g_value_get_enum (value);
+  else if (strcmp (key, "modulation") == 0)
+    mod->constellation = (GstDTAPIConstellation) g_value_get_enum (value);
+  else if (strcmp (key, "code-rate") == 0)
+    mod->code_rate = g_value_get_enum (value);
+  /* These four make up the mod_param bitmask */
+  else if (strcmp (key, "bandwidth") == 0)
+    assign_bits (&mod->mod_param, DTAPI_MOD_DVBT_BW_MSK,
+        g_value_get_enum (value));
+  else if (strcmp (key, "guard") == 0)
+    assign_bits (&mod->mod_param, DTAPI_MOD_DVBT_GU_MSK,
+        g_value_get_enum (value));
+  else if (strcmp (key, "interleaving") == 0)
+    assign_bits (&mod->mod_param, DTAPI_MOD_DVBT_IL_MSK,
+        g_value_get_enum (value));
+  else if (strcmp (key, "trans-mode") == 0)
+    assign_bits (&mod->mod_param, DTAPI_MOD_DVBT_MD_MSK,
+        g_value_get_enum (value));
+  else if (strcmp (key, "inversion") == 0)
+    profile->rf_mode = DTAPI_UPCONV_NORMAL | g_value_get_enum (value);
+  else if (strcmp (key, "transmit-mode") == 0)
+    profile->tx_mode = g_value_get_enum (value);
+  else if (strcmp (key, "stuffing") == 0)
+    profile->stuff_mode = g_value_get_enum (value);
+  else if (strcmp (key, "symbol-rate") == 0)
+    mod->symbol_rate = g_value_get_int (value);
+  else if (strcmp (key, "pilots") == 0)
+    mod->pilots = g_value_get_boolean (value);
+  else if (strcmp (key, "short-frames") == 0)
+    mod->short_frames = g_value_get_boolean (value);
+  else if (strcmp (key, "t2-fft-mode") == 0)
+    mod->t2_fft_mode = g_value_get_enum (value);
+  else if (strcmp (key, "t2-guard") == 0)
+    mod->t2_guard = g_value_get_enum (value);
+  else if (strcmp (key, "t2-pilot-pattern") == 0)
+    mod->t2_pilot_pattern = g_value_get_enum (value);
+  else if (strcmp (key, "t2-fec-type") == 0)
+    mod->t2_fec_type = g_value_get_enum (value);
+  else
+    return FALSE;
+  return TRUE;
+}
+
+/* Returns NULL if the group makes a valid profile, or the problem */
+static gchar *
+load_profile (GstDTAPIModProfile * profile, GKeyFile * file,
+    const gchar * group, GObjectClass * klass)
+{
+  GValue value = G_VALUE_INIT;
+  GParamSpec *pspec;
+  gchar **keys, *str, *error = NULL;
+  const char *invalid;
+  guint i;
+
+  keys = g_key_file_get_keys (file, group, NULL, NULL);
+  for (i = 0; keys && keys[i] && error == NULL; i++) {
+    str = g_key_file_get_value (file, group, keys[i], NULL);
+    pspec = g_object_class_find_property (klass, keys[i]);
+    if (pspec == NULL) {
+      error = g_strdup_printf ("unknown setting %s", keys[i]);
+    } else {
+      g_value_init (&value, G_PARAM_SPEC_VALUE_TYPE (pspec));
+      if (!gst_value_deserialize (&value, str) ||
+          g_param_value_validate (pspec, &value))
+        error = g_strdup_printf ("bad value %s for %s", str, keys[i]);
+      else if (!set_key (profile, keys[i], &value))
+        error = g_strdup_printf ("%s can't be part of a profile", keys[i]);
+      g_value_unset (&value);
+    }
+    g_free (str);
+  }
+  g_strfreev (keys);
+  if (error)
+    return error;
+
+  /* Find out now rather than when switching to it */
+  if ((invalid = gst_dtapi_mod_pars_validate (&profile->mod)) != NULL)
+    return g_strdup (invalid);
+  profile->capacity = gst_dtapi_mod_pars_capacity (&profile->mod);
+  return NULL;
+}
+
+static void
+profile_free (gpointer data)
+{
+  GstDTAPIModProfile *profile = (GstDTAPIModProfile *) data;
+
+  g_free (profile->name);
+  g_free (profile);
+}
+
+GHashTable *
+gst_dtapi_mod_profiles_load (const gchar * location,
+    const GstDTAPIModProfile * base, GObjectClass * klass, gchar ** error)
+{
+  GKeyFile *file = g_key_file_new ();
+  GHashTable *profiles = NULL;
+  GstDTAPIModProfile *profile;
+  GError *err = NULL;
+  gchar **groups = NULL, *invalid;
+  guint i;
+
+  if (!g_key_file_load_from_file (file, location, G_KEY_FILE_NONE, &err)) {
+    *error = g_strdup_printf ("%s: %s", location, err->message);
+    g_error_free (err);
+    goto out;
+  }
+
+  profiles = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+      profile_free);
+  groups = g_key_file_get_groups (file, NULL);
+  for (i = 0; groups[i]; i++) {
+    profile = g_new (GstDTAPIModProfile, 1);
+    *profile = *base;
+    profile->name = g_strdup (groups[i]);
+    /* The key is the profile's own copy of the name */
+    g_hash_table_replace (profiles, profile->name, profile);
+
+    if ((invalid = load_profile (profile, file, groups[i], klass)) != NULL) {
+      *error = g_strdup_printf ("%s: profile %s: %s", location, groups[i],
+          invalid);
+      g_free (invalid);
+      g_hash_table_unref (profiles);
+      profiles = NULL;
+      goto out;
+    }
+  }
+
+out:
+  g_strfreev (groups);
+  g_key_file_free (file);
+  return profiles;
+}
@@ -0,0 +1,69 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * gstdtapimodprofile.h: named sets of modulator settings
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_DTAPI_MOD_PROFILE_H__
+#define __GST_DTAPI_MOD_PROFILE_H__
+
+#include <gst/gst.h>
+#include "gstdtapimodpars.h"
+
+/* These are C++ only as they deal in DTAPI values */
+
+/* Everything dtapisink passes to the modulator, so a channel can be switched
+   from one configuration to another in one go */
+typedef struct _GstDTAPIModProfile
+{
+  gchar *name;
+
+  /* As the fields of the same name in GstDTAPISink */
+  int ts_rate_bps;
+  int64_t frequency;
+  GstDTAPIModPars mod;
+  int rf_mode;
+  int tx_mode;
+  int stuff_mode;
+  int output_power;
+
+  /* The channel capacity, worked out when loaded */
+  int capacity;
+} GstDTAPIModProfile;
+
+/* Loads each group of the key-file at location as a profile named after the
+   group.  Each starts off as base with the group's keys applied on top.
+   The keys are named after, and their values parsed as, the properties of
+   klass they correspond to: bitrate, frequency, output-power, standard,
+   modulation, code-rate, bandwidth, guard, interleaving, trans-mode,
+   inversion, transmit-mode, stuffing, symbol-rate, pilots, short-frames and
+   the t2-* settings other than t2-plps.  For example:
+
+     [uk-mux-1]
+     frequency=482000000
+     modulation=qam64
+     code-rate=2/3
+     guard=1/32
+
+   Returns a table of name to GstDTAPIModProfile, or NULL and sets *error if
+   the file can't be read or any of the profiles in it are invalid. */
+GHashTable *gst_dtapi_mod_profiles_load (const gchar * location,
+    const GstDTAPIModProfile * base, GObjectClass * klass, gchar ** error);
+
+#endif /* __GST_DTAPI_MOD_PROFILE_H__ */
@@ -0,0 +1,393 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * gstdtapimonitor.c: ETSI TR 101 290 priority 1 checks on outgoing TS
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include "gstdtapimonitor.h"
+
+#define NUM_PIDS 8192
+#define NULL_PID 0x1fff
+#define SYNC_BYTE 0x47
+#define TS_PACKET_SIZE 188
+
+/* TR 101 290 limits, in microseconds of stream time */
+#define PAT_INTERVAL_US 500000
+#define PMT_INTERVAL_US 500000
+#define PID_TIMEOUT_US 5000000
+#define REPORT_INTERVAL_US 1000000
+/* The interval checks don't need doing every packet */
+#define TICK_US 10000
+
+/* Sync is lost after this many bad sync bytes in a row and regained after
+   this many good ones */
+#define SYNC_LOSS_BAD 2
+#define SYNC_GAIN_GOOD 5
+
+#define MAX_PMTS 64
+#define MAX_REFERENCED 512
+
+enum
+{
+  PID_CC_VALID = 1 << 0,
+  PID_DUPLICATE = 1 << 1,
+  PID_PMT = 1 << 2,
+  PID_REFERENCED = 1 << 3
+};
+
+/* Kept to 16 bytes so the whole table is 128k and the state for a PID is
+   one cache line fetch */
+typedef struct
+{
+  gint64 last_seen;
+  guint32 packets;
+  guint8 flags;
+  guint8 cc;
+} PidState;
+
+struct _GstDTAPIMonitor
+{
+  guint packet_size;
+  guint header;
+  guint8 partial[204];
+  gsize partial_len;
+
+  gboolean in_sync;
+  int bad_syncs;
+  int good_syncs;
+
+  guint64 bytes;
+  gint64 now;
+  gint64 next_tick;
+  gint64 report_start;
+
+  gint64 last_pat;
+  int pat_version;
+  guint16 pmt_pids[MAX_PMTS];
+  int n_pmts;
+  guint16 referenced_pids[MAX_REFERENCED];
+  int n_referenced;
+
+  GstDTAPIMonitorCounts counts;
+  PidState pids[NUM_PIDS];
+};
+
+GstDTAPIMonitor *
+gst_dtapi_monitor_new (guint packet_size)
+{
+  GstDTAPIMonitor *mon;
+
+  g_return_val_if_fail (packet_size == 188 || packet_size == 192 ||
+      packet_size == 204, NULL);
+
+  mon = g_new (GstDTAPIMonitor, 1);
+  mon->packet_size = packet_size;
+  /* M2TS style 192 byte packets have a 4 byte timestamp in front */
+  mon->header = packet_size == 192 ? 4 : 0;
+  gst_dtapi_monitor_reset (mon);
+  return mon;
+}
+
+void
+gst_dtapi_monitor_free (GstDTAPIMonitor * mon)
+{
+  g_free (mon);
+}
+
+void
+gst_dtapi_monitor_reset (GstDTAPIMonitor * mon)
+{
+  mon->partial_len = 0;
+  mon->in_sync = TRUE;
+  mon->bad_syncs = 0;
+  mon->good_syncs = 0;
+  mon->bytes = 0;
+  mon->now = 0;
+  mon->next_tick = TICK_US;
+  mon->report_start = 0;
+  mon->last_pat = 0;
+  mon->pat_version = -1;
+  mon->n_pmts = 0;
+  mon->n_referenced = 0;
+  memset (&mon->counts, 0, sizeof (mon->counts));
+  memset (mon->pids, 0, sizeof (mon->pids));
+}
+
+static void
+add_pid (GstDTAPIMonitor * mon, guint pid, guint8 flag, guint16 * list,
+    int *n, int max)
+{
+  PidState *st = &mon->pids[pid];
+
+  if ((st->flags & flag) || *n >= max)
+    return;
+  st->flags |= flag;
+  /* Give it a full interval from now before we complain */
+  st->last_seen = mon->now;
+  list[(*n)++] = pid;
+}
+
+/* Returns the section starting in this packet and sets *len to how much of
+   it is in this packet, or NULL if there isn't one */
+static const guint8 *
+section_start (const guint8 * h, const guint8 * end, gsize * len)
+{
+  const guint8 *p = h + 4, *sec;
+  gsize section_length;
+
+  if (!(h[1] & 0x40) || !(h[3] & 0x10))
+    return NULL;
+  if (h[3] & 0x20)
+    p += 1 + p[0];
+  if (p >= end)
+    return NULL;
+  sec = p + 1 + p[0];
+  if (sec + 8 > end)
+    return NULL;
+  section_length = ((sec[1] & 0x0f) << 8) | sec[2];
+  /* Leave off the CRC */
+  *len = MIN ((gsize) (end - sec), 3 + section_length - 4);
+  return sec;
+}
+
+static void
+parse_pat (GstDTAPIMonitor * mon, const guint8 * sec, gsize len)
+{
+  int version = (sec[5] >> 1) & 0x1f;
+  gsize i;
+  int j;
+
+  if (version != mon->pat_version) {
+    /* Start again with the PMTs and the PIDs they refer to */
+    for (j = 0; j < mon->n_pmts; j++)
+      mon->pids[mon->pmt_pids[j]].flags &= ~PID_PMT;
+    for (j = 0; j < mon->n_referenced; j++)
+      mon->pids[mon->referenced_pids[j]].flags &= ~PID_REFERENCED;
+    mon->n_pmts = 0;
+    mon->n_referenced = 0;
+    mon->pat_version = version;
+  }
+
+  for (i = 8; i + 4 <= len; i += 4) {
+    guint program = (sec[i] << 8) | sec[i + 1];
+    guint pid = ((sec[i + 2] & 0x1f) << 8) | sec[i + 3];
+
+    /* Program 0 is the NIT */
+    if (program != 0)
+      add_pid (mon, pid, PID_PMT, mon->pmt_pids, &mon->n_pmts, MAX_PMTS);
+  }
+}
+
+static void
+parse_pmt (GstDTAPIMonitor * mon, const guint8 * sec, gsize len)
+{
+  gsize i;
+
+  if (len < 12)
+    return;
+  add_pid (mon, ((sec[8] & 0x1f) << 8) | sec[9], PID_REFERENCED,
+      mon->referenced_pids, &mon->n_referenced, MAX_REFERENCED);
+
+  i = 12 + (((sec[10] & 0x0f) << 8) | sec[11]);
+  for (; i + 5 <= len; i += 5 + (((sec[i + 3] & 0x0f) << 8) | sec[i + 4])) {
+    add_pid (mon, ((sec[i + 1] & 0x1f) << 8) | sec[i + 2], PID_REFERENCED,
+        mon->referenced_pids, &mon->n_referenced, MAX_REFERENCED);
+  }
+}
+
+static void
+check_packet (GstDTAPIMonitor * mon, const guint8 * packet)
+{
+  const guint8 *h = packet + mon->header;
+  const guint8 *end = h + TS_PACKET_SIZE;
+  const guint8 *sec;
+  PidState *st;
+  guint pid, cc, afc;
+  gsize len;
+
+  mon->counts.packets++;
+
+  /* 1.1 and 1.2 */
+  if (G_UNLIKELY (h[0] != SYNC_BYTE)) {
+    mon->counts.sync_byte_error++;
+    mon->good_syncs = 0;
+    if (++mon->bad_syncs == SYNC_LOSS_BAD && mon->in_sync) {
+      mon->in_sync = FALSE;
+      mon->counts.sync_loss++;
+    }
+    return;
+  }
+  mon->bad_syncs = 0;
+  if (!mon->in_sync && ++mon->good_syncs >= SYNC_GAIN_GOOD)
+    mon->in_sync = TRUE;
+
+  pid = ((h[1] & 0x1f) << 8) | h[2];
+  st = &mon->pids[pid];
+  st->last_seen = mon->now;
+  st->packets++;
+  if (pid == NULL_PID)
+    return;
+
+  /* 1.4: The counter goes up with every packet carrying payload and stays put
+     for those that don't.  One duplicate is allowed. */
+  afc = (h[3] >> 4) & 3;
+  cc = h[3] & 0x0f;
+  if ((afc & 2) && h[4] > 0 && (h[5] & 0x80)) {
+    /* Discontinuity indicator */
+  } else if (st->flags & PID_CC_VALID) {
+    if (!(afc & 1)) {
+      if (cc != st->cc)
+        mon->counts.cc_error++;
+    } else if (cc == st->cc) {
+      if (st->flags & PID_DUPLICATE)
+        mon->counts.cc_error++;
+      st->flags |= PID_DUPLICATE;
+    } else {
+      if (cc != ((st->cc + 1) & 0x0f))
+        mon->counts.cc_error++;
+      st->flags &= ~PID_DUPLICATE;
+    }
+  }
+  st->cc = cc;
+  st->flags |= PID_CC_VALID;
+
+  /* 1.3 and 1.5: also wrong table ids and scrambling */
+  if (pid == 0) {
+    mon->last_pat = mon->now;
+    if (h[3] & 0xc0)
+      mon->counts.pat_error++;
+    else if ((sec = section_start (h, end, &len)) != NULL) {
+      if (sec[0] != 0x00)
+        mon->counts.pat_error++;
+      else
+        parse_pat (mon, sec, len);
+    }
+  } else if (st->flags & PID_PMT) {
+    if (h[3] & 0xc0)
+      mon->counts.pmt_error++;
+    else if ((sec = section_start (h, end, &len)) != NULL) {
+      if (sec[0] != 0x02)
+        mon->counts.pmt_error++;
+      else
+        parse_pmt (mon, sec, len);
+    }
+  }
+}
+
+/* The checks for things that haven't turned up.  Each is counted once per
+   interval that goes by without them. */
+static void
+check_intervals (GstDTAPIMonitor * mon)
+{
+  int i;
+
+  if (mon->now - mon->last_pat > PAT_INTERVAL_US) {
+    mon->counts.pat_error++;
+    mon->last_pat = mon->now;
+  }
+  for (i = 0; i < mon->n_pmts; i++) {
+    PidState *st = &mon->pids[mon->pmt_pids[i]];
+    if (mon->now - st->last_seen > PMT_INTERVAL_US) {
+      mon->counts.pmt_error++;
+      st->last_seen = mon->now;
+    }
+  }
+  for (i = 0; i < mon->n_referenced; i++) {
+    PidState *st = &mon->pids[mon->referenced_pids[i]];
+    if (mon->now - st->last_seen > PID_TIMEOUT_US) {
+      mon->counts.pid_error++;
+      st->last_seen = mon->now;
+    }
+  }
+}
+
+gboolean
+gst_dtapi_monitor_process (GstDTAPIMonitor * mon, const guint8 * data,
+    gsize len, int rate_bps)
+{
+  guint packet_size = mon->packet_size;
+  gdouble us_per_byte;
+
+  if (rate_bps <= 0)
+    return FALSE;
+  us_per_byte = 8.0 * G_USEC_PER_SEC / rate_bps;
+
+  /* Finish off the packet left over from last time */
+  if (mon->partial_len > 0) {
+    gsize n = MIN (len, packet_size - mon->partial_len);
+
+    memcpy (mon->partial + mon->partial_len, data, n);
+    mon->partial_len += n;
+    data += n;
+    len -= n;
+    if (mon->partial_len < packet_size)
+      return FALSE;
+    mon->now = (gint64) (mon->bytes * us_per_byte);
+    check_packet (mon, mon->partial);
+    mon->bytes += packet_size;
+    mon->partial_len = 0;
+  }
+
+  for (; len >= packet_size; data += packet_size, len -= packet_size) {
+    mon->now = (gint64) (mon->bytes * us_per_byte);
+    check_packet (mon, data);
+    mon->bytes += packet_size;
+    if (G_UNLIKELY (mon->now >= mon->next_tick)) {
+      check_intervals (mon);
+      mon->next_tick = mon->now + TICK_US;
+    }
+  }
+
+  memcpy (mon->partial, data, len);
+  mon->partial_len = len;
+
+  return mon->now - mon->report_start >= REPORT_INTERVAL_US;
+}
+
+void
+gst_dtapi_monitor_get_counts (GstDTAPIMonitor * mon,
+    GstDTAPIMonitorCounts * counts)
+{
+  *counts = mon->counts;
+}
+
+void
+gst_dtapi_monitor_foreach_bitrate (GstDTAPIMonitor * mon,
+    GstDTAPIMonitorBitrateFunc func, gpointer user_data)
+{
+  gint64 period = mon->now - mon->report_start;
+  guint pid;
+
+  for (pid = 0; pid < NUM_PIDS; pid++) {
+    PidState *st = &mon->pids[pid];
+
+    if (st->packets == 0)
+      continue;
+    if (period > 0)
+      func (pid, (guint64) st->packets * mon->packet_size * 8 *
+          G_USEC_PER_SEC / period, user_data);
+    st->packets = 0;
+  }
+  mon->report_start = mon->now;
+}
@@ -0,0 +1,67 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * gstdtapimonitor.h: ETSI TR 101 290 priority 1 checks on outgoing TS
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_DTAPI_MONITOR_H__
+#define __GST_DTAPI_MONITOR_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Running totals of the TR 101 290 priority 1 indicators */
+typedef struct _GstDTAPIMonitorCounts
+{
+  guint64 sync_loss;            /* 1.1 TS_sync_loss */
+  guint64 sync_byte_error;      /* 1.2 Sync_byte_error */
+  guint64 pat_error;            /* 1.3 PAT_error_2 */
+  guint64 cc_error;             /* 1.4 Continuity_count_error */
+  guint64 pmt_error;            /* 1.5 PMT_error_2 */
+  guint64 pid_error;            /* 1.6 PID_error */
+  guint64 packets;
+} GstDTAPIMonitorCounts;
+
+typedef struct _GstDTAPIMonitor GstDTAPIMonitor;
+
+/* Time is measured in the stream: it is worked out from the number of
+   bytes seen at rate_bps, which is what it will be on air */
+GstDTAPIMonitor *gst_dtapi_monitor_new (guint packet_size);
+void gst_dtapi_monitor_free (GstDTAPIMonitor * mon);
+void gst_dtapi_monitor_reset (GstDTAPIMonitor * mon);
+
+/* Checks len bytes of TS.  The data is only read and packets may straddle
+   calls.  Returns TRUE once a report is due (every second of stream), at
+   which point the caller should collect the counts and bit rates. */
+gboolean gst_dtapi_monitor_process (GstDTAPIMonitor * mon,
+    const guint8 * data, gsize len, int rate_bps);
+
+void gst_dtapi_monitor_get_counts (GstDTAPIMonitor * mon,
+    GstDTAPIMonitorCounts * counts);
+
+/* Calls func for each PID seen since the last report with its bit rate over
+   that time, then starts a new reporting period */
+typedef void (*GstDTAPIMonitorBitrateFunc) (guint pid, guint64 bps,
+    gpointer user_data);
+void gst_dtapi_monitor_foreach_bitrate (GstDTAPIMonitor * mon,
+    GstDTAPIMonitorBitrateFunc func, gpointer user_data);
+
+G_END_DECLS
+#endif /* __GST_DTAPI_MONITOR_H__ */
@@ -0,0 +1,282 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * gstdtapipcr.c: PCR restamping from the position in the output
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include "gstdtapipcr.h"
+
+#define SYNC_BYTE 0x47
+#define TS_PACKET_SIZE 188
+
+/* PCRs count a 27 MHz clock and wrap at 2^33 * 300 */
+#define PCR_HZ G_GUINT64_CONSTANT (27000000)
+#define PCR_WRAP (G_GUINT64_CONSTANT (8589934592) * 300)
+
+/* Anchors are kept in 1/1024ths of a tick so that tracking can make
+   corrections smaller than a tick */
+#define FRAC_BITS 10
+#define FRAC_WRAP (PCR_WRAP << FRAC_BITS)
+
+/* Each PCR pulls the anchor 1/n of the way towards itself, where n counts
+   the PCRs since the anchor was set up to a limit of TRACKING_MAX.  To
+   begin with that makes the anchor the average of the input, which settles
+   quickly.  Once at the limit it is slow enough that 10ms of input jitter
+   moves the output by less than the 500ns TR 101 290 allows, but still
+   follows any slow drift between the stream's clock and the TS rate. */
+#define TRACKING_MAX (1 << 14)
+
+/* Further than this from where it should be and the input clock has jumped
+   rather than drifted, so we start again from the input */
+#define MAX_CORRECTION (PCR_HZ / 10)
+
+#define MAX_PCR_PIDS 16
+
+typedef struct
+{
+  guint pid;
+  gboolean valid;
+
+  /* The output clock: the PCR, in FRAC_BITS units, that the byte at
+     anchor_pos goes out with */
+  guint64 anchor;
+  guint64 anchor_pos;
+  gint64 tracked;
+
+  /* The previous PCR in and out, for the stats */
+  guint64 last_in;
+  guint64 last_out;
+  guint64 last_pos;
+} PcrPid;
+
+struct _GstDTAPIPcrRestamp
+{
+  guint packet_size;
+  guint header;
+
+  PcrPid pids[MAX_PCR_PIDS];
+  int n_pids;
+
+  GstDTAPIPcrStats stats;
+};
+
+GstDTAPIPcrRestamp *
+gst_dtapi_pcr_restamp_new (guint packet_size)
+{
+  GstDTAPIPcrRestamp *restamp;
+
+  g_return_val_if_fail (packet_size == 188 || packet_size == 192 ||
+      packet_size == 204, NULL);
+
+  restamp = g_new0 (GstDTAPIPcrRestamp, 1);
+  restamp->packet_size = packet_size;
+  /* M2TS style 192 byte packets have a 4 byte timestamp in front */
+  restamp->header = packet_size == 192 ? 4 : 0;
+  return restamp;
+}
+
+void
+gst_dtapi_pcr_restamp_free (GstDTAPIPcrRestamp * restamp)
+{
+  g_free (restamp);
+}
+
+void
+gst_dtapi_pcr_restamp_discont (GstDTAPIPcrRestamp * restamp)
+{
+  int i;
+
+  for (i = 0; i < restamp->n_pids; i++)
+    restamp->pids[i].valid = FALSE;
+}
+
+/* Time taken by bytes at rate_bps, in FRAC_BITS units of the 27 MHz clock.
+   Done in two parts so that it can't overflow however far apart the PCRs
+   are. */
+static guint64
+bytes_to_frac (guint64 bytes, int rate_bps)
+{
+  guint64 scaled = bytes * 8 * PCR_HZ;
+
+  return ((scaled / rate_bps) << FRAC_BITS) +
+      (((scaled % rate_bps) << FRAC_BITS) / rate_bps);
+}
+
+/* a - b, allowing for wrap, in the range (-wrap/2, wrap/2] */
+static gint64
+wrap_diff (guint64 a, guint64 b, guint64 wrap)
+{
+  guint64 d = (a + wrap - b) % wrap;
+
+  return d > wrap / 2 ? (gint64) d - (gint64) wrap : (gint64) d;
+}
+
+static guint64
+ticks_to_ns (gint64 ticks)
+{
+  return (guint64) ABS (ticks) * 1000 / 27;
+}
+
+static guint64
+read_pcr (const guint8 * h)
+{
+  guint64 base = ((guint64) h[6] << 25) | (h[7] << 17) | (h[8] << 9) |
+      (h[9] << 1) | (h[10] >> 7);
+
+  return base * 300 + (((h[10] & 1) << 8) | h[11]);
+}
+
+static void
+write_pcr (guint8 * h, guint64 pcr)
+{
+  guint64 base = pcr / 300;
+  guint ext = pcr % 300;
+
+  h[6] = base >> 25;
+  h[7] = base >> 17;
+  h[8] = base >> 9;
+  h[9] = base >> 1;
+  h[10] = ((base & 1) << 7) | 0x7e | (ext >> 8);
+  h[11] = ext;
+}
+
+static PcrPid *
+find_pid (GstDTAPIPcrRestamp * restamp, guint pid)
+{
+  int i;
+
+  for (i = 0; i < restamp->n_pids; i++) {
+    if (restamp->pids[i].pid == pid)
+      return &restamp->pids[i];
+  }
+  if (restamp->n_pids == MAX_PCR_PIDS)
+    return NULL;
+
+  restamp->pids[i].pid = pid;
+  restamp->pids[i].valid = FALSE;
+  restamp->n_pids++;
+  return &restamp->pids[i];
+}
+
+/* pos is where the PCR goes out, counted in 188 byte packets as that's what
+   the TS rate is counted in */
+static void
+restamp_pcr (GstDTAPIPcrRestamp * restamp, guint8 * h, guint64 pos,
+    int rate_bps)
+{
+  guint64 in, out, ideal, error_ns;
+  gint64 diff;
+  PcrPid *p;
+
+  p = find_pid (restamp, ((h[1] & 0x1f) << 8) | h[2]);
+  if (p == NULL)
+    return;
+
+  in = read_pcr (h);
+  restamp->stats.pcrs++;
+
+  if (!p->valid)
+    goto reanchor;
+  /* discontinuity_indicator */
+  if (h[5] & 0x80) {
+    restamp->stats.discontinuities++;
+    goto reanchor;
+  }
+
+  ideal = (p->anchor + bytes_to_frac (pos - p->anchor_pos, rate_bps)) %
+      FRAC_WRAP;
+  diff = wrap_diff (in << FRAC_BITS, ideal, FRAC_WRAP);
+  if (ABS (diff) > (gint64) (MAX_CORRECTION << FRAC_BITS)) {
+    restamp->stats.discontinuities++;
+    goto reanchor;
+  }
+
+  if (p->tracked < TRACKING_MAX)
+    p->tracked++;
+  p->anchor = (ideal + FRAC_WRAP + diff / (p->tracked + 1)) % FRAC_WRAP;
+  p->anchor_pos = pos;
+  out = ((p->anchor + (1 << (FRAC_BITS - 1))) >> FRAC_BITS) % PCR_WRAP;
+  write_pcr (h, out);
+  restamp->stats.restamped++;
+
+  /* How far each is from its predecessor extrapolated at the TS rate */
+  ideal = bytes_to_frac (pos - p->last_pos, rate_bps) >> FRAC_BITS;
+  error_ns = ticks_to_ns (wrap_diff (in, (p->last_in + ideal) % PCR_WRAP,
+          PCR_WRAP));
+  restamp->stats.input_max_ns = MAX (restamp->stats.input_max_ns, error_ns);
+  restamp->stats.input_total_ns += error_ns;
+  error_ns = ticks_to_ns (wrap_diff (out, (p->last_out + ideal) % PCR_WRAP,
+          PCR_WRAP));
+  restamp->stats.output_max_ns = MAX (restamp->stats.output_max_ns,
+      error_ns);
+  restamp->stats.output_total_ns += error_ns;
+
+  p->last_in = in;
+  p->last_out = out;
+  p->last_pos = pos;
+  return;
+
+reanchor:
+  p->valid = TRUE;
+  p->anchor = in << FRAC_BITS;
+  p->anchor_pos = pos;
+  p->tracked = 0;
+  p->last_in = p->last_out = in;
+  p->last_pos = pos;
+}
+
+guint
+gst_dtapi_pcr_restamp_process (GstDTAPIPcrRestamp * restamp, guint8 * data,
+    gsize len, guint64 offset, int rate_bps)
+{
+  guint packet_size = restamp->packet_size;
+  guint64 packet = (offset + packet_size - 1) / packet_size;
+  guint64 before = restamp->stats.pcrs;
+  gsize i;
+
+  if (rate_bps <= 0)
+    return 0;
+
+  /* All we need of a packet is up to the end of its PCR, so only a packet
+     split between buffers before that is passed over */
+  for (i = packet * packet_size - offset; i + restamp->header + 12 <= len;
+      i += packet_size, packet++) {
+    guint8 *h = data + i + restamp->header;
+
+    /* Sync byte, adaptation field long enough for a PCR and PCR_flag */
+    if (h[0] != SYNC_BYTE || !(h[3] & 0x20) || h[4] < 7 || !(h[5] & 0x10))
+      continue;
+    /* The PCR is for the byte holding the last bit of its base */
+    restamp_pcr (restamp, h, packet * TS_PACKET_SIZE + 10, rate_bps);
+  }
+
+  return restamp->stats.pcrs - before;
+}
+
+void
+gst_dtapi_pcr_restamp_get_stats (GstDTAPIPcrRestamp * restamp,
+    GstDTAPIPcrStats * stats)
+{
+  *stats = restamp->stats;
+}
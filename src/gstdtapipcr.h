@@ -0,0 +1,63 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * gstdtapipcr.h: PCR restamping from the position in the output
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_DTAPI_PCR_H__
+#define __GST_DTAPI_PCR_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* PCR accuracy is measured the way an analyser on the output would see it:
+   each PCR against the one before it on the same PID, extrapolated at the
+   TS rate.  Times are in nanoseconds. */
+typedef struct _GstDTAPIPcrStats
+{
+  guint64 pcrs;
+  guint64 restamped;
+  guint64 discontinuities;
+  guint64 input_max_ns;
+  guint64 input_total_ns;
+  guint64 output_max_ns;
+  guint64 output_total_ns;
+} GstDTAPIPcrStats;
+
+typedef struct _GstDTAPIPcrRestamp GstDTAPIPcrRestamp;
+
+GstDTAPIPcrRestamp *gst_dtapi_pcr_restamp_new (guint packet_size);
+void gst_dtapi_pcr_restamp_free (GstDTAPIPcrRestamp * restamp);
+
+/* Forgets the timing of every PID, as after a flush.  The stats are kept. */
+void gst_dtapi_pcr_restamp_discont (GstDTAPIPcrRestamp * restamp);
+
+/* Rewrites the PCRs in len bytes of data in place.  offset is the position
+   of data[0] in the output, which must be packet aligned from offset 0, and
+   the output is taken to go out at exactly rate_bps.  Returns the number of
+   PCRs seen. */
+guint gst_dtapi_pcr_restamp_process (GstDTAPIPcrRestamp * restamp,
+    guint8 * data, gsize len, guint64 offset, int rate_bps);
+
+void gst_dtapi_pcr_restamp_get_stats (GstDTAPIPcrRestamp * restamp,
+    GstDTAPIPcrStats * stats);
+
+G_END_DECLS
+#endif /* __GST_DTAPI_PCR_H__ */
@@ -0,0 +1,228 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * gstdtapipidfilter.c: TS packet filtering and PID remapping
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include "gstdtapipidfilter.h"
+
+#define SYNC_BYTE 0x47
+
+static gboolean
+parse_pid (const gchar * s, guint * pid)
+{
+  gchar *end;
+  guint64 v = g_ascii_strtoull (s, &end, 0);
+
+  if (end == s || *end != '\0' || v >= GST_DTAPI_NUM_PIDS)
+    return FALSE;
+  *pid = (guint) v;
+  return TRUE;
+}
+
+GstDTAPIPidTable *
+gst_dtapi_pid_table_new (const gchar * filter, const gchar * remap,
+    gchar ** error)
+{
+  GstDTAPIPidTable *table = g_new0 (GstDTAPIPidTable, 1);
+  gchar **items;
+  guint i, pid;
+
+  for (pid = 0; pid < GST_DTAPI_NUM_PIDS; pid++)
+    table->remap[pid] = pid;
+
+  if (filter == NULL || *filter == '\0') {
+    memset (table->pass, 0xff, sizeof (table->pass));
+  } else {
+    table->active = TRUE;
+    items = g_strsplit (filter, ",", -1);
+    for (i = 0; items[i] != NULL; i++) {
+      gchar **range = g_strsplit (g_strstrip (items[i]), "-", 2);
+      guint first, last;
+
+      if (!parse_pid (range[0], &first) ||
+          !parse_pid (range[1] ? range[1] : range[0], &last) || last < first) {
+        *error = g_strdup_printf ("bad PID or PID range \"%s\"", items[i]);
+        g_strfreev (range);
+        g_strfreev (items);
+        g_free (table);
+        return NULL;
+      }
+      for (pid = first; pid <= last; pid++)
+        table->pass[pid / 32] |= 1u << (pid % 32);
+      g_strfreev (range);
+    }
+    g_strfreev (items);
+  }
+
+  if (remap != NULL && *remap != '\0') {
+    table->active = TRUE;
+    items = g_strsplit (remap, ",", -1);
+    for (i = 0; items[i] != NULL; i++) {
+      gchar **pair = g_strsplit (g_strstrip (items[i]), "=", 2);
+      guint from, to;
+
+      if (pair[1] == NULL || !parse_pid (pair[0], &from) ||
+          !parse_pid (pair[1], &to)) {
+        *error = g_strdup_printf ("bad PID mapping \"%s\"", items[i]);
+        g_strfreev (pair);
+        g_strfreev (items);
+        g_free (table);
+        return NULL;
+      }
+      table->remap[from] = to;
+      if (from != to)
+        table->remaps = TRUE;
+      g_strfreev (pair);
+    }
+    g_strfreev (items);
+  }
+
+  return table;
+}
+
+void
+gst_dtapi_pid_table_free (GstDTAPIPidTable * table)
+{
+  g_free (table);
+}
+
+void
+gst_dtapi_pid_filter_init (GstDTAPIPidFilter * filter, guint packet_size)
+{
+  g_return_if_fail (packet_size == 188 || packet_size == 192 ||
+      packet_size == 204);
+
+  filter->packet_size = packet_size;
+  filter->remap = TRUE;
+  filter->partial_len = 0;
+}
+
+/* Whether a packet passes.  Packets that have lost sync are passed as they
+   are as we can't tell what they are. */
+static inline gboolean
+packet_passes (const GstDTAPIPidTable * table, const guint8 * h)
+{
+  guint pid;
+
+  if (G_UNLIKELY (h[0] != SYNC_BYTE))
+    return TRUE;
+  pid = ((h[1] & 0x1f) << 8) | h[2];
+  return (table->pass[pid / 32] & (1u << (pid % 32))) != 0;
+}
+
+/* Gives a packet that has passed its new PID, where it is */
+static inline void
+remap_packet (const GstDTAPIPidTable * table, guint8 * h)
+{
+  guint pid, new_pid;
+
+  if (G_UNLIKELY (h[0] != SYNC_BYTE))
+    return;
+  pid = ((h[1] & 0x1f) << 8) | h[2];
+  new_pid = table->remap[pid];
+  if (new_pid != pid) {
+    h[1] = (h[1] & 0xe0) | (new_pid >> 8);
+    h[2] = new_pid & 0xff;
+  }
+}
+
+/* Copies a packet from in to out if it passes, remapping its PID if
+   remap */
+static inline gboolean
+filter_packet (const GstDTAPIPidTable * table, gboolean remap, guint header,
+    const guint8 * in, guint8 * out, guint packet_size)
+{
+  if (!packet_passes (table, in + header))
+    return FALSE;
+  memcpy (out, in, packet_size);
+  if (remap)
+    remap_packet (table, out + header);
+  return TRUE;
+}
+
+gsize
+gst_dtapi_pid_filter_process (GstDTAPIPidFilter * filter,
+    const GstDTAPIPidTable * table, const guint8 * in, gsize len,
+    guint8 * out)
+{
+  guint packet_size = filter->packet_size;
+  /* M2TS style 192 byte packets have a 4 byte timestamp in front */
+  guint header = packet_size == 192 ? 4 : 0;
+  guint8 *out_start = out;
+
+  /* Finish off the packet left over from last time */
+  if (filter->partial_len > 0) {
+    gsize n = MIN (len, packet_size - filter->partial_len);
+
+    memcpy (filter->partial + filter->partial_len, in, n);
+    filter->partial_len += n;
+    in += n;
+    len -= n;
+    if (filter->partial_len < packet_size)
+      return 0;
+    if (filter_packet (table, filter->remap, header, filter->partial, out,
+            packet_size))
+      out += packet_size;
+    filter->partial_len = 0;
+  }
+
+  for (; len >= packet_size; in += packet_size, len -= packet_size) {
+    if (filter_packet (table, filter->remap, header, in, out, packet_size))
+      out += packet_size;
+  }
+
+  memcpy (filter->partial, in, len);
+  filter->partial_len = len;
+
+  return out - out_start;
+}
+
+gsize
+gst_dtapi_pid_filter_process_in_place (GstDTAPIPidFilter * filter,
+    const GstDTAPIPidTable * table, guint8 * data, gsize len)
+{
+  guint packet_size = filter->packet_size;
+  guint header = packet_size == 192 ? 4 : 0;
+  guint8 *in = data, *out = data;
+
+  g_return_val_if_fail (filter->partial_len == 0, 0);
+
+  for (; len >= packet_size; in += packet_size, len -= packet_size) {
+    if (!packet_passes (table, in + header))
+      continue;
+    /* Only once something has been dropped does anything need to move */
+    if (out != in)
+      memmove (out, in, packet_size);
+    if (filter->remap)
+      remap_packet (table, out + header);
+    out += packet_size;
+  }
+
+  memcpy (filter->partial, in, len);
+  filter->partial_len = len;
+
+  return out - data;
+}
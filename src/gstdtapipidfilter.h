@@ -0,0 +1,85 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * gstdtapipidfilter.h: TS packet filtering and PID remapping
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_DTAPI_PID_FILTER_H__
+#define __GST_DTAPI_PID_FILTER_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define GST_DTAPI_NUM_PIDS 8192
+
+/* Which PIDs to pass and what to call them on the way out.  Immutable once
+   built so the streaming thread can use one while a new one is being
+   parsed. */
+typedef struct _GstDTAPIPidTable
+{
+  /* Bit n set means pass PID n */
+  guint32 pass[GST_DTAPI_NUM_PIDS / 32];
+  guint16 remap[GST_DTAPI_NUM_PIDS];
+  /* FALSE if this table passes everything unchanged */
+  gboolean active;
+  /* TRUE if any PID is given a new one */
+  gboolean remaps;
+} GstDTAPIPidTable;
+
+/* filter is a comma separated list of PIDs and PID ranges to pass, e.g.
+   "0,16-18,256".  NULL or empty passes everything.  remap is a comma
+   separated list of from=to pairs, e.g. "256=512,257=513".  Returns NULL
+   and sets *error if either can't be parsed. */
+GstDTAPIPidTable *gst_dtapi_pid_table_new (const gchar * filter,
+    const gchar * remap, gchar ** error);
+void gst_dtapi_pid_table_free (GstDTAPIPidTable * table);
+
+/* Packets straddle buffer boundaries so the filter carries the end of one
+   buffer over to the next */
+typedef struct _GstDTAPIPidFilter
+{
+  /* 188, 192 (with a 4 byte prefix) or 204 (with 16 bytes of parity) */
+  guint packet_size;
+  /* TRUE (the default) to apply the table's remapping as well as its
+     filter.  A new PID would leave parity that covers the header wrong. */
+  gboolean remap;
+  guint8 partial[204];
+  gsize partial_len;
+} GstDTAPIPidFilter;
+
+void gst_dtapi_pid_filter_init (GstDTAPIPidFilter * filter,
+    guint packet_size);
+
+/* Filters and remaps len bytes of in, writing whole packets to out, which
+   must have room for len + packet_size bytes.  Returns the number of bytes
+   written to out. */
+gsize gst_dtapi_pid_filter_process (GstDTAPIPidFilter * filter,
+    const GstDTAPIPidTable * table, const guint8 * in, gsize len,
+    guint8 * out);
+
+/* As gst_dtapi_pid_filter_process but filters data where it is, moving
+   packets up over those that are dropped.  There mustn't be a partial
+   packet carried over from last time (partial_len must be 0).  Returns the
+   number of bytes left at the start of data. */
+gsize gst_dtapi_pid_filter_process_in_place (GstDTAPIPidFilter * filter,
+    const GstDTAPIPidTable * table, guint8 * data, gsize len);
+
+G_END_DECLS
+#endif /* __GST_DTAPI_PID_FILTER_H__ */
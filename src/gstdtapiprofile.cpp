@@ -0,0 +1,200 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * gstdtapiprofile.cpp: timing every call made to DekTec hardware
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+#include "gstdtapiprofile.h"
+
+static const char *call_names[GST_DTAPI_N_CALLS] = {
+  "AttachToSerial",
+  "AttachToType",
+  "AttachToPort",
+  "Detach",
+  "Write",
+  "Reset",
+  "GetFifoLoad",
+  "GetFifoSize",
+  "GetFlags",
+  "GetModControl",
+  "GetOutputLevel",
+  "GetRfControl",
+  "GetTsRateBps",
+  "GetTxControl",
+  "GetTxMode",
+  "SetModControl",
+  "SetOutputLevel",
+  "SetRfControl",
+  "SetRfMode",
+  "SetTsRateBps",
+  "SetTxControl",
+  "SetTxMode",
+};
+
+/* Each thread's slots, one per profile it has recorded in.  Profiles are
+   told apart by id rather than address, which may be reused once a profile
+   has been cleared and its slots freed. */
+typedef struct
+{
+  guint id;
+  GstDTAPIProfileSlot *slot;
+} GstDTAPIThreadSlot;
+
+static void
+gst_dtapi_thread_slots_free (gpointer data)
+{
+  g_slist_free_full ((GSList *) data, g_free);
+}
+
+static GPrivate thread_slots = G_PRIVATE_INIT (gst_dtapi_thread_slots_free);
+static volatile gint next_id;
+
+void
+gst_dtapi_profile_init (GstDTAPIProfile * profile)
+{
+  profile->enabled = FALSE;
+  profile->generation = 0;
+  profile->id = (guint) g_atomic_int_add (&next_id, 1);
+  g_mutex_init (&profile->lock);
+  profile->slots = NULL;
+}
+
+void
+gst_dtapi_profile_clear (GstDTAPIProfile * profile)
+{
+  g_slist_free_full (profile->slots, g_free);
+  profile->slots = NULL;
+  g_mutex_clear (&profile->lock);
+}
+
+void
+gst_dtapi_profile_reset (GstDTAPIProfile * profile)
+{
+  g_atomic_int_inc (&profile->generation);
+}
+
+/* The calling thread's slot, made the first time it records */
+static GstDTAPIProfileSlot *
+gst_dtapi_profile_get_slot (GstDTAPIProfile * profile)
+{
+  GSList *slots = (GSList *) g_private_get (&thread_slots), *l;
+  GstDTAPIThreadSlot *thread_slot;
+
+  for (l = slots; l != NULL; l = l->next) {
+    thread_slot = (GstDTAPIThreadSlot *) l->data;
+    if (thread_slot->id == profile->id)
+      return thread_slot->slot;
+  }
+
+  thread_slot = g_new (GstDTAPIThreadSlot, 1);
+  thread_slot->id = profile->id;
+  thread_slot->slot = g_new0 (GstDTAPIProfileSlot, 1);
+  thread_slot->slot->generation = g_atomic_int_get (&profile->generation);
+  g_mutex_lock (&profile->lock);
+  profile->slots = g_slist_prepend (profile->slots, thread_slot->slot);
+  g_mutex_unlock (&profile->lock);
+  g_private_set (&thread_slots, g_slist_prepend (slots, thread_slot));
+  return thread_slot->slot;
+}
+
+void
+gst_dtapi_profile_record (GstDTAPIProfile * profile, GstDTAPICall call,
+    gint64 start_ns)
+{
+  GstDTAPIProfileSlot *slot = gst_dtapi_profile_get_slot (profile);
+  gint generation = g_atomic_int_get (&profile->generation);
+  GstDTAPICallStats *stats = &slot->calls[call];
+  guint64 ns = MAX (gst_dtapi_profile_now () - start_ns, 0);
+  guint64 us = ns / 1000;
+  guint bucket = us == 0 ? 0 : g_bit_storage (us);
+
+  if (G_UNLIKELY (slot->generation != generation)) {
+    memset (slot->calls, 0, sizeof (slot->calls));
+    g_atomic_int_set (&slot->generation, generation);
+  }
+  stats->count++;
+  stats->total_ns += ns;
+  stats->max_ns = MAX (stats->max_ns, ns);
+  stats->histogram[MIN (bucket, GST_DTAPI_PROFILE_BUCKETS - 1)]++;
+}
+
+GstStructure *
+gst_dtapi_profile_to_structure (GstDTAPIProfile * profile,
+    const gchar * name)
+{
+  GstStructure *s = gst_structure_new_empty (name);
+  GstDTAPICallStats calls[GST_DTAPI_N_CALLS];
+  gint generation = g_atomic_int_get (&profile->generation);
+  gchar field[32];
+  GSList *l;
+  int call, bucket;
+
+  memset (calls, 0, sizeof (calls));
+  g_mutex_lock (&profile->lock);
+  for (l = profile->slots; l != NULL; l = l->next) {
+    GstDTAPIProfileSlot *slot = (GstDTAPIProfileSlot *) l->data;
+
+    if (g_atomic_int_get (&slot->generation) != generation)
+      continue;
+    for (call = 0; call < GST_DTAPI_N_CALLS; call++) {
+      calls[call].count += slot->calls[call].count;
+      calls[call].total_ns += slot->calls[call].total_ns;
+      calls[call].max_ns = MAX (calls[call].max_ns, slot->calls[call].max_ns);
+      for (bucket = 0; bucket < GST_DTAPI_PROFILE_BUCKETS; bucket++)
+        calls[call].histogram[bucket] += slot->calls[call].histogram[bucket];
+    }
+  }
+  g_mutex_unlock (&profile->lock);
+
+  for (call = 0; call < GST_DTAPI_N_CALLS; call++) {
+    GstDTAPICallStats stats = calls[call];
+    GstStructure *method, *histogram;
+
+    if (stats.count == 0)
+      continue;
+
+    histogram = gst_structure_new_empty ("histogram");
+    for (bucket = 0; bucket < GST_DTAPI_PROFILE_BUCKETS; bucket++) {
+      if (stats.histogram[bucket] == 0)
+        continue;
+      if (bucket < GST_DTAPI_PROFILE_BUCKETS - 1)
+        g_snprintf (field, sizeof (field), "under-%uus", 1u << bucket);
+      else
+        g_snprintf (field, sizeof (field), "over-%uus", 1u << (bucket - 1));
+      gst_structure_set (histogram, field, G_TYPE_UINT64,
+          stats.histogram[bucket], NULL);
+    }
+
+    method = gst_structure_new (call_names[call],
+        "count", G_TYPE_UINT64, stats.count,
+        "total", G_TYPE_UINT64, stats.total_ns,
+        "mean", G_TYPE_UINT64, stats.total_ns / stats.count,
+        "max", G_TYPE_UINT64, stats.max_ns,
+        "histogram", GST_TYPE_STRUCTURE, histogram, NULL);
+    gst_structure_set (s, call_names[call], GST_TYPE_STRUCTURE, method, NULL);
+    gst_structure_free (histogram);
+    gst_structure_free (method);
+  }
+  return s;
+}
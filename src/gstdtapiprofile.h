@@ -0,0 +1,207 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * gstdtapiprofile.h: timing every call made to DekTec hardware
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_DTAPI_PROFILE_H__
+#define __GST_DTAPI_PROFILE_H__
+
+#include <gst/gst.h>
+#include <time.h>
+#include <utility>
+#include "DTAPI.h"
+
+/* These are C++ only as they deal in DTAPI objects */
+
+typedef enum {
+  GST_DTAPI_CALL_ATTACH_TO_SERIAL,
+  GST_DTAPI_CALL_ATTACH_TO_TYPE,
+  GST_DTAPI_CALL_ATTACH_TO_PORT,
+  GST_DTAPI_CALL_DETACH,
+  GST_DTAPI_CALL_WRITE,
+  GST_DTAPI_CALL_RESET,
+  GST_DTAPI_CALL_GET_FIFO_LOAD,
+  GST_DTAPI_CALL_GET_FIFO_SIZE,
+  GST_DTAPI_CALL_GET_FLAGS,
+  GST_DTAPI_CALL_GET_MOD_CONTROL,
+  GST_DTAPI_CALL_GET_OUTPUT_LEVEL,
+  GST_DTAPI_CALL_GET_RF_CONTROL,
+  GST_DTAPI_CALL_GET_TS_RATE_BPS,
+  GST_DTAPI_CALL_GET_TX_CONTROL,
+  GST_DTAPI_CALL_GET_TX_MODE,
+  GST_DTAPI_CALL_SET_MOD_CONTROL,
+  GST_DTAPI_CALL_SET_OUTPUT_LEVEL,
+  GST_DTAPI_CALL_SET_RF_CONTROL,
+  GST_DTAPI_CALL_SET_RF_MODE,
+  GST_DTAPI_CALL_SET_TS_RATE_BPS,
+  GST_DTAPI_CALL_SET_TX_CONTROL,
+  GST_DTAPI_CALL_SET_TX_MODE,
+  GST_DTAPI_N_CALLS
+} GstDTAPICall;
+
+/* Call times are counted in powers of two microseconds: bucket 0 is under
+   1 us, bucket n is under 2^n us and the last one takes the rest */
+#define GST_DTAPI_PROFILE_BUCKETS 24
+
+typedef struct _GstDTAPICallStats
+{
+  guint64 count;
+  guint64 total_ns;
+  guint64 max_ns;
+  guint64 histogram[GST_DTAPI_PROFILE_BUCKETS];
+} GstDTAPICallStats;
+
+/* The calls one thread has made, counted since generation */
+typedef struct _GstDTAPIProfileSlot
+{
+  volatile gint generation;
+  GstDTAPICallStats calls[GST_DTAPI_N_CALLS];
+} GstDTAPIProfileSlot;
+
+/* Every thread that makes calls (the streaming thread, the PLP feeder, the
+   application in unlock) records them in a slot of its own, so recording
+   takes no lock and there is only ever one writer to each slot.  Slots are
+   kept in slots, under lock, until gst_dtapi_profile_clear so the calls of
+   threads that have gone still count, and are merged when read.  Resetting
+   moves generation on: slots from before then are left out when reading
+   and start again the next time their thread records.  Readers may see a
+   call half recorded. */
+typedef struct _GstDTAPIProfile
+{
+  volatile gint enabled;
+  volatile gint generation;
+  guint id;
+  GMutex lock;
+  GSList *slots;
+} GstDTAPIProfile;
+
+void gst_dtapi_profile_init (GstDTAPIProfile * profile);
+void gst_dtapi_profile_clear (GstDTAPIProfile * profile);
+void gst_dtapi_profile_reset (GstDTAPIProfile * profile);
+void gst_dtapi_profile_record (GstDTAPIProfile * profile, GstDTAPICall call,
+    gint64 start_ns);
+
+/* One field per method called so far, named after it, each a structure of
+   count, total, mean and max (in ns) and histogram, a structure with a
+   field for each non-empty bucket */
+GstStructure *gst_dtapi_profile_to_structure (GstDTAPIProfile * profile,
+    const gchar * name);
+
+static inline gint64
+gst_dtapi_profile_now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (gint64) ts.tv_sec * GST_SECOND + ts.tv_nsec;
+}
+
+/* Times the rest of its scope against call if profile is enabled.  When it
+   isn't, all this costs is reading enabled. */
+class GstDTAPICallTimer
+{
+public:
+  GstDTAPICallTimer (GstDTAPIProfile * profile, GstDTAPICall call)
+    : profile_ (profile && g_atomic_int_get (&profile->enabled) ? profile
+                                                                : NULL),
+      call_ (call),
+      start_ (profile_ ? gst_dtapi_profile_now () : 0)
+  {
+  }
+  ~GstDTAPICallTimer ()
+  {
+    if (G_UNLIKELY (profile_ != NULL))
+      gst_dtapi_profile_record (profile_, call_, start_);
+  }
+
+private:
+  GstDTAPIProfile *profile_;
+  GstDTAPICall call_;
+  gint64 start_;
+};
+
+/* DTAPI's methods aren't virtual, so these only see calls made through a
+   pointer to the derived class.  That's all we need as the sink never
+   passes them around as anything else. */
+#define GST_DTAPI_PROFILED(Base, Method, call) \
+  template <typename... Args> DTAPI_RESULT Method (Args &&... args) \
+  { \
+    GstDTAPICallTimer timer (profile, call); \
+    return Base::Method (std::forward<Args> (args)...); \
+  }
+
+/* A DtDevice and a DtOutpChannel that time every call made to them in
+   profile, which may be NULL */
+class GstDTAPIDevice : public DtDevice
+{
+public:
+  GstDTAPIDevice (GstDTAPIProfile * p = NULL) : profile (p) {}
+
+  GST_DTAPI_PROFILED (DtDevice, AttachToSerial,
+      GST_DTAPI_CALL_ATTACH_TO_SERIAL)
+  GST_DTAPI_PROFILED (DtDevice, AttachToType, GST_DTAPI_CALL_ATTACH_TO_TYPE)
+  GST_DTAPI_PROFILED (DtDevice, Detach, GST_DTAPI_CALL_DETACH)
+
+  GstDTAPIProfile *profile;
+};
+
+class GstDTAPIOutpChannel : public DtOutpChannel
+{
+public:
+  GstDTAPIOutpChannel (GstDTAPIProfile * p = NULL) : profile (p) {}
+
+  GST_DTAPI_PROFILED (DtOutpChannel, AttachToPort,
+      GST_DTAPI_CALL_ATTACH_TO_PORT)
+  GST_DTAPI_PROFILED (DtOutpChannel, Detach, GST_DTAPI_CALL_DETACH)
+  GST_DTAPI_PROFILED (DtOutpChannel, Write, GST_DTAPI_CALL_WRITE)
+  GST_DTAPI_PROFILED (DtOutpChannel, Reset, GST_DTAPI_CALL_RESET)
+  GST_DTAPI_PROFILED (DtOutpChannel, GetFifoLoad,
+      GST_DTAPI_CALL_GET_FIFO_LOAD)
+  GST_DTAPI_PROFILED (DtOutpChannel, GetFifoSize,
+      GST_DTAPI_CALL_GET_FIFO_SIZE)
+  GST_DTAPI_PROFILED (DtOutpChannel, GetFlags, GST_DTAPI_CALL_GET_FLAGS)
+  GST_DTAPI_PROFILED (DtOutpChannel, GetModControl,
+      GST_DTAPI_CALL_GET_MOD_CONTROL)
+  GST_DTAPI_PROFILED (DtOutpChannel, GetOutputLevel,
+      GST_DTAPI_CALL_GET_OUTPUT_LEVEL)
+  GST_DTAPI_PROFILED (DtOutpChannel, GetRfControl,
+      GST_DTAPI_CALL_GET_RF_CONTROL)
+  GST_DTAPI_PROFILED (DtOutpChannel, GetTsRateBps,
+      GST_DTAPI_CALL_GET_TS_RATE_BPS)
+  GST_DTAPI_PROFILED (DtOutpChannel, GetTxControl,
+      GST_DTAPI_CALL_GET_TX_CONTROL)
+  GST_DTAPI_PROFILED (DtOutpChannel, GetTxMode, GST_DTAPI_CALL_GET_TX_MODE)
+  GST_DTAPI_PROFILED (DtOutpChannel, SetModControl,
+      GST_DTAPI_CALL_SET_MOD_CONTROL)
+  GST_DTAPI_PROFILED (DtOutpChannel, SetOutputLevel,
+      GST_DTAPI_CALL_SET_OUTPUT_LEVEL)
+  GST_DTAPI_PROFILED (DtOutpChannel, SetRfControl,
+      GST_DTAPI_CALL_SET_RF_CONTROL)
+  GST_DTAPI_PROFILED (DtOutpChannel, SetRfMode, GST_DTAPI_CALL_SET_RF_MODE)
+  GST_DTAPI_PROFILED (DtOutpChannel, SetTsRateBps,
+      GST_DTAPI_CALL_SET_TS_RATE_BPS)
+  GST_DTAPI_PROFILED (DtOutpChannel, SetTxControl,
+      GST_DTAPI_CALL_SET_TX_CONTROL)
+  GST_DTAPI_PROFILED (DtOutpChannel, SetTxMode, GST_DTAPI_CALL_SET_TX_MODE)
+
+  GstDTAPIProfile *profile;
+};
+
+#endif /* __GST_DTAPI_PROFILE_H__ */
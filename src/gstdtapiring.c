@@ -0,0 +1,133 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * gstdtapiring.c: single producer, single consumer byte ring
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include "gstdtapiring.h"
+
+/* DTAPI wants 32-bit aligned buffers */
+#define RING_ALIGN 4
+
+GstDTAPIRing *
+gst_dtapi_ring_new (gsize size, GstDTAPIMemFlags flags)
+{
+  GstDTAPIRing *ring = g_new0 (GstDTAPIRing, 1);
+
+  ring->size = size - size % RING_ALIGN;
+  ring->data = (guint8 *) gst_dtapi_mem_alloc (ring->size, flags, NULL);
+  g_mutex_init (&ring->lock);
+  g_cond_init (&ring->cond);
+  return ring;
+}
+
+void
+gst_dtapi_ring_free (GstDTAPIRing * ring)
+{
+  if (!ring)
+    return;
+  g_mutex_clear (&ring->lock);
+  g_cond_clear (&ring->cond);
+  gst_dtapi_mem_free (ring->data);
+  g_free (ring);
+}
+
+gboolean
+gst_dtapi_ring_write (GstDTAPIRing * ring, const guint8 * data, gsize len)
+{
+  g_mutex_lock (&ring->lock);
+  while (len > 0) {
+    gsize space, offset, chunk;
+
+    while (!ring->flushing && ring->written - ring->read == ring->size)
+      g_cond_wait (&ring->cond, &ring->lock);
+    if (ring->flushing) {
+      g_mutex_unlock (&ring->lock);
+      return FALSE;
+    }
+
+    space = ring->size - (gsize) (ring->written - ring->read);
+    offset = ring->written % ring->size;
+    chunk = MIN (MIN (len, space), ring->size - offset);
+
+    /* The consumer only ever reads below written, so we can copy without the
+       lock held */
+    g_mutex_unlock (&ring->lock);
+    memcpy (ring->data + offset, data, chunk);
+    g_mutex_lock (&ring->lock);
+
+    ring->written += chunk;
+    data += chunk;
+    len -= chunk;
+  }
+  g_mutex_unlock (&ring->lock);
+  return TRUE;
+}
+
+gsize
+gst_dtapi_ring_peek (GstDTAPIRing * ring, const guint8 ** data, gsize max)
+{
+  gsize fill, offset;
+
+  g_mutex_lock (&ring->lock);
+  fill = (gsize) (ring->written - ring->read);
+  offset = ring->read % ring->size;
+  g_mutex_unlock (&ring->lock);
+
+  *data = ring->data + offset;
+  return MIN (MIN (fill, max), ring->size - offset);
+}
+
+void
+gst_dtapi_ring_consume (GstDTAPIRing * ring, gsize len)
+{
+  g_mutex_lock (&ring->lock);
+  /* The ring may have been emptied by a flush while the consumer was busy
+     with what it peeked at */
+  ring->read = MIN (ring->read + len, ring->written);
+  g_cond_signal (&ring->cond);
+  g_mutex_unlock (&ring->lock);
+}
+
+gsize
+gst_dtapi_ring_fill (GstDTAPIRing * ring)
+{
+  gsize fill;
+
+  g_mutex_lock (&ring->lock);
+  fill = (gsize) (ring->written - ring->read);
+  g_mutex_unlock (&ring->lock);
+  return fill;
+}
+
+void
+gst_dtapi_ring_set_flushing (GstDTAPIRing * ring, gboolean flushing)
+{
+  g_mutex_lock (&ring->lock);
+  ring->flushing = flushing;
+  if (!flushing)
+    ring->read = ring->written;
+  g_cond_broadcast (&ring->cond);
+  g_mutex_unlock (&ring->lock);
+}
@@ -0,0 +1,68 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * gstdtapiring.h: single producer, single consumer byte ring
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_DTAPI_RING_H__
+#define __GST_DTAPI_RING_H__
+
+#include <glib.h>
+#include "gstdtapimem.h"
+
+G_BEGIN_DECLS
+
+/* The producer blocks in gst_dtapi_ring_write when the ring is full.  The
+   consumer never blocks: it peeks at what is there, hands it to DTAPI
+   straight out of the ring and then consumes it. */
+typedef struct _GstDTAPIRing
+{
+  guint8 *data;
+  gsize size;
+
+  GMutex lock;
+  GCond cond;
+  /* Free running byte counts; fill is written - read */
+  guint64 written;
+  guint64 read;
+  gboolean flushing;
+} GstDTAPIRing;
+
+GstDTAPIRing *gst_dtapi_ring_new (gsize size, GstDTAPIMemFlags flags);
+void gst_dtapi_ring_free (GstDTAPIRing * ring);
+
+/* Returns FALSE if the ring was set flushing before everything could be
+   written */
+gboolean gst_dtapi_ring_write (GstDTAPIRing * ring, const guint8 * data,
+    gsize len);
+
+/* Returns the length of the contiguous readable region starting at *data,
+   at most max */
+gsize gst_dtapi_ring_peek (GstDTAPIRing * ring, const guint8 ** data,
+    gsize max);
+void gst_dtapi_ring_consume (GstDTAPIRing * ring, gsize len);
+
+gsize gst_dtapi_ring_fill (GstDTAPIRing * ring);
+
+/* Wakes up and fails any blocked writers.  Clearing flushing also empties
+   the ring. */
+void gst_dtapi_ring_set_flushing (GstDTAPIRing * ring, gboolean flushing);
+
+G_END_DECLS
+#endif /* __GST_DTAPI_RING_H__ */
@@ -50,7 +50,7 @@
  * <refsect2>
  * <title>Example launch line</title>
  * |[
- * gst-launch-0.10 filesrc location=Mux1.ts ! dtapisink
+ * gst-launch-1.0 filesrc location=Mux1.ts ! dtapisink
  * ]|
  * </refsect2>
  */
@@ -65,22 +65,71 @@
 #include <gst/base/gstbasesink.h>
 
 #include "DTAPI.h"
+#include "gstdtapicarousel.h"
+#include "gstdtapidelay.h"
+#include "gstdtapidevice.h"
+#include "gstdtapimem.h"
+#include "gstdtapimirror.h"
+#include "gstdtapimodpars.h"
+#include "gstdtapimodprofile.h"
+#include "gstdtapimonitor.h"
+#include "gstdtapipcr.h"
+#include "gstdtapipidfilter.h"
+#include "gstdtapiprofile.h"
+#include "gstdtapiring.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <assert.h>
+#include <pthread.h>
+#include <sched.h>
 
-/* FIXME: what is a sane default?: */
-#define DEFAULT_BITRATE 24128342
+/* 0 means use the channel capacity for the current modulation parameters */
+#define DEFAULT_BITRATE 0
 #define DEFAULT_FREQUENCY 474000000
 #define DEFAULT_OUTPUT_POWER -495 /* /0.1dBm */
 #define DEFAULT_CODE_RATE DTAPI_MOD_2_3
 #define DEFAULT_BANDWIDTH DTAPI_MOD_DVBT_8MHZ
-#define DEFAULT_MODULATION DTAPI_MOD_DVBT_QAM64
+#define DEFAULT_MODULATION GST_DTAPI_CONSTELLATION_QAM64
 #define DEFAULT_GUARD DTAPI_MOD_DVBT_G_1_32
 #define DEFAULT_INTERLEAVING DTAPI_MOD_DVBT_NATIVE
 #define DEFAULT_TRANSMISSION_MODE DTAPI_MOD_DVBT_8K
 #define DEFAULT_INVERSION 0
 #define DEFAULT_TXMODE DTAPI_TXMODE_188
 #define DEFAULT_STUFFING 1
+#define DEFAULT_STANDARD GST_DTAPI_STANDARD_DVBT
+#define DEFAULT_SYMBOL_RATE 6900000
+#define DEFAULT_PILOTS FALSE
+#define DEFAULT_SHORT_FRAMES FALSE
+#define DEFAULT_T2_FFT_MODE DTAPI_DVBT2_FFT_32K
+#define DEFAULT_T2_GUARD DTAPI_DVBT2_GI_1_128
+#define DEFAULT_T2_PILOT_PATTERN DTAPI_DVBT2_PP_7
+#define DEFAULT_T2_FEC_TYPE DTAPI_DVBT2_LDPC_64K
+#define DEFAULT_T2_PLPS NULL
+#define DEFAULT_PROFILE_LOCATION NULL
+#define DEFAULT_PROFILE NULL
+#define DEFAULT_DRAIN_ON_EOS TRUE
+#define DEFAULT_EOS_TAIL 0
+#define DEFAULT_PID_FILTER NULL
+#define DEFAULT_PID_REMAP NULL
+#define DEFAULT_MONITOR FALSE
+#define DEFAULT_PCR_RESTAMP FALSE
+#define DEFAULT_SI_LOCATION NULL
+#define DEFAULT_NIT_INTERVAL GST_DTAPI_CAROUSEL_DEFAULT_NIT_INTERVAL
+#define DEFAULT_SDT_INTERVAL GST_DTAPI_CAROUSEL_DEFAULT_SDT_INTERVAL
+#define DEFAULT_TDT_INTERVAL GST_DTAPI_CAROUSEL_DEFAULT_TDT_INTERVAL
+#define DEFAULT_RECOVERY_TIMEOUT 30
+#define DEFAULT_REALTIME_PRIORITY 0
+#define DEFAULT_REALTIME_POLICY SCHED_FIFO
+#define DEFAULT_CPU_AFFINITY 0
+#define DEFAULT_LOCK_MEMORY FALSE
+#define DEFAULT_HUGEPAGES FALSE
+#define DEFAULT_PROFILE_CALLS FALSE
+#define DEFAULT_DELAY 0
+#define DEFAULT_DELAY_LOCATION NULL
+#define DEFAULT_MIRROR_LOCATION NULL
+#define DEFAULT_MIRROR_FILE_SIZE (G_GUINT64_CONSTANT (1) << 30)
+#define DEFAULT_MIRROR_MAX_FILES 0
 
 #define GST_TYPE_DTAPISINK_CODE_RATE (gst_dtapisink_code_rate_get_type ())
 static GType
@@ -117,9 +166,17 @@ gst_dtapisink_modulation_get_type (void)
 {
   static GType dtapisink_modulation_type = 0;
   static GEnumValue modulation_types[] = {
-    {DTAPI_MOD_DVBT_QPSK,   "QPSK",    "qpsk"},
-    {DTAPI_MOD_DVBT_QAM16,  "QAM 16",  "qam-16"},
-    {DTAPI_MOD_DVBT_QAM64,  "QAM 64",  "qam-64"},
+    {GST_DTAPI_CONSTELLATION_QPSK,   "QPSK",     "qpsk"},
+    {GST_DTAPI_CONSTELLATION_QAM16,  "QAM 16",   "qam-16"},
+    {GST_DTAPI_CONSTELLATION_QAM32,  "QAM 32",   "qam-32"},
+    {GST_DTAPI_CONSTELLATION_QAM64,  "QAM 64",   "qam-64"},
+    {GST_DTAPI_CONSTELLATION_QAM128, "QAM 128",  "qam-128"},
+    {GST_DTAPI_CONSTELLATION_QAM256, "QAM 256",  "qam-256"},
+    {GST_DTAPI_CONSTELLATION_8PSK,   "8PSK",     "8psk"},
+    {GST_DTAPI_CONSTELLATION_16APSK, "16APSK",   "16apsk"},
+    {GST_DTAPI_CONSTELLATION_32APSK, "32APSK",   "32apsk"},
+    {GST_DTAPI_CONSTELLATION_8VSB,   "8-VSB",    "8vsb"},
+    {GST_DTAPI_CONSTELLATION_16VSB,  "16-VSB",   "16vsb"},
     {0, NULL, NULL},
   };
 
@@ -265,122 +322,406 @@ gst_dtapisink_stuffing_get_type (void)
   return dtapisink_stuffing_type;
 }
 
-static const char* result_to_string(DTAPI_RESULT result)
-{
-  switch (result) {
-  case DTAPI_OK:
-    return "Success";
-  case DTAPI_E_DEV_DRIVER:
-    return "Unclassified failure in device driver";
-  case DTAPI_E_INSUF_LOAD:
-    return "For modulators: FIFO load is insufficient to start modulation";
-  case DTAPI_E_INVALID_LEVEL:
-    return "The output level specified in SetOutputLevel is invalid for the "
-           "attached hardware function";
-  case DTAPI_E_INVALID_MODE:
-    return "The specified transmit-control state is invalid or incompatible "
-           "with the attached hardware function";
-    // FIXME: This is for SetModControl:
-    return "Modulation type is incompatible with modulator";
-  case DTAPI_E_MODPARS_NOT_SET:
-    return "For modulators: modulation parameters have not been set but are "
-           "required for starting modulation";
-  case DTAPI_E_MODTYPE_UNSUP:
-    return "For modulators: modulation type is not supported";
-  case DTAPI_E_NO_IPPARS:
-    return "For TS-over-IP channels: cannot set transmission state because "
-           "IP parameters have not been specified yet";
-  case DTAPI_E_NO_TSRATE:
-    // FIXME: This is for SetTxControl:
-    return "For modulators: TS rate has not been set but is required for "
-           "starting modulation";
-    // FIXME: And this is for Write:
-    return "For TS-over-IP channels: cannot write data because Transport-"
-           "Stream rate has not been specified, or is too low";
-  case DTAPI_E_NOT_ATTACHED:
-    return "Channel object is not attached to a hardware function";
-  case DTAPI_E_INVALID_BUF:
-    return "The buffer is not aligned to a 32-bit word boundary";
-  case DTAPI_E_INVALID_SIZE:
-    return "The specified transfer size is negative or not a multiple of four";
-  case DTAPI_E_IDLE:
-    // FIXME: This is for write
-    return "Cannot write data because transmission-control state is"
-           "DTAPI_TXCTRL_IDLE";
-    // FIXME: And this is for SetModControl:
-    return "Transmit-control state is not DTAPI_TXCTRL_IDLE; The requested "
-           "modulation parameters can only be set in idle state";
-  case DTAPI_E_INVALID_BANDWIDTH:
-      return "Invalid value for bandwidth field";
-  case DTAPI_E_INVALID_CONSTEL:
-      return "Invalid value for constellation field";
-  case DTAPI_E_INVALID_FHMODE:
-      return "Invalid value for frame-header mode field";
-  case DTAPI_E_INVALID_GUARD:
-      return "Invalid value for guard-interval field";
-  case DTAPI_E_INVALID_INTERLVNG:
-      return "Invalid value for interleaving field";
-  case DTAPI_E_INVALID_J83ANNEX:
-  case DTAPI_E_INVALID_ROLLOFF:
-      return "Invalid value for J.83 annex";
-  case DTAPI_E_INVALID_PILOTS:
-      return "Pilots cannot be specified in C=1 mode";
-  case DTAPI_E_INVALID_RATE:
-      return "Invalid value for convolutional rate or FEC code rate";
-  case DTAPI_E_INVALID_TRANSMODE:
-      return "Invalid value for transmission-mode field";
-  case DTAPI_E_INVALID_USEFRAMENO:
-      return "Invalid value for use-frame-numbering field";
-  case DTAPI_E_NOT_SUPPORTED:
-      return "The device does not include a modulator";
-  default:
-    return "Unknown error";
+#define GST_TYPE_DTAPISINK_STANDARD (gst_dtapisink_standard_get_type ())
+static GType
+gst_dtapisink_standard_get_type (void)
+{
+  static GType dtapisink_standard_type = 0;
+  static GEnumValue standard_types[] = {
+    {GST_DTAPI_STANDARD_DVBT,  "DVB-T",              "dvb-t"},
+    {GST_DTAPI_STANDARD_J83A,  "J.83 annex A/DVB-C", "j83a"},
+    {GST_DTAPI_STANDARD_J83B,  "J.83 annex B",       "j83b"},
+    {GST_DTAPI_STANDARD_J83C,  "J.83 annex C",       "j83c"},
+    {GST_DTAPI_STANDARD_ATSC,  "ATSC",               "atsc"},
+    {GST_DTAPI_STANDARD_ISDBT, "ISDB-T",             "isdb-t"},
+    {GST_DTAPI_STANDARD_DVBS2, "DVB-S2",             "dvb-s2"},
+    {GST_DTAPI_STANDARD_DVBT2, "DVB-T2",             "dvb-t2"},
+    {0, NULL, NULL},
+  };
+
+  if (!dtapisink_standard_type) {
+    dtapisink_standard_type =
+        g_enum_register_static ("GstDTAPISinkStandard", standard_types);
+  }
+  return dtapisink_standard_type;
+}
+
+#define GST_TYPE_DTAPISINK_T2_FFT_MODE (gst_dtapisink_t2_fft_mode_get_type ())
+static GType
+gst_dtapisink_t2_fft_mode_get_type (void)
+{
+  static GType dtapisink_t2_fft_mode_type = 0;
+  static GEnumValue t2_fft_mode_types[] = {
+    {DTAPI_DVBT2_FFT_1K,  "1K",  "1k"},
+    {DTAPI_DVBT2_FFT_2K,  "2K",  "2k"},
+    {DTAPI_DVBT2_FFT_4K,  "4K",  "4k"},
+    {DTAPI_DVBT2_FFT_8K,  "8K",  "8k"},
+    {DTAPI_DVBT2_FFT_16K, "16K", "16k"},
+    {DTAPI_DVBT2_FFT_32K, "32K", "32k"},
+    {0, NULL, NULL},
+  };
+
+  if (!dtapisink_t2_fft_mode_type) {
+    dtapisink_t2_fft_mode_type =
+        g_enum_register_static ("GstDTAPISinkT2FftMode", t2_fft_mode_types);
+  }
+  return dtapisink_t2_fft_mode_type;
+}
+
+#define GST_TYPE_DTAPISINK_T2_GUARD (gst_dtapisink_t2_guard_get_type ())
+static GType
+gst_dtapisink_t2_guard_get_type (void)
+{
+  static GType dtapisink_t2_guard_type = 0;
+  static GEnumValue t2_guard_types[] = {
+    {DTAPI_DVBT2_GI_1_128,  "1/128",  "1/128"},
+    {DTAPI_DVBT2_GI_1_32,   "1/32",   "1/32"},
+    {DTAPI_DVBT2_GI_1_16,   "1/16",   "1/16"},
+    {DTAPI_DVBT2_GI_19_256, "19/256", "19/256"},
+    {DTAPI_DVBT2_GI_1_8,    "1/8",    "1/8"},
+    {DTAPI_DVBT2_GI_19_128, "19/128", "19/128"},
+    {DTAPI_DVBT2_GI_1_4,    "1/4",    "1/4"},
+    {0, NULL, NULL},
+  };
+
+  if (!dtapisink_t2_guard_type) {
+    dtapisink_t2_guard_type =
+        g_enum_register_static ("GstDTAPISinkT2Guard", t2_guard_types);
+  }
+  return dtapisink_t2_guard_type;
+}
+
+#define GST_TYPE_DTAPISINK_T2_PILOT_PATTERN \
+  (gst_dtapisink_t2_pilot_pattern_get_type ())
+static GType
+gst_dtapisink_t2_pilot_pattern_get_type (void)
+{
+  static GType dtapisink_t2_pilot_pattern_type = 0;
+  static GEnumValue t2_pilot_pattern_types[] = {
+    {DTAPI_DVBT2_PP_1, "PP1", "pp1"},
+    {DTAPI_DVBT2_PP_2, "PP2", "pp2"},
+    {DTAPI_DVBT2_PP_3, "PP3", "pp3"},
+    {DTAPI_DVBT2_PP_4, "PP4", "pp4"},
+    {DTAPI_DVBT2_PP_5, "PP5", "pp5"},
+    {DTAPI_DVBT2_PP_6, "PP6", "pp6"},
+    {DTAPI_DVBT2_PP_7, "PP7", "pp7"},
+    {DTAPI_DVBT2_PP_8, "PP8", "pp8"},
+    {0, NULL, NULL},
+  };
+
+  if (!dtapisink_t2_pilot_pattern_type) {
+    dtapisink_t2_pilot_pattern_type =
+        g_enum_register_static ("GstDTAPISinkT2PilotPattern",
+        t2_pilot_pattern_types);
+  }
+  return dtapisink_t2_pilot_pattern_type;
+}
+
+#define GST_TYPE_DTAPISINK_T2_FEC_TYPE (gst_dtapisink_t2_fec_type_get_type ())
+static GType
+gst_dtapisink_t2_fec_type_get_type (void)
+{
+  static GType dtapisink_t2_fec_type_type = 0;
+  static GEnumValue t2_fec_type_types[] = {
+    {DTAPI_DVBT2_LDPC_16K, "16K LDPC", "16k"},
+    {DTAPI_DVBT2_LDPC_64K, "64K LDPC", "64k"},
+    {0, NULL, NULL},
+  };
+
+  if (!dtapisink_t2_fec_type_type) {
+    dtapisink_t2_fec_type_type =
+        g_enum_register_static ("GstDTAPISinkT2FecType", t2_fec_type_types);
+  }
+  return dtapisink_t2_fec_type_type;
+}
+
+#define GST_TYPE_DTAPISINK_REALTIME_POLICY \
+  (gst_dtapisink_realtime_policy_get_type ())
+static GType
+gst_dtapisink_realtime_policy_get_type (void)
+{
+  static GType dtapisink_realtime_policy_type = 0;
+  static GEnumValue realtime_policy_types[] = {
+    {SCHED_FIFO, "SCHED_FIFO", "fifo"},
+    {SCHED_RR,   "SCHED_RR",   "rr"},
+    {0, NULL, NULL},
+  };
+
+  if (!dtapisink_realtime_policy_type) {
+    dtapisink_realtime_policy_type =
+        g_enum_register_static ("GstDTAPISinkRealtimePolicy",
+                                realtime_policy_types);
   }
+  return dtapisink_realtime_policy_type;
 }
 
 /* FIXME: RESOURCE, OPEN_WRITE is inappropriate for the vast majority of errors
-   here.  Need to go though and apply the right codes in the right places */
+   here.  Need to go though and apply the right codes in the right places.
+
+   Losing the device isn't an error yet: the next write notices channel_lost
+   and tries to get it back, see gst_dtapi_sink_recover.  Must be called with
+   channel_lock held. */
 #define CHECK(expr, desc) \
   if ((result = expr) != DTAPI_OK) { \
-    GST_ELEMENT_ERROR(sink, RESOURCE, OPEN_WRITE, (NULL), \
-                      (desc, result_to_string(result))); \
+    if (gst_dtapi_result_is_transient (result)) { \
+      GST_WARNING_OBJECT (sink, desc, gst_dtapi_result_to_string(result)); \
+      sink->channel_lost = TRUE; \
+    } else { \
+      GST_ELEMENT_ERROR(sink, RESOURCE, OPEN_WRITE, (NULL), \
+                        (desc, gst_dtapi_result_to_string(result))); \
+    } \
   }
 
 #define BUFSIZE (512 * 1024)
 
+#define TS_PACKET_SIZE 188
+
+/* What we ask upstream to allocate for us in the allocation query.  DTAPI
+   wants 32-bit aligned buffers which are a multiple of 4 bytes long. */
+#define POOL_ALIGN 4
+#define POOL_BUFFER_SIZE (TS_PACKET_SIZE * POOL_ALIGN * 256)
+
+/* Multi-PLP: each PLP's ring holds this much of its own data */
+#define PLP_RING_MS 500
+/* The feeder visits every PLP once per round and gives it this much time's
+   worth of its capacity, so the PLPs drain in proportion */
+#define PLP_QUANTUM_MS 1
+/* How long the feeder sleeps when there was nothing it could write */
+#define PLP_FEEDER_IDLE_US 1000
+
+/* Draining on EOS: we sleep for as long as the data left in the FIFO should
+   take to air, within these bounds, then check again */
+#define DRAIN_MIN_WAIT_US 1000
+#define DRAIN_MAX_WAIT_US 100000
+/* Give up if the FIFO hasn't gone down at all in this long */
+#define DRAIN_STALL_US 2000000
+/* Null packets are written out this many at a time */
+#define STUFFING_CHUNK_PACKETS 64
+
+/* Recovery: how often we try to attach again once the device has gone.  A
+   USB device is usually back within a few hundred ms of being lost. */
+#define RECOVERY_RETRY_US 100000
+
+/* QoS: the FIFO trend is smoothed over roughly this long */
+#define QOS_SMOOTHING_MS 500
+/* Send QoS upstream at most this often */
+#define QOS_INTERVAL_US 100000
+/* Keep the FIFO this full.  Any more and we're just adding latency, any less
+   and we're closer to underflow than we need to be. */
+#define QOS_TARGET_FILL 0.5
+/* How quickly we ask upstream to get the FIFO back to the target, in
+   seconds */
+#define QOS_CORRECTION_S 1.0
+
+/* What gst_dtapi_sink_apply_scheduling has done to one thread.  The
+   thread's own policy, priority and affinity are saved the first time we
+   change them so they can be put back when the properties go back to 0 or
+   at EOS.  Only ever touched by that thread, as a saved pthread_t may
+   belong to a thread that has since gone and had its id reused. */
+typedef struct
+{
+  /* The sched_generation last applied, and the thread it was applied to */
+  gint applied;
+  pthread_t thread;
+  gboolean policy_saved;
+  int policy;
+  struct sched_param param;
+  gboolean affinity_saved;
+  cpu_set_t cpus;
+} GstDTAPISinkSched;
+
 typedef struct _GstDTAPISink
 {
   GstBaseSink base_class;
 
   GstPad *sinkpad;
 
-  DtDevice* Dvc;
-  DtOutpChannel* TsOut;
+  GstDTAPIDevice* Dvc;
+  GstDTAPIOutpChannel* TsOut;
+  /* Every call made to Dvc and TsOut is timed here when call_profile.enabled
+     is set, see gstdtapiprofile.h */
+  GstDTAPIProfile call_profile;
+
+  /* Held by whichever thread is talking to TsOut, see
+     gst_dtapi_sink_apply_pending */
+  GMutex channel_lock;
+  /* Held by recover while it detaches TsOut and attaches it again, and by
+     unlock around its Reset, which can't wait for channel_lock */
+  GMutex attach_lock;
+  /* PENDING_* bits for settings changed but not yet pushed to TsOut */
+  volatile guint pending;
+  /* Whether TsOut was last put into DTAPI_TXCTRL_SEND, see
+     gst_dtapi_sink_set_tx_control */
+  volatile gint transmitting;
 
   /* Each of these mirrors a parameter that must be passed to DTAPI.  We do this
      so we can assign to them before we have even set-up the relevant DTAPI
-     objects. */
+     objects.  Protected by the object lock. */
   int ts_rate_bps;
   int64_t frequency;
-  int code_rate;
-  int mod_param;
+  GstDTAPIModPars mod;
   int rf_mode;
   int tx_mode;
   int stuff_mode;
   int output_power;
+
+  /* Named sets of the above loaded from profile-location, and the one last
+     switched to.  Protected by the object lock. */
+  gchar* profile_location;
+  GHashTable* mod_profiles;
+  gchar* profile_name;
+
+  /* DVB-T2 multi-PLP.  PLP 0 comes in on the always sink pad and the others
+     on the plp_%u request pads.  Each PLP is buffered in its own ring and a
+     feeder thread moves data from the rings to the PLP's FIFO on the
+     modulator as and when there is room, so a PLP with no data or no room
+     never holds up the others.  None of this is used with a single PLP. */
+  gchar* t2_plps;
+  GstPad* plp_pads[GST_DTAPI_MAX_PLPS];
+  GstDTAPIRing* plp_rings[GST_DTAPI_MAX_PLPS];
+  int plp_quantum[GST_DTAPI_MAX_PLPS];
+  int plp_fifo_size;
+  GThread* plp_feeder;
+  volatile gint plp_feeder_stop;
+
+  /* On EOS we wait for the FIFO to empty (after airing eos_tail_ms of null
+     packets) before passing it on.  unlock sets drain_cancelled to get us out
+     of that early. */
+  gboolean drain_on_eos;
+  guint eos_tail_ms;
+  GMutex drain_lock;
+  GCond drain_cond;
+  gboolean drain_cancelled;
+
+  /* What we last knew about the FIFO, so that queries never have to go to
+     the device (and wait for channel_lock).  For multi-PLP these are for
+     PLP 0.  Protected by the object lock.  ts_rate_cache is only set by
+     gst_dtapi_sink_apply_pending, which holds channel_lock as well. */
+  guint64 bytes_written;
+  int fifo_load;
+  int fifo_size;
+  int ts_rate_cache;
+
+  /* Where the end of the last buffer we rendered falls, as stream time for
+     the position query and as running time for QoS.  GST_CLOCK_TIME_NONE
+     until we've rendered a timestamped buffer since starting or flushing.
+     Protected by the object lock. */
+  GstClockTime last_position;
+  GstClockTime last_running_time;
+
+  /* QoS: smoothed rate of change of fifo_load in bytes/s, worked out from
+     the cached values above as they're updated.  Protected by the object
+     lock. */
+  gdouble fifo_trend;
+  gint64 fifo_update_time;
+  gint64 qos_sent_time;
+
+  /* pid-filter and pid-remap.  set_property builds pid_table_next under the
+     object lock and the streaming thread swaps it in before the next
+     buffer, so the table in use never changes under it.  A NULL table
+     passes everything through untouched. */
+  gchar* pid_filter_desc;
+  gchar* pid_remap_desc;
+  GstDTAPIPidTable* pid_table_next;
+  volatile gint pid_table_changed;
+  GstDTAPIPidTable* pid_table;
+  GstDTAPIPidFilter pid_filter;
+
+  /* Where the streaming thread puts data it has to change before writing */
+  guint8* scratch;
+  gsize scratch_size;
+
+  /* pcr-restamp.  restamp belongs to the streaming thread, which copies
+     its stats to pcr_stats under the object lock for get_property. */
+  gboolean pcr_restamp;
+  GstDTAPIPcrRestamp* restamp;
+  GstDTAPIPcrStats pcr_stats;
+
+  /* SI carousel.  As with the PID table set_property builds carousel_next
+     and sets carousel_changed and the streaming thread swaps it in.
+     si_changed says the intervals need passing on. */
+  gchar* si_location;
+  guint si_interval[GST_DTAPI_CAROUSEL_N_TABLES];
+  GstDTAPICarousel* carousel_next;
+  gboolean carousel_changed;
+  gboolean si_changed;
+  GstDTAPICarousel* carousel;
+
+  /* delay.  As with the PID table set_property sets delay_changed and the
+     streaming thread makes delay_line match, so delay_line is the streaming
+     thread's.  NULL when we're live.  Making a delay line allocates the
+     whole file, so when delay_line hasn't room for the new delay (more than
+     delay_max_hold bytes) set_property or start builds delay_next first and
+     the streaming thread only has to swap it in.  It leaves the delay alone
+     while delay_preparing says one is being built.  delay_fill is how much
+     delay_line is holding, kept up to date by the streaming thread for
+     position queries. */
+  guint delay_ms;
+  gchar* delay_location;
+  volatile gint delay_changed;
+  GstDTAPIDelay* delay_next;
+  gsize delay_max_hold;
+  guint delay_preparing;
+  gsize delay_fill;
+  GstDTAPIDelay* delay_line;
+
+  /* Air-check copy of everything we Write, made in start and freed in stop
+     under the object lock so mirror-stats can get at it.  Otherwise it's
+     used by whoever holds channel_lock. */
+  gchar* mirror_location;
+  guint64 mirror_file_size;
+  guint mirror_max_files;
+  GstDTAPIMirror* mirror;
+  gboolean mirror_failed;
+
+  /* TR 101 290 checks on what we write, created by the streaming thread
+     when first needed */
+  gboolean monitor;
+  GstDTAPIMonitor* mon;
+
+  /* Recovery.  CHECK and write set channel_lost when the device goes away
+     and the streaming thread then attaches again as soon as it can, see
+     gst_dtapi_sink_recover.  channel_lost and the outage_* fields are under
+     channel_lock, the rest under the object lock. */
+  guint recovery_timeout;
+  gboolean channel_lost;
+  gint64 outage_start;
+  gint64 outage_next_attach;
+  guint outage_attempts;
+  guint64 outages;
+  GstClockTime outage_total;
+  GstClockTime outage_max;
+
+  /* Scheduling for whichever thread calls Write: the streaming thread or,
+     with multiple PLPs, the feeder.  Each applies the settings to itself
+     when sched_generation moves on from what it last applied, see
+     gst_dtapi_sink_apply_scheduling.  sched is the streaming thread's,
+     which only it touches while we're running and stop forgets.  A thread
+     that is stopped without EOS is left as we made it.  lock_memory and hugepages apply to the
+     scratch buffer and PLP rings, which are allocated in start.  The rest
+     are under the object lock. */
+  guint realtime_priority;
+  int realtime_policy;
+  guint64 cpu_affinity;
+  gboolean lock_memory;
+  gboolean hugepages;
+  volatile gint sched_generation;
+  GstDTAPISinkSched sched;
 } GstDTAPISink;
 
 typedef struct _GstDTAPISinkClass {
   GstBaseSinkClass parent_class;
 } GstDTAPISinkClass;
 
-static void
-_do_init (GType gst_dtapi_sink_type)
-{
-}
+GST_DEBUG_CATEGORY_STATIC (gst_dtapi_sink_debug);
+#define GST_CAT_DEFAULT gst_dtapi_sink_debug
 
-GST_BOILERPLATE_FULL (GstDTAPISink, gst_dtapi_sink, GstBaseSink,
-                      GST_TYPE_BASE_SINK, _do_init);
+#define _do_init \
+  GST_DEBUG_CATEGORY_INIT (gst_dtapi_sink_debug, "dtapisink", 0, \
+      "DekTec DTAPI sink");
+#define gst_dtapi_sink_parent_class parent_class
+G_DEFINE_TYPE_WITH_CODE (GstDTAPISink, gst_dtapi_sink, GST_TYPE_BASE_SINK,
+                         _do_init);
 
 #define GST_TYPE_DTAPI_SINK \
   (gst_dtapi_sink_get_type())
@@ -401,9 +742,24 @@ static void gst_dtapi_sink_get_property (GObject * object, guint prop_id,
 static gboolean      gst_dtapi_sink_start       (GstBaseSink *sink);
 static GstFlowReturn gst_dtapi_sink_render      (GstBaseSink *sink,
                                                  GstBuffer *buffer);
+static GstFlowReturn gst_dtapi_sink_render_list (GstBaseSink *sink,
+                                                 GstBufferList *list);
+static gboolean      gst_dtapi_sink_propose_allocation (GstBaseSink *sink,
+                                                        GstQuery *query);
+static gboolean      gst_dtapi_sink_event       (GstBaseSink *sink,
+                                                 GstEvent *event);
+static gboolean      gst_dtapi_sink_query       (GstBaseSink *sink,
+                                                 GstQuery *query);
 static gboolean      gst_dtapi_sink_unlock      (GstBaseSink *sink);
 static gboolean      gst_dtapi_sink_stop_unlock (GstBaseSink *sink);
 static gboolean      gst_dtapi_sink_stop        (GstBaseSink *sink);
+static void          gst_dtapi_sink_finalize    (GObject * object);
+static GstPad*       gst_dtapi_sink_request_new_pad (GstElement * element,
+                                                     GstPadTemplate * templ,
+                                                     const gchar * name,
+                                                     const GstCaps * caps);
+static void          gst_dtapi_sink_release_pad (GstElement * element,
+                                                 GstPad * pad);
 
 enum
 {
@@ -436,6 +792,67 @@ enum
   PROP_DTAPISINK_TXMODE,
   PROP_DTAPISINK_STUFFING,
 
+  /* Standards other than DVB-T */
+  PROP_DTAPISINK_STANDARD,
+  PROP_DTAPISINK_SYMBOL_RATE,
+  PROP_DTAPISINK_PILOTS,
+  PROP_DTAPISINK_SHORT_FRAMES,
+  PROP_DTAPISINK_T2_FFT_MODE,
+  PROP_DTAPISINK_T2_GUARD,
+  PROP_DTAPISINK_T2_PILOT_PATTERN,
+  PROP_DTAPISINK_T2_FEC_TYPE,
+  PROP_DTAPISINK_T2_PLPS,
+
+  /* Profiles */
+  PROP_DTAPISINK_PROFILE_LOCATION,
+  PROP_DTAPISINK_PROFILE,
+
+  /* EOS handling */
+  PROP_DTAPISINK_DRAIN_ON_EOS,
+  PROP_DTAPISINK_EOS_TAIL,
+
+  /* Packet filtering */
+  PROP_DTAPISINK_PID_FILTER,
+  PROP_DTAPISINK_PID_REMAP,
+
+  /* Monitoring */
+  PROP_DTAPISINK_MONITOR,
+
+  /* Timing */
+  PROP_DTAPISINK_PCR_RESTAMP,
+  PROP_DTAPISINK_PCR_STATS,
+
+  /* SI */
+  PROP_DTAPISINK_SI_LOCATION,
+  PROP_DTAPISINK_NIT_INTERVAL,
+  PROP_DTAPISINK_SDT_INTERVAL,
+  PROP_DTAPISINK_TDT_INTERVAL,
+
+  /* Delay */
+  PROP_DTAPISINK_DELAY,
+  PROP_DTAPISINK_DELAY_LOCATION,
+
+  /* Mirror */
+  PROP_DTAPISINK_MIRROR_LOCATION,
+  PROP_DTAPISINK_MIRROR_FILE_SIZE,
+  PROP_DTAPISINK_MIRROR_MAX_FILES,
+  PROP_DTAPISINK_MIRROR_STATS,
+
+  /* Recovery */
+  PROP_DTAPISINK_RECOVERY_TIMEOUT,
+  PROP_DTAPISINK_RECOVERY_STATS,
+
+  /* Scheduling */
+  PROP_DTAPISINK_REALTIME_PRIORITY,
+  PROP_DTAPISINK_REALTIME_POLICY,
+  PROP_DTAPISINK_CPU_AFFINITY,
+  PROP_DTAPISINK_LOCK_MEMORY,
+  PROP_DTAPISINK_HUGEPAGES,
+
+  /* Profiling */
+  PROP_DTAPISINK_PROFILE_CALLS,
+  PROP_DTAPISINK_CALL_STATS,
+
 #if 0
   /* GetFifoLoad */
   PROP_FIFO_LOAD,
@@ -455,7 +872,9 @@ enum
   PROP_DTAPISINK_TUNE,
   PROP_DTAPISINK_DISEQC_SRC,
 
-  /* TODO: Work out how hierarchy fits into all of this: */
+  /* TODO: Work out how hierarchy fits into all of this.  DTAPI's DVB-T
+     ParXtra1 has no hierarchy field and a DtOutpChannel has the one FIFO,
+     so there's nowhere to send an LP stream. */
   PROP_DTAPISINK_HIERARCHY_INF,
   PROP_DTAPISINK_CODE_RATE_HP,
   PROP_DTAPISINK_CODE_RATE_LP,
@@ -468,35 +887,49 @@ enum
 static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
-    GST_STATIC_CAPS("video/mpegts, mpegversion = (int) 2"));
-
-static void
-gst_dtapi_sink_base_init (gpointer g_class)
-{
-  GstElementClass *gstelement_class = GST_ELEMENT_CLASS (g_class);
+    GST_STATIC_CAPS("video/mpegts, systemstream = (boolean) true"));
 
-  gst_element_class_set_details_simple (gstelement_class,
-      "DekTec DTAPI Sink",
-      "Sink/Modulator",
-      "Write data to a DekTec modulator",
-      "William Manley <william.manley@youview.com>");
-  gst_element_class_add_pad_template (gstelement_class,
-      gst_static_pad_template_get (&sinktemplate));
-}
+static GstStaticPadTemplate plptemplate = GST_STATIC_PAD_TEMPLATE ("plp_%u",
+    GST_PAD_SINK,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS("video/mpegts, systemstream = (boolean) true"));
 
 static void
 gst_dtapi_sink_class_init (GstDTAPISinkClass * klass)
 {
   GObjectClass *gobject_class;
+  GstElementClass *gstelement_class;
   GstBaseSinkClass *gstbasesink_class;
 
   gobject_class = G_OBJECT_CLASS (klass);
+  gstelement_class = GST_ELEMENT_CLASS (klass);
   gstbasesink_class = GST_BASE_SINK_CLASS (klass);
 
   gobject_class->set_property = gst_dtapi_sink_set_property;
   gobject_class->get_property = gst_dtapi_sink_get_property;
+  gobject_class->finalize = gst_dtapi_sink_finalize;
+
+  gst_element_class_set_static_metadata (gstelement_class,
+      "DekTec DTAPI Sink",
+      "Sink/Modulator",
+      "Write data to a DekTec modulator",
+      "William Manley <william.manley@youview.com>");
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&sinktemplate));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&plptemplate));
+
+  gstelement_class->request_new_pad =
+      GST_DEBUG_FUNCPTR (gst_dtapi_sink_request_new_pad);
+  gstelement_class->release_pad = GST_DEBUG_FUNCPTR (gst_dtapi_sink_release_pad);
 
   gstbasesink_class->render = GST_DEBUG_FUNCPTR (gst_dtapi_sink_render);
+  gstbasesink_class->render_list =
+      GST_DEBUG_FUNCPTR (gst_dtapi_sink_render_list);
+  gstbasesink_class->propose_allocation =
+      GST_DEBUG_FUNCPTR (gst_dtapi_sink_propose_allocation);
+  gstbasesink_class->event = GST_DEBUG_FUNCPTR (gst_dtapi_sink_event);
+  gstbasesink_class->query = GST_DEBUG_FUNCPTR (gst_dtapi_sink_query);
   gstbasesink_class->start = GST_DEBUG_FUNCPTR (gst_dtapi_sink_start);
   gstbasesink_class->stop = GST_DEBUG_FUNCPTR (gst_dtapi_sink_stop);
   gstbasesink_class->unlock = GST_DEBUG_FUNCPTR (gst_dtapi_sink_unlock);
@@ -504,7 +937,8 @@ gst_dtapi_sink_class_init (GstDTAPISinkClass * klass)
 
   // TODO: Set this with caps rather than as a property:
   g_object_class_install_property (gobject_class, PROP_BITRATE,
-      g_param_spec_int ("bitrate", "bitrate", "Bitrate",
+      g_param_spec_int ("bitrate", "bitrate",
+          "Bitrate, or 0 to use the channel capacity",
           0, G_MAXINT, DEFAULT_BITRATE, (GParamFlags) G_PARAM_READWRITE));
 
   /* SetRfControl: */
@@ -536,7 +970,8 @@ gst_dtapi_sink_class_init (GstDTAPISinkClass * klass)
 
   g_object_class_install_property (gobject_class, PROP_DTAPISINK_MODULATION,
       g_param_spec_enum ("modulation", "modulation",
-          "Modulation (DVB-T and DVB-C)",
+          "Modulation (constellation).  Which are valid depends on the "
+          "standard",
           GST_TYPE_DTAPISINK_MODULATION, DEFAULT_MODULATION,
           (GParamFlags) G_PARAM_READWRITE));
 
@@ -584,195 +1019,1202 @@ gst_dtapi_sink_class_init (GstDTAPISinkClass * klass)
         "data available (none or nulls",
         GST_TYPE_DTAPISINK_STUFFING, DEFAULT_STUFFING,
         (GParamFlags) G_PARAM_READWRITE));
+
+  /* Standards other than DVB-T */
+  g_object_class_install_property (gobject_class, PROP_DTAPISINK_STANDARD,
+    g_param_spec_enum ("standard",
+        "standard",
+        "Modulation standard",
+        GST_TYPE_DTAPISINK_STANDARD, DEFAULT_STANDARD,
+        (GParamFlags) G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_DTAPISINK_SYMBOL_RATE,
+      g_param_spec_int ("symbol-rate", "symbol-rate",
+          "Symbol rate in symbols per second (J.83 and DVB-S2)",
+          0, G_MAXINT, DEFAULT_SYMBOL_RATE, (GParamFlags) G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_DTAPISINK_PILOTS,
+      g_param_spec_boolean ("pilots", "pilots",
+          "Insert pilot symbols (DVB-S2)",
+          DEFAULT_PILOTS, (GParamFlags) G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_DTAPISINK_SHORT_FRAMES,
+      g_param_spec_boolean ("short-frames", "short-frames",
+          "Use short 16200 bit FEC frames (DVB-S2)",
+          DEFAULT_SHORT_FRAMES, (GParamFlags) G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_DTAPISINK_T2_FFT_MODE,
+    g_param_spec_enum ("t2-fft-mode",
+        "t2-fft-mode",
+        "FFT size (DVB-T2)",
+        GST_TYPE_DTAPISINK_T2_FFT_MODE, DEFAULT_T2_FFT_MODE,
+        (GParamFlags) G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_DTAPISINK_T2_GUARD,
+    g_param_spec_enum ("t2-guard",
+        "t2-guard",
+        "Guard Interval (DVB-T2)",
+        GST_TYPE_DTAPISINK_T2_GUARD, DEFAULT_T2_GUARD,
+        (GParamFlags) G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class,
+      PROP_DTAPISINK_T2_PILOT_PATTERN,
+    g_param_spec_enum ("t2-pilot-pattern",
+        "t2-pilot-pattern",
+        "Pilot Pattern (DVB-T2)",
+        GST_TYPE_DTAPISINK_T2_PILOT_PATTERN, DEFAULT_T2_PILOT_PATTERN,
+        (GParamFlags) G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_DTAPISINK_T2_FEC_TYPE,
+    g_param_spec_enum ("t2-fec-type",
+        "t2-fec-type",
+        "LDPC FEC frame length (DVB-T2)",
+        GST_TYPE_DTAPISINK_T2_FEC_TYPE, DEFAULT_T2_FEC_TYPE,
+        (GParamFlags) G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_DTAPISINK_T2_PLPS,
+      g_param_spec_string ("t2-plps", "t2-plps",
+          "Comma separated list of modulation:code-rate:share for each PLP "
+          "of a multi-PLP DVB-T2 multiplex, where share is the percentage of "
+          "the frame to give it.  e.g. \"qam-256:2/3:70,qpsk:1/2:30\".  PLP 0 "
+          "is fed from the sink pad and the others from the plp_%u request "
+          "pads.  Unset for a single PLP.",
+          DEFAULT_T2_PLPS, (GParamFlags) G_PARAM_READWRITE));
+
+  /* Profiles */
+  g_object_class_install_property (gobject_class,
+      PROP_DTAPISINK_PROFILE_LOCATION,
+      g_param_spec_string ("profile-location", "profile-location",
+          "Key-file of named profiles for the profile property, one group "
+          "each.  A profile's keys are any of the modulation, RF and "
+          "transmit-mode properties, anything it leaves out being the "
+          "default.  Every profile is checked when the file is loaded.",
+          DEFAULT_PROFILE_LOCATION, (GParamFlags) G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_DTAPISINK_PROFILE,
+      g_param_spec_string ("profile", "profile",
+          "Switch to this profile from profile-location (which must be set "
+          "first), changing all the settings in it at once.  Only those that "
+          "differ from the current ones go to the modulator.  t2-plps is "
+          "left as it is.",
+          DEFAULT_PROFILE, (GParamFlags) G_PARAM_READWRITE));
+
+  /* EOS handling */
+  g_object_class_install_property (gobject_class, PROP_DTAPISINK_DRAIN_ON_EOS,
+      g_param_spec_boolean ("drain-on-eos", "drain-on-eos",
+          "Hold on to EOS until everything written has been transmitted",
+          DEFAULT_DRAIN_ON_EOS, (GParamFlags) G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_DTAPISINK_EOS_TAIL,
+      g_param_spec_uint ("eos-tail", "eos-tail",
+          "Milliseconds of null packets to transmit after the end of the "
+          "stream before passing on EOS (with drain-on-eos).  There's no "
+          "tail in the RAW transmit-mode",
+          0, G_MAXUINT, DEFAULT_EOS_TAIL, (GParamFlags) G_PARAM_READWRITE));
+
+  /* Packet filtering */
+  g_object_class_install_property (gobject_class, PROP_DTAPISINK_PID_FILTER,
+      g_param_spec_string ("pid-filter", "pid-filter",
+          "Comma separated list of PIDs and PID ranges to transmit, e.g. "
+          "\"0,16-18,256,257\".  Unset to transmit everything.",
+          DEFAULT_PID_FILTER, (GParamFlags) G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_DTAPISINK_PID_REMAP,
+      g_param_spec_string ("pid-remap", "pid-remap",
+          "Comma separated list of from=to PID mappings to apply to the "
+          "packets transmitted, e.g. \"256=512,257=513\".  PSI is not "
+          "rewritten to match.  Not applied in transmit-mode 204, as the "
+          "packets' parity would no longer match.  Packets are only "
+          "changed in place, rather than copied, when nothing else holds "
+          "the buffer, which needs enable-last-sample=false.",
+          DEFAULT_PID_REMAP, (GParamFlags) G_PARAM_READWRITE));
+
+  /* Monitoring */
+  g_object_class_install_property (gobject_class, PROP_DTAPISINK_MONITOR,
+      g_param_spec_boolean ("monitor", "monitor",
+          "Check what is transmitted against the TR 101 290 priority 1 "
+          "indicators and post a dtapisink-tr101290 element message with "
+          "the results every second",
+          DEFAULT_MONITOR, (GParamFlags) G_PARAM_READWRITE));
+
+  /* Timing */
+  g_object_class_install_property (gobject_class, PROP_DTAPISINK_PCR_RESTAMP,
+      g_param_spec_boolean ("pcr-restamp", "pcr-restamp",
+          "Rewrite PCRs to match when they will be transmitted, working from "
+          "their position in the output at the TS rate.  Removes jitter "
+          "added upstream.  Not used with multiple PLPs.",
+          DEFAULT_PCR_RESTAMP, (GParamFlags) G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_DTAPISINK_PCR_STATS,
+      g_param_spec_boxed ("pcr-stats", "pcr-stats",
+          "PCR accuracy in nanoseconds before (input-*) and after (output-*) "
+          "restamping",
+          GST_TYPE_STRUCTURE, (GParamFlags) G_PARAM_READABLE));
+
+  /* SI */
+  g_object_class_install_property (gobject_class, PROP_DTAPISINK_SI_LOCATION,
+      g_param_spec_string ("si-location", "si-location",
+          "File of NIT, SDT, BAT, TDT and TOT sections to send in place of "
+          "null packets, replacing any upstream sends on their PIDs.  The "
+          "time in the TDT and TOT is kept up to date.  Not used with "
+          "multiple PLPs.",
+          DEFAULT_SI_LOCATION, (GParamFlags) G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_DTAPISINK_NIT_INTERVAL,
+      g_param_spec_uint ("nit-interval", "nit-interval",
+          "Time between NITs from si-location in ms",
+          25, 10000, DEFAULT_NIT_INTERVAL,
+          (GParamFlags) G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_DTAPISINK_SDT_INTERVAL,
+      g_param_spec_uint ("sdt-interval", "sdt-interval",
+          "Time between SDTs and BATs from si-location in ms",
+          25, 10000, DEFAULT_SDT_INTERVAL,
+          (GParamFlags) G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_DTAPISINK_TDT_INTERVAL,
+      g_param_spec_uint ("tdt-interval", "tdt-interval",
+          "Time between TDTs and TOTs from si-location in ms",
+          25, 30000, DEFAULT_TDT_INTERVAL,
+          (GParamFlags) G_PARAM_READWRITE));
+
+  /* Delay */
+  g_object_class_install_property (gobject_class, PROP_DTAPISINK_DELAY,
+      g_param_spec_uint ("delay", "delay",
+          "Hold everything back by this many ms before transmitting it, in "
+          "a file (see delay-location) rather than in memory.  Setting it "
+          "to 0 cuts over to live straight away, dropping whatever was held. "
+          " Shortening it skips what would have gone out in between and "
+          "lengthening it stops transmission until the extra has built up. "
+          " Not used with multiple PLPs.",
+          0, 3600000, DEFAULT_DELAY, (GParamFlags) G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class,
+      PROP_DTAPISINK_DELAY_LOCATION,
+      g_param_spec_string ("delay-location", "delay-location",
+          "File to keep the delay in.  Unset for a file in the temporary "
+          "directory that nothing else can see.",
+          DEFAULT_DELAY_LOCATION, (GParamFlags) (G_PARAM_READWRITE |
+              GST_PARAM_MUTABLE_READY)));
+
+  /* Mirror */
+  g_object_class_install_property (gobject_class,
+      PROP_DTAPISINK_MIRROR_LOCATION,
+      g_param_spec_string ("mirror-location", "mirror-location",
+          "Keep a copy of exactly what is transmitted in files named this "
+          "followed by .000000, .000001 and so on, each with a .idx of "
+          "(wall clock time in us, offset) pairs as little endian 64 bit "
+          "integers.  Written from a thread of its own, so if the disk "
+          "can't keep up data is left out of the copy rather than the "
+          "output being held up.  Not used with multiple PLPs.",
+          DEFAULT_MIRROR_LOCATION, (GParamFlags) (G_PARAM_READWRITE |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class,
+      PROP_DTAPISINK_MIRROR_FILE_SIZE,
+      g_param_spec_uint64 ("mirror-file-size", "mirror-file-size",
+          "Start a new mirror file after this many bytes",
+          1024 * 1024, G_MAXUINT64, DEFAULT_MIRROR_FILE_SIZE,
+          (GParamFlags) (G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class,
+      PROP_DTAPISINK_MIRROR_MAX_FILES,
+      g_param_spec_uint ("mirror-max-files", "mirror-max-files",
+          "Delete the oldest mirror file when there are more than this many "
+          "(0 = keep them all)",
+          0, G_MAXUINT, DEFAULT_MIRROR_MAX_FILES,
+          (GParamFlags) (G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class,
+      PROP_DTAPISINK_MIRROR_STATS,
+      g_param_spec_boxed ("mirror-stats", "mirror-stats",
+          "Bytes written to the mirror files and left out because the disk "
+          "couldn't keep up, and the number of files started",
+          GST_TYPE_STRUCTURE, (GParamFlags) G_PARAM_READABLE));
+
+  /* Recovery */
+  g_object_class_install_property (gobject_class,
+      PROP_DTAPISINK_RECOVERY_TIMEOUT,
+      g_param_spec_uint ("recovery-timeout", "recovery-timeout",
+          "If the device goes away (e.g. USB disconnect or driver error) "
+          "keep trying to attach to it again for this many seconds before "
+          "giving up with an error.  Input is consumed at the TS rate in "
+          "the meantime.  0 to fail straight away.  There is no recovery "
+          "with multiple PLPs: losing the device stops the feeder and fails "
+          "the pipeline whatever this is set to.",
+          0, 3600, DEFAULT_RECOVERY_TIMEOUT,
+          (GParamFlags) G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class,
+      PROP_DTAPISINK_RECOVERY_STATS,
+      g_param_spec_boxed ("recovery-stats", "recovery-stats",
+          "Number of times the device has been lost and recovered and the "
+          "total and longest time off air in nanoseconds",
+          GST_TYPE_STRUCTURE, (GParamFlags) G_PARAM_READABLE));
+
+  /* Scheduling */
+  g_object_class_install_property (gobject_class,
+      PROP_DTAPISINK_REALTIME_PRIORITY,
+      g_param_spec_uint ("realtime-priority", "realtime-priority",
+          "Real-time priority (1-99) to give the thread that writes to the "
+          "device, which is the upstream streaming thread unless there are "
+          "multiple PLPs.  Needs CAP_SYS_NICE or a high enough "
+          "RLIMIT_RTPRIO.  0 leaves its scheduling alone, or puts back "
+          "what it had before if it has been changed.  It is also put back "
+          "at EOS, but a thread stopped without EOS is left as it is.",
+          0, 99, DEFAULT_REALTIME_PRIORITY,
+          (GParamFlags) G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class,
+      PROP_DTAPISINK_REALTIME_POLICY,
+      g_param_spec_enum ("realtime-policy", "realtime-policy",
+          "Scheduling policy to use with realtime-priority",
+          GST_TYPE_DTAPISINK_REALTIME_POLICY, DEFAULT_REALTIME_POLICY,
+          (GParamFlags) G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class,
+      PROP_DTAPISINK_CPU_AFFINITY,
+      g_param_spec_uint64 ("cpu-affinity", "cpu-affinity",
+          "Bit mask of the CPUs the thread that writes to the device may run "
+          "on.  0 leaves it alone, or puts back what it had before if it "
+          "has been changed.  It is also put back at EOS, but a thread "
+          "stopped without EOS is left as it is.",
+          0, G_MAXUINT64, DEFAULT_CPU_AFFINITY,
+          (GParamFlags) G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_DTAPISINK_LOCK_MEMORY,
+      g_param_spec_boolean ("lock-memory", "lock-memory",
+          "Lock the memory the sink writes from into RAM so that writing "
+          "never waits for a page fault.  Needs a high enough "
+          "RLIMIT_MEMLOCK.  Takes effect on the next start.",
+          DEFAULT_LOCK_MEMORY, (GParamFlags) (G_PARAM_READWRITE |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_DTAPISINK_HUGEPAGES,
+      g_param_spec_boolean ("hugepages", "hugepages",
+          "Back the memory the sink writes from with huge pages where "
+          "possible.  Takes effect on the next start.",
+          DEFAULT_HUGEPAGES, (GParamFlags) (G_PARAM_READWRITE |
+              GST_PARAM_MUTABLE_READY)));
+
+  /* Profiling */
+  g_object_class_install_property (gobject_class,
+      PROP_DTAPISINK_PROFILE_CALLS,
+      g_param_spec_boolean ("profile-calls", "profile-calls",
+          "Time every call made to the device for call-stats.  Can be "
+          "turned on and off at any time.",
+          DEFAULT_PROFILE_CALLS, (GParamFlags) G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_DTAPISINK_CALL_STATS,
+      g_param_spec_boxed ("call-stats", "call-stats",
+          "For each DTAPI method called since start with profile-calls on: "
+          "the number of calls, their total, mean and maximum time in "
+          "nanoseconds and a histogram of their times in powers of two "
+          "microseconds",
+          GST_TYPE_STRUCTURE, (GParamFlags) G_PARAM_READABLE));
+}
+
+/* The modulator settings we start off with, which every profile starts
+   from too */
+static void
+gst_dtapi_sink_default_mod_profile (GstDTAPIModProfile * profile)
+{
+  memset (profile, 0, sizeof (*profile));
+  profile->ts_rate_bps = DEFAULT_BITRATE;
+  profile->frequency = DEFAULT_FREQUENCY;
+  gst_dtapi_mod_pars_init (&profile->mod);
+  profile->mod.standard = DEFAULT_STANDARD;
+  profile->mod.constellation = DEFAULT_MODULATION;
+  profile->mod.code_rate = DEFAULT_CODE_RATE;
+  profile->mod.mod_param =   DEFAULT_BANDWIDTH | DEFAULT_INTERLEAVING
+                           | DEFAULT_GUARD | DEFAULT_TRANSMISSION_MODE;
+  profile->mod.symbol_rate = DEFAULT_SYMBOL_RATE;
+  profile->mod.pilots = DEFAULT_PILOTS;
+  profile->mod.short_frames = DEFAULT_SHORT_FRAMES;
+  profile->mod.t2_fft_mode = DEFAULT_T2_FFT_MODE;
+  profile->mod.t2_guard = DEFAULT_T2_GUARD;
+  profile->mod.t2_pilot_pattern = DEFAULT_T2_PILOT_PATTERN;
+  profile->mod.t2_fec_type = DEFAULT_T2_FEC_TYPE;
+  profile->rf_mode = DTAPI_UPCONV_NORMAL | DEFAULT_INVERSION;
+  profile->tx_mode = DEFAULT_TXMODE;
+  profile->stuff_mode = DEFAULT_STUFFING;
+  profile->output_power = DEFAULT_OUTPUT_POWER;
 }
 
 static void
-gst_dtapi_sink_init (GstDTAPISink * sink, GstDTAPISinkClass * gclass)
+gst_dtapi_sink_init (GstDTAPISink * sink)
 {
+  GstDTAPIModProfile defaults;
+
   /* TODO: Is this appropriate???: */
   gst_base_sink_set_sync (GST_BASE_SINK (sink), FALSE);
   /* NOTE: not sure what effect this has.  Setting it doesn't seem to make
      filesrc send us buffers > 4KB as you might expect: */
   gst_base_sink_set_blocksize (GST_BASE_SINK (sink), BUFSIZE / 2);
-  /* FIXME: We don't want to preroll a certain number of buffers, we want to
-     pre-roll until there is enough data in the FIFO such that we can enter
-     state TXCTRL_SEND as soon as we enter state PLAYING */
-  g_object_set(G_OBJECT(sink), "preroll-queue-len", 100, NULL);
-
-  sink->ts_rate_bps = DEFAULT_BITRATE;
-  sink->frequency = DEFAULT_FREQUENCY;
-  sink->code_rate = DEFAULT_CODE_RATE;
-  sink->mod_param =   DEFAULT_BANDWIDTH | DEFAULT_MODULATION
-                    | DEFAULT_INTERLEAVING | DEFAULT_GUARD
-                    | DEFAULT_TRANSMISSION_MODE;
-  sink->rf_mode = DTAPI_UPCONV_NORMAL | DEFAULT_INVERSION;
-  sink->tx_mode = DEFAULT_TXMODE;
-  sink->stuff_mode = DEFAULT_STUFFING;
-  sink->output_power = DEFAULT_OUTPUT_POWER;
+  /* FIXME: We want to preroll until there is enough data in the FIFO such
+     that we can enter state TXCTRL_SEND as soon as we enter state PLAYING.
+     1.x basesink has no preroll queue so for now we preroll on the first
+     buffer. */
+
+  gst_dtapi_sink_default_mod_profile (&defaults);
+  sink->ts_rate_bps = defaults.ts_rate_bps;
+  sink->frequency = defaults.frequency;
+  sink->mod = defaults.mod;
+  sink->rf_mode = defaults.rf_mode;
+  sink->tx_mode = defaults.tx_mode;
+  sink->stuff_mode = defaults.stuff_mode;
+  sink->output_power = defaults.output_power;
+
+  sink->drain_on_eos = DEFAULT_DRAIN_ON_EOS;
+  sink->monitor = DEFAULT_MONITOR;
+  sink->pcr_restamp = DEFAULT_PCR_RESTAMP;
+  sink->si_interval[GST_DTAPI_CAROUSEL_NIT] = DEFAULT_NIT_INTERVAL;
+  sink->si_interval[GST_DTAPI_CAROUSEL_SDT] = DEFAULT_SDT_INTERVAL;
+  sink->si_interval[GST_DTAPI_CAROUSEL_TDT] = DEFAULT_TDT_INTERVAL;
+  sink->eos_tail_ms = DEFAULT_EOS_TAIL;
+  sink->delay_ms = DEFAULT_DELAY;
+  sink->mirror_file_size = DEFAULT_MIRROR_FILE_SIZE;
+  sink->mirror_max_files = DEFAULT_MIRROR_MAX_FILES;
+  sink->recovery_timeout = DEFAULT_RECOVERY_TIMEOUT;
+  sink->realtime_priority = DEFAULT_REALTIME_PRIORITY;
+  sink->realtime_policy = DEFAULT_REALTIME_POLICY;
+  sink->cpu_affinity = DEFAULT_CPU_AFFINITY;
+  sink->lock_memory = DEFAULT_LOCK_MEMORY;
+  sink->hugepages = DEFAULT_HUGEPAGES;
+  gst_dtapi_profile_init (&sink->call_profile);
+  sink->call_profile.enabled = DEFAULT_PROFILE_CALLS;
+  sink->last_position = GST_CLOCK_TIME_NONE;
+  sink->last_running_time = GST_CLOCK_TIME_NONE;
+
+  g_mutex_init (&sink->channel_lock);
+  g_mutex_init (&sink->attach_lock);
+  g_mutex_init (&sink->drain_lock);
+  g_cond_init (&sink->drain_cond);
+}
+
+/* Device control.  Setting a property only records the new value and marks
+   it pending.  The pending settings are then pushed to the modulator by
+   whichever thread holds channel_lock: normally the streaming thread in
+   between writes, or the thread that set the property if the channel isn't
+   transmitting and nothing else was using it at the time.  While we're
+   transmitting the streaming thread never waits for a property change to
+   be applied, which could mean taking the modulator through IDLE over USB.
+   Calls to DTAPI are never made concurrently and repeated changes to a
+   setting collapse into one, so sweeping the frequency costs one
+   SetRfControl per write at most. */
+enum
+{
+  PENDING_TS_RATE = 1 << 0,
+  PENDING_FREQUENCY = 1 << 1,
+  PENDING_OUTPUT_LEVEL = 1 << 2,
+  PENDING_MOD_CONTROL = 1 << 3,
+  PENDING_RF_MODE = 1 << 4,
+  PENDING_TX_MODE = 1 << 5,
+  PENDING_ALL = (1 << 6) - 1
+};
+
+/* SetTxControl, keeping track of whether we're transmitting.  Must be
+   called with channel_lock held. */
+static DTAPI_RESULT
+gst_dtapi_sink_set_tx_control (GstDTAPISink * sink, int tx_control)
+{
+  DTAPI_RESULT result = sink->TsOut->SetTxControl(tx_control);
+
+  if (result == DTAPI_OK)
+    g_atomic_int_set (&sink->transmitting, tx_control == DTAPI_TXCTRL_SEND);
+  return result;
 }
 
+/* Reads back what the modulator actually accepted.  Must be called with
+   channel_lock held.  The TS rate isn't read back as 0 in ts_rate_bps means
+   "whatever the capacity is", which we want to keep. */
 static void
 gst_dtapi_sink_update_prop_cache (GstDTAPISink * sink)
 {
   /* TODO: Deal with errors */
   if (sink->TsOut) {
-    int result, mod_type, par_xtra_2, lock_status;
+    int result, mod_type, par_xtra_0, par_xtra_1, par_xtra_2, lock_status;
+    int tx_mode, stuff_mode, output_power;
+    int64_t frequency;
     void* p_xtra_pars;
-    CHECK(sink->TsOut->GetTsRateBps(sink->ts_rate_bps),
-          "Failed to get TS rate: %s");
-    CHECK(sink->TsOut->GetTxMode(sink->tx_mode, sink->stuff_mode),
+    gboolean have_mod;
+
+    /* Not under the object lock as CHECK may need it to post an error */
+    CHECK(sink->TsOut->GetTxMode(tx_mode, stuff_mode),
           "Failed to get TxMode: %s");
-    CHECK(sink->TsOut->GetRfControl(sink->frequency, lock_status),
+    if (result != DTAPI_OK)
+      return;
+    CHECK(sink->TsOut->GetRfControl(frequency, lock_status),
           "Failed to get frequency: %s");
-    CHECK(sink->TsOut->GetOutputLevel(sink->output_power),
+    if (result != DTAPI_OK)
+      return;
+    CHECK(sink->TsOut->GetOutputLevel(output_power),
           "Failed to get output power: %s");
-    CHECK(sink->TsOut->GetModControl(mod_type, sink->code_rate,
-                                     sink->mod_param, par_xtra_2, p_xtra_pars),
+    if (result != DTAPI_OK)
+      return;
+    CHECK(sink->TsOut->GetModControl(mod_type, par_xtra_0, par_xtra_1,
+                                     par_xtra_2, p_xtra_pars),
           "Failed to get modulation parameters: %s");
-  }
-}
+    have_mod = result == DTAPI_OK;
 
-static void assign_bits(int* out, int mask, int value)
-{
-  assert((~mask & value) == 0);
-  assert(out);
-  *out &= ~mask;
-  *out |= value;
+    GST_OBJECT_LOCK (sink);
+    /* Don't clobber anything the user has changed since it was applied */
+    if (!(g_atomic_int_get (&sink->pending) & PENDING_TX_MODE)) {
+      sink->tx_mode = tx_mode;
+      sink->stuff_mode = stuff_mode;
+    }
+    if (!(g_atomic_int_get (&sink->pending) & PENDING_FREQUENCY))
+      sink->frequency = frequency;
+    if (!(g_atomic_int_get (&sink->pending) & PENDING_OUTPUT_LEVEL))
+      sink->output_power = output_power;
+    if (have_mod && !(g_atomic_int_get (&sink->pending) & PENDING_MOD_CONTROL))
+      gst_dtapi_mod_pars_update(&sink->mod, mod_type, par_xtra_0, par_xtra_1,
+                                par_xtra_2);
+    GST_OBJECT_UNLOCK (sink);
+  }
 }
 
+/* Must be called with channel_lock held */
 static void
-gst_dtapi_sink_set_property (GObject * object, guint prop_id,
-    const GValue * value, GParamSpec * pspec)
+gst_dtapi_sink_apply_pending (GstDTAPISink * sink)
 {
-  int result;
-  GstDTAPISink *sink;
+  int result, pending, ts_rate_bps, rf_mode, tx_mode, stuff_mode,
+      output_power;
+  int64_t frequency;
+  GstDTAPIModPars mod;
+  const char* invalid;
 
-  sink = GST_DTAPI_SINK (object);
-  gst_dtapi_sink_update_prop_cache(sink);
+  if (!g_atomic_int_get (&sink->pending) || !sink->TsOut)
+    return;
 
-  switch (prop_id) {
-    case PROP_BITRATE:
-      /* Only takes effect once start() is called */
-      sink->ts_rate_bps = g_value_get_int(value);
-      if (sink->TsOut) {
-        CHECK(sink->TsOut->SetTsRateBps(sink->ts_rate_bps),
-          "Failed to set TS rate: %s");
-      }
-      break;
-    /* SetRfControl: */
-    case PROP_DTAPISINK_FREQUENCY:
-      sink->frequency = g_value_get_int64(value);
-      if (sink->TsOut) {
-        CHECK(sink->TsOut->SetRfControl(sink->frequency),
-              "Failed to set frequency: %s");
-      }
-      break;
-    /* SetOutputLevel */
-    case PROP_DTAPISINK_OUTPUT_POWER:
-      /* SetOutputLevel expects a value expressed in 0.1 dBm, we expect one in
-         dBm so need to do a conversion here: */
-      /* FIXME: do rounding */
-      sink->output_power = g_value_get_double(value) * 10;
-      if (sink->TsOut) {
-        CHECK(sink->TsOut->SetOutputLevel(sink->output_power),
-              "Failed to set output power: %s");
-      }
-      break;
-    /* SetModControl*/
-    /* ParXtra0 */
-    case PROP_DTAPISINK_CODE_RATE:
-      sink->code_rate = g_value_get_enum(value);
-      if (sink->TsOut) {
-        CHECK(sink->TsOut->SetModControl(DTAPI_MOD_DVBT, sink->code_rate,
-                                         sink->mod_param, -1),
-              "Failed to set code rate: %s");
-      }
-      break;
-    /* ParXtra1 */
-    case PROP_DTAPISINK_BANDWIDTH:
-      assign_bits(&sink->mod_param, DTAPI_MOD_DVBT_BW_MSK,
-                  g_value_get_enum(value));
-      if (sink->TsOut) {
-        CHECK(sink->TsOut->SetModControl(DTAPI_MOD_DVBT, sink->code_rate,
-                                         sink->mod_param, -1),
-              "Failed to set bandwidth: %s");
-      }
-      break;
-    case PROP_DTAPISINK_MODULATION:
-      assign_bits(&sink->mod_param, DTAPI_MOD_DVBT_CO_MSK,
-                  g_value_get_enum(value));
-      if (sink->TsOut) {
-        CHECK(sink->TsOut->SetModControl(DTAPI_MOD_DVBT, sink->code_rate,
-                                         sink->mod_param, -1),
-              "Failed to set modulation: %s");
-      }
-      break;
-    case PROP_DTAPISINK_GUARD:
-      assign_bits(&sink->mod_param, DTAPI_MOD_DVBT_GU_MSK,
-                  g_value_get_enum(value));
-      if (sink->TsOut) {
-        CHECK(sink->TsOut->SetModControl(DTAPI_MOD_DVBT, sink->code_rate,
-                                         sink->mod_param, -1),
-              "Failed to set guard: %s");
-      }
-      break;
-    case PROP_DTAPISINK_INTERLEAVING:
-      assign_bits(&sink->mod_param, DTAPI_MOD_DVBT_IL_MSK,
-                  g_value_get_enum(value));
-      if (sink->TsOut) {
-        CHECK(sink->TsOut->SetModControl(DTAPI_MOD_DVBT, sink->code_rate,
-                                         sink->mod_param, -1),
-              "Failed to set interleaving: %s");
-      }
-      break;
-    case PROP_DTAPISINK_TRANSMISSION_MODE:
-      assign_bits(&sink->mod_param, DTAPI_MOD_DVBT_MD_MSK,
-                  g_value_get_enum(value));
-      if (sink->TsOut) {
-        CHECK(sink->TsOut->SetModControl(DTAPI_MOD_DVBT, sink->code_rate,
-                                         sink->mod_param, -1),
-              "Failed to set transmission mode: %s");
-      }
-      break;
-    /* SetRfMode */
-    case PROP_DTAPISINK_INVERSION:
-      sink->rf_mode = DTAPI_UPCONV_NORMAL | g_value_get_enum(value);
-      if (sink->TsOut) {
-        CHECK(sink->TsOut->SetRfMode(sink->rf_mode, sink->stuff_mode),
-              "Failed to set inversion: %s");
-      }
-      break;
-    /* SetTxMode */
-    case PROP_DTAPISINK_TXMODE:
-      sink->tx_mode = g_value_get_enum(value);
-      if (sink->TsOut) {
-        CHECK(sink->TsOut->SetTxMode(sink->tx_mode, sink->stuff_mode),
-              "Failed to set txmode: %s");
-      }
-      break;
-    case PROP_DTAPISINK_STUFFING:
-      sink->stuff_mode = g_value_get_enum(value);
-      if (sink->TsOut) {
-        CHECK(sink->TsOut->SetTxMode(sink->tx_mode, sink->stuff_mode),
-              "Failed to set stuffing: %s");
-      }
-      break;
-    default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
-      break;
+  GST_OBJECT_LOCK (sink);
+  pending = g_atomic_int_get (&sink->pending);
+  g_atomic_int_set (&sink->pending, 0);
+  ts_rate_bps = sink->ts_rate_bps;
+  frequency = sink->frequency;
+  mod = sink->mod;
+  rf_mode = sink->rf_mode;
+  tx_mode = sink->tx_mode;
+  stuff_mode = sink->stuff_mode;
+  output_power = sink->output_power;
+  GST_OBJECT_UNLOCK (sink);
+
+  if (pending & PENDING_TX_MODE) {
+    CHECK(sink->TsOut->SetTxMode(tx_mode, stuff_mode),
+          "Failed to set TxMode: %s");
+  }
+  if (pending & PENDING_MOD_CONTROL &&
+      (invalid = gst_dtapi_mod_pars_validate (&mod)) != NULL) {
+    /* Keep going with what we had, the user may be half way through changing
+       several properties */
+    GST_WARNING_OBJECT (sink, "Not applying modulation parameters: %s",
+        invalid);
+    pending &= ~(PENDING_MOD_CONTROL | PENDING_TS_RATE);
+  }
+  if (pending & PENDING_MOD_CONTROL) {
+    int tx_control = DTAPI_TXCTRL_IDLE;
+
+    /* The modulation parameters can only be changed in IDLE.  Dropping back
+       to HOLD afterwards means the FIFO is refilled before we start sending
+       again, as it is after start. */
+    CHECK(sink->TsOut->GetTxControl(tx_control), "GetTxControl failed: %s");
+    if (tx_control != DTAPI_TXCTRL_IDLE)
+      CHECK(gst_dtapi_sink_set_tx_control (sink, DTAPI_TXCTRL_IDLE),
+            "Entering state IDLE failed: %s");
+    {
+      /* gst_dtapi_mod_pars_apply deals in plain DtOutpChannels so we time
+         it here.  It may call SetSymSampleRate too. */
+      GstDTAPICallTimer timer (&sink->call_profile,
+                               GST_DTAPI_CALL_SET_MOD_CONTROL);
+      CHECK(gst_dtapi_mod_pars_apply(&mod, sink->TsOut),
+            "Failed to set modulation parameters: %s");
+    }
+    if (tx_control != DTAPI_TXCTRL_IDLE)
+      CHECK(gst_dtapi_sink_set_tx_control (sink, DTAPI_TXCTRL_HOLD),
+            "Entering state HOLD failed: %s");
+  }
+  /* The capacity depends on the modulation parameters */
+  if (pending & (PENDING_TS_RATE | PENDING_MOD_CONTROL)) {
+    int rate = gst_dtapi_mod_pars_ts_rate (&mod, ts_rate_bps);
+
+    /* FIXME: Setting the TS rate has no effect, it seems to be purely
+       detemined by the other parameters and I can't seem to work out how to
+       apply stuffing to e.g. bulk out a 18Mb/s stream into a 24Mb/s one. */
+    CHECK(sink->TsOut->SetTsRateBps(rate), "Failed to set TS rate: %s");
+
+    /* The sink pad only carries PLP 0 */
+    if (mod.standard == GST_DTAPI_STANDARD_DVBT2 && mod.t2_num_plps > 1)
+      rate = gst_dtapi_mod_pars_plp_capacity (&mod, 0);
+    GST_OBJECT_LOCK (sink);
+    sink->ts_rate_cache = rate;
+    GST_OBJECT_UNLOCK (sink);
+    /* Our latency is the FIFO size at this rate */
+    gst_element_post_message (GST_ELEMENT (sink),
+        gst_message_new_latency (GST_OBJECT (sink)));
+  }
+  if (pending & PENDING_RF_MODE) {
+    CHECK(sink->TsOut->SetRfMode(rf_mode), "Failed to set RF mode: %s");
+  }
+  if (pending & PENDING_FREQUENCY) {
+    CHECK(sink->TsOut->SetRfControl(frequency),
+          "Failed to set frequency: %s");
+  }
+  if (pending & PENDING_OUTPUT_LEVEL) {
+    CHECK(sink->TsOut->SetOutputLevel(output_power),
+          "Failed to set output power: %s");
   }
 }
 
+/* Applies the pending settings now if we aren't transmitting and nobody
+   else is using the channel.  Otherwise the streaming thread (or the
+   feeder) applies them when it's next between writes, rather than waiting
+   on us. */
 static void
-gst_dtapi_sink_get_property (GObject * object, guint prop_id,
-    GValue * value, GParamSpec * pspec)
+gst_dtapi_sink_try_apply_pending (GstDTAPISink * sink)
 {
-  GstDTAPISink *sink;
+  if (g_atomic_int_get (&sink->transmitting))
+    return;
+  if (g_mutex_trylock (&sink->channel_lock)) {
+    gst_dtapi_sink_apply_pending (sink);
+    g_mutex_unlock (&sink->channel_lock);
+  }
+}
+
+static GstDTAPIMemFlags
+gst_dtapi_sink_mem_flags (GstDTAPISink * sink)
+{
+  int flags = 0;
+
+  GST_OBJECT_LOCK (sink);
+  if (sink->lock_memory)
+    flags |= GST_DTAPI_MEM_LOCKED;
+  if (sink->hugepages)
+    flags |= GST_DTAPI_MEM_HUGEPAGES;
+  GST_OBJECT_UNLOCK (sink);
+  return (GstDTAPIMemFlags) flags;
+}
+
+/* Puts back the policy and priority the calling thread had before we
+   changed them */
+static void
+gst_dtapi_sink_restore_policy (GstDTAPISink * sink, GstDTAPISinkSched * sched)
+{
+  int err;
+
+  if (!sched->policy_saved)
+    return;
+  sched->policy_saved = FALSE;
+  if ((err = pthread_setschedparam (pthread_self (), sched->policy,
+                                    &sched->param)) != 0)
+    GST_WARNING_OBJECT (sink, "Couldn't restore scheduling policy %d: %s",
+        sched->policy, g_strerror (err));
+}
+
+/* Puts back the CPU affinity the calling thread had before we changed it */
+static void
+gst_dtapi_sink_restore_affinity (GstDTAPISink * sink,
+    GstDTAPISinkSched * sched)
+{
+  int err;
+
+  if (!sched->affinity_saved)
+    return;
+  sched->affinity_saved = FALSE;
+  if ((err = pthread_setaffinity_np (pthread_self (), sizeof (sched->cpus),
+                                     &sched->cpus)) != 0)
+    GST_WARNING_OBJECT (sink, "Couldn't restore CPU affinity: %s",
+        g_strerror (err));
+}
+
+/* Gives the calling thread the realtime-priority, realtime-policy and
+   cpu-affinity it should have, if they've changed since sched was last
+   applied.  Setting either back to 0 puts back what the thread had before.
+   Cheap enough to call before every write when they haven't changed. */
+static void
+gst_dtapi_sink_apply_scheduling (GstDTAPISink * sink,
+    GstDTAPISinkSched * sched)
+{
+  gint generation = g_atomic_int_get (&sink->sched_generation);
+  pthread_t self = pthread_self ();
+  struct sched_param param;
+  guint priority;
+  int policy, err, cpu;
+  guint64 affinity;
+
+  if (G_LIKELY (sched->applied == generation &&
+                pthread_equal (sched->thread, self)))
+    return;
+  if (!pthread_equal (sched->thread, self)) {
+    /* Upstream has given us a different thread.  The one we had may be gone
+       so we can't put it back, and what we saved doesn't apply to this one. */
+    sched->thread = self;
+    sched->policy_saved = FALSE;
+    sched->affinity_saved = FALSE;
+  }
+  sched->applied = generation;
+
+  GST_OBJECT_LOCK (sink);
+  priority = sink->realtime_priority;
+  policy = sink->realtime_policy;
+  affinity = sink->cpu_affinity;
+  GST_OBJECT_UNLOCK (sink);
+
+  if (priority > 0) {
+    if (!sched->policy_saved) {
+      err = pthread_getschedparam (self, &sched->policy, &sched->param);
+      sched->policy_saved = err == 0;
+    }
+    memset (&param, 0, sizeof (param));
+    param.sched_priority = priority;
+    if ((err = pthread_setschedparam (self, policy, &param)) != 0)
+      GST_WARNING_OBJECT (sink, "Couldn't set real-time priority %u: %s",
+          priority, g_strerror (err));
+  } else
+    gst_dtapi_sink_restore_policy (sink, sched);
+
+  if (affinity != 0) {
+    cpu_set_t cpus;
+
+    if (!sched->affinity_saved) {
+      err = pthread_getaffinity_np (self, sizeof (sched->cpus), &sched->cpus);
+      sched->affinity_saved = err == 0;
+    }
+    CPU_ZERO (&cpus);
+    for (cpu = 0; cpu < 64; cpu++) {
+      if (affinity & (G_GUINT64_CONSTANT (1) << cpu))
+        CPU_SET (cpu, &cpus);
+    }
+    if ((err = pthread_setaffinity_np (self, sizeof (cpus), &cpus)) != 0)
+      GST_WARNING_OBJECT (sink, "Couldn't set CPU affinity 0x%"
+          G_GINT64_MODIFIER "x: %s", affinity, g_strerror (err));
+  } else
+    gst_dtapi_sink_restore_affinity (sink, sched);
+}
+
+/* Puts the calling thread's scheduling back as it was before we changed
+   it, and makes the next apply start again from scratch.  Does nothing if
+   we never changed this thread. */
+static void
+gst_dtapi_sink_restore_scheduling (GstDTAPISink * sink,
+    GstDTAPISinkSched * sched)
+{
+  if (pthread_equal (sched->thread, pthread_self ())) {
+    gst_dtapi_sink_restore_policy (sink, sched);
+    gst_dtapi_sink_restore_affinity (sink, sched);
+  }
+  sched->applied = -1;
+}
+
+/* Parses the t2-plps property into sink->mod.  Nothing changes unless the
+   whole of it parses. */
+static gboolean
+gst_dtapi_sink_parse_plps (GstDTAPISink * sink, const gchar * desc)
+{
+  GstDTAPIPlpPars parsed[GST_DTAPI_MAX_PLPS];
+  GEnumClass *modulations, *code_rates;
+  gchar **plps;
+  gboolean ok = TRUE;
+  int i;
+
+  if (desc == NULL || *desc == '\0') {
+    sink->mod.t2_num_plps = 1;
+    return TRUE;
+  }
+
+  modulations = G_ENUM_CLASS (g_type_class_ref (GST_TYPE_DTAPISINK_MODULATION));
+  code_rates = G_ENUM_CLASS (g_type_class_ref (GST_TYPE_DTAPISINK_CODE_RATE));
+  plps = g_strsplit (desc, ",", -1);
+
+  for (i = 0; plps[i] != NULL && ok; i++) {
+    gchar **fields = g_strsplit (plps[i], ":", -1);
+    GEnumValue *modulation = NULL, *code_rate = NULL;
+
+    if (i >= GST_DTAPI_MAX_PLPS || g_strv_length (fields) != 3) {
+      ok = FALSE;
+    } else {
+      modulation = g_enum_get_value_by_nick (modulations, fields[0]);
+      code_rate = g_enum_get_value_by_nick (code_rates, fields[1]);
+      ok = modulation != NULL && code_rate != NULL;
+    }
+    if (ok) {
+      parsed[i].constellation = (GstDTAPIConstellation) modulation->value;
+      parsed[i].code_rate = code_rate->value;
+      parsed[i].share = atoi (fields[2]);
+    }
+    g_strfreev (fields);
+  }
+
+  if (ok) {
+    memcpy (sink->mod.t2_plps, parsed, i * sizeof (parsed[0]));
+    sink->mod.t2_num_plps = i;
+  } else
+    g_warning ("dtapisink: could not parse t2-plps \"%s\"", desc);
+
+  g_strfreev (plps);
+  g_type_class_unref (code_rates);
+  g_type_class_unref (modulations);
+  return ok;
+}
+
+/* Replaces the pid-filter and pid-remap properties, provided they parse.
+   Called with the object lock held. */
+static void
+gst_dtapi_sink_set_pid_table (GstDTAPISink * sink, const gchar * filter,
+    const gchar * remap)
+{
+  GstDTAPIPidTable *table;
+  gchar *error = NULL;
+  /* Either of these may be the string we're about to free */
+  gchar *new_filter = g_strdup (filter), *new_remap = g_strdup (remap);
+
+  if ((table = gst_dtapi_pid_table_new (new_filter, new_remap, &error)) == NULL) {
+    g_warning ("dtapisink: %s", error);
+    g_free (error);
+    g_free (new_filter);
+    g_free (new_remap);
+    return;
+  }
+  if (!table->active) {
+    gst_dtapi_pid_table_free (table);
+    table = NULL;
+  }
+
+  g_free (sink->pid_filter_desc);
+  sink->pid_filter_desc = new_filter;
+  g_free (sink->pid_remap_desc);
+  sink->pid_remap_desc = new_remap;
+  gst_dtapi_pid_table_free (sink->pid_table_next);
+  sink->pid_table_next = table;
+  g_atomic_int_set (&sink->pid_table_changed, TRUE);
+}
+
+/* Loads si-location, provided it parses.  Called with the object lock
+   held. */
+static void
+gst_dtapi_sink_set_si_location (GstDTAPISink * sink, const gchar * location)
+{
+  GstDTAPICarousel *carousel = NULL;
+  GError *err = NULL;
+  gchar *contents, *error = NULL;
+  gsize len;
+
+  if (location != NULL && *location != '\0') {
+    if (!g_file_get_contents (location, &contents, &len, &err)) {
+      g_warning ("dtapisink: %s", err->message);
+      g_error_free (err);
+      return;
+    }
+    carousel = gst_dtapi_carousel_new ((const guint8 *) contents, len, &error);
+    g_free (contents);
+    if (carousel == NULL) {
+      g_warning ("dtapisink: %s: %s", location, error);
+      g_free (error);
+      return;
+    }
+  }
+
+  g_free (sink->si_location);
+  sink->si_location = g_strdup (location);
+  if (sink->carousel_next)
+    gst_dtapi_carousel_free (sink->carousel_next);
+  sink->carousel_next = carousel;
+  sink->carousel_changed = TRUE;
+  sink->si_changed = TRUE;
+}
+
+/* Loads the profiles at location.  Must be called with the object lock
+   held. */
+static void
+gst_dtapi_sink_set_profile_location (GstDTAPISink * sink,
+    const gchar * location)
+{
+  GstDTAPIModProfile defaults;
+  GHashTable *profiles = NULL;
+  gchar *error = NULL;
+
+  if (location != NULL && *location != '\0') {
+    gst_dtapi_sink_default_mod_profile (&defaults);
+    profiles = gst_dtapi_mod_profiles_load (location, &defaults,
+        G_OBJECT_GET_CLASS (sink), &error);
+    if (profiles == NULL) {
+      g_warning ("dtapisink: %s", error);
+      g_free (error);
+      return;
+    }
+  }
+
+  g_free (sink->profile_location);
+  sink->profile_location = g_strdup (location);
+  if (sink->mod_profiles)
+    g_hash_table_unref (sink->mod_profiles);
+  sink->mod_profiles = profiles;
+}
+
+/* Switches to the named profile.  Everything is changed under the one lock
+   and only what differs is marked pending, so however many settings change
+   it's applied with a single gst_dtapi_sink_apply_pending and a profile
+   that only moves the frequency doesn't restart the modulator.  Returns
+   the PENDING_* bits.  Must be called with the object lock held. */
+static int
+gst_dtapi_sink_set_profile (GstDTAPISink * sink, const gchar * name)
+{
+  const GstDTAPIModProfile *profile = NULL;
+  GstDTAPIModPars mod;
+  const char *invalid;
+  int pending = 0;
+
+  if (name == NULL)
+    return 0;
+  if (sink->mod_profiles)
+    profile = (const GstDTAPIModProfile *)
+        g_hash_table_lookup (sink->mod_profiles, name);
+  if (profile == NULL) {
+    GST_WARNING_OBJECT (sink, "No profile called %s", name);
+    return 0;
+  }
+
+  /* Not the profile's to change */
+  mod = profile->mod;
+  mod.t2_num_plps = sink->mod.t2_num_plps;
+  memcpy (mod.t2_plps, sink->mod.t2_plps, sizeof (mod.t2_plps));
+
+  /* The profile was checked on its own when it was loaded, but not with
+     the PLPs we kept */
+  if ((invalid = gst_dtapi_mod_pars_validate (&mod)) != NULL) {
+    GST_WARNING_OBJECT (sink, "Not switching to profile %s: %s", name,
+        invalid);
+    return 0;
+  }
+
+  if (sink->ts_rate_bps != profile->ts_rate_bps)
+    pending |= PENDING_TS_RATE;
+  if (sink->frequency != profile->frequency)
+    pending |= PENDING_FREQUENCY;
+  if (sink->output_power != profile->output_power)
+    pending |= PENDING_OUTPUT_LEVEL;
+  if (!gst_dtapi_mod_pars_equal (&sink->mod, &mod))
+    pending |= PENDING_MOD_CONTROL;
+  if (sink->rf_mode != profile->rf_mode)
+    pending |= PENDING_RF_MODE;
+  if (sink->tx_mode != profile->tx_mode ||
+      sink->stuff_mode != profile->stuff_mode)
+    pending |= PENDING_TX_MODE;
+
+  GST_INFO_OBJECT (sink, "Switching to profile %s, capacity %d bps",
+      name, profile->capacity);
+  sink->ts_rate_bps = profile->ts_rate_bps;
+  sink->frequency = profile->frequency;
+  sink->output_power = profile->output_power;
+  sink->mod = mod;
+  sink->rf_mode = profile->rf_mode;
+  sink->tx_mode = profile->tx_mode;
+  sink->stuff_mode = profile->stuff_mode;
+  g_free (sink->profile_name);
+  sink->profile_name = g_strdup (name);
+
+  return pending;
+}
+
+static void assign_bits(int* out, int mask, int value)
+{
+  assert((~mask & value) == 0);
+  assert(out);
+  *out &= ~mask;
+  *out |= value;
+}
+
+/* The size of the packets we're given in tx_mode, or 0 for RAW */
+static guint
+gst_dtapi_sink_packet_size (int tx_mode)
+{
+  switch (tx_mode) {
+    case DTAPI_TXMODE_192:
+      return 192;
+    case DTAPI_TXMODE_204:
+    case DTAPI_TXMODE_MIN16:
+      return 204;
+    case DTAPI_TXMODE_RAW:
+      return 0;
+    default:
+      return TS_PACKET_SIZE;
+  }
+}
+
+/* How many bytes the delay property comes to at the current TS rate, which
+   the TS goes out at constantly.  Must be called with the object lock
+   held. */
+static gsize
+gst_dtapi_sink_delay_hold (GstDTAPISink * sink)
+{
+  gsize hold = (guint64) MAX (sink->ts_rate_cache, 0) / 8 * sink->delay_ms /
+      1000;
+
+  return hold - hold % 4;
+}
+
+/* Tells the streaming thread the delay has changed, first making a delay
+   line for it if the one in use hasn't room.  Making one allocates the
+   whole file, which for a long delay can take a while, so it's done here
+   rather than on the streaming thread with channel_lock held.  Until we're
+   running there's no TS rate to size it by, so start calls this again. */
+static void
+gst_dtapi_sink_prepare_delay (GstDTAPISink * sink)
+{
+  GstDTAPIDelay *next = NULL;
+  gchar *location, *error = NULL;
+  guint delay_ms;
+  gsize hold;
+  int tx_mode;
+
+  GST_OBJECT_LOCK (sink);
+  hold = sink->TsOut ? gst_dtapi_sink_delay_hold (sink) : 0;
+  if (hold <= sink->delay_max_hold) {
+    g_atomic_int_set (&sink->delay_changed, TRUE);
+    GST_OBJECT_UNLOCK (sink);
+    return;
+  }
+  delay_ms = sink->delay_ms;
+  location = g_strdup (sink->delay_location);
+  tx_mode = sink->tx_mode;
+  sink->delay_preparing++;
+  GST_OBJECT_UNLOCK (sink);
+
+  next = gst_dtapi_delay_new (location, hold,
+      gst_dtapi_sink_packet_size (tx_mode), &error);
+  if (next == NULL) {
+    GST_ELEMENT_WARNING (sink, RESOURCE, OPEN_READ_WRITE, (NULL),
+      ("Can't delay by %u ms, staying live: %s", delay_ms, error));
+    g_free (error);
+  }
+  g_free (location);
+
+  GST_OBJECT_LOCK (sink);
+  if (sink->delay_next)
+    gst_dtapi_delay_free (sink->delay_next);
+  sink->delay_next = next;
+  g_atomic_int_set (&sink->delay_changed, TRUE);
+  sink->delay_preparing--;
+  GST_OBJECT_UNLOCK (sink);
+}
+
+static void
+gst_dtapi_sink_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstDTAPISink *sink;
+  int pending = 0;
+  gboolean delay_changed = FALSE;
 
   sink = GST_DTAPI_SINK (object);
 
-  gst_dtapi_sink_update_prop_cache (sink);
+  GST_OBJECT_LOCK (sink);
+  switch (prop_id) {
+    case PROP_BITRATE:
+      sink->ts_rate_bps = g_value_get_int(value);
+      pending = PENDING_TS_RATE;
+      break;
+    /* SetRfControl: */
+    case PROP_DTAPISINK_FREQUENCY:
+      sink->frequency = g_value_get_int64(value);
+      pending = PENDING_FREQUENCY;
+      break;
+    /* SetOutputLevel */
+    case PROP_DTAPISINK_OUTPUT_POWER:
+      /* SetOutputLevel expects a value expressed in 0.1 dBm, we expect one in
+         dBm so need to do a conversion here: */
+      /* FIXME: do rounding */
+      sink->output_power = g_value_get_double(value) * 10;
+      pending = PENDING_OUTPUT_LEVEL;
+      break;
+    /* SetModControl*/
+    /* ParXtra0 */
+    case PROP_DTAPISINK_CODE_RATE:
+      sink->mod.code_rate = g_value_get_enum(value);
+      pending = PENDING_MOD_CONTROL;
+      break;
+    /* ParXtra1 */
+    case PROP_DTAPISINK_BANDWIDTH:
+      assign_bits(&sink->mod.mod_param, DTAPI_MOD_DVBT_BW_MSK,
+                  g_value_get_enum(value));
+      pending = PENDING_MOD_CONTROL;
+      break;
+    case PROP_DTAPISINK_MODULATION:
+      sink->mod.constellation = (GstDTAPIConstellation) g_value_get_enum(value);
+      pending = PENDING_MOD_CONTROL;
+      break;
+    case PROP_DTAPISINK_GUARD:
+      assign_bits(&sink->mod.mod_param, DTAPI_MOD_DVBT_GU_MSK,
+                  g_value_get_enum(value));
+      pending = PENDING_MOD_CONTROL;
+      break;
+    case PROP_DTAPISINK_INTERLEAVING:
+      assign_bits(&sink->mod.mod_param, DTAPI_MOD_DVBT_IL_MSK,
+                  g_value_get_enum(value));
+      pending = PENDING_MOD_CONTROL;
+      break;
+    case PROP_DTAPISINK_TRANSMISSION_MODE:
+      assign_bits(&sink->mod.mod_param, DTAPI_MOD_DVBT_MD_MSK,
+                  g_value_get_enum(value));
+      pending = PENDING_MOD_CONTROL;
+      break;
+    /* SetRfMode */
+    case PROP_DTAPISINK_INVERSION:
+      sink->rf_mode = DTAPI_UPCONV_NORMAL | g_value_get_enum(value);
+      pending = PENDING_RF_MODE;
+      break;
+    /* SetTxMode */
+    case PROP_DTAPISINK_TXMODE:
+      sink->tx_mode = g_value_get_enum(value);
+      pending = PENDING_TX_MODE;
+      break;
+    case PROP_DTAPISINK_STUFFING:
+      sink->stuff_mode = g_value_get_enum(value);
+      pending = PENDING_TX_MODE;
+      break;
+    /* Standards other than DVB-T */
+    case PROP_DTAPISINK_STANDARD:
+      sink->mod.standard = (GstDTAPIStandard) g_value_get_enum(value);
+      pending = PENDING_MOD_CONTROL;
+      break;
+    case PROP_DTAPISINK_SYMBOL_RATE:
+      sink->mod.symbol_rate = g_value_get_int(value);
+      pending = PENDING_MOD_CONTROL;
+      break;
+    case PROP_DTAPISINK_PILOTS:
+      sink->mod.pilots = g_value_get_boolean(value);
+      pending = PENDING_MOD_CONTROL;
+      break;
+    case PROP_DTAPISINK_SHORT_FRAMES:
+      sink->mod.short_frames = g_value_get_boolean(value);
+      pending = PENDING_MOD_CONTROL;
+      break;
+    case PROP_DTAPISINK_T2_FFT_MODE:
+      sink->mod.t2_fft_mode = g_value_get_enum(value);
+      pending = PENDING_MOD_CONTROL;
+      break;
+    case PROP_DTAPISINK_T2_GUARD:
+      sink->mod.t2_guard = g_value_get_enum(value);
+      pending = PENDING_MOD_CONTROL;
+      break;
+    case PROP_DTAPISINK_T2_PILOT_PATTERN:
+      sink->mod.t2_pilot_pattern = g_value_get_enum(value);
+      pending = PENDING_MOD_CONTROL;
+      break;
+    case PROP_DTAPISINK_T2_FEC_TYPE:
+      sink->mod.t2_fec_type = g_value_get_enum(value);
+      pending = PENDING_MOD_CONTROL;
+      break;
+    case PROP_DTAPISINK_T2_PLPS:
+      /* Changing the number of PLPs changes the number of FIFOs we feed, so
+         this can't be done on the fly */
+      if (sink->TsOut)
+        GST_WARNING_OBJECT (sink, "t2-plps can't be changed while running");
+      else if (gst_dtapi_sink_parse_plps(sink, g_value_get_string(value))) {
+        g_free(sink->t2_plps);
+        sink->t2_plps = g_value_dup_string(value);
+      }
+      break;
+    /* Profiles */
+    case PROP_DTAPISINK_PROFILE_LOCATION:
+      gst_dtapi_sink_set_profile_location (sink, g_value_get_string(value));
+      break;
+    case PROP_DTAPISINK_PROFILE:
+      pending = gst_dtapi_sink_set_profile (sink, g_value_get_string(value));
+      break;
+    /* EOS handling */
+    case PROP_DTAPISINK_DRAIN_ON_EOS:
+      sink->drain_on_eos = g_value_get_boolean(value);
+      break;
+    case PROP_DTAPISINK_EOS_TAIL:
+      sink->eos_tail_ms = g_value_get_uint(value);
+      break;
+    /* Packet filtering */
+    case PROP_DTAPISINK_PID_FILTER:
+      gst_dtapi_sink_set_pid_table (sink, g_value_get_string(value),
+                                    sink->pid_remap_desc);
+      break;
+    case PROP_DTAPISINK_PID_REMAP:
+      gst_dtapi_sink_set_pid_table (sink, sink->pid_filter_desc,
+                                    g_value_get_string(value));
+      break;
+    /* Monitoring */
+    case PROP_DTAPISINK_MONITOR:
+      sink->monitor = g_value_get_boolean(value);
+      break;
+    /* Timing */
+    case PROP_DTAPISINK_PCR_RESTAMP:
+      sink->pcr_restamp = g_value_get_boolean(value);
+      break;
+    /* SI */
+    case PROP_DTAPISINK_SI_LOCATION:
+      gst_dtapi_sink_set_si_location (sink, g_value_get_string(value));
+      break;
+    case PROP_DTAPISINK_NIT_INTERVAL:
+      sink->si_interval[GST_DTAPI_CAROUSEL_NIT] = g_value_get_uint(value);
+      sink->si_changed = TRUE;
+      break;
+    case PROP_DTAPISINK_SDT_INTERVAL:
+      sink->si_interval[GST_DTAPI_CAROUSEL_SDT] = g_value_get_uint(value);
+      sink->si_changed = TRUE;
+      break;
+    case PROP_DTAPISINK_TDT_INTERVAL:
+      sink->si_interval[GST_DTAPI_CAROUSEL_TDT] = g_value_get_uint(value);
+      sink->si_changed = TRUE;
+      break;
+    /* Delay */
+    case PROP_DTAPISINK_DELAY:
+      sink->delay_ms = g_value_get_uint(value);
+      delay_changed = TRUE;
+      break;
+    case PROP_DTAPISINK_DELAY_LOCATION:
+      g_free (sink->delay_location);
+      sink->delay_location = g_value_dup_string(value);
+      break;
+    /* Mirror */
+    case PROP_DTAPISINK_MIRROR_LOCATION:
+      g_free (sink->mirror_location);
+      sink->mirror_location = g_value_dup_string(value);
+      break;
+    case PROP_DTAPISINK_MIRROR_FILE_SIZE:
+      sink->mirror_file_size = g_value_get_uint64(value);
+      break;
+    case PROP_DTAPISINK_MIRROR_MAX_FILES:
+      sink->mirror_max_files = g_value_get_uint(value);
+      break;
+    /* Recovery */
+    case PROP_DTAPISINK_RECOVERY_TIMEOUT:
+      sink->recovery_timeout = g_value_get_uint(value);
+      break;
+    /* Scheduling */
+    case PROP_DTAPISINK_REALTIME_PRIORITY:
+      sink->realtime_priority = g_value_get_uint(value);
+      g_atomic_int_inc (&sink->sched_generation);
+      break;
+    case PROP_DTAPISINK_REALTIME_POLICY:
+      sink->realtime_policy = g_value_get_enum(value);
+      g_atomic_int_inc (&sink->sched_generation);
+      break;
+    case PROP_DTAPISINK_CPU_AFFINITY:
+      sink->cpu_affinity = g_value_get_uint64(value);
+      g_atomic_int_inc (&sink->sched_generation);
+      break;
+    case PROP_DTAPISINK_LOCK_MEMORY:
+      sink->lock_memory = g_value_get_boolean(value);
+      break;
+    case PROP_DTAPISINK_HUGEPAGES:
+      sink->hugepages = g_value_get_boolean(value);
+      break;
+    /* Profiling */
+    case PROP_DTAPISINK_PROFILE_CALLS:
+      g_atomic_int_set (&sink->call_profile.enabled,
+          g_value_get_boolean(value));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  if (pending)
+    g_atomic_int_or (&sink->pending, pending);
+  GST_OBJECT_UNLOCK (sink);
 
+  if (pending)
+    gst_dtapi_sink_try_apply_pending (sink);
+  if (delay_changed)
+    gst_dtapi_sink_prepare_delay (sink);
+}
+
+static void
+gst_dtapi_sink_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstDTAPISink *sink;
+
+  sink = GST_DTAPI_SINK (object);
+
+  GST_OBJECT_LOCK (sink);
   switch (prop_id) {
     case PROP_BITRATE:
       g_value_set_int (value, sink->ts_rate_bps);
@@ -788,23 +2230,23 @@ gst_dtapi_sink_get_property (GObject * object, guint prop_id,
     /* SetModControl*/
     /* ParXtra0 */
     case PROP_DTAPISINK_CODE_RATE:
-      g_value_set_enum (value, sink->code_rate);
+      g_value_set_enum (value, sink->mod.code_rate);
       break;
     /* ParXtra1 */
     case PROP_DTAPISINK_BANDWIDTH:
-      g_value_set_enum (value, sink->mod_param & DTAPI_MOD_DVBT_BW_MSK);
+      g_value_set_enum (value, sink->mod.mod_param & DTAPI_MOD_DVBT_BW_MSK);
       break;
     case PROP_DTAPISINK_MODULATION:
-      g_value_set_enum (value, sink->mod_param & DTAPI_MOD_DVBT_CO_MSK);
+      g_value_set_enum (value, sink->mod.constellation);
       break;
     case PROP_DTAPISINK_GUARD:
-      g_value_set_enum (value, sink->mod_param & DTAPI_MOD_DVBT_GU_MSK);
+      g_value_set_enum (value, sink->mod.mod_param & DTAPI_MOD_DVBT_GU_MSK);
       break;
     case PROP_DTAPISINK_INTERLEAVING:
-      g_value_set_enum (value, sink->mod_param & DTAPI_MOD_DVBT_IL_MSK);
+      g_value_set_enum (value, sink->mod.mod_param & DTAPI_MOD_DVBT_IL_MSK);
       break;
     case PROP_DTAPISINK_TRANSMISSION_MODE:
-      g_value_set_enum (value, sink->mod_param & DTAPI_MOD_DVBT_MD_MSK);
+      g_value_set_enum (value, sink->mod.mod_param & DTAPI_MOD_DVBT_MD_MSK);
       break;
     /* SetRfMode */
     case PROP_DTAPISINK_INVERSION:
@@ -817,132 +2259,1328 @@ gst_dtapi_sink_get_property (GObject * object, guint prop_id,
     case PROP_DTAPISINK_STUFFING:
       g_value_set_enum(value, sink->stuff_mode);
       break;
+    /* Standards other than DVB-T */
+    case PROP_DTAPISINK_STANDARD:
+      g_value_set_enum(value, sink->mod.standard);
+      break;
+    case PROP_DTAPISINK_SYMBOL_RATE:
+      g_value_set_int(value, sink->mod.symbol_rate);
+      break;
+    case PROP_DTAPISINK_PILOTS:
+      g_value_set_boolean(value, sink->mod.pilots);
+      break;
+    case PROP_DTAPISINK_SHORT_FRAMES:
+      g_value_set_boolean(value, sink->mod.short_frames);
+      break;
+    case PROP_DTAPISINK_T2_FFT_MODE:
+      g_value_set_enum(value, sink->mod.t2_fft_mode);
+      break;
+    case PROP_DTAPISINK_T2_GUARD:
+      g_value_set_enum(value, sink->mod.t2_guard);
+      break;
+    case PROP_DTAPISINK_T2_PILOT_PATTERN:
+      g_value_set_enum(value, sink->mod.t2_pilot_pattern);
+      break;
+    case PROP_DTAPISINK_T2_FEC_TYPE:
+      g_value_set_enum(value, sink->mod.t2_fec_type);
+      break;
+    case PROP_DTAPISINK_T2_PLPS:
+      g_value_set_string(value, sink->t2_plps);
+      break;
+    /* Profiles */
+    case PROP_DTAPISINK_PROFILE_LOCATION:
+      g_value_set_string(value, sink->profile_location);
+      break;
+    case PROP_DTAPISINK_PROFILE:
+      g_value_set_string(value, sink->profile_name);
+      break;
+    /* EOS handling */
+    case PROP_DTAPISINK_DRAIN_ON_EOS:
+      g_value_set_boolean(value, sink->drain_on_eos);
+      break;
+    case PROP_DTAPISINK_EOS_TAIL:
+      g_value_set_uint(value, sink->eos_tail_ms);
+      break;
+    /* Packet filtering */
+    case PROP_DTAPISINK_PID_FILTER:
+      g_value_set_string(value, sink->pid_filter_desc);
+      break;
+    case PROP_DTAPISINK_PID_REMAP:
+      g_value_set_string(value, sink->pid_remap_desc);
+      break;
+    /* Monitoring */
+    case PROP_DTAPISINK_MONITOR:
+      g_value_set_boolean(value, sink->monitor);
+      break;
+    /* Timing */
+    case PROP_DTAPISINK_PCR_RESTAMP:
+      g_value_set_boolean(value, sink->pcr_restamp);
+      break;
+    /* SI */
+    case PROP_DTAPISINK_SI_LOCATION:
+      g_value_set_string(value, sink->si_location);
+      break;
+    case PROP_DTAPISINK_NIT_INTERVAL:
+      g_value_set_uint(value, sink->si_interval[GST_DTAPI_CAROUSEL_NIT]);
+      break;
+    case PROP_DTAPISINK_SDT_INTERVAL:
+      g_value_set_uint(value, sink->si_interval[GST_DTAPI_CAROUSEL_SDT]);
+      break;
+    case PROP_DTAPISINK_TDT_INTERVAL:
+      g_value_set_uint(value, sink->si_interval[GST_DTAPI_CAROUSEL_TDT]);
+      break;
+    case PROP_DTAPISINK_PCR_STATS: {
+      GstDTAPIPcrStats *stats = &sink->pcr_stats;
+      guint64 n = MAX (stats->restamped, 1);
+
+      g_value_take_boxed(value, gst_structure_new ("dtapisink-pcr-stats",
+          "pcrs", G_TYPE_UINT64, stats->pcrs,
+          "restamped", G_TYPE_UINT64, stats->restamped,
+          "discontinuities", G_TYPE_UINT64, stats->discontinuities,
+          "input-max", G_TYPE_UINT64, stats->input_max_ns,
+          "input-mean", G_TYPE_UINT64, stats->input_total_ns / n,
+          "output-max", G_TYPE_UINT64, stats->output_max_ns,
+          "output-mean", G_TYPE_UINT64, stats->output_total_ns / n, NULL));
+      break;
+    }
+    /* Delay */
+    case PROP_DTAPISINK_DELAY:
+      g_value_set_uint(value, sink->delay_ms);
+      break;
+    case PROP_DTAPISINK_DELAY_LOCATION:
+      g_value_set_string(value, sink->delay_location);
+      break;
+    /* Mirror */
+    case PROP_DTAPISINK_MIRROR_LOCATION:
+      g_value_set_string(value, sink->mirror_location);
+      break;
+    case PROP_DTAPISINK_MIRROR_FILE_SIZE:
+      g_value_set_uint64(value, sink->mirror_file_size);
+      break;
+    case PROP_DTAPISINK_MIRROR_MAX_FILES:
+      g_value_set_uint(value, sink->mirror_max_files);
+      break;
+    case PROP_DTAPISINK_MIRROR_STATS: {
+      GstDTAPIMirrorStats stats = { 0, 0, 0 };
+
+      if (sink->mirror)
+        gst_dtapi_mirror_get_stats (sink->mirror, &stats);
+      g_value_take_boxed(value, gst_structure_new ("dtapisink-mirror-stats",
+          "written", G_TYPE_UINT64, stats.written,
+          "dropped", G_TYPE_UINT64, stats.dropped,
+          "files", G_TYPE_UINT, stats.files, NULL));
+      break;
+    }
+    /* Recovery */
+    case PROP_DTAPISINK_RECOVERY_TIMEOUT:
+      g_value_set_uint(value, sink->recovery_timeout);
+      break;
+    case PROP_DTAPISINK_RECOVERY_STATS:
+      g_value_take_boxed(value, gst_structure_new ("dtapisink-recovery-stats",
+          "outages", G_TYPE_UINT64, sink->outages,
+          "total", G_TYPE_UINT64, sink->outage_total,
+          "max", G_TYPE_UINT64, sink->outage_max, NULL));
+      break;
+    /* Scheduling */
+    case PROP_DTAPISINK_REALTIME_PRIORITY:
+      g_value_set_uint(value, sink->realtime_priority);
+      break;
+    case PROP_DTAPISINK_REALTIME_POLICY:
+      g_value_set_enum(value, sink->realtime_policy);
+      break;
+    case PROP_DTAPISINK_CPU_AFFINITY:
+      g_value_set_uint64(value, sink->cpu_affinity);
+      break;
+    case PROP_DTAPISINK_LOCK_MEMORY:
+      g_value_set_boolean(value, sink->lock_memory);
+      break;
+    case PROP_DTAPISINK_HUGEPAGES:
+      g_value_set_boolean(value, sink->hugepages);
+      break;
+    /* Profiling */
+    case PROP_DTAPISINK_PROFILE_CALLS:
+      g_value_set_boolean(value,
+          g_atomic_int_get (&sink->call_profile.enabled));
+      break;
+    case PROP_DTAPISINK_CALL_STATS:
+      g_value_take_boxed(value, gst_dtapi_profile_to_structure (
+          &sink->call_profile, "dtapisink-call-stats"));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
+  GST_OBJECT_UNLOCK (sink);
+}
+
+/* Records what we've just written and the FIFO load that resulted */
+static void
+gst_dtapi_sink_update_fifo_cache (GstDTAPISink * sink, int written, int load)
+{
+  gint64 now = g_get_monotonic_time ();
+
+  GST_OBJECT_LOCK (sink);
+  if (sink->fifo_update_time != 0 && now > sink->fifo_update_time) {
+    gdouble dt = (now - sink->fifo_update_time) / (gdouble) G_USEC_PER_SEC;
+    gdouble alpha = MIN (1.0, dt * 1000 / QOS_SMOOTHING_MS);
+
+    sink->fifo_trend += alpha * ((load - sink->fifo_load) / dt -
+                                 sink->fifo_trend);
+  }
+  sink->fifo_update_time = now;
+  sink->bytes_written += written;
+  sink->fifo_load = load;
+  GST_OBJECT_UNLOCK (sink);
+}
+
+/* Tells upstream whether it's heading for overflowing or underflowing the
+   FIFO.  The proportion is the rate it should be sending at over the rate
+   it is sending at.  It should be sending at the TS rate, less whatever it
+   takes to get the FIFO back to QOS_TARGET_FILL within QOS_CORRECTION_S.
+   It is sending at the TS rate plus what the FIFO is gaining.  So a FIFO
+   above the target, or filling, gives a proportion below 1.0 and an
+   OVERFLOW.  This works from the cached values only so costs no calls to
+   the device. */
+static void
+gst_dtapi_sink_do_qos (GstDTAPISink * sink)
+{
+  gint64 now;
+  int load, size, rate;
+  gdouble trend, out_rate, in_rate, target, proportion;
+  GstClockTime timestamp;
+  GstClockTimeDiff diff;
+  GstPad *pad = GST_BASE_SINK_PAD (sink);
+
+  if (!gst_base_sink_is_qos_enabled (GST_BASE_SINK (sink)))
+    return;
+
+  now = g_get_monotonic_time ();
+  GST_OBJECT_LOCK (sink);
+  if (now - sink->qos_sent_time < QOS_INTERVAL_US ||
+      sink->fifo_update_time == 0 || sink->ts_rate_cache <= 0 ||
+      sink->fifo_size <= 0 ||
+      !GST_CLOCK_TIME_IS_VALID (sink->last_running_time)) {
+    GST_OBJECT_UNLOCK (sink);
+    return;
+  }
+  sink->qos_sent_time = now;
+  load = sink->fifo_load;
+  size = sink->fifo_size;
+  rate = sink->ts_rate_cache;
+  trend = sink->fifo_trend;
+  timestamp = sink->last_running_time;
+  GST_OBJECT_UNLOCK (sink);
+
+  out_rate = rate / 8.0;
+  target = size * QOS_TARGET_FILL;
+  /* An emptying FIFO can make this come out at or below zero */
+  in_rate = MAX (out_rate + trend, out_rate / 10);
+  proportion = (out_rate - (load - target) / QOS_CORRECTION_S) / in_rate;
+  proportion = CLAMP (proportion, 0.0, 10.0);
+
+  /* We're "late" by however long it would take to air what we're short of
+     the target */
+  diff = (GstClockTimeDiff) ((target - load) * GST_SECOND / out_rate);
+  diff = MAX (diff, -(GstClockTimeDiff) timestamp);
+
+  GST_LOG_OBJECT (sink, "FIFO %d/%d trend %.0f B/s proportion %f", load, size,
+      trend, proportion);
+
+  gst_pad_push_event (pad, gst_event_new_qos (proportion < 1.0 ?
+      GST_QOS_TYPE_OVERFLOW : GST_QOS_TYPE_UNDERFLOW, proportion, diff,
+      timestamp));
+  /* The raw figures for anything upstream that wants to do its own thing */
+  gst_pad_push_event (pad, gst_event_new_custom (GST_EVENT_CUSTOM_UPSTREAM,
+      gst_structure_new ("dtapisink-fifo",
+          "load", G_TYPE_INT, load,
+          "size", G_TYPE_INT, size,
+          "trend", G_TYPE_DOUBLE, trend,
+          "proportion", G_TYPE_DOUBLE, proportion, NULL)));
+}
+
+/* Multi-PLP: Writes up to len bytes of PLP data to the PLP's FIFO on the
+   modulator without blocking.  Returns the number of bytes written or -1 on
+   error. */
+static int
+gst_dtapi_sink_write_plp (GstDTAPISink * sink, int plp, const guint8 * data,
+    int len)
+{
+  DTAPI_RESULT result;
+  int load;
+
+  if ((result = sink->TsOut->GetFifoLoad(load, plp)) != DTAPI_OK) {
+    GST_ELEMENT_ERROR (sink, RESOURCE, WRITE, (NULL),
+      ("Getting fifo load for PLP %d failed: %s", plp,
+       gst_dtapi_result_to_string(result)));
+    return -1;
+  }
+
+  len = MIN (len, sink->plp_fifo_size - load);
+  len -= len % TS_PACKET_SIZE;
+  if (len <= 0)
+    return 0;
+
+  if ((result = sink->TsOut->Write((char*) data, len, plp)) != DTAPI_OK) {
+    GST_ELEMENT_ERROR (sink, RESOURCE, WRITE, (NULL),
+      ("Writing data for PLP %d failed: %s", plp, gst_dtapi_result_to_string(result)));
+    return -1;
+  }
+  if (plp == 0)
+    gst_dtapi_sink_update_fifo_cache (sink, len, load + len);
+  return len;
+}
+
+/* Multi-PLP: Deficit round robin over the PLP rings, weighted by the PLP
+   capacities */
+static gpointer
+gst_dtapi_sink_plp_feeder (gpointer data)
+{
+  GstDTAPISink *sink = GST_DTAPI_SINK (data);
+  int deficit[GST_DTAPI_MAX_PLPS] = { 0 };
+  gboolean sending = FALSE;
+  GstDTAPISinkSched sched = GstDTAPISinkSched ();
+  DTAPI_RESULT result;
+
+  while (!g_atomic_int_get (&sink->plp_feeder_stop)) {
+    gboolean wrote = FALSE;
+    int plp;
+
+    gst_dtapi_sink_apply_scheduling (sink, &sched);
+
+    g_mutex_lock (&sink->channel_lock);
+    /* Changing the modulation parameters drops us back to HOLD */
+    if (g_atomic_int_get (&sink->pending) & PENDING_MOD_CONTROL)
+      sending = FALSE;
+    gst_dtapi_sink_apply_pending (sink);
+
+    for (plp = 0; plp < sink->mod.t2_num_plps; plp++) {
+      const guint8 *ring_data;
+      int len, written;
+
+      deficit[plp] += sink->plp_quantum[plp];
+      len = (int) gst_dtapi_ring_peek (sink->plp_rings[plp], &ring_data,
+                                       deficit[plp]);
+      if (len < TS_PACKET_SIZE) {
+        /* An idle PLP doesn't get to save up */
+        deficit[plp] = MIN (deficit[plp], sink->plp_quantum[plp]);
+        continue;
+      }
+
+      if ((written = gst_dtapi_sink_write_plp (sink, plp, ring_data, len)) < 0) {
+        g_mutex_unlock (&sink->channel_lock);
+        return NULL;
+      }
+      if (written > 0) {
+        gst_dtapi_ring_consume (sink->plp_rings[plp], written);
+        deficit[plp] -= written;
+        wrote = TRUE;
+      }
+    }
+
+    if (wrote && !sending) {
+      result = gst_dtapi_sink_set_tx_control (sink, DTAPI_TXCTRL_SEND);
+      if (result == DTAPI_OK)
+        sending = TRUE;
+      else if (result != DTAPI_E_INSUF_LOAD) {
+        GST_ELEMENT_ERROR (sink, RESOURCE, WRITE, (NULL),
+          ("Enabling outputs failed: %s", gst_dtapi_result_to_string(result)));
+        g_mutex_unlock (&sink->channel_lock);
+        return NULL;
+      }
+    }
+    g_mutex_unlock (&sink->channel_lock);
+
+    if (!wrote)
+      g_usleep (PLP_FEEDER_IDLE_US);
+  }
+  return NULL;
+}
+
+static gboolean
+gst_dtapi_sink_start_plps (GstDTAPISink * sink)
+{
+  DTAPI_RESULT result;
+  GError *error = NULL;
+  int plp;
+
+  for (plp = 1; plp < GST_DTAPI_MAX_PLPS; plp++) {
+    if (sink->plp_pads[plp] && plp >= sink->mod.t2_num_plps) {
+      GST_ELEMENT_ERROR (sink, RESOURCE, SETTINGS, (NULL),
+        ("Pad plp_%d requested but t2-plps only describes %d PLPs", plp,
+         sink->mod.t2_num_plps));
+      return FALSE;
+    }
+  }
+
+  if ((result = sink->TsOut->GetFifoSize(sink->plp_fifo_size)) != DTAPI_OK) {
+    GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, (NULL),
+      ("Getting fifo size failed: %s", gst_dtapi_result_to_string(result)));
+    return FALSE;
+  }
+  GST_OBJECT_LOCK (sink);
+  sink->fifo_size = sink->plp_fifo_size;
+  GST_OBJECT_UNLOCK (sink);
+
+  for (plp = 0; plp < sink->mod.t2_num_plps; plp++) {
+    gint64 bytes_per_s =
+        gst_dtapi_mod_pars_plp_capacity (&sink->mod, plp) / 8;
+    gsize ring_size = bytes_per_s * PLP_RING_MS / 1000;
+
+    /* Keep the ring a whole number of packets so that the contiguous regions
+       we hand to Write are too */
+    ring_size = MAX (ring_size - ring_size % TS_PACKET_SIZE,
+                     64 * TS_PACKET_SIZE);
+    sink->plp_rings[plp] = gst_dtapi_ring_new (ring_size,
+                                               gst_dtapi_sink_mem_flags (sink));
+    sink->plp_quantum[plp] = MAX (bytes_per_s * PLP_QUANTUM_MS / 1000,
+                                  TS_PACKET_SIZE);
+  }
+
+  g_atomic_int_set (&sink->plp_feeder_stop, 0);
+  sink->plp_feeder = g_thread_try_new ("dtapisink-plp",
+      gst_dtapi_sink_plp_feeder, sink, &error);
+  if (!sink->plp_feeder) {
+    GST_ELEMENT_ERROR (sink, RESOURCE, FAILED, (NULL),
+      ("Could not start PLP feeder thread: %s", error->message));
+    g_error_free (error);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static void
+gst_dtapi_sink_stop_plps (GstDTAPISink * sink)
+{
+  int plp;
+
+  for (plp = 0; plp < GST_DTAPI_MAX_PLPS; plp++) {
+    if (sink->plp_rings[plp])
+      gst_dtapi_ring_set_flushing (sink->plp_rings[plp], TRUE);
+  }
+  if (sink->plp_feeder) {
+    g_atomic_int_set (&sink->plp_feeder_stop, 1);
+    g_thread_join (sink->plp_feeder);
+    sink->plp_feeder = NULL;
+  }
+  for (plp = 0; plp < GST_DTAPI_MAX_PLPS; plp++) {
+    gst_dtapi_ring_free (sink->plp_rings[plp]);
+    sink->plp_rings[plp] = NULL;
+  }
+}
+
+static void
+gst_dtapi_sink_set_plps_flushing (GstDTAPISink * sink, gboolean flushing)
+{
+  int plp;
+
+  for (plp = 0; plp < GST_DTAPI_MAX_PLPS; plp++) {
+    if (sink->plp_rings[plp])
+      gst_dtapi_ring_set_flushing (sink->plp_rings[plp], flushing);
+  }
+}
+
+static GstFlowReturn
+gst_dtapi_sink_plp_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  GstDTAPISink *sink = GST_DTAPI_SINK (parent);
+  int plp = GPOINTER_TO_INT (gst_pad_get_element_private (pad));
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstMapInfo map;
+
+  if (!sink->plp_rings[plp])
+    ret = GST_FLOW_FLUSHING;
+  else if (!gst_buffer_map (buffer, &map, GST_MAP_READ)) {
+    GST_ELEMENT_ERROR (sink, RESOURCE, WRITE, (NULL),
+      ("Failed to map buffer"));
+    ret = GST_FLOW_ERROR;
+  } else {
+    if (!gst_dtapi_ring_write (sink->plp_rings[plp], map.data, map.size))
+      ret = GST_FLOW_FLUSHING;
+    gst_buffer_unmap (buffer, &map);
+  }
+
+  gst_buffer_unref (buffer);
+  return ret;
+}
+
+static gboolean
+gst_dtapi_sink_plp_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  GstDTAPISink *sink = GST_DTAPI_SINK (parent);
+  int plp = GPOINTER_TO_INT (gst_pad_get_element_private (pad));
+
+  /* The sink pad carrying PLP 0 deals with EOS, segments and so on for the
+     element as a whole */
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_START:
+      if (sink->plp_rings[plp])
+        gst_dtapi_ring_set_flushing (sink->plp_rings[plp], TRUE);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      if (sink->plp_rings[plp])
+        gst_dtapi_ring_set_flushing (sink->plp_rings[plp], FALSE);
+      break;
+    default:
+      break;
+  }
+  gst_event_unref (event);
+  return TRUE;
+}
+
+static GstPad *
+gst_dtapi_sink_request_new_pad (GstElement * element, GstPadTemplate * templ,
+    const gchar * name, const GstCaps * caps)
+{
+  GstDTAPISink *sink = GST_DTAPI_SINK (element);
+  GstPad *pad;
+  gchar *pad_name;
+  guint plp = 0;
+
+  if (name == NULL) {
+    for (plp = 1; plp < GST_DTAPI_MAX_PLPS && sink->plp_pads[plp]; plp++);
+  } else if (sscanf (name, "plp_%u", &plp) != 1) {
+    plp = 0;
+  }
+  if (plp < 1 || plp >= GST_DTAPI_MAX_PLPS || sink->plp_pads[plp])
+    return NULL;
+
+  pad_name = g_strdup_printf ("plp_%u", plp);
+  pad = gst_pad_new_from_template (templ, pad_name);
+  g_free (pad_name);
+
+  gst_pad_set_element_private (pad, GINT_TO_POINTER (plp));
+  gst_pad_set_chain_function (pad, GST_DEBUG_FUNCPTR (gst_dtapi_sink_plp_chain));
+  gst_pad_set_event_function (pad, GST_DEBUG_FUNCPTR (gst_dtapi_sink_plp_event));
+  sink->plp_pads[plp] = pad;
+
+  if (GST_STATE (element) > GST_STATE_READY)
+    gst_pad_set_active (pad, TRUE);
+  gst_element_add_pad (element, pad);
+  return pad;
+}
+
+static void
+gst_dtapi_sink_release_pad (GstElement * element, GstPad * pad)
+{
+  GstDTAPISink *sink = GST_DTAPI_SINK (element);
+  int plp = GPOINTER_TO_INT (gst_pad_get_element_private (pad));
+
+  sink->plp_pads[plp] = NULL;
+  gst_element_remove_pad (element, pad);
+}
+
+static void
+gst_dtapi_sink_finalize (GObject * object)
+{
+  GstDTAPISink *sink = GST_DTAPI_SINK (object);
+
+  g_free (sink->t2_plps);
+  g_free (sink->profile_location);
+  g_free (sink->profile_name);
+  if (sink->mod_profiles)
+    g_hash_table_unref (sink->mod_profiles);
+  g_free (sink->pid_filter_desc);
+  g_free (sink->pid_remap_desc);
+  gst_dtapi_pid_table_free (sink->pid_table_next);
+  gst_dtapi_pid_table_free (sink->pid_table);
+  gst_dtapi_mem_free (sink->scratch);
+  if (sink->restamp)
+    gst_dtapi_pcr_restamp_free (sink->restamp);
+  g_free (sink->si_location);
+  if (sink->carousel_next)
+    gst_dtapi_carousel_free (sink->carousel_next);
+  if (sink->carousel)
+    gst_dtapi_carousel_free (sink->carousel);
+  if (sink->mon)
+    gst_dtapi_monitor_free (sink->mon);
+  g_free (sink->delay_location);
+  g_free (sink->mirror_location);
+  if (sink->delay_next)
+    gst_dtapi_delay_free (sink->delay_next);
+  if (sink->delay_line)
+    gst_dtapi_delay_free (sink->delay_line);
+  gst_dtapi_profile_clear (&sink->call_profile);
+  g_mutex_clear (&sink->channel_lock);
+  g_mutex_clear (&sink->attach_lock);
+  g_mutex_clear (&sink->drain_lock);
+  g_cond_clear (&sink->drain_cond);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+#ifdef DTAPI_DEBUG
+/* Just for debugging: Print all the properties according to DTAPI */
+static void
+gst_dtapi_sink_print_props (GstDTAPISink * sink)
+{
+  int result, ts_rate_bps, tx_mode, stuff_mode, lock_status,
+      output_power, mod_type, code_rate, mod_param, par_xtra_2;
+  int64_t frequency;
+  void* p_xtra_pars;
+  CHECK(sink->TsOut->GetTsRateBps(ts_rate_bps),
+        "Failed to get TS rate: %s");
+  CHECK(sink->TsOut->GetTxMode(tx_mode, stuff_mode),
+        "Failed to get TxMode: %s");
+  CHECK(sink->TsOut->GetRfControl(frequency, lock_status),
+        "Failed to get frequency: %s");
+  CHECK(sink->TsOut->GetOutputLevel(output_power),
+        "Failed to get output power: %s");
+  CHECK(sink->TsOut->GetModControl(mod_type, code_rate,
+                                   mod_param, par_xtra_2, p_xtra_pars),
+        "Failed to get modulation parameters: %s");
+  printf("ts_rate_bps: %i\ntx_mode: %i\nstuff_mode: %i\nlock_status: %i\n"
+         "output_power: %i\nmod_type: %i\ncode_rate: %i\nmod_param: %i\n"
+         "par_xtra_2: %i\nfrequency: %lld\n", ts_rate_bps, tx_mode, stuff_mode,
+         lock_status, output_power, mod_type, code_rate, mod_param, par_xtra_2,
+         frequency);
+}
+#endif /* DTAPI_DEBUG */
+
+/* Gets a freshly attached channel into the state we want: the whole
+   configuration in one go, then HOLD so the FIFO fills up before we start
+   sending.  Used by start and again when recovering from losing the device.
+   Must be called with channel_lock held.  Returns FALSE if the device went
+   away again while we were at it. */
+static gboolean
+gst_dtapi_sink_configure (GstDTAPISink * sink)
+{
+  DTAPI_RESULT result;
+  int fifo_size;
+
+  sink->channel_lost = FALSE;
+
+  g_atomic_int_or (&sink->pending, PENDING_ALL);
+  gst_dtapi_sink_apply_pending (sink);
+
+  CHECK(gst_dtapi_sink_set_tx_control (sink, DTAPI_TXCTRL_HOLD),
+        "Entering state HOLD failed: %s");
+
+  gst_dtapi_sink_update_prop_cache(sink);
+
+  GST_OBJECT_LOCK (sink);
+  sink->fifo_load = 0;
+  sink->fifo_trend = 0;
+  sink->fifo_update_time = 0;
+  GST_OBJECT_UNLOCK (sink);
+  CHECK(sink->TsOut->GetFifoSize(fifo_size), "Getting fifo size failed: %s");
+  if (result == DTAPI_OK) {
+    GST_OBJECT_LOCK (sink);
+    sink->fifo_size = fifo_size;
+    GST_OBJECT_UNLOCK (sink);
+  }
+
+  return !sink->channel_lost;
+}
+
+static gboolean
+gst_dtapi_sink_start (GstBaseSink * base_sink)
+{
+  GstDTAPISink *sink = GST_DTAPI_SINK (base_sink);
+  GstDTAPIMemFlags mem_flags, got;
+  GstDTAPIMirror *mirror;
+  const char* invalid;
+  gchar* error;
+
+  if ((invalid = gst_dtapi_mod_pars_validate (&sink->mod)) != NULL) {
+    GST_ELEMENT_ERROR (sink, RESOURCE, SETTINGS, (NULL),
+      ("Invalid modulation parameters: %s", invalid));
+    return FALSE;
+  }
+
+  /* Get the memory we write from in place now rather than in the data path,
+     where it would fault in as it was first used */
+  gst_dtapi_mem_free (sink->scratch);
+  sink->scratch = NULL;
+  sink->scratch_size = 0;
+  mem_flags = gst_dtapi_sink_mem_flags (sink);
+  if (mem_flags) {
+    sink->scratch_size = BUFSIZE;
+    sink->scratch = (guint8 *) gst_dtapi_mem_alloc (sink->scratch_size,
+        mem_flags, &got);
+    if ((mem_flags & ~got) & GST_DTAPI_MEM_LOCKED)
+      GST_WARNING_OBJECT (sink, "Couldn't lock memory, is RLIMIT_MEMLOCK "
+          "high enough?");
+    if ((mem_flags & ~got) & GST_DTAPI_MEM_HUGEPAGES)
+      GST_WARNING_OBJECT (sink, "No huge pages to be had");
+  }
+
+  if (sink->mirror_location) {
+    mirror = gst_dtapi_mirror_new (sink->mirror_location,
+        sink->mirror_file_size, sink->mirror_max_files, &error);
+    if (mirror == NULL) {
+      GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, (NULL), ("%s", error));
+      g_free (error);
+      return FALSE;
+    }
+    GST_OBJECT_LOCK (sink);
+    sink->mirror = mirror;
+    sink->mirror_failed = FALSE;
+    GST_OBJECT_UNLOCK (sink);
+  }
+
+  /* Stops property changes being applied to a half attached channel */
+  g_mutex_lock (&sink->channel_lock);
+
+  gst_dtapi_profile_reset (&sink->call_profile);
+  sink->Dvc = new GstDTAPIDevice(&sink->call_profile);
+  sink->TsOut = new GstDTAPIOutpChannel(&sink->call_profile);
+
+  /* Attach device and output channel objects to hardware */
+  if ((error = gst_dtapi_attach (sink->Dvc, sink->TsOut, 0, 215, 1)) != NULL) {
+    delete sink->TsOut;
+    sink->TsOut = NULL;
+    delete sink->Dvc;
+    sink->Dvc = NULL;
+    g_mutex_unlock (&sink->channel_lock);
+    GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, (NULL), ("%s", error));
+    g_free (error);
+    GST_OBJECT_LOCK (sink);
+    mirror = sink->mirror;
+    sink->mirror = NULL;
+    GST_OBJECT_UNLOCK (sink);
+    if (mirror)
+      gst_dtapi_mirror_free (mirror);
+    return FALSE;
+  }
+
+  GST_OBJECT_LOCK (sink);
+  sink->bytes_written = 0;
+  sink->last_position = GST_CLOCK_TIME_NONE;
+  sink->last_running_time = GST_CLOCK_TIME_NONE;
+  sink->qos_sent_time = 0;
+  memset (&sink->pcr_stats, 0, sizeof (sink->pcr_stats));
+  GST_OBJECT_UNLOCK (sink);
+  sink->outage_start = 0;
+  /* A device lost now is picked up by the first write */
+  gst_dtapi_sink_configure (sink);
+  /* The output starts again from nothing */
+  if (sink->carousel)
+    gst_dtapi_carousel_reset (sink->carousel);
+  g_mutex_unlock (&sink->channel_lock);
+
+  /* Now there's a TS rate to size it by */
+  gst_dtapi_sink_prepare_delay (sink);
+
+  if (sink->mod.standard == GST_DTAPI_STANDARD_DVBT2 &&
+      sink->mod.t2_num_plps > 1 && !gst_dtapi_sink_start_plps (sink))
+    return FALSE;
+
+  return TRUE;
+}
+
+#ifdef DTAPI_DEBUG
+/* Just used for debugging in conjunction with DtOutpChannel::GetFlags */
+static void
+print_flags(int flags)
+{
+  if (flags & DTAPI_TX_FIFO_UFL)
+    printf("DTAPI_TX_FIFO_UFL, ");
+  if (flags & DTAPI_TX_MUX_OVF)
+    printf("DTAPI_TX_MUX_OVF, ");
+  if (flags & DTAPI_TX_READBACK_ERR)
+    printf("DTAPI_TX_READBACK_ERR, ");
+  if (flags & DTAPI_TX_SYNC_ERR)
+    printf("DTAPI_TX_SYNC_ERR, ");
+  if (flags & DTAPI_TX_TARGET_ERR)
+    printf("DTAPI_TX_TARGET_ERR, ");
+  if (flags & DTAPI_TX_LINK_ERR)
+    printf("DTAPI_TX_LINK_ERR, ");
+  if (flags & DTAPI_TX_DATA_ERR)
+    printf("DTAPI_TX_DATA_ERR, ");
+  
+  /* Check that we've printed everything: */
+  printf("%i\n", flags & ~(  DTAPI_TX_FIFO_UFL
+                           | DTAPI_TX_MUX_OVF | DTAPI_TX_READBACK_ERR
+                           | DTAPI_TX_SYNC_ERR | DTAPI_TX_TARGET_ERR
+                           | DTAPI_TX_LINK_ERR | DTAPI_TX_DATA_ERR ));
+}
+#endif /* DTAPI_DEBUG */
+
+/* Returns the scratch buffer, grown to at least size bytes.  What was in it
+   is lost. */
+static guint8 *
+gst_dtapi_sink_scratch (GstDTAPISink * sink, gsize size)
+{
+  if (sink->scratch_size < size) {
+    sink->scratch_size = size;
+    gst_dtapi_mem_free (sink->scratch);
+    sink->scratch = (guint8 *) gst_dtapi_mem_alloc (sink->scratch_size,
+        gst_dtapi_sink_mem_flags (sink), NULL);
+  }
+  return sink->scratch;
+}
+
+/* Returns data if we can change it where it is (writable is TRUE or it's
+   in the scratch buffer already), otherwise a copy of it in the scratch
+   buffer */
+static guint8 *
+gst_dtapi_sink_writable (GstDTAPISink * sink, const guint8 * data,
+    gsize size, gboolean writable)
+{
+  guint8 *out;
+
+  if (writable || data == sink->scratch)
+    return (guint8 *) data;
+  out = gst_dtapi_sink_scratch (sink, size);
+  memcpy (out, data, size);
+  return out;
+}
+
+/* Applies pid-filter and pid-remap to data.  Returns what should be written
+   instead, which is either data itself or the scratch buffer, and updates
+   *size to match.  If writable is TRUE data is remapped in place, and only
+   moved up if packets are dropped. */
+static const guint8 *
+gst_dtapi_sink_filter_pids (GstDTAPISink * sink, const guint8 * data,
+    gsize * size, gboolean writable)
+{
+  guint8 *out;
+
+  if (G_UNLIKELY (g_atomic_int_get (&sink->pid_table_changed))) {
+    int tx_mode;
+    guint packet_size;
+
+    GST_OBJECT_LOCK (sink);
+    gst_dtapi_pid_table_free (sink->pid_table);
+    sink->pid_table = sink->pid_table_next;
+    sink->pid_table_next = NULL;
+    g_atomic_int_set (&sink->pid_table_changed, FALSE);
+    tx_mode = sink->tx_mode;
+    GST_OBJECT_UNLOCK (sink);
+
+    packet_size = gst_dtapi_sink_packet_size (tx_mode);
+    if (packet_size == 0) {
+      GST_WARNING_OBJECT (sink, "Can't filter PIDs with tx-mode RAW");
+      gst_dtapi_pid_table_free (sink->pid_table);
+      sink->pid_table = NULL;
+      packet_size = TS_PACKET_SIZE;
+    }
+    gst_dtapi_pid_filter_init (&sink->pid_filter, packet_size);
+    /* The modulator sends the parity as it is, unlike with MIN16 where it
+       is dropped */
+    if (tx_mode == DTAPI_TXMODE_204 && sink->pid_table &&
+        sink->pid_table->remaps) {
+      GST_WARNING_OBJECT (sink, "Can't remap PIDs with tx-mode 204, the "
+          "Reed-Solomon parity wouldn't match.  Only filtering.");
+      sink->pid_filter.remap = FALSE;
+    }
+  }
+
+  if (sink->pid_table == NULL)
+    return data;
+
+  /* A packet carried over from the last buffer would have to go in front
+     of this one */
+  if (writable && sink->pid_filter.partial_len == 0) {
+    *size = gst_dtapi_pid_filter_process_in_place (&sink->pid_filter,
+        sink->pid_table, (guint8 *) data, *size);
+    return data;
+  }
+
+  out = gst_dtapi_sink_scratch (sink, *size + sink->pid_filter.packet_size);
+  *size = gst_dtapi_pid_filter_process (&sink->pid_filter, sink->pid_table,
+                                        data, *size, out);
+  return out;
+}
+
+/* si-location: returns data with due sections in place of its null
+   packets.  Unless data is writable (or in the scratch buffer already) it
+   is copied to the scratch buffer first, but only if something in it is
+   going to change.  Call with channel_lock held, before the data is
+   written. */
+static const guint8 *
+gst_dtapi_sink_send_si (GstDTAPISink * sink, const guint8 * data, gsize size,
+    gboolean writable)
+{
+  guint interval[GST_DTAPI_CAROUSEL_N_TABLES];
+  gboolean si_changed;
+  guint64 offset;
+  gint64 utc_us;
+  int rate, tx_mode, fifo_load, i;
+  guint packet_size;
+  guint8 *out;
+
+  GST_OBJECT_LOCK (sink);
+  if (G_UNLIKELY (sink->carousel_changed)) {
+    if (sink->carousel)
+      gst_dtapi_carousel_free (sink->carousel);
+    sink->carousel = sink->carousel_next;
+    sink->carousel_next = NULL;
+    sink->carousel_changed = FALSE;
+  }
+  si_changed = sink->si_changed;
+  sink->si_changed = FALSE;
+  memcpy (interval, sink->si_interval, sizeof (interval));
+  rate = sink->ts_rate_cache;
+  tx_mode = sink->tx_mode;
+  offset = sink->bytes_written;
+  fifo_load = sink->fifo_load;
+  GST_OBJECT_UNLOCK (sink);
+
+  if (sink->carousel == NULL)
+    return data;
+
+  if (G_UNLIKELY (si_changed)) {
+    for (i = 0; i < GST_DTAPI_CAROUSEL_N_TABLES; i++)
+      gst_dtapi_carousel_set_interval (sink->carousel,
+          (GstDTAPICarouselTable) i, interval[i]);
+  }
+
+  packet_size = gst_dtapi_sink_packet_size (tx_mode);
+  if (packet_size == 0 || rate <= 0)
+    return data;
+
+  /* Most buffers have nothing due or nowhere to put it, so only copy one
+     that's going to change */
+  if (!writable && data != sink->scratch &&
+      !gst_dtapi_carousel_needs_fill (sink->carousel, data, size, packet_size,
+                                      offset, rate))
+    return data;
+
+  /* What's in the FIFO goes out before this does */
+  utc_us = g_get_real_time () + (gint64) fifo_load * 8 * G_USEC_PER_SEC / rate;
+
+  out = gst_dtapi_sink_writable (sink, data, size, writable);
+  gst_dtapi_carousel_fill (sink->carousel, out, size, packet_size, offset,
+                           rate, utc_us);
+  return out;
+}
+
+/* pcr-restamp: returns data with its PCRs rewritten for when they will go
+   out, which is the scratch buffer, copying data there first if it isn't
+   already and isn't writable.  Call with channel_lock held, before the data
+   is written. */
+static const guint8 *
+gst_dtapi_sink_restamp_pcrs (GstDTAPISink * sink, const guint8 * data,
+    gsize size, gboolean writable)
+{
+  gboolean restamp, underflow;
+  guint64 offset;
+  int rate, tx_mode;
+  guint8 *out;
+
+  GST_OBJECT_LOCK (sink);
+  restamp = sink->pcr_restamp;
+  rate = sink->ts_rate_cache;
+  tx_mode = sink->tx_mode;
+  offset = sink->bytes_written;
+  /* If the FIFO has run dry the modulator has been filling in and our
+     bytes no longer go out where we think */
+  underflow = sink->bytes_written > 0 && sink->fifo_load == 0;
+  GST_OBJECT_UNLOCK (sink);
+
+  if (!restamp) {
+    if (sink->restamp) {
+      gst_dtapi_pcr_restamp_free (sink->restamp);
+      sink->restamp = NULL;
+    }
+    return data;
+  }
+
+  if (!sink->restamp) {
+    if (tx_mode == DTAPI_TXMODE_RAW) {
+      GST_WARNING_OBJECT (sink, "Can't restamp PCRs with tx-mode RAW");
+      GST_OBJECT_LOCK (sink);
+      sink->pcr_restamp = FALSE;
+      GST_OBJECT_UNLOCK (sink);
+      return data;
+    }
+    sink->restamp = gst_dtapi_pcr_restamp_new (
+        gst_dtapi_sink_packet_size (tx_mode));
+  } else if (underflow) {
+    GST_DEBUG_OBJECT (sink, "FIFO underflowed, PCRs start again");
+    gst_dtapi_pcr_restamp_discont (sink->restamp);
+  }
+
+  out = gst_dtapi_sink_writable (sink, data, size, writable);
+  if (gst_dtapi_pcr_restamp_process (sink->restamp, out, size, offset,
+                                     rate) > 0) {
+    GST_OBJECT_LOCK (sink);
+    gst_dtapi_pcr_restamp_get_stats (sink->restamp, &sink->pcr_stats);
+    GST_OBJECT_UNLOCK (sink);
+  }
+  return out;
+}
+
+static void
+gst_dtapi_sink_add_bitrate (guint pid, guint64 bps, gpointer user_data)
+{
+  gchar name[16];
+
+  g_snprintf (name, sizeof (name), "pid-%u", pid);
+  gst_structure_set ((GstStructure *) user_data, name, G_TYPE_UINT64, bps,
+                     NULL);
+}
+
+/* Runs the TR 101 290 checks over data on its way to Write, in place.  Once
+   a second of stream has gone by the results go out on the bus. */
+static void
+gst_dtapi_sink_monitor (GstDTAPISink * sink, const guint8 * data, gsize size)
+{
+  GstDTAPIMonitorCounts counts;
+  GstStructure *bitrates;
+  int rate, tx_mode;
+  gboolean monitor;
+
+  GST_OBJECT_LOCK (sink);
+  monitor = sink->monitor;
+  rate = sink->ts_rate_cache;
+  tx_mode = sink->tx_mode;
+  GST_OBJECT_UNLOCK (sink);
+
+  if (!monitor) {
+    if (sink->mon) {
+      gst_dtapi_monitor_free (sink->mon);
+      sink->mon = NULL;
+    }
+    return;
+  }
+
+  if (!sink->mon) {
+    if (tx_mode == DTAPI_TXMODE_RAW) {
+      GST_WARNING_OBJECT (sink, "Can't monitor with tx-mode RAW");
+      GST_OBJECT_LOCK (sink);
+      sink->monitor = FALSE;
+      GST_OBJECT_UNLOCK (sink);
+      return;
+    }
+    sink->mon = gst_dtapi_monitor_new (gst_dtapi_sink_packet_size (tx_mode));
+  }
+
+  if (!gst_dtapi_monitor_process (sink->mon, data, size, rate))
+    return;
+
+  gst_dtapi_monitor_get_counts (sink->mon, &counts);
+  bitrates = gst_structure_new_empty ("bitrates");
+  gst_dtapi_monitor_foreach_bitrate (sink->mon, gst_dtapi_sink_add_bitrate,
+                                     bitrates);
+  gst_element_post_message (GST_ELEMENT (sink),
+      gst_message_new_element (GST_OBJECT (sink),
+          gst_structure_new ("dtapisink-tr101290",
+              "packets", G_TYPE_UINT64, counts.packets,
+              "sync-loss", G_TYPE_UINT64, counts.sync_loss,
+              "sync-byte-error", G_TYPE_UINT64, counts.sync_byte_error,
+              "pat-error", G_TYPE_UINT64, counts.pat_error,
+              "continuity-count-error", G_TYPE_UINT64, counts.cc_error,
+              "pmt-error", G_TYPE_UINT64, counts.pmt_error,
+              "pid-error", G_TYPE_UINT64, counts.pid_error,
+              "bitrates", GST_TYPE_STRUCTURE, bitrates, NULL)));
+  gst_structure_free (bitrates);
+}
+
+/* Called by write in place of writing while the device is lost.  Tries to
+   attach again every RECOVERY_RETRY_US and meanwhile throws away size bytes
+   of input in the time they would have taken to air, so upstream carries on
+   at the TS rate and the outage leaves a gap rather than a backlog that
+   would add to our latency from then on.  Sets *recovered once the channel
+   is back and configured, in which case the caller can go ahead and write.
+   Must be called with channel_lock held. */
+static GstFlowReturn
+gst_dtapi_sink_recover (GstDTAPISink * sink, gsize size, gboolean * recovered)
+{
+  gint64 now = g_get_monotonic_time (), wait_until;
+  GstClockTime outage;
+  guint timeout;
+  int rate;
+  gchar *error;
+  gboolean configured, cancelled;
+
+  *recovered = FALSE;
+
+  GST_OBJECT_LOCK (sink);
+  timeout = sink->recovery_timeout;
+  rate = sink->ts_rate_cache;
+  GST_OBJECT_UNLOCK (sink);
+
+  if (sink->outage_start == 0) {
+    if (timeout == 0) {
+      GST_ELEMENT_ERROR (sink, RESOURCE, WRITE, (NULL),
+        ("Lost the device"));
+      return GST_FLOW_ERROR;
+    }
+    GST_WARNING_OBJECT (sink, "Lost the device, trying to get it back");
+    sink->outage_start = now;
+    sink->outage_next_attach = now;
+    sink->outage_attempts = 0;
+    gst_element_post_message (GST_ELEMENT (sink),
+        gst_message_new_element (GST_OBJECT (sink),
+            gst_structure_new_empty ("dtapisink-outage")));
+  }
+
+  if (now >= sink->outage_next_attach) {
+    /* Whatever state it was left in we start again from scratch */
+    g_mutex_lock (&sink->attach_lock);
+    sink->TsOut->Detach (DTAPI_INSTANT_DETACH);
+    g_atomic_int_set (&sink->transmitting, FALSE);
+    sink->Dvc->Detach ();
+    sink->outage_attempts++;
+    error = gst_dtapi_attach (sink->Dvc, sink->TsOut, 0, 215, 1);
+    configured = error == NULL && gst_dtapi_sink_configure (sink);
+    g_mutex_unlock (&sink->attach_lock);
+    if (configured) {
+      outage = (g_get_monotonic_time () - sink->outage_start) * GST_USECOND;
+      GST_INFO_OBJECT (sink, "Got the device back after %" GST_TIME_FORMAT
+          " and %u attempts", GST_TIME_ARGS (outage), sink->outage_attempts);
+      GST_OBJECT_LOCK (sink);
+      sink->outages++;
+      sink->outage_total += outage;
+      sink->outage_max = MAX (sink->outage_max, outage);
+      GST_OBJECT_UNLOCK (sink);
+      gst_element_post_message (GST_ELEMENT (sink),
+          gst_message_new_element (GST_OBJECT (sink),
+              gst_structure_new ("dtapisink-recovered",
+                  "duration", G_TYPE_UINT64, outage,
+                  "attempts", G_TYPE_UINT, sink->outage_attempts, NULL)));
+
+      /* What was in flight is gone, so the first packet we had kept back
+         for and the PCRs' positions in the output no longer follow on */
+      sink->pid_filter.partial_len = 0;
+      if (sink->restamp)
+        gst_dtapi_pcr_restamp_discont (sink->restamp);
+      sink->outage_start = 0;
+      *recovered = TRUE;
+      return GST_FLOW_OK;
+    }
+    GST_DEBUG_OBJECT (sink, "Attaching again failed: %s",
+        error ? error : "lost the device again");
+    g_free (error);
+    sink->outage_next_attach = now + RECOVERY_RETRY_US;
+  }
+
+  if (now - sink->outage_start > (gint64) timeout * G_USEC_PER_SEC) {
+    GST_ELEMENT_ERROR (sink, RESOURCE, WRITE, (NULL),
+      ("Lost the device and couldn't get it back within %u s", timeout));
+    return GST_FLOW_ERROR;
+  }
+
+  wait_until = now + (gint64) size * 8 * G_USEC_PER_SEC / MAX (rate, 1);
+  g_mutex_lock (&sink->drain_lock);
+  while (!sink->drain_cancelled &&
+         g_cond_wait_until (&sink->drain_cond, &sink->drain_lock,
+                            wait_until));
+  cancelled = sink->drain_cancelled;
+  g_mutex_unlock (&sink->drain_lock);
+  return cancelled ? GST_FLOW_FLUSHING : GST_FLOW_OK;
 }
 
-#ifdef DTAPI_DEBUG
-/* Just for debugging: Print all the properties according to DTAPI */
+/* Copies what has just been written to the mirror files.  Must be called
+   with channel_lock held. */
 static void
-gst_dtapi_sink_print_props (GstDTAPISink * sink)
+gst_dtapi_sink_mirror (GstDTAPISink * sink, const guint8 * data, gsize size)
 {
-  int result, ts_rate_bps, tx_mode, stuff_mode, lock_status,
-      output_power, mod_type, code_rate, mod_param, par_xtra_2;
-  int64_t frequency;
-  void* p_xtra_pars;
-  CHECK(sink->TsOut->GetTsRateBps(ts_rate_bps),
-        "Failed to get TS rate: %s");
-  CHECK(sink->TsOut->GetTxMode(tx_mode, stuff_mode),
-        "Failed to get TxMode: %s");
-  CHECK(sink->TsOut->GetRfControl(frequency, lock_status),
-        "Failed to get frequency: %s");
-  CHECK(sink->TsOut->GetOutputLevel(output_power),
-        "Failed to get output power: %s");
-  CHECK(sink->TsOut->GetModControl(mod_type, code_rate,
-                                   mod_param, par_xtra_2, p_xtra_pars),
-        "Failed to get modulation parameters: %s");
-  printf("ts_rate_bps: %i\ntx_mode: %i\nstuff_mode: %i\nlock_status: %i\n"
-         "output_power: %i\nmod_type: %i\ncode_rate: %i\nmod_param: %i\n"
-         "par_xtra_2: %i\nfrequency: %lld\n", ts_rate_bps, tx_mode, stuff_mode,
-         lock_status, output_power, mod_type, code_rate, mod_param, par_xtra_2,
-         frequency);
+  gchar *error = NULL;
+
+  if (G_LIKELY (sink->mirror == NULL) || sink->mirror_failed)
+    return;
+
+  if (!gst_dtapi_mirror_write (sink->mirror, data, size, &error)) {
+    GST_ELEMENT_WARNING (sink, RESOURCE, WRITE, (NULL),
+      ("Not mirroring any more: %s", error));
+    g_free (error);
+    sink->mirror_failed = TRUE;
+  }
 }
-#endif /* DTAPI_DEBUG */
 
-static gboolean
-gst_dtapi_sink_start (GstBaseSink * base_sink)
+/* Mirrors data that has just been written to the FIFO and accounts for it
+   in bytes_written and the FIFO cache.  Must be called with channel_lock
+   held. */
+static void
+gst_dtapi_sink_written (GstDTAPISink * sink, const guint8 * data, gsize size)
+{
+  int fifo_load;
+
+  gst_dtapi_sink_mirror (sink, data, size);
+  /* The one extra call per buffer that keeps queries cheap */
+  if (sink->TsOut->GetFifoLoad(fifo_load) == DTAPI_OK)
+    gst_dtapi_sink_update_fifo_cache (sink, size, fifo_load);
+}
+
+/* Writes data to the modulator, filtering PIDs, inserting SI, restamping
+   PCRs and monitoring on the way as all of those depend on when it goes
+   out.  If writable is TRUE those are done to data in place rather than to
+   a copy.  Must be called with channel_lock held. */
+static DTAPI_RESULT
+gst_dtapi_sink_write_out (GstDTAPISink * sink, const guint8 * data,
+    gsize size, gboolean writable)
 {
   DTAPI_RESULT result;
-  GstDTAPISink *sink = GST_DTAPI_SINK (base_sink);
 
-  sink->Dvc = new DtDevice();
-  sink->TsOut = new DtOutpChannel();
+  data = gst_dtapi_sink_filter_pids (sink, data, &size, writable);
+  if (size == 0)
+    return DTAPI_OK;
 
-  /* Attach device and output channel objects to hardware */
-  if (sink->Dvc->AttachToType(215) != DTAPI_OK) {
-    GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, (NULL),
-      ("No DTU-215 in system"));
-    return FALSE;
-  }
-  if (sink->TsOut->AttachToPort(sink->Dvc, 1) != DTAPI_OK) {
-    /* TODO: Decide what the right type of error code to use here: */
-    GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, (NULL),
-      ("Can't attach output channel."));
-    return FALSE;
+  data = gst_dtapi_sink_send_si (sink, data, size, writable);
+  data = gst_dtapi_sink_restamp_pcrs (sink, data, size, writable);
+  gst_dtapi_sink_monitor (sink, data, size);
+  if ((result = sink->TsOut->Write((char*) data, size)) != DTAPI_OK)
+    return result;
+  gst_dtapi_sink_written (sink, data, size);
+  return DTAPI_OK;
+}
+
+/* Returns the delay line, first making it match the delay property if
+   that has changed, or NULL if we're live.  The existing line is used if
+   it has room, otherwise the one gst_dtapi_sink_prepare_delay built. */
+static GstDTAPIDelay *
+gst_dtapi_sink_delay_line (GstDTAPISink * sink)
+{
+  GstDTAPIDelay *next;
+  guint delay_ms;
+  gsize hold;
+
+  if (G_LIKELY (!g_atomic_int_get (&sink->delay_changed)))
+    return sink->delay_line;
+
+  GST_OBJECT_LOCK (sink);
+  if (sink->delay_preparing > 0) {
+    /* The new delay may need the line being built, which sets
+       delay_changed again once it's ready */
+    GST_OBJECT_UNLOCK (sink);
+    return sink->delay_line;
   }
+  delay_ms = sink->delay_ms;
+  hold = gst_dtapi_sink_delay_hold (sink);
+  next = sink->delay_next;
+  sink->delay_next = NULL;
+  g_atomic_int_set (&sink->delay_changed, FALSE);
+  GST_OBJECT_UNLOCK (sink);
 
-  /* Initialise bit rate and packet mode */
-  CHECK(sink->TsOut->SetTxMode(sink->tx_mode, sink->stuff_mode),
-        "Failed to set TxMode: %s");
-  /* FIXME: Setting the TS rate has no effect, it seems to be purely detemined
-     by the other parameters and I can't seem to work out how to apply
-     stuffing to e.g. bulk out a 18Mb/s stream into a 24Mb/s one. */
-  CHECK(sink->TsOut->SetTsRateBps(sink->ts_rate_bps),
-        "Failed to set TS rate: %s");
-  CHECK(sink->TsOut->SetRfMode(sink->rf_mode),
-        "Failed to set RF mode");
-  CHECK(sink->TsOut->SetRfControl(sink->frequency),
-        "Failed to set frequency: %s");
-  CHECK(sink->TsOut->SetOutputLevel(sink->output_power * 10),
-        "Failed to set output power: %s");
-  CHECK(sink->TsOut->SetModControl(DTAPI_MOD_DVBT, sink->code_rate,
-                                   sink->mod_param, -1),
-        "Failed to set modulation parameters: %s");
-
-  CHECK(sink->TsOut->SetTxControl(DTAPI_TXCTRL_HOLD),
-        "Entering state HOLD failed: %s");
+  if (hold == 0) {
+    if (sink->delay_line) {
+      GST_INFO_OBJECT (sink, "Cutting over to live");
+      gst_dtapi_delay_free (sink->delay_line);
+      sink->delay_line = NULL;
+    }
+  } else if (sink->delay_line == NULL ||
+             !gst_dtapi_delay_set_hold (sink->delay_line, hold)) {
+    /* Too small: whatever it was holding is lost */
+    if (sink->delay_line)
+      gst_dtapi_delay_free (sink->delay_line);
+    sink->delay_line = NULL;
+    if (next && gst_dtapi_delay_set_hold (next, hold)) {
+      sink->delay_line = next;
+      next = NULL;
+    } else {
+      /* gst_dtapi_sink_prepare_delay couldn't make one, and has said why */
+      GST_WARNING_OBJECT (sink, "No delay line for %u ms, staying live",
+          delay_ms);
+    }
+  }
+  if (next)
+    gst_dtapi_delay_free (next);
 
-  gst_dtapi_sink_update_prop_cache(sink);
+  GST_OBJECT_LOCK (sink);
+  sink->delay_max_hold = sink->delay_line ?
+      gst_dtapi_delay_get_max_hold (sink->delay_line) : 0;
+  sink->delay_fill = sink->delay_line ?
+      gst_dtapi_delay_get_fill (sink->delay_line) : 0;
+  GST_OBJECT_UNLOCK (sink);
 
-  return TRUE;
+  return sink->delay_line;
 }
 
-#ifdef DTAPI_DEBUG
-/* Just used for debugging in conjunction with DtOutpChannel::GetFlags */
-static void
-print_flags(int flags)
+/* Puts data into the delay line and writes out whatever has been in there
+   long enough, straight from the file's pages.  Returns FALSE if the delay
+   line failed, which has been reported, otherwise how writing went is in
+   result.  Must be called with channel_lock held. */
+static gboolean
+gst_dtapi_sink_write_delayed (GstDTAPISink * sink, GstDTAPIDelay * delay,
+    const guint8 * data, gsize size, DTAPI_RESULT * result)
 {
-  if (flags & DTAPI_TX_FIFO_UFL)
-    printf("DTAPI_TX_FIFO_UFL, ");
-  if (flags & DTAPI_TX_MUX_OVF)
-    printf("DTAPI_TX_MUX_OVF, ");
-  if (flags & DTAPI_TX_READBACK_ERR)
-    printf("DTAPI_TX_READBACK_ERR, ");
-  if (flags & DTAPI_TX_SYNC_ERR)
-    printf("DTAPI_TX_SYNC_ERR, ");
-  if (flags & DTAPI_TX_TARGET_ERR)
-    printf("DTAPI_TX_TARGET_ERR, ");
-  if (flags & DTAPI_TX_LINK_ERR)
-    printf("DTAPI_TX_LINK_ERR, ");
-  if (flags & DTAPI_TX_DATA_ERR)
-    printf("DTAPI_TX_DATA_ERR, ");
-  
-  /* Check that we've printed everything: */
-  printf("%i\n", flags & ~(  DTAPI_TX_FIFO_UFL
-                           | DTAPI_TX_MUX_OVF | DTAPI_TX_READBACK_ERR
-                           | DTAPI_TX_SYNC_ERR | DTAPI_TX_TARGET_ERR
-                           | DTAPI_TX_LINK_ERR | DTAPI_TX_DATA_ERR ));
+  const guint8 *out;
+  gchar *error = NULL;
+  gssize n;
+  gsize len;
+
+  do {
+    if ((n = gst_dtapi_delay_write (delay, data, size, &error)) < 0) {
+      GST_ELEMENT_ERROR (sink, RESOURCE, WRITE, (NULL), ("%s", error));
+      g_free (error);
+      return FALSE;
+    }
+    data += n;
+    size -= n;
+    while ((len = gst_dtapi_delay_peek (delay, &out)) > 0) {
+      if ((*result = gst_dtapi_sink_write_out (sink, out, len, FALSE)) !=
+          DTAPI_OK)
+        return TRUE;
+      gst_dtapi_delay_consume (delay, len);
+    }
+  } while (size > 0);
+
+  *result = DTAPI_OK;
+  return TRUE;
 }
-#endif /* DTAPI_DEBUG */
 
+/* Writes one buffer's worth of data to the modulator, by way of the delay
+   line if there is one, and makes sure it's transmitting.  in_shared_list
+   says the buffer is in a list somebody else holds too, which before
+   GStreamer 1.16 gst_buffer_is_writable didn't take into account.  Must be
+   called with channel_lock held. */
 static GstFlowReturn
-gst_dtapi_sink_render (GstBaseSink *base_sink, GstBuffer *buffer)
+gst_dtapi_sink_write (GstDTAPISink * sink, GstBuffer * buffer,
+    gboolean in_shared_list)
 {
-  GstDTAPISink *sink = GST_DTAPI_SINK (base_sink);
   DTAPI_RESULT result;
+  GstFlowReturn ret;
+  GstMapInfo map;
+  GstDTAPIDelay *delay;
+  gsize size;
+  gboolean recovered, writable, delayed;
 
-  static size_t total_bytes_rendered = 0;
-  total_bytes_rendered += GST_BUFFER_SIZE(buffer);
+  if (G_UNLIKELY (sink->channel_lost)) {
+    ret = gst_dtapi_sink_recover (sink, gst_buffer_get_size (buffer),
+                                  &recovered);
+    if (!recovered)
+      return ret;
+  }
+
+  /* If nobody else has the buffer we can filter, insert SI and restamp in
+     it rather than in a copy.  The delay line takes a copy anyway.  With
+     enable-last-sample, basesink's default, basesink has a ref to it, so
+     this is only for pipelines that turn that off. */
+  delay = gst_dtapi_sink_delay_line (sink);
+  writable = delay == NULL && !in_shared_list &&
+      gst_buffer_is_writable (buffer);
 
-  if ((result = sink->TsOut->Write((char*) GST_BUFFER_DATA(buffer), GST_BUFFER_SIZE(buffer))) != DTAPI_OK) {
+  /* Buffers from our own pool are a single block of suitably aligned memory
+     so this doesn't copy */
+  if (!gst_buffer_map (buffer, &map, writable ? GST_MAP_READWRITE :
+                                                GST_MAP_READ)) {
+    GST_ELEMENT_ERROR (sink, RESOURCE, WRITE, (NULL),
+      ("Failed to map buffer"));
+    return GST_FLOW_ERROR;
+  }
+  size = map.size;
+  if (delay == NULL)
+    result = gst_dtapi_sink_write_out (sink, map.data, size, writable);
+  else {
+    delayed = gst_dtapi_sink_write_delayed (sink, delay, map.data, size,
+                                            &result);
+    GST_OBJECT_LOCK (sink);
+    sink->delay_fill = gst_dtapi_delay_get_fill (delay);
+    GST_OBJECT_UNLOCK (sink);
+    if (!delayed) {
+      gst_buffer_unmap (buffer, &map);
+      return GST_FLOW_ERROR;
+    }
+  }
+  gst_buffer_unmap (buffer, &map);
+  if (result != DTAPI_OK && gst_dtapi_result_is_transient (result)) {
+    GST_WARNING_OBJECT (sink, "Writing data failed: %s",
+        gst_dtapi_result_to_string(result));
+    sink->channel_lost = TRUE;
+    return gst_dtapi_sink_recover (sink, size, &recovered);
+  } else if (result != DTAPI_OK) {
     GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, (NULL),
-      ("Writing data failed: %s", result_to_string(result)));
+      ("Writing data failed: %s", gst_dtapi_result_to_string(result)));
     return GST_FLOW_ERROR;
   }
 
 #ifdef DTAPI_DEBUG
+  static size_t total_bytes_rendered = 0;
+  total_bytes_rendered += size;
+
   int out;
   CHECK(sink->TsOut->GetTxControl(out), "GetTxControl failed: %s");
   switch (out) {
@@ -957,24 +3595,30 @@ gst_dtapi_sink_render (GstBaseSink *base_sink, GstBuffer *buffer)
     printf("Sending... ");
     break;
   };
-  printf("Writing %iB, total %uB\n", GST_BUFFER_SIZE(buffer), total_bytes_rendered);
+  printf("Writing %" G_GSIZE_FORMAT "B, total %" G_GSIZE_FORMAT "B\n",
+         size, total_bytes_rendered);
 #endif /* DTAPI_DEBUG */
   /* Start transmission (if not already started) */
-  result = sink->TsOut->SetTxControl(DTAPI_TXCTRL_SEND);
+  result = gst_dtapi_sink_set_tx_control (sink, DTAPI_TXCTRL_SEND);
   /* If we haven't loaded enough it's not an error.
      TODO: work out how to load up in preroll */
-  if (result != DTAPI_OK && result != DTAPI_E_INSUF_LOAD) {
+  if (gst_dtapi_result_is_transient (result)) {
+    GST_WARNING_OBJECT (sink, "Enabling outputs failed: %s",
+        gst_dtapi_result_to_string(result));
+    sink->channel_lost = TRUE;
+    return GST_FLOW_OK;
+  } else if (result != DTAPI_OK && result != DTAPI_E_INSUF_LOAD) {
     GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, (NULL),
-      ("Enabling outputs failed: %s", result_to_string(result)));
+      ("Enabling outputs failed: %s", gst_dtapi_result_to_string(result)));
     return GST_FLOW_ERROR;
   };
 
+#ifdef DTAPI_DEBUG
   int status, latched, fifosize, fifoload;
   CHECK(sink->TsOut->GetFlags(status, latched), "Getting flags failed: %s");
   CHECK(sink->TsOut->GetFifoLoad(fifoload), "Getting fifo load failed: %s");
   CHECK(sink->TsOut->GetFifoSize(fifosize), "Getting fifo size failed: %s");
 
-#ifdef DTAPI_DEBUG
   printf("State: ");
   print_flags(status);
   printf("Latched: ");
@@ -987,25 +3631,568 @@ gst_dtapi_sink_render (GstBaseSink *base_sink, GstBuffer *buffer)
   return GST_FLOW_OK;
 }
 
+/* Multi-PLP: PLP 0's data goes to its ring for the feeder thread to write.
+   in_shared_list is as for gst_dtapi_sink_write. */
+static GstFlowReturn
+gst_dtapi_sink_write_plp0 (GstDTAPISink * sink, GstBuffer * buffer,
+    gboolean in_shared_list)
+{
+  GstMapInfo map;
+  const guint8 *data;
+  gsize size;
+  gboolean ok, writable = !in_shared_list && gst_buffer_is_writable (buffer);
+
+  if (!gst_buffer_map (buffer, &map, writable ? GST_MAP_READWRITE :
+                                                GST_MAP_READ)) {
+    GST_ELEMENT_ERROR (sink, RESOURCE, WRITE, (NULL),
+      ("Failed to map buffer"));
+    return GST_FLOW_ERROR;
+  }
+  size = map.size;
+  data = gst_dtapi_sink_filter_pids (sink, map.data, &size, writable);
+  gst_dtapi_sink_monitor (sink, data, size);
+  ok = gst_dtapi_ring_write (sink->plp_rings[0], data, size);
+  gst_buffer_unmap (buffer, &map);
+  return ok ? GST_FLOW_OK : GST_FLOW_FLUSHING;
+}
+
+/* Records where the end of a buffer we've just rendered falls in the
+   segment */
+static void
+gst_dtapi_sink_update_position (GstDTAPISink * sink, GstBuffer * buffer)
+{
+  GstSegment *segment = &GST_BASE_SINK (sink)->segment;
+  GstClockTime end = GST_BUFFER_PTS (buffer);
+
+  if (!GST_CLOCK_TIME_IS_VALID (end))
+    return;
+  if (GST_BUFFER_DURATION_IS_VALID (buffer))
+    end += GST_BUFFER_DURATION (buffer);
+
+  GST_OBJECT_LOCK (sink);
+  if (segment->format == GST_FORMAT_TIME) {
+    sink->last_position = gst_segment_to_stream_time (segment,
+        GST_FORMAT_TIME, end);
+    sink->last_running_time = gst_segment_to_running_time (segment,
+        GST_FORMAT_TIME, end);
+  }
+  GST_OBJECT_UNLOCK (sink);
+}
+
+static GstFlowReturn
+gst_dtapi_sink_render (GstBaseSink *base_sink, GstBuffer *buffer)
+{
+  GstDTAPISink *sink = GST_DTAPI_SINK (base_sink);
+  GstFlowReturn ret;
+
+  gst_dtapi_sink_apply_scheduling (sink, &sink->sched);
+
+  /* With multiple PLPs the feeder thread does the writing */
+  if (sink->plp_feeder)
+    ret = gst_dtapi_sink_write_plp0 (sink, buffer, FALSE);
+  else {
+    /* Settings changed while we were blocked in the last Write */
+    g_mutex_lock (&sink->channel_lock);
+    gst_dtapi_sink_apply_pending (sink);
+    ret = gst_dtapi_sink_write (sink, buffer, FALSE);
+    g_mutex_unlock (&sink->channel_lock);
+  }
+
+  if (ret == GST_FLOW_OK) {
+    gst_dtapi_sink_update_position (sink, buffer);
+    gst_dtapi_sink_do_qos (sink);
+  }
+  return ret;
+}
+
+/* As render but only takes channel_lock and applies pending settings once
+   for the whole list */
+static GstFlowReturn
+gst_dtapi_sink_render_list (GstBaseSink *base_sink, GstBufferList *list)
+{
+  GstDTAPISink *sink = GST_DTAPI_SINK (base_sink);
+  GstFlowReturn ret = GST_FLOW_OK;
+  guint i, len = gst_buffer_list_length (list);
+  gboolean shared = !gst_buffer_list_is_writable (list);
+
+  gst_dtapi_sink_apply_scheduling (sink, &sink->sched);
+
+  if (sink->plp_feeder) {
+    for (i = 0; i < len && ret == GST_FLOW_OK; i++)
+      ret = gst_dtapi_sink_write_plp0 (sink, gst_buffer_list_get (list, i),
+                                       shared);
+  } else {
+    g_mutex_lock (&sink->channel_lock);
+    gst_dtapi_sink_apply_pending (sink);
+    for (i = 0; i < len && ret == GST_FLOW_OK; i++)
+      ret = gst_dtapi_sink_write (sink, gst_buffer_list_get (list, i),
+                                  shared);
+    g_mutex_unlock (&sink->channel_lock);
+  }
+
+  if (ret == GST_FLOW_OK && len > 0) {
+    gst_dtapi_sink_update_position (sink, gst_buffer_list_get (list, len - 1));
+    gst_dtapi_sink_do_qos (sink);
+  }
+  return ret;
+}
+
+/* Offer upstream buffers that DTAPI can take as they are: 32-bit aligned and
+   a whole number of packets long */
+static gboolean
+gst_dtapi_sink_propose_allocation (GstBaseSink * base_sink, GstQuery * query)
+{
+  GstCaps *caps;
+  gboolean need_pool;
+  GstBufferPool *pool = NULL;
+  GstAllocationParams params;
+
+  gst_query_parse_allocation (query, &caps, &need_pool);
+
+  gst_allocation_params_init (&params);
+  params.align = POOL_ALIGN - 1;
+
+  if (need_pool) {
+    GstStructure *config;
+
+    pool = gst_buffer_pool_new ();
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_set_params (config, caps, POOL_BUFFER_SIZE, 0, 0);
+    gst_buffer_pool_config_set_allocator (config, NULL, &params);
+    if (!gst_buffer_pool_set_config (pool, config)) {
+      gst_object_unref (pool);
+      return FALSE;
+    }
+  }
+
+  gst_query_add_allocation_pool (query, pool, POOL_BUFFER_SIZE, 0, 0);
+  gst_query_add_allocation_param (query, NULL, &params);
+  if (pool)
+    gst_object_unref (pool);
+
+  return TRUE;
+}
+
+/* Writes at least len bytes of null packets.  Returns FALSE on error or if
+   we were flushed part way through. */
+static gboolean
+gst_dtapi_sink_write_stuffing (GstDTAPISink * sink, int packet_size,
+    gint64 len)
+{
+  DTAPI_RESULT result;
+  int chunk_len = packet_size * STUFFING_CHUNK_PACKETS;
+  guint8 *chunk = (guint8 *) g_malloc0 (chunk_len);
+  /* M2TS style 192 byte packets have a 4 byte timestamp in front */
+  int header = packet_size == 192 ? 4 : 0;
+  gboolean ok = TRUE;
+  int i;
+
+  /* Anything after the first 188 bytes of a 204 byte packet is a dummy
+     Reed-Solomon parity field the modulator fills in */
+  for (i = header; i < chunk_len; i += packet_size) {
+    memset (chunk + i, 0xff, TS_PACKET_SIZE);
+    chunk[i] = 0x47;
+    chunk[i + 1] = 0x1f;
+    chunk[i + 3] = 0x10;
+  }
+
+  while (len > 0 && ok) {
+    int n = (int) MIN (len + packet_size - 1, (gint64) chunk_len);
+    n -= n % packet_size;
+
+    if (sink->plp_feeder)
+      ok = gst_dtapi_ring_write (sink->plp_rings[0], chunk, n);
+    else {
+      g_mutex_lock (&sink->channel_lock);
+      result = sink->TsOut->Write((char*) chunk, n);
+      /* As render, so we can't block on a full FIFO that isn't draining */
+      if (result == DTAPI_OK) {
+        gst_dtapi_sink_written (sink, chunk, n);
+        gst_dtapi_sink_set_tx_control (sink, DTAPI_TXCTRL_SEND);
+      }
+      g_mutex_unlock (&sink->channel_lock);
+      if (result != DTAPI_OK) {
+        GST_WARNING_OBJECT (sink, "Writing stuffing failed: %s",
+            gst_dtapi_result_to_string(result));
+        ok = FALSE;
+      }
+    }
+    len -= n;
+  }
+
+  g_free (chunk);
+  return ok;
+}
+
+/* Bytes written to the sink that have yet to be transmitted */
+static gboolean
+gst_dtapi_sink_backlog (GstDTAPISink * sink, gint64 * backlog)
+{
+  DTAPI_RESULT result = DTAPI_OK;
+  int plp, load;
+
+  *backlog = 0;
+  g_mutex_lock (&sink->channel_lock);
+  if (sink->plp_feeder) {
+    for (plp = 0; plp < sink->mod.t2_num_plps && result == DTAPI_OK; plp++) {
+      *backlog += gst_dtapi_ring_fill (sink->plp_rings[plp]);
+      if ((result = sink->TsOut->GetFifoLoad(load, plp)) == DTAPI_OK)
+        *backlog += load;
+    }
+  } else if ((result = sink->TsOut->GetFifoLoad(load)) == DTAPI_OK)
+    *backlog = load;
+  g_mutex_unlock (&sink->channel_lock);
+
+  if (result != DTAPI_OK) {
+    GST_WARNING_OBJECT (sink, "Getting fifo load failed: %s",
+        gst_dtapi_result_to_string(result));
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/* A short stream might never have loaded the FIFO enough for us to start
+   transmitting, in which case nothing will drain until we top it up */
+static void
+gst_dtapi_sink_ensure_sending (GstDTAPISink * sink, int packet_size)
+{
+  DTAPI_RESULT result;
+  int fifo_size, topped_up = 0;
+
+  if (sink->plp_feeder)
+    return;  /* The feeder sends as soon as it can */
+
+  g_mutex_lock (&sink->channel_lock);
+  result = sink->TsOut->GetFifoSize(fifo_size);
+  g_mutex_unlock (&sink->channel_lock);
+  if (result != DTAPI_OK)
+    return;
+
+  for (;;) {
+    g_mutex_lock (&sink->channel_lock);
+    result = gst_dtapi_sink_set_tx_control (sink, DTAPI_TXCTRL_SEND);
+    g_mutex_unlock (&sink->channel_lock);
+    if (result != DTAPI_E_INSUF_LOAD || topped_up >= fifo_size)
+      break;
+    if (!gst_dtapi_sink_write_stuffing (sink, packet_size,
+                                        packet_size * STUFFING_CHUNK_PACKETS))
+      break;
+    topped_up += packet_size * STUFFING_CHUNK_PACKETS;
+  }
+}
+
+/* At EOS whatever the delay line is holding back is written out, however
+   long that takes to air, in chunks so that unlock can get in between.
+   Returns FALSE if interrupted by unlock. */
+static gboolean
+gst_dtapi_sink_release_delay (GstDTAPISink * sink)
+{
+  DTAPI_RESULT result = DTAPI_OK;
+  const guint8 *data;
+  gchar *error = NULL;
+  gboolean cancelled = FALSE;
+  gsize len;
+
+  if (sink->delay_line == NULL)
+    return TRUE;
+
+  if (!gst_dtapi_delay_release (sink->delay_line, &error)) {
+    GST_WARNING_OBJECT (sink, "Some of the delay has been lost: %s", error);
+    g_free (error);
+  }
+
+  while (!cancelled && result == DTAPI_OK &&
+         (len = gst_dtapi_delay_peek (sink->delay_line, &data)) > 0) {
+    len = MIN (len, BUFSIZE);
+    g_mutex_lock (&sink->channel_lock);
+    result = gst_dtapi_sink_write_out (sink, data, len, FALSE);
+    if (result == DTAPI_OK) {
+      /* It may never have started if the delay is longer than the stream */
+      result = gst_dtapi_sink_set_tx_control (sink, DTAPI_TXCTRL_SEND);
+      if (result == DTAPI_E_INSUF_LOAD)
+        result = DTAPI_OK;
+    }
+    g_mutex_unlock (&sink->channel_lock);
+    gst_dtapi_delay_consume (sink->delay_line, len);
+
+    g_mutex_lock (&sink->drain_lock);
+    cancelled = sink->drain_cancelled;
+    g_mutex_unlock (&sink->drain_lock);
+  }
+
+  if (result != DTAPI_OK)
+    GST_WARNING_OBJECT (sink, "Writing out the delay failed: %s",
+        gst_dtapi_result_to_string(result));
+  gst_dtapi_delay_clear (sink->delay_line);
+  GST_OBJECT_LOCK (sink);
+  sink->delay_fill = 0;
+  GST_OBJECT_UNLOCK (sink);
+  return !cancelled;
+}
+
+/* Waits until everything we've been given has been transmitted.  Rather than
+   polling we sleep for as long as the backlog should take to air at the TS
+   rate.  Returns FALSE if interrupted by unlock. */
+static gboolean
+gst_dtapi_sink_drain (GstDTAPISink * sink)
+{
+  gint64 backlog, last_backlog = -1, stall_start = 0, now, wait_us;
+  int rate, tx_mode, packet_size;
+  guint tail_ms;
+  gboolean cancelled;
+
+  GST_OBJECT_LOCK (sink);
+  rate = sink->ts_rate_cache;
+  tx_mode = sink->tx_mode;
+  tail_ms = sink->eos_tail_ms;
+  GST_OBJECT_UNLOCK (sink);
+
+  packet_size = gst_dtapi_sink_packet_size (tx_mode);
+  if (tail_ms > 0 && packet_size == 0)
+    GST_WARNING_OBJECT (sink, "Can't add a stuffing tail in this tx-mode");
+  else if (tail_ms > 0 &&
+           !gst_dtapi_sink_write_stuffing (sink, packet_size,
+               (gint64) rate / 8 * tail_ms / 1000 * packet_size /
+               TS_PACKET_SIZE))
+    return FALSE;
+  if (packet_size)
+    gst_dtapi_sink_ensure_sending (sink, packet_size);
+
+  for (;;) {
+    if (!gst_dtapi_sink_backlog (sink, &backlog) || backlog <= 0)
+      return TRUE;
+
+    now = g_get_monotonic_time ();
+    if (backlog != last_backlog) {
+      last_backlog = backlog;
+      stall_start = now;
+    } else if (now - stall_start > DRAIN_STALL_US) {
+      GST_WARNING_OBJECT (sink, "FIFO stuck with %" G_GINT64_FORMAT
+          " bytes in it, not waiting for it to drain", backlog);
+      return TRUE;
+    }
+
+    wait_us = backlog * 8 * G_USEC_PER_SEC / MAX (rate, 1);
+    wait_us = CLAMP (wait_us, DRAIN_MIN_WAIT_US, DRAIN_MAX_WAIT_US);
+
+    g_mutex_lock (&sink->drain_lock);
+    while (!sink->drain_cancelled &&
+           g_cond_wait_until (&sink->drain_cond, &sink->drain_lock,
+                              now + wait_us));
+    cancelled = sink->drain_cancelled;
+    g_mutex_unlock (&sink->drain_lock);
+    if (cancelled)
+      return FALSE;
+  }
+}
+
+static gboolean
+gst_dtapi_sink_event (GstBaseSink * base_sink, GstEvent * event)
+{
+  GstDTAPISink *sink = GST_DTAPI_SINK (base_sink);
+  gboolean drain_on_eos, drained;
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP) {
+    GST_OBJECT_LOCK (sink);
+    sink->last_position = GST_CLOCK_TIME_NONE;
+    sink->last_running_time = GST_CLOCK_TIME_NONE;
+    GST_OBJECT_UNLOCK (sink);
+  }
+
+  GST_OBJECT_LOCK (sink);
+  drain_on_eos = sink->drain_on_eos;
+  GST_OBJECT_UNLOCK (sink);
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_EOS) {
+    drained = gst_dtapi_sink_release_delay (sink) &&
+        (!drain_on_eos || gst_dtapi_sink_drain (sink));
+
+    /* There's nothing more to write, so the streaming thread goes back to
+       upstream as we found it.  We're on it, so it's still there.  The next
+       render after a flush applies the settings again. */
+    gst_dtapi_sink_restore_scheduling (sink, &sink->sched);
+
+    if (!drained) {
+      /* We're flushing or shutting down so there's no EOS to post */
+      gst_event_unref (event);
+      return FALSE;
+    }
+  }
+
+  return GST_BASE_SINK_CLASS (parent_class)->event (base_sink, event);
+}
+
+/* Everything written to the FIFO is delayed by however much is in front of
+   it.  In the steady state Write keeps the FIFO full so that's the minimum.
+   With multi-PLP there's the ring in front of that too. */
+static GstClockTime
+gst_dtapi_sink_fifo_latency (GstDTAPISink * sink)
+{
+  GstClockTime latency = GST_CLOCK_TIME_NONE, delay = 0;
+
+  GST_OBJECT_LOCK (sink);
+  if (sink->ts_rate_cache > 0 && sink->fifo_size > 0)
+    latency = gst_util_uint64_scale (sink->fifo_size, 8 * GST_SECOND,
+                                     sink->ts_rate_cache);
+  /* The streaming thread's delay_line is only there when this is set */
+  if (sink->delay_max_hold > 0)
+    delay = sink->delay_ms * GST_MSECOND;
+  GST_OBJECT_UNLOCK (sink);
+
+  if (GST_CLOCK_TIME_IS_VALID (latency) && sink->plp_feeder)
+    latency += PLP_RING_MS * GST_MSECOND;
+  else if (GST_CLOCK_TIME_IS_VALID (latency))
+    latency += delay;
+  return latency;
+}
+
+static gboolean
+gst_dtapi_sink_query (GstBaseSink * base_sink, GstQuery * query)
+{
+  GstDTAPISink *sink = GST_DTAPI_SINK (base_sink);
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_LATENCY: {
+      gboolean live, us_live;
+      GstClockTime min, max, fifo_latency;
+      int rate;
+
+      if (!gst_base_sink_query_latency (base_sink, &live, &us_live, &min,
+                                        &max))
+        return FALSE;
+      fifo_latency = gst_dtapi_sink_fifo_latency (sink);
+      GST_OBJECT_LOCK (sink);
+      rate = sink->ts_rate_cache;
+      GST_OBJECT_UNLOCK (sink);
+      if (GST_CLOCK_TIME_IS_VALID (fifo_latency)) {
+        min += fifo_latency;
+        if (GST_CLOCK_TIME_IS_VALID (max))
+          max += fifo_latency + gst_util_uint64_scale (
+              gst_base_sink_get_blocksize (base_sink), 8 * GST_SECOND,
+              MAX (rate, 1));
+      }
+      gst_query_set_latency (query, live, min, max);
+      return TRUE;
+    }
+    case GST_QUERY_POSITION: {
+      GstFormat format;
+      guint64 aired;
+      GstClockTime position, queued = 0;
+      int rate;
+
+      /* What has actually gone out over the air rather than what we've
+         been given: the end of the last buffer we rendered less however
+         long what's still in front of the antenna takes to go out at the
+         TS rate.  BYTES is everything aired since we started, whatever the
+         segment. */
+      gst_query_parse_position (query, &format, NULL);
+      GST_OBJECT_LOCK (sink);
+      aired = sink->bytes_written - MIN ((guint64) sink->fifo_load,
+                                         sink->bytes_written);
+      rate = sink->ts_rate_cache;
+      position = sink->last_position;
+      /* The delay line only holds back the whole delay once it has filled
+         up, so until then it's what it is holding */
+      if (rate > 0)
+        queued = gst_util_uint64_scale (sink->fifo_load, 8 * GST_SECOND,
+                                        rate) +
+            MIN (gst_util_uint64_scale (sink->delay_fill, 8 * GST_SECOND,
+                                        rate),
+                 sink->delay_ms * GST_MSECOND);
+      GST_OBJECT_UNLOCK (sink);
+
+      if (format == GST_FORMAT_BYTES) {
+        gst_query_set_position (query, format, aired);
+        return TRUE;
+      } else if (format == GST_FORMAT_TIME &&
+                 GST_CLOCK_TIME_IS_VALID (position) && rate > 0) {
+        gst_query_set_position (query, format,
+            position - MIN (queued, position));
+        return TRUE;
+      }
+      break;
+    }
+    default:
+      break;
+  }
+
+  return GST_BASE_SINK_CLASS (parent_class)->query (base_sink, query);
+}
+
 static gboolean
 gst_dtapi_sink_unlock (GstBaseSink *base_sink)
 {
   GstDTAPISink *sink = GST_DTAPI_SINK (base_sink);
-  return sink->TsOut->Reset(DTAPI_FIFO_RESET) == DTAPI_OK;
+  gboolean ret;
+
+  gst_dtapi_sink_set_plps_flushing (sink, TRUE);
+
+  g_mutex_lock (&sink->drain_lock);
+  sink->drain_cancelled = TRUE;
+  g_cond_broadcast (&sink->drain_cond);
+  g_mutex_unlock (&sink->drain_lock);
+
+  /* Not under channel_lock: the streaming thread will be holding it while
+     blocked in the Write we are trying to get it out of.  attach_lock keeps
+     us from Resetting a channel that recover is halfway through replacing. */
+  if (sink->TsOut == NULL)
+    return TRUE;
+  g_mutex_lock (&sink->attach_lock);
+  ret = sink->TsOut->Reset(DTAPI_FIFO_RESET) == DTAPI_OK;
+  g_mutex_unlock (&sink->attach_lock);
+  return ret;
 }
 
 static gboolean
 gst_dtapi_sink_stop_unlock (GstBaseSink *base_sink)
 {
   GstDTAPISink *sink = GST_DTAPI_SINK (base_sink);
-  return sink->TsOut->SetTxControl(DTAPI_TXCTRL_HOLD) == DTAPI_OK;
+  gboolean ret;
+
+  gst_dtapi_sink_set_plps_flushing (sink, FALSE);
+
+  g_mutex_lock (&sink->drain_lock);
+  sink->drain_cancelled = FALSE;
+  g_mutex_unlock (&sink->drain_lock);
+
+  /* Nothing carries over from before the flush */
+  sink->pid_filter.partial_len = 0;
+  if (sink->mon)
+    gst_dtapi_monitor_reset (sink->mon);
+  if (sink->restamp)
+    gst_dtapi_pcr_restamp_discont (sink->restamp);
+  if (sink->delay_line)
+    gst_dtapi_delay_clear (sink->delay_line);
+
+  /* unlock threw away whatever was in the FIFO */
+  GST_OBJECT_LOCK (sink);
+  sink->delay_fill = 0;
+  sink->fifo_load = 0;
+  sink->fifo_trend = 0;
+  sink->fifo_update_time = 0;
+  GST_OBJECT_UNLOCK (sink);
+
+  g_mutex_lock (&sink->channel_lock);
+  ret = gst_dtapi_sink_set_tx_control (sink, DTAPI_TXCTRL_HOLD) == DTAPI_OK;
+  g_mutex_unlock (&sink->channel_lock);
+  return ret;
 }
 
 static gboolean
 gst_dtapi_sink_stop (GstBaseSink *base_sink)
 {
   GstDTAPISink *sink = GST_DTAPI_SINK (base_sink);
+  GstDTAPIMirror *mirror;
 
+  gst_dtapi_sink_stop_plps (sink);
+
+  /* We aren't on the streaming thread and it may well be gone, so without
+     an EOS to have put it back it's left as it is.  The next start applies
+     the settings afresh to whichever thread upstream gives us then. */
+  sink->sched = GstDTAPISinkSched ();
+  sink->sched.applied = -1;
+
+  g_mutex_lock (&sink->channel_lock);
   sink->TsOut->Detach (DTAPI_INSTANT_DETACH);
   sink->Dvc->Detach ();
 
@@ -1013,6 +4200,44 @@ gst_dtapi_sink_stop (GstBaseSink *base_sink)
   sink->Dvc = NULL;
   delete sink->TsOut;
   sink->TsOut = NULL;
+  g_atomic_int_set (&sink->transmitting, FALSE);
+  g_mutex_unlock (&sink->channel_lock);
+
+  /* tx-mode may be different next time */
+  if (sink->mon) {
+    gst_dtapi_monitor_free (sink->mon);
+    sink->mon = NULL;
+  }
+  if (sink->restamp) {
+    gst_dtapi_pcr_restamp_free (sink->restamp);
+    sink->restamp = NULL;
+  }
+  /* ...and so may the TS rate */
+  if (sink->delay_line) {
+    gst_dtapi_delay_free (sink->delay_line);
+    sink->delay_line = NULL;
+  }
+  GST_OBJECT_LOCK (sink);
+  if (sink->delay_next) {
+    gst_dtapi_delay_free (sink->delay_next);
+    sink->delay_next = NULL;
+  }
+  sink->delay_max_hold = 0;
+  sink->delay_fill = 0;
+  g_atomic_int_set (&sink->delay_changed, TRUE);
+  /* ...and the PID filter is set up for the tx-mode when a table is
+     swapped in, so have the one we've got swapped in again */
+  if (!g_atomic_int_get (&sink->pid_table_changed)) {
+    sink->pid_table_next = sink->pid_table;
+    sink->pid_table = NULL;
+    g_atomic_int_set (&sink->pid_table_changed, TRUE);
+  }
+  mirror = sink->mirror;
+  sink->mirror = NULL;
+  GST_OBJECT_UNLOCK (sink);
+  /* Waits for the last of it to reach the disk */
+  if (mirror)
+    gst_dtapi_mirror_free (mirror);
 
   return TRUE;
 }
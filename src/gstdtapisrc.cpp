@@ -0,0 +1,500 @@
+/*
+ * GStreamer
+ * Copyright (C) 2012 YouView TV Ltd. <william.manley@youview.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * SECTION:element-dtapisrc
+ *
+ * Receives a transport stream from a DekTec input port (ASI or a
+ * receiver) using the proprietary DTAPI C++ API.
+ *
+ * A thread of its own reads from the input FIFO into buffers from a pool
+ * that are handed downstream as they are, so a slow downstream stalls
+ * only the pool and not the reads, up to the pool's depth.  FIFO overflows
+ * are counted in the stats property.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 dtapisrc device-type=2145 port=1 ! filesink location=capture.ts
+ * ]|
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <gst/gst.h>
+#include <gst/base/gstpushsrc.h>
+
+#include "DTAPI.h"
+#include "gstdtapidevice.h"
+#include "gstdtapisrc.h"
+
+#define TS_PACKET_SIZE 188
+
+/* DTAPI reads must be a multiple of 4 bytes, so whole packets four at a
+   time.  About 100k per read. */
+#define READ_SIZE (TS_PACKET_SIZE * 4 * 128)
+/* DTAPI wants reads into 32-bit aligned buffers; we give it cache lines */
+#define READ_ALIGN 63
+/* How long a read waits for data before checking whether to stop, in ms */
+#define READ_TIMEOUT 100
+
+#define DEFAULT_SERIAL 0
+#define DEFAULT_DEVICE_TYPE 2145
+#define DEFAULT_PORT 1
+#define DEFAULT_BUFFERS 32
+
+typedef struct _GstDTAPISrc {
+  GstPushSrc parent;
+
+  DtDevice* Dvc;
+  DtInpChannel* TsIn;
+
+  /* Properties, only read in start */
+  gint64 serial;
+  int device_type;
+  int port;
+  guint buffers;
+
+  /* The reader thread fills buffers from pool and pushes them onto queue
+     for create to pop.  Errors reach create as a NULL on the queue, with
+     the message already posted. */
+  GstBufferPool* pool;
+  GAsyncQueue* queue;
+  GThread* reader;
+  volatile gint reader_stop;
+  volatile gint flushing;
+
+  /* Protected by the object lock */
+  guint64 bytes_read;
+  guint64 overflows;
+  int fifo_max_load;
+} GstDTAPISrc;
+
+typedef struct _GstDTAPISrcClass {
+  GstPushSrcClass parent_class;
+} GstDTAPISrcClass;
+
+GST_DEBUG_CATEGORY_STATIC (gst_dtapi_src_debug);
+#define GST_CAT_DEFAULT gst_dtapi_src_debug
+
+#define _do_init \
+  GST_DEBUG_CATEGORY_INIT (gst_dtapi_src_debug, "dtapisrc", 0, \
+      "DekTec DTAPI source");
+#define gst_dtapi_src_parent_class parent_class
+G_DEFINE_TYPE_WITH_CODE (GstDTAPISrc, gst_dtapi_src, GST_TYPE_PUSH_SRC,
+                         _do_init);
+
+#define GST_TYPE_DTAPI_SRC \
+  (gst_dtapi_src_get_type())
+#define GST_DTAPI_SRC(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_DTAPI_SRC,GstDTAPISrc))
+
+enum
+{
+  PROP_0,
+  PROP_SERIAL,
+  PROP_DEVICE_TYPE,
+  PROP_PORT,
+  PROP_BUFFERS,
+  PROP_STATS
+};
+
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS("video/mpegts, systemstream = (boolean) true, "
+                    "packetsize = (int) 188"));
+
+static void gst_dtapi_src_set_property (GObject * object, guint prop_id,
+                                        const GValue * value,
+                                        GParamSpec * pspec);
+static void gst_dtapi_src_get_property (GObject * object, guint prop_id,
+                                        GValue * value, GParamSpec * pspec);
+static gboolean      gst_dtapi_src_start       (GstBaseSrc * src);
+static gboolean      gst_dtapi_src_stop        (GstBaseSrc * src);
+static gboolean      gst_dtapi_src_unlock      (GstBaseSrc * src);
+static gboolean      gst_dtapi_src_unlock_stop (GstBaseSrc * src);
+static GstFlowReturn gst_dtapi_src_create      (GstPushSrc * src,
+                                                GstBuffer ** buf);
+
+static void
+gst_dtapi_src_class_init (GstDTAPISrcClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
+  GstBaseSrcClass *gstbasesrc_class = GST_BASE_SRC_CLASS (klass);
+  GstPushSrcClass *gstpushsrc_class = GST_PUSH_SRC_CLASS (klass);
+
+  gobject_class->set_property = gst_dtapi_src_set_property;
+  gobject_class->get_property = gst_dtapi_src_get_property;
+
+  gst_element_class_set_static_metadata (gstelement_class,
+      "DekTec DTAPI Source",
+      "Source/Receiver",
+      "Read data from a DekTec input port",
+      "William Manley <william.manley@youview.com>");
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&srctemplate));
+
+  gstbasesrc_class->start = GST_DEBUG_FUNCPTR (gst_dtapi_src_start);
+  gstbasesrc_class->stop = GST_DEBUG_FUNCPTR (gst_dtapi_src_stop);
+  gstbasesrc_class->unlock = GST_DEBUG_FUNCPTR (gst_dtapi_src_unlock);
+  gstbasesrc_class->unlock_stop =
+      GST_DEBUG_FUNCPTR (gst_dtapi_src_unlock_stop);
+  gstpushsrc_class->create = GST_DEBUG_FUNCPTR (gst_dtapi_src_create);
+
+  g_object_class_install_property (gobject_class, PROP_SERIAL,
+      g_param_spec_int64 ("serial", "serial",
+          "Serial number of the device to use, or 0 for the first of "
+          "device-type",
+          0, G_MAXINT64, DEFAULT_SERIAL,
+          (GParamFlags) (G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_DEVICE_TYPE,
+      g_param_spec_int ("device-type", "device-type",
+          "Type number of the device to use, e.g. 2145 for a DTA-2145",
+          0, G_MAXINT, DEFAULT_DEVICE_TYPE,
+          (GParamFlags) (G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_PORT,
+      g_param_spec_int ("port", "port",
+          "Port on the device to receive from",
+          1, G_MAXINT, DEFAULT_PORT,
+          (GParamFlags) (G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_BUFFERS,
+      g_param_spec_uint ("buffers", "buffers",
+          "Number of buffers to read into.  Reading stops once they are all "
+          "downstream and the FIFO on the device starts to fill.",
+          2, G_MAXUINT, DEFAULT_BUFFERS,
+          (GParamFlags) (G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "stats",
+          "Bytes read, input FIFO overflows and the highest FIFO load seen",
+          GST_TYPE_STRUCTURE, (GParamFlags) G_PARAM_READABLE));
+}
+
+static void
+gst_dtapi_src_init (GstDTAPISrc * src)
+{
+  src->serial = DEFAULT_SERIAL;
+  src->device_type = DEFAULT_DEVICE_TYPE;
+  src->port = DEFAULT_PORT;
+  src->buffers = DEFAULT_BUFFERS;
+
+  gst_base_src_set_live (GST_BASE_SRC (src), TRUE);
+  gst_base_src_set_format (GST_BASE_SRC (src), GST_FORMAT_TIME);
+  gst_base_src_set_do_timestamp (GST_BASE_SRC (src), TRUE);
+}
+
+static void
+gst_dtapi_src_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstDTAPISrc *src = GST_DTAPI_SRC (object);
+
+  GST_OBJECT_LOCK (src);
+  switch (prop_id) {
+    case PROP_SERIAL:
+      src->serial = g_value_get_int64 (value);
+      break;
+    case PROP_DEVICE_TYPE:
+      src->device_type = g_value_get_int (value);
+      break;
+    case PROP_PORT:
+      src->port = g_value_get_int (value);
+      break;
+    case PROP_BUFFERS:
+      src->buffers = g_value_get_uint (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (src);
+}
+
+static void
+gst_dtapi_src_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstDTAPISrc *src = GST_DTAPI_SRC (object);
+
+  GST_OBJECT_LOCK (src);
+  switch (prop_id) {
+    case PROP_SERIAL:
+      g_value_set_int64 (value, src->serial);
+      break;
+    case PROP_DEVICE_TYPE:
+      g_value_set_int (value, src->device_type);
+      break;
+    case PROP_PORT:
+      g_value_set_int (value, src->port);
+      break;
+    case PROP_BUFFERS:
+      g_value_set_uint (value, src->buffers);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_structure_new ("dtapisrc-stats",
+          "bytes", G_TYPE_UINT64, src->bytes_read,
+          "overflows", G_TYPE_UINT64, src->overflows,
+          "fifo-max-load", G_TYPE_INT, src->fifo_max_load, NULL));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (src);
+}
+
+/* Counts the overflows latched since we last looked */
+static void
+gst_dtapi_src_check_flags (GstDTAPISrc * src)
+{
+  int status, latched, load;
+
+  if (src->TsIn->GetFlags (status, latched) == DTAPI_OK &&
+      (latched & DTAPI_RX_FIFO_OVF)) {
+    src->TsIn->ClearFlags (DTAPI_RX_FIFO_OVF);
+    GST_WARNING_OBJECT (src, "Input FIFO overflowed, data lost");
+    GST_OBJECT_LOCK (src);
+    src->overflows++;
+    GST_OBJECT_UNLOCK (src);
+  }
+  if (src->TsIn->GetFifoLoad (load) == DTAPI_OK) {
+    GST_OBJECT_LOCK (src);
+    src->fifo_max_load = MAX (src->fifo_max_load, load);
+    GST_OBJECT_UNLOCK (src);
+  }
+}
+
+static gpointer
+gst_dtapi_src_reader (gpointer data)
+{
+  GstDTAPISrc *src = GST_DTAPI_SRC (data);
+  DTAPI_RESULT result;
+  GstBuffer *buf;
+  GstMapInfo map;
+
+  while (!g_atomic_int_get (&src->reader_stop)) {
+    /* Blocks once every buffer is downstream.  Fails when the pool is
+       deactivated in stop. */
+    if (gst_buffer_pool_acquire_buffer (src->pool, &buf, NULL) != GST_FLOW_OK)
+      break;
+
+    gst_buffer_map (buf, &map, GST_MAP_WRITE);
+    result = src->TsIn->Read ((char *) map.data, READ_SIZE, READ_TIMEOUT);
+    gst_buffer_unmap (buf, &map);
+
+    gst_dtapi_src_check_flags (src);
+
+    if (result == DTAPI_E_TIMEOUT) {
+      gst_buffer_unref (buf);
+      continue;
+    }
+    if (result != DTAPI_OK) {
+      gst_buffer_unref (buf);
+      GST_ELEMENT_ERROR (src, RESOURCE, READ, (NULL),
+          ("Reading data failed: %s", gst_dtapi_result_to_string (result)));
+      g_async_queue_push (src->queue, GINT_TO_POINTER (-1));
+      break;
+    }
+
+    GST_OBJECT_LOCK (src);
+    src->bytes_read += READ_SIZE;
+    GST_OBJECT_UNLOCK (src);
+    g_async_queue_push (src->queue, buf);
+  }
+
+  return NULL;
+}
+
+static gboolean
+gst_dtapi_src_start (GstBaseSrc * base_src)
+{
+  GstDTAPISrc *src = GST_DTAPI_SRC (base_src);
+  GstAllocationParams params;
+  GstStructure *config;
+  DTAPI_RESULT result;
+  gchar *error;
+
+  src->Dvc = new DtDevice();
+  src->TsIn = new DtInpChannel();
+
+  if ((error = gst_dtapi_attach (src->Dvc, src->TsIn, src->serial,
+                                 src->device_type, src->port)) != NULL) {
+    delete src->TsIn;
+    src->TsIn = NULL;
+    delete src->Dvc;
+    src->Dvc = NULL;
+    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("%s", error));
+    g_free (error);
+    return FALSE;
+  }
+
+  /* Packets synchronised and delivered as 188 bytes whatever comes in */
+  if ((result = src->TsIn->SetRxMode (DTAPI_RXMODE_ST188)) != DTAPI_OK ||
+      (result = src->TsIn->Reset (DTAPI_FIFO_RESET)) != DTAPI_OK ||
+      (result = src->TsIn->ClearFlags (DTAPI_RX_FIFO_OVF)) != DTAPI_OK ||
+      (result = src->TsIn->SetRxControl (DTAPI_RXCTRL_RCV)) != DTAPI_OK) {
+    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL),
+        ("Starting reception failed: %s",
+         gst_dtapi_result_to_string (result)));
+    gst_dtapi_src_stop (base_src);
+    return FALSE;
+  }
+
+  src->pool = gst_buffer_pool_new ();
+  config = gst_buffer_pool_get_config (src->pool);
+  gst_buffer_pool_config_set_params (config, NULL, READ_SIZE, src->buffers,
+                                     src->buffers);
+  gst_allocation_params_init (&params);
+  params.align = READ_ALIGN;
+  gst_buffer_pool_config_set_allocator (config, NULL, &params);
+  if (!gst_buffer_pool_set_config (src->pool, config) ||
+      !gst_buffer_pool_set_active (src->pool, TRUE)) {
+    GST_ELEMENT_ERROR (src, RESOURCE, SETTINGS, (NULL),
+        ("Failed to set up buffer pool"));
+    gst_dtapi_src_stop (base_src);
+    return FALSE;
+  }
+
+  GST_OBJECT_LOCK (src);
+  src->bytes_read = 0;
+  src->overflows = 0;
+  src->fifo_max_load = 0;
+  GST_OBJECT_UNLOCK (src);
+
+  src->queue = g_async_queue_new ();
+  g_atomic_int_set (&src->reader_stop, 0);
+  src->reader = g_thread_new ("dtapisrc-reader", gst_dtapi_src_reader, src);
+
+  return TRUE;
+}
+
+static gboolean
+gst_dtapi_src_stop (GstBaseSrc * base_src)
+{
+  GstDTAPISrc *src = GST_DTAPI_SRC (base_src);
+  gpointer item;
+
+  if (src->reader) {
+    g_atomic_int_set (&src->reader_stop, 1);
+    /* Wakes it if it's waiting for a buffer to come back */
+    gst_buffer_pool_set_active (src->pool, FALSE);
+    g_thread_join (src->reader);
+    src->reader = NULL;
+  }
+  if (src->queue) {
+    while ((item = g_async_queue_try_pop (src->queue)) != NULL) {
+      if (item != GINT_TO_POINTER (-1))
+        gst_buffer_unref (GST_BUFFER (item));
+    }
+    g_async_queue_unref (src->queue);
+    src->queue = NULL;
+  }
+  if (src->pool) {
+    gst_buffer_pool_set_active (src->pool, FALSE);
+    gst_object_unref (src->pool);
+    src->pool = NULL;
+  }
+
+  if (src->TsIn) {
+    src->TsIn->SetRxControl (DTAPI_RXCTRL_IDLE);
+    src->TsIn->Detach (DTAPI_INSTANT_DETACH);
+    src->Dvc->Detach ();
+    delete src->TsIn;
+    src->TsIn = NULL;
+    delete src->Dvc;
+    src->Dvc = NULL;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+gst_dtapi_src_unlock (GstBaseSrc * base_src)
+{
+  GstDTAPISrc *src = GST_DTAPI_SRC (base_src);
+
+  g_atomic_int_set (&src->flushing, 1);
+  return TRUE;
+}
+
+static gboolean
+gst_dtapi_src_unlock_stop (GstBaseSrc * base_src)
+{
+  GstDTAPISrc *src = GST_DTAPI_SRC (base_src);
+
+  g_atomic_int_set (&src->flushing, 0);
+  return TRUE;
+}
+
+static GstFlowReturn
+gst_dtapi_src_create (GstPushSrc * push_src, GstBuffer ** buf)
+{
+  GstDTAPISrc *src = GST_DTAPI_SRC (push_src);
+  gpointer item = NULL;
+
+  /* Wake up now and then to see if we've been unlocked */
+  while (item == NULL) {
+    if (g_atomic_int_get (&src->flushing))
+      return GST_FLOW_FLUSHING;
+    item = g_async_queue_timeout_pop (src->queue,
+                                      READ_TIMEOUT * G_TIME_SPAN_MILLISECOND);
+  }
+  if (item == GINT_TO_POINTER (-1))
+    return GST_FLOW_ERROR;
+
+  *buf = GST_BUFFER (item);
+  return GST_FLOW_OK;
+}
+
+extern "C" {
+gboolean
+gst_dtapisrc_plugin_init (GstPlugin * plugin)
+{
+  return gst_element_register (plugin, "dtapisrc", GST_RANK_NONE,
+      GST_TYPE_DTAPI_SRC);
+}
+}
@@ -0,0 +1,424 @@
+/*
+ * GStreamer
+ * Copyright (C) 2012 YouView TV Ltd. <william.manley@youview.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * SECTION:element-dtapitestsrc
+ *
+ * Generates transport stream test signals for commissioning transmitters
+ * and measuring BER: a PRBS-23 payload, null packets or a fixed byte
+ * pattern.  There is no rate to set: the modulator takes data at its TS
+ * rate and back-pressure does the rest, so the output fills the channel
+ * exactly.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 dtapitestsrc mode=prbs ! dtapisink
+ * ]|
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <gst/gst.h>
+#include <gst/base/gstbasesrc.h>
+#include <string.h>
+
+#include "gstdtapitestsrc.h"
+
+#define TS_PACKET_SIZE 188
+#define TS_PAYLOAD_SIZE 184
+#define NULL_PID 0x1fff
+
+/* Buffers are made of whole packets and, so that a prebuilt one can be
+   pushed again and again without breaking continuity, whole cycles of the
+   CC */
+#define CC_CYCLE 16
+
+/* PRBS-23 (x^23 + x^18 + 1, as ITU-T O.150), 23 bits of state */
+#define PRBS_MASK 0x7fffff
+
+typedef enum
+{
+  GST_DTAPI_TEST_SRC_PRBS,
+  GST_DTAPI_TEST_SRC_NULL,
+  GST_DTAPI_TEST_SRC_PATTERN
+} GstDTAPITestSrcMode;
+
+#define DEFAULT_MODE GST_DTAPI_TEST_SRC_PRBS
+#define DEFAULT_PID 0x100
+#define DEFAULT_PATTERN 0x00
+/* 21 cycles of the CC comes to a little under 64k */
+#define DEFAULT_BLOCKSIZE (TS_PACKET_SIZE * CC_CYCLE * 21)
+
+typedef struct _GstDTAPITestSrc {
+  GstBaseSrc parent;
+
+  /* Only read in start: they can't change while we run */
+  GstDTAPITestSrcMode mode;
+  guint pid;
+  guint pattern;
+
+  /* null and pattern: every buffer is the same so we make one in start and
+     push it each time */
+  GstBuffer* block;
+
+  /* prbs: where we've got to */
+  guint32 prbs;
+  guint8 cc;
+} GstDTAPITestSrc;
+
+typedef struct _GstDTAPITestSrcClass {
+  GstBaseSrcClass parent_class;
+} GstDTAPITestSrcClass;
+
+GST_DEBUG_CATEGORY_STATIC (gst_dtapi_test_src_debug);
+#define GST_CAT_DEFAULT gst_dtapi_test_src_debug
+
+#define _do_init \
+  GST_DEBUG_CATEGORY_INIT (gst_dtapi_test_src_debug, "dtapitestsrc", 0, \
+      "DekTec test signal source");
+#define gst_dtapi_test_src_parent_class parent_class
+G_DEFINE_TYPE_WITH_CODE (GstDTAPITestSrc, gst_dtapi_test_src,
+                         GST_TYPE_BASE_SRC, _do_init);
+
+#define GST_TYPE_DTAPI_TEST_SRC \
+  (gst_dtapi_test_src_get_type())
+#define GST_DTAPI_TEST_SRC(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_DTAPI_TEST_SRC,GstDTAPITestSrc))
+
+enum
+{
+  PROP_0,
+  PROP_MODE,
+  PROP_PID,
+  PROP_PATTERN
+};
+
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS("video/mpegts, systemstream = (boolean) true, "
+                    "packetsize = (int) 188"));
+
+#define GST_TYPE_DTAPI_TEST_SRC_MODE (gst_dtapi_test_src_mode_get_type ())
+static GType
+gst_dtapi_test_src_mode_get_type (void)
+{
+  static GType dtapi_test_src_mode_type = 0;
+  static GEnumValue mode_types[] = {
+    {GST_DTAPI_TEST_SRC_PRBS,    "PRBS-23 payload", "prbs"},
+    {GST_DTAPI_TEST_SRC_NULL,    "Null packets",    "null"},
+    {GST_DTAPI_TEST_SRC_PATTERN, "Fixed pattern",   "pattern"},
+    {0, NULL, NULL},
+  };
+
+  if (!dtapi_test_src_mode_type) {
+    dtapi_test_src_mode_type =
+        g_enum_register_static ("GstDTAPITestSrcMode", mode_types);
+  }
+  return dtapi_test_src_mode_type;
+}
+
+static void gst_dtapi_test_src_set_property (GObject * object, guint prop_id,
+                                             const GValue * value,
+                                             GParamSpec * pspec);
+static void gst_dtapi_test_src_get_property (GObject * object, guint prop_id,
+                                             GValue * value,
+                                             GParamSpec * pspec);
+static gboolean      gst_dtapi_test_src_start  (GstBaseSrc * src);
+static gboolean      gst_dtapi_test_src_stop   (GstBaseSrc * src);
+static GstFlowReturn gst_dtapi_test_src_create (GstBaseSrc * src,
+                                                guint64 offset, guint length,
+                                                GstBuffer ** buf);
+static GstFlowReturn gst_dtapi_test_src_fill   (GstBaseSrc * src,
+                                                guint64 offset, guint length,
+                                                GstBuffer * buf);
+
+static void
+gst_dtapi_test_src_class_init (GstDTAPITestSrcClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
+  GstBaseSrcClass *gstbasesrc_class = GST_BASE_SRC_CLASS (klass);
+
+  gobject_class->set_property = gst_dtapi_test_src_set_property;
+  gobject_class->get_property = gst_dtapi_test_src_get_property;
+
+  gst_element_class_set_static_metadata (gstelement_class,
+      "DekTec Test Signal Source",
+      "Source",
+      "Generate PRBS, null or fixed pattern transport streams for testing "
+      "modulators",
+      "William Manley <william.manley@youview.com>");
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&srctemplate));
+
+  gstbasesrc_class->start = GST_DEBUG_FUNCPTR (gst_dtapi_test_src_start);
+  gstbasesrc_class->stop = GST_DEBUG_FUNCPTR (gst_dtapi_test_src_stop);
+  gstbasesrc_class->create = GST_DEBUG_FUNCPTR (gst_dtapi_test_src_create);
+  gstbasesrc_class->fill = GST_DEBUG_FUNCPTR (gst_dtapi_test_src_fill);
+
+  g_object_class_install_property (gobject_class, PROP_MODE,
+      g_param_spec_enum ("mode", "mode",
+          "What to put in the stream",
+          GST_TYPE_DTAPI_TEST_SRC_MODE, DEFAULT_MODE,
+          (GParamFlags) (G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_PID,
+      g_param_spec_uint ("pid", "pid",
+          "PID to send the PRBS or pattern on",
+          0, NULL_PID - 1, DEFAULT_PID,
+          (GParamFlags) (G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_PATTERN,
+      g_param_spec_uint ("pattern", "pattern",
+          "Byte to fill the payload with in pattern mode",
+          0, 255, DEFAULT_PATTERN,
+          (GParamFlags) (G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY)));
+}
+
+static void
+gst_dtapi_test_src_init (GstDTAPITestSrc * src)
+{
+  src->mode = DEFAULT_MODE;
+  src->pid = DEFAULT_PID;
+  src->pattern = DEFAULT_PATTERN;
+
+  gst_base_src_set_format (GST_BASE_SRC (src), GST_FORMAT_BYTES);
+  gst_base_src_set_blocksize (GST_BASE_SRC (src), DEFAULT_BLOCKSIZE);
+}
+
+static void
+gst_dtapi_test_src_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstDTAPITestSrc *src = GST_DTAPI_TEST_SRC (object);
+
+  GST_OBJECT_LOCK (src);
+  switch (prop_id) {
+    case PROP_MODE:
+      src->mode = (GstDTAPITestSrcMode) g_value_get_enum (value);
+      break;
+    case PROP_PID:
+      src->pid = g_value_get_uint (value);
+      break;
+    case PROP_PATTERN:
+      src->pattern = g_value_get_uint (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (src);
+}
+
+static void
+gst_dtapi_test_src_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstDTAPITestSrc *src = GST_DTAPI_TEST_SRC (object);
+
+  GST_OBJECT_LOCK (src);
+  switch (prop_id) {
+    case PROP_MODE:
+      g_value_set_enum (value, src->mode);
+      break;
+    case PROP_PID:
+      g_value_set_uint (value, src->pid);
+      break;
+    case PROP_PATTERN:
+      g_value_set_uint (value, src->pattern);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (src);
+}
+
+/* Writes the 4 byte header of a payload only packet */
+static inline void
+write_header (guint8 * p, guint pid, guint8 cc)
+{
+  p[0] = 0x47;
+  p[1] = pid >> 8;
+  p[2] = pid & 0xff;
+  p[3] = 0x10 | cc;
+}
+
+/* The number of whole packets in length bytes, rounded down to whole cycles
+   of the CC */
+static guint
+block_packets (guint length)
+{
+  guint packets = length / TS_PACKET_SIZE;
+
+  return MAX (packets - packets % CC_CYCLE, CC_CYCLE);
+}
+
+static gboolean
+gst_dtapi_test_src_start (GstBaseSrc * base_src)
+{
+  GstDTAPITestSrc *src = GST_DTAPI_TEST_SRC (base_src);
+  GstMapInfo map;
+  guint i, packets, pid;
+  guint8 payload;
+
+  src->prbs = PRBS_MASK;
+  src->cc = 0;
+
+  if (src->mode == GST_DTAPI_TEST_SRC_PRBS)
+    return TRUE;
+
+  if (src->mode == GST_DTAPI_TEST_SRC_NULL) {
+    pid = NULL_PID;
+    payload = 0xff;
+  } else {
+    pid = src->pid;
+    payload = src->pattern;
+  }
+
+  packets = block_packets (gst_base_src_get_blocksize (base_src));
+  src->block = gst_buffer_new_allocate (NULL, packets * TS_PACKET_SIZE, NULL);
+  gst_buffer_map (src->block, &map, GST_MAP_WRITE);
+  for (i = 0; i < packets; i++) {
+    guint8 *p = map.data + i * TS_PACKET_SIZE;
+
+    write_header (p, pid, i % CC_CYCLE);
+    memset (p + 4, payload, TS_PAYLOAD_SIZE);
+  }
+  gst_buffer_unmap (src->block, &map);
+
+  return TRUE;
+}
+
+static gboolean
+gst_dtapi_test_src_stop (GstBaseSrc * base_src)
+{
+  GstDTAPITestSrc *src = GST_DTAPI_TEST_SRC (base_src);
+
+  gst_buffer_replace (&src->block, NULL);
+  return TRUE;
+}
+
+static GstFlowReturn
+gst_dtapi_test_src_create (GstBaseSrc * base_src, guint64 offset,
+    guint length, GstBuffer ** buf)
+{
+  GstDTAPITestSrc *src = GST_DTAPI_TEST_SRC (base_src);
+
+  /* No allocation, no copy: the same memory goes out every time */
+  if (src->block) {
+    *buf = gst_buffer_ref (src->block);
+    return GST_FLOW_OK;
+  }
+
+  return GST_BASE_SRC_CLASS (parent_class)->create (base_src, offset,
+      length, buf);
+}
+
+/* Continues the PRBS into the payload of len bytes.  Taps are 23 and 18
+   bits back, so the next 16 bits depend only on bits we already have and
+   can be worked out in one go. */
+static void
+fill_prbs (GstDTAPITestSrc * src, guint8 * payload, guint len)
+{
+  guint32 s = src->prbs;
+  guint i;
+
+  for (i = 0; i + 2 <= len; i += 2) {
+    guint32 bits = ((s >> 7) ^ (s >> 2)) & 0xffff;
+
+    payload[i] = bits >> 8;
+    payload[i + 1] = bits & 0xff;
+    s = ((s << 16) | bits) & PRBS_MASK;
+  }
+  for (; i < len; i++) {
+    guint32 bits = ((s >> 15) ^ (s >> 10)) & 0xff;
+
+    payload[i] = bits;
+    s = ((s << 8) | bits) & PRBS_MASK;
+  }
+  src->prbs = s;
+}
+
+static GstFlowReturn
+gst_dtapi_test_src_fill (GstBaseSrc * base_src, guint64 offset,
+    guint length, GstBuffer * buf)
+{
+  GstDTAPITestSrc *src = GST_DTAPI_TEST_SRC (base_src);
+  GstMapInfo map;
+  guint i, packets;
+
+  packets = gst_buffer_get_size (buf) / TS_PACKET_SIZE;
+  if (packets == 0) {
+    GST_ELEMENT_ERROR (src, RESOURCE, SETTINGS, (NULL),
+      ("blocksize must be at least one packet"));
+    return GST_FLOW_ERROR;
+  }
+  gst_buffer_resize (buf, 0, packets * TS_PACKET_SIZE);
+
+  if (!gst_buffer_map (buf, &map, GST_MAP_WRITE)) {
+    GST_ELEMENT_ERROR (src, RESOURCE, WRITE, (NULL),
+      ("Failed to map buffer"));
+    return GST_FLOW_ERROR;
+  }
+  for (i = 0; i < packets; i++) {
+    guint8 *p = map.data + i * TS_PACKET_SIZE;
+
+    write_header (p, src->pid, src->cc);
+    src->cc = (src->cc + 1) % CC_CYCLE;
+    fill_prbs (src, p + 4, TS_PAYLOAD_SIZE);
+  }
+  gst_buffer_unmap (buf, &map);
+
+  return GST_FLOW_OK;
+}
+
+gboolean
+gst_dtapitestsrc_plugin_init (GstPlugin * plugin)
+{
+  return gst_element_register (plugin, "dtapitestsrc", GST_RANK_NONE,
+      GST_TYPE_DTAPI_TEST_SRC);
+}
@@ -0,0 +1,153 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * bench-monitor.c: How fast gst_dtapi_monitor_process gets through TS
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Runs a clean single programme TS through the monitor on one core and
+   fails if it gets through less than the target rate (100 Mb/s unless
+   given in Mb/s on the command line).  Usage: bench-monitor [target] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "gstdtapimonitor.h"
+
+#define TS_PACKET_SIZE 188
+#define PAT_PID 0x0000
+#define PMT_PID 0x0100
+#define VIDEO_PID 0x0101
+#define AUDIO_PID 0x0102
+#define NULL_PID 0x1fff
+
+/* One cycle of the stream is this many packets: a PAT, a PMT, video, a
+   little audio and some stuffing.  Every PID gets a multiple of 16 packets
+   per loop of the buffer so the continuity counters carry on across it. */
+#define CYCLE 100
+#define LOOPS 640
+#define CHUNK (348 * TS_PACKET_SIZE)
+#define STREAM_RATE 40000000
+#define SECONDS 2
+
+static guint8 cc[8192];
+
+static guint8 *
+packet_header (guint8 * p, guint pid, gboolean pusi)
+{
+  memset (p, 0xff, TS_PACKET_SIZE);
+  p[0] = 0x47;
+  p[1] = (pusi ? 0x40 : 0) | (pid >> 8);
+  p[2] = pid & 0xff;
+  p[3] = 0x10 | (cc[pid]++ & 0x0f);
+  return p + 4;
+}
+
+static void
+section_packet (guint8 * p, guint pid, const guint8 * section, gsize len)
+{
+  guint8 *payload = packet_header (p, pid, TRUE);
+
+  payload[0] = 0;
+  memcpy (payload + 1, section, len);
+}
+
+static guint8 *
+make_stream (gsize * size)
+{
+  static const guint8 pat[] = {
+    0x00, 0xb0, 0x0d, 0x00, 0x01, 0xc1, 0x00, 0x00,
+    0x00, 0x01, 0xe0 | (PMT_PID >> 8), PMT_PID & 0xff,
+    0x00, 0x00, 0x00, 0x00
+  };
+  static const guint8 pmt[] = {
+    0x02, 0xb0, 0x17, 0x00, 0x01, 0xc1, 0x00, 0x00,
+    0xe0 | (VIDEO_PID >> 8), VIDEO_PID & 0xff, 0xf0, 0x00,
+    0x1b, 0xe0 | (VIDEO_PID >> 8), VIDEO_PID & 0xff, 0xf0, 0x00,
+    0x03, 0xe0 | (AUDIO_PID >> 8), AUDIO_PID & 0xff, 0xf0, 0x00,
+    0x00, 0x00, 0x00, 0x00
+  };
+  guint8 *stream, *p;
+  int i, j;
+
+  *size = (gsize) LOOPS * CYCLE * TS_PACKET_SIZE;
+  p = stream = (guint8 *) g_malloc (*size);
+  for (i = 0; i < LOOPS; i++) {
+    section_packet (p, PAT_PID, pat, sizeof (pat));
+    p += TS_PACKET_SIZE;
+    section_packet (p, PMT_PID, pmt, sizeof (pmt));
+    p += TS_PACKET_SIZE;
+    for (j = 0; j < 88; j++, p += TS_PACKET_SIZE)
+      packet_header (p, VIDEO_PID, j == 0);
+    for (j = 0; j < 8; j++, p += TS_PACKET_SIZE)
+      packet_header (p, AUDIO_PID, j == 0);
+    for (j = 0; j < 2; j++, p += TS_PACKET_SIZE)
+      packet_header (p, NULL_PID, FALSE);
+  }
+  return stream;
+}
+
+static void
+ignore_bitrate (guint pid, guint64 bps, gpointer user_data)
+{
+}
+
+int
+main (int argc, char **argv)
+{
+  GstDTAPIMonitor *mon;
+  GstDTAPIMonitorCounts counts;
+  guint8 *stream;
+  gsize size, offset, len;
+  guint64 bytes = 0;
+  gint64 start, elapsed;
+  gdouble target = argc > 1 ? g_ascii_strtod (argv[1], NULL) : 100, mbps;
+
+  stream = make_stream (&size);
+  mon = gst_dtapi_monitor_new (TS_PACKET_SIZE);
+
+  start = g_get_monotonic_time ();
+  do {
+    for (offset = 0; offset < size; offset += len) {
+      len = MIN (CHUNK, size - offset);
+      if (gst_dtapi_monitor_process (mon, stream + offset, len, STREAM_RATE))
+        gst_dtapi_monitor_foreach_bitrate (mon, ignore_bitrate, NULL);
+    }
+    bytes += size;
+    elapsed = g_get_monotonic_time () - start;
+  } while (elapsed < SECONDS * G_USEC_PER_SEC);
+
+  gst_dtapi_monitor_get_counts (mon, &counts);
+  mbps = bytes * 8.0 / elapsed;
+  printf ("gst_dtapi_monitor_process: %.0f Mb/s on one core (target %.0f), "
+      "%" G_GUINT64_FORMAT " packets\n", mbps, target, counts.packets);
+
+  gst_dtapi_monitor_free (mon);
+  g_free (stream);
+
+  /* The stream is clean so anything found means the benchmark is measuring
+     the wrong thing */
+  if (counts.sync_loss || counts.sync_byte_error || counts.pat_error ||
+      counts.cc_error || counts.pmt_error || counts.pid_error) {
+    fprintf (stderr, "Monitor found errors in a clean stream\n");
+    return 1;
+  }
+  return mbps >= target ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * bench-sched.c: What realtime-priority and cpu-affinity do for write gaps
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Streams into dtapisink on the stand-in device with every CPU kept busy
+   by twice as many spinning threads, and measures the longest the device
+   is left between one Write and the next: first with the thread's
+   scheduling left alone, then with realtime-priority and cpu-affinity set.
+   Fails if the worst gap with them set is over the target (5 ms unless
+   given in ms on the command line).  Usage: bench-sched [target]
+
+   Without CAP_SYS_NICE or a high enough RLIMIT_RTPRIO there's nothing to
+   measure, so it says so and passes. */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+#include <gst/gst.h>
+
+#include "dtapistandin.h"
+#include "gstdtapisink.h"
+#include "gstdtapitestsrc.h"
+
+#define SECONDS 3
+#define WARM_UP_US 200000
+#define PRIORITY 50
+
+static volatile gint stop_load;
+
+static gpointer
+spin (gpointer data)
+{
+  while (!g_atomic_int_get (&stop_load))
+    ;
+  return NULL;
+}
+
+static gboolean
+can_go_realtime (void)
+{
+  struct sched_param param = { 0 }, old;
+  int policy;
+
+  pthread_getschedparam (pthread_self (), &policy, &old);
+  param.sched_priority = PRIORITY;
+  if (pthread_setschedparam (pthread_self (), SCHED_FIFO, &param) != 0)
+    return FALSE;
+  pthread_setschedparam (pthread_self (), policy, &old);
+  return TRUE;
+}
+
+/* The worst gap over SECONDS, in ms */
+static gdouble
+worst_gap (void)
+{
+  g_usleep (WARM_UP_US);
+  dtapi_standin_max_write_gap ();
+  g_usleep (SECONDS * G_USEC_PER_SEC);
+  return dtapi_standin_max_write_gap () / 1000.0;
+}
+
+int
+main (int argc, char **argv)
+{
+  GstElement *pipeline, *sink;
+  GThread **load;
+  GError *error = NULL;
+  guint i, n_load;
+  gdouble target, off, on;
+
+  gst_init (&argc, &argv);
+  target = argc > 1 ? g_ascii_strtod (argv[1], NULL) : 5;
+
+  if (!can_go_realtime ()) {
+    printf ("bench-sched: not allowed real-time priority, skipping\n");
+    return 0;
+  }
+
+  if (!gst_dtapisink_plugin_init (NULL) ||
+      !gst_dtapitestsrc_plugin_init (NULL)) {
+    fprintf (stderr, "Couldn't register the elements\n");
+    return 1;
+  }
+  pipeline = gst_parse_launch ("dtapitestsrc mode=null ! "
+      "dtapisink name=sink sync=false", &error);
+  if (pipeline == NULL) {
+    fprintf (stderr, "Couldn't make the pipeline: %s\n", error->message);
+    g_error_free (error);
+    return 1;
+  }
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+
+  n_load = 2 * g_get_num_processors ();
+  load = g_new (GThread *, n_load);
+  for (i = 0; i < n_load; i++)
+    load[i] = g_thread_new ("load", spin, NULL);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  off = worst_gap ();
+  g_object_set (sink, "realtime-priority", PRIORITY, "cpu-affinity",
+      (guint64) 1, NULL);
+  on = worst_gap ();
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+
+  g_atomic_int_set (&stop_load, TRUE);
+  for (i = 0; i < n_load; i++)
+    g_thread_join (load[i]);
+  g_free (load);
+  gst_object_unref (sink);
+  gst_object_unref (pipeline);
+
+  printf ("Worst gap between writes with %u busy threads: %.2f ms as it "
+      "was, %.2f ms with realtime-priority and cpu-affinity (target %.2f)\n",
+      n_load, off, on, target);
+  if (off == 0 || on == 0) {
+    fprintf (stderr, "dtapisink didn't write anything\n");
+    return 1;
+  }
+  return on <= target ? 0 : 1;
+}
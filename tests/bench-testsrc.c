@@ -0,0 +1,89 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * bench-testsrc.c: How fast dtapitestsrc makes PRBS buffers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Calls dtapitestsrc's fill over and over on one buffer, as basesrc would
+   with one from dtapisink's pool, and fails if it can't keep the fastest
+   DTU-215 channel full on one core.  Usage: bench-testsrc [target Mb/s] */
+
+#include <stdio.h>
+#include <gst/gst.h>
+#include <gst/base/gstbasesrc.h>
+
+#include "gstdtapitestsrc.h"
+
+#define SECONDS 2
+
+/* The fastest channel the DTU-215 can modulate: J.83 annex A 256-QAM at
+   7.2 MBd, 8 bits a symbol less the Reed-Solomon parity */
+#define CHANNEL_CAPACITY (7200000.0 * 8 * 188 / 204)
+
+int
+main (int argc, char **argv)
+{
+  GstElement *element;
+  GstBaseSrc *src;
+  GstBaseSrcClass *klass;
+  GstBuffer *buf;
+  guint size;
+  guint64 bytes = 0;
+  gint64 start, elapsed;
+  gdouble target, rate;
+
+  gst_init (&argc, &argv);
+  target = argc > 1 ? g_ascii_strtod (argv[1], NULL) * 1e6 : CHANNEL_CAPACITY;
+
+  if (!gst_dtapitestsrc_plugin_init (NULL) ||
+      (element = gst_element_factory_make ("dtapitestsrc", NULL)) == NULL) {
+    fprintf (stderr, "Couldn't make a dtapitestsrc\n");
+    return 1;
+  }
+  src = GST_BASE_SRC (element);
+  klass = GST_BASE_SRC_GET_CLASS (src);
+  g_object_set (element, "mode", 0 /* prbs */, NULL);
+
+  size = gst_base_src_get_blocksize (src);
+  buf = gst_buffer_new_allocate (NULL, size, NULL);
+  if (!klass->start (src)) {
+    fprintf (stderr, "dtapitestsrc didn't start\n");
+    return 1;
+  }
+
+  start = g_get_monotonic_time ();
+  do {
+    if (klass->fill (src, bytes, size, buf) != GST_FLOW_OK) {
+      fprintf (stderr, "fill failed\n");
+      return 1;
+    }
+    bytes += gst_buffer_get_size (buf);
+    elapsed = g_get_monotonic_time () - start;
+  } while (elapsed < SECONDS * G_USEC_PER_SEC);
+
+  klass->stop (src);
+  gst_buffer_unref (buf);
+  gst_object_unref (element);
+
+  rate = bytes * 8.0 * G_USEC_PER_SEC / elapsed;
+  printf ("gst_dtapi_test_src_fill: %.1f Mb/s on one core, %.1f times "
+      "the %.1f Mb/s target\n", rate / 1e6, rate / target, target / 1e6);
+
+  return rate >= target ? 0 : 1;
+}
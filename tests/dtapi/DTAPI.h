@@ -0,0 +1,365 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * DTAPI.h: Stand-in for DekTec's DTAPI.h, for the tests
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* The tests build the plugin against this rather than the real DTAPI.h and
+   link dtapistandin.cpp in place of DTAPI.o, so they run without DekTec
+   hardware or the SDK.  It declares just what the plugin uses, with the
+   same names and call signatures.  The values of the constants are only
+   consistent with each other, not with DTAPI's. */
+
+#ifndef __DTAPI_H
+#define __DTAPI_H
+
+#include <stdint.h>
+
+typedef unsigned int DTAPI_RESULT;
+
+/* Results */
+#define DTAPI_OK                    0
+#define DTAPI_E                     0x1000
+#define DTAPI_E_DEV_DRIVER          (DTAPI_E + 1)
+#define DTAPI_E_IDLE                (DTAPI_E + 2)
+#define DTAPI_E_INSUF_LOAD          (DTAPI_E + 3)
+#define DTAPI_E_INVALID_BANDWIDTH   (DTAPI_E + 4)
+#define DTAPI_E_INVALID_BUF         (DTAPI_E + 5)
+#define DTAPI_E_INVALID_CONSTEL     (DTAPI_E + 6)
+#define DTAPI_E_INVALID_FHMODE      (DTAPI_E + 7)
+#define DTAPI_E_INVALID_GUARD       (DTAPI_E + 8)
+#define DTAPI_E_INVALID_INTERLVNG   (DTAPI_E + 9)
+#define DTAPI_E_INVALID_J83ANNEX    (DTAPI_E + 10)
+#define DTAPI_E_INVALID_LEVEL       (DTAPI_E + 11)
+#define DTAPI_E_INVALID_MODE        (DTAPI_E + 12)
+#define DTAPI_E_INVALID_PILOTS      (DTAPI_E + 13)
+#define DTAPI_E_INVALID_RATE        (DTAPI_E + 14)
+#define DTAPI_E_INVALID_ROLLOFF     (DTAPI_E + 15)
+#define DTAPI_E_INVALID_SIZE        (DTAPI_E + 16)
+#define DTAPI_E_INVALID_TRANSMODE   (DTAPI_E + 17)
+#define DTAPI_E_INVALID_USEFRAMENO  (DTAPI_E + 18)
+#define DTAPI_E_MODPARS_NOT_SET     (DTAPI_E + 19)
+#define DTAPI_E_MODTYPE_UNSUP       (DTAPI_E + 20)
+#define DTAPI_E_NOT_ATTACHED        (DTAPI_E + 21)
+#define DTAPI_E_NOT_SUPPORTED       (DTAPI_E + 22)
+#define DTAPI_E_NO_IPPARS           (DTAPI_E + 23)
+#define DTAPI_E_NO_TSRATE           (DTAPI_E + 24)
+#define DTAPI_E_TIMEOUT             (DTAPI_E + 25)
+#define DTAPI_E_NO_DTDEVICE         (DTAPI_E + 26)
+
+/* Detach and Reset */
+#define DTAPI_INSTANT_DETACH        1
+#define DTAPI_FIFO_RESET            0
+
+/* Transmit control, transmit modes and flags */
+#define DTAPI_TXCTRL_IDLE           1
+#define DTAPI_TXCTRL_HOLD           2
+#define DTAPI_TXCTRL_SEND           3
+
+#define DTAPI_TXMODE_188            0
+#define DTAPI_TXMODE_192            1
+#define DTAPI_TXMODE_204            2
+#define DTAPI_TXMODE_ADD16          3
+#define DTAPI_TXMODE_MIN16          4
+#define DTAPI_TXMODE_RAW            5
+
+#define DTAPI_TX_FIFO_UFL           0x0002
+#define DTAPI_TX_SYNC_ERR           0x0004
+#define DTAPI_TX_READBACK_ERR       0x0008
+#define DTAPI_TX_TARGET_ERR         0x0010
+#define DTAPI_TX_MUX_OVF            0x0020
+#define DTAPI_TX_LINK_ERR           0x0040
+#define DTAPI_TX_DATA_ERR           0x0080
+
+#define DTAPI_UPCONV_NORMAL         0
+#define DTAPI_UPCONV_SPECINV        2
+
+/* Receive control, receive modes and flags */
+#define DTAPI_RXCTRL_IDLE           0
+#define DTAPI_RXCTRL_RCV            1
+#define DTAPI_RXMODE_ST188          1
+#define DTAPI_RX_FIFO_OVF           0x0002
+
+/* Modulation types */
+#define DTAPI_MOD_QAM16             3
+#define DTAPI_MOD_QAM32             4
+#define DTAPI_MOD_QAM64             5
+#define DTAPI_MOD_QAM128            6
+#define DTAPI_MOD_QAM256            7
+#define DTAPI_MOD_DVBT              8
+#define DTAPI_MOD_ATSC              9
+#define DTAPI_MOD_DVBT2             10
+#define DTAPI_MOD_ISDBT             11
+#define DTAPI_MOD_DVBS2_QPSK        32
+#define DTAPI_MOD_DVBS2_8PSK        33
+#define DTAPI_MOD_DVBS2_16APSK      34
+#define DTAPI_MOD_DVBS2_32APSK      35
+
+/* Code rates */
+#define DTAPI_MOD_1_2               0
+#define DTAPI_MOD_2_3               1
+#define DTAPI_MOD_3_4               2
+#define DTAPI_MOD_4_5               3
+#define DTAPI_MOD_5_6               4
+#define DTAPI_MOD_6_7               5
+#define DTAPI_MOD_7_8               6
+#define DTAPI_MOD_1_4               7
+#define DTAPI_MOD_1_3               8
+#define DTAPI_MOD_2_5               9
+#define DTAPI_MOD_3_5               10
+#define DTAPI_MOD_8_9               11
+#define DTAPI_MOD_9_10              12
+
+/* DVB-T parameters, OR'ed together */
+#define DTAPI_MOD_DVBT_5MHZ         0x00000001
+#define DTAPI_MOD_DVBT_6MHZ         0x00000002
+#define DTAPI_MOD_DVBT_7MHZ         0x00000003
+#define DTAPI_MOD_DVBT_8MHZ         0x00000004
+#define DTAPI_MOD_DVBT_BW_MSK       0x0000000f
+#define DTAPI_MOD_DVBT_QPSK         0x00000010
+#define DTAPI_MOD_DVBT_QAM16        0x00000020
+#define DTAPI_MOD_DVBT_QAM64        0x00000030
+#define DTAPI_MOD_DVBT_CO_MSK       0x000000f0
+#define DTAPI_MOD_DVBT_G_1_32       0x00000100
+#define DTAPI_MOD_DVBT_G_1_16       0x00000200
+#define DTAPI_MOD_DVBT_G_1_8        0x00000300
+#define DTAPI_MOD_DVBT_G_1_4        0x00000400
+#define DTAPI_MOD_DVBT_GU_MSK       0x00000f00
+#define DTAPI_MOD_DVBT_INDEPTH      0x00001000
+#define DTAPI_MOD_DVBT_NATIVE       0x00002000
+#define DTAPI_MOD_DVBT_IL_MSK       0x0000f000
+#define DTAPI_MOD_DVBT_2K           0x00010000
+#define DTAPI_MOD_DVBT_4K           0x00020000
+#define DTAPI_MOD_DVBT_8K           0x00030000
+#define DTAPI_MOD_DVBT_MD_MSK       0x000f0000
+
+/* J.83, ATSC and DVB-S2 parameters */
+#define DTAPI_MOD_J83_A             2
+#define DTAPI_MOD_J83_B             3
+#define DTAPI_MOD_J83_C             1
+#define DTAPI_MOD_QAMB_I128_J1D     0x1
+#define DTAPI_MOD_ATSC_VSB8         0x00000000
+#define DTAPI_MOD_ATSC_VSB16        0x00000001
+#define DTAPI_MOD_ATSC_VSB_MSK      0x00000003
+#define DTAPI_MOD_S2_NOPILOTS       0x00000000
+#define DTAPI_MOD_S2_PILOTS         0x00000001
+#define DTAPI_MOD_S2_PILOTS_MSK     0x00000001
+#define DTAPI_MOD_S2_LONGFRM        0x00000000
+#define DTAPI_MOD_S2_SHORTFRM       0x00000002
+#define DTAPI_MOD_S2_FRM_MSK        0x00000002
+
+/* DVB-T2 parameters */
+#define DTAPI_DVBT2_5MHZ            1
+#define DTAPI_DVBT2_6MHZ            2
+#define DTAPI_DVBT2_7MHZ            3
+#define DTAPI_DVBT2_8MHZ            4
+#define DTAPI_DVBT2_FFT_1K          0
+#define DTAPI_DVBT2_FFT_2K          1
+#define DTAPI_DVBT2_FFT_4K          2
+#define DTAPI_DVBT2_FFT_8K          3
+#define DTAPI_DVBT2_FFT_16K         4
+#define DTAPI_DVBT2_FFT_32K         5
+#define DTAPI_DVBT2_GI_1_32         0
+#define DTAPI_DVBT2_GI_1_16         1
+#define DTAPI_DVBT2_GI_1_8          2
+#define DTAPI_DVBT2_GI_1_4          3
+#define DTAPI_DVBT2_GI_1_128        4
+#define DTAPI_DVBT2_GI_19_128       5
+#define DTAPI_DVBT2_GI_19_256       6
+#define DTAPI_DVBT2_PP_1            1
+#define DTAPI_DVBT2_PP_2            2
+#define DTAPI_DVBT2_PP_3            3
+#define DTAPI_DVBT2_PP_4            4
+#define DTAPI_DVBT2_PP_5            5
+#define DTAPI_DVBT2_PP_6            6
+#define DTAPI_DVBT2_PP_7            7
+#define DTAPI_DVBT2_PP_8            8
+#define DTAPI_DVBT2_QPSK            0
+#define DTAPI_DVBT2_QAM16           1
+#define DTAPI_DVBT2_QAM64           2
+#define DTAPI_DVBT2_QAM256          3
+#define DTAPI_DVBT2_COD_1_2         0
+#define DTAPI_DVBT2_COD_3_5         1
+#define DTAPI_DVBT2_COD_2_3         2
+#define DTAPI_DVBT2_COD_3_4         3
+#define DTAPI_DVBT2_COD_4_5         4
+#define DTAPI_DVBT2_COD_5_6         5
+#define DTAPI_DVBT2_LDPC_16K        0
+#define DTAPI_DVBT2_LDPC_64K        1
+#define DTAPI_DVBT2_NUM_PLP_MAX     8
+#define DTAPI_PLPINP_TS188          0
+
+/* ISDB-T parameters */
+#define DTAPI_ISDBT_BTYPE_TV        0
+#define DTAPI_ISDBT_BW_6MHZ         1
+#define DTAPI_ISDBT_BW_7MHZ         2
+#define DTAPI_ISDBT_BW_8MHZ         3
+#define DTAPI_ISDBT_GUARD_1_32      0
+#define DTAPI_ISDBT_GUARD_1_16      1
+#define DTAPI_ISDBT_GUARD_1_8       2
+#define DTAPI_ISDBT_GUARD_1_4       3
+#define DTAPI_ISDBT_MOD_QPSK        1
+#define DTAPI_ISDBT_MOD_QAM16       2
+#define DTAPI_ISDBT_MOD_QAM64       3
+#define DTAPI_ISDBT_RATE_1_2        0
+#define DTAPI_ISDBT_RATE_2_3        1
+#define DTAPI_ISDBT_RATE_3_4        2
+#define DTAPI_ISDBT_RATE_5_6        3
+#define DTAPI_ISDBT_RATE_7_8        4
+
+/* The C tests only want the constants */
+#ifdef __cplusplus
+
+struct DtDvbT2ParamInfo
+{
+  int m_TotalCellsPerFrame;
+  int m_L1CellsPerFrame;
+};
+
+struct DtDvbT2PlpPars
+{
+  int m_Id;
+  int m_Modulation;
+  int m_CodeRate;
+  int m_FecType;
+  int m_NumBlocks;
+  void Init ();
+};
+
+struct DtDvbT2Pars
+{
+  int m_Bandwidth;
+  int m_FftMode;
+  int m_GuardInterval;
+  int m_PilotPattern;
+  int m_NumDataSyms;
+  int m_NumPlps;
+  DtDvbT2PlpPars m_Plps[DTAPI_DVBT2_NUM_PLP_MAX];
+
+  void Init ();
+  DTAPI_RESULT CheckValidity ();
+  DTAPI_RESULT OptimisePlpNumBlocks (DtDvbT2ParamInfo & Info, int & NumBlocks,
+      int & NumDataSyms);
+};
+
+struct DtPlpInpPars
+{
+  int m_DataType;
+  int m_FifoIdx;
+};
+
+struct DtMplpPars
+{
+  bool m_Enabled;
+  DtPlpInpPars m_PlpInps[DTAPI_DVBT2_NUM_PLP_MAX];
+  DtMplpPars () : m_Enabled (false) {}
+};
+
+struct DtIsdbtLayerPars
+{
+  int m_NumSegments;
+  int m_ModType;
+  int m_CodeRate;
+  int m_TimeInterleave;
+};
+
+struct DtIsdbtPars
+{
+  bool m_DoMux;
+  int m_BType;
+  bool m_PartialRx;
+  int m_Bandwidth;
+  int m_Mode;
+  int m_Guard;
+  DtIsdbtLayerPars m_LayerPars[3];
+};
+
+DTAPI_RESULT DtapiModPars2TsRate (int & TsRate, DtDvbT2Pars & Pars,
+    int PlpIdx = 0);
+
+class DtDevice
+{
+public:
+  DtDevice ();
+  virtual ~DtDevice ();
+  DTAPI_RESULT AttachToSerial (int64_t SerialNumber);
+  DTAPI_RESULT AttachToType (int TypeNumber, int DeviceNo = 0);
+  DTAPI_RESULT Detach ();
+
+  /* Which time the stand-in was plugged in when we attached, or -1 */
+  int m_Plug;
+};
+
+class DtOutpChannel
+{
+public:
+  DtOutpChannel ();
+  virtual ~DtOutpChannel ();
+  DTAPI_RESULT AttachToPort (DtDevice * pDtDvc, int Port,
+      bool ProbeOnly = false);
+  DTAPI_RESULT Detach (int DetachMode);
+  DTAPI_RESULT Write (char * pBuffer, int NumBytesToWrite, int FifoIdx = 0);
+  DTAPI_RESULT Reset (int ResetMode);
+  DTAPI_RESULT GetFifoLoad (int & FifoLoad, int FifoIdx = 0);
+  DTAPI_RESULT GetFifoSize (int & FifoSize);
+  DTAPI_RESULT GetFlags (int & Status, int & Latched);
+  DTAPI_RESULT GetModControl (int & ModType, int & ParXtra0, int & ParXtra1,
+      int & ParXtra2, void * & pXtraPars);
+  DTAPI_RESULT GetOutputLevel (int & LeveldBm);
+  DTAPI_RESULT GetRfControl (int64_t & RfFreq, int & LockStatus);
+  DTAPI_RESULT GetTsRateBps (int & TsRate);
+  DTAPI_RESULT GetTxControl (int & TxControl);
+  DTAPI_RESULT GetTxMode (int & TxMode, int & StuffMode);
+  DTAPI_RESULT SetModControl (int ModType, int ParXtra0, int ParXtra1,
+      int ParXtra2);
+  DTAPI_RESULT SetModControl (DtDvbT2Pars & T2Pars);
+  DTAPI_RESULT SetModControl (DtDvbT2Pars & T2Pars, DtMplpPars & MplpPars);
+  DTAPI_RESULT SetModControl (DtIsdbtPars & IsdbtPars);
+  DTAPI_RESULT SetOutputLevel (int LeveldBm);
+  DTAPI_RESULT SetRfControl (int64_t RfFreq);
+  DTAPI_RESULT SetRfMode (int RfMode);
+  DTAPI_RESULT SetSymSampleRate (int SymSampleRate);
+  DTAPI_RESULT SetTsRateBps (int TsRate);
+  DTAPI_RESULT SetTxControl (int TxControl);
+  DTAPI_RESULT SetTxMode (int TxMode, int StuffMode);
+
+  int m_Plug;
+};
+
+class DtInpChannel
+{
+public:
+  DtInpChannel ();
+  virtual ~DtInpChannel ();
+  DTAPI_RESULT AttachToPort (DtDevice * pDtDvc, int Port,
+      bool ProbeOnly = false);
+  DTAPI_RESULT Detach (int DetachMode);
+  DTAPI_RESULT ClearFlags (int Latched);
+  DTAPI_RESULT GetFifoLoad (int & FifoLoad);
+  DTAPI_RESULT GetFlags (int & Status, int & Latched);
+  DTAPI_RESULT Read (char * pBuffer, int NumBytesToRead, int TimeOut);
+  DTAPI_RESULT Reset (int ResetMode);
+  DTAPI_RESULT SetRxControl (int RxControl);
+  DTAPI_RESULT SetRxMode (int RxMode);
+
+  int m_Plug;
+};
+
+#endif /* __cplusplus */
+#endif /* __DTAPI_H */
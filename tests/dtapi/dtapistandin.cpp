@@ -0,0 +1,705 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * dtapistandin.cpp: A software DTU-215 in place of DTAPI.o, for the tests
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "DTAPI.h"
+#include "dtapistandin.h"
+
+#define STANDIN_TYPE_NUMBER 215
+
+/* The one device and its output.  Everything is protected by lock; cond is
+   signalled whenever something a blocked Write is waiting on changes. */
+static struct
+{
+  GMutex lock;
+  GCond cond;
+
+  guint fail;
+  /* Goes up every time the device is unplugged */
+  int plug;
+  guint attach_count;
+  guint64 bytes_written;
+  guint64 write_count;
+  guint resets;
+
+  /* When the last Write returned, and the longest wait for the next since
+     dtapi_standin_max_write_gap was called */
+  gint64 write_end;
+  gint64 max_write_gap;
+
+  int tx_control;
+  int tx_mode;
+  int stuff_mode;
+  int ts_rate;
+  int output_level;
+  int rf_mode;
+  int64_t frequency;
+  int mod_type;
+  int par_xtra[3];
+
+  /* The FIFO held load bytes at load_time, and drains from then on at
+     ts_rate if we're sending */
+  gdouble load;
+  gint64 load_time;
+
+  /* The input's FIFO held in_load bytes at in_load_time and fills from then
+     on at in_rate if we're receiving.  in_read is everything Read has
+     taken, which says where in a packet the next Read starts. */
+  int rx_control;
+  int in_rate;
+  int in_latched;
+  gdouble in_load;
+  gint64 in_load_time;
+  guint64 in_read;
+} standin;
+
+static void
+reset_output (void)
+{
+  standin.tx_control = DTAPI_TXCTRL_IDLE;
+  standin.tx_mode = DTAPI_TXMODE_188;
+  standin.stuff_mode = 0;
+  standin.ts_rate = 0;
+  standin.output_level = -270;
+  standin.rf_mode = DTAPI_UPCONV_NORMAL;
+  standin.frequency = 578000000;
+  standin.mod_type = -1;
+  standin.par_xtra[0] = standin.par_xtra[1] = standin.par_xtra[2] = -1;
+  standin.load = 0;
+  standin.load_time = g_get_monotonic_time ();
+}
+
+static void
+reset_input (void)
+{
+  standin.rx_control = DTAPI_RXCTRL_IDLE;
+  standin.in_latched = 0;
+  standin.in_load = 0;
+  standin.in_load_time = g_get_monotonic_time ();
+}
+
+/* Brings the FIFO load up to date.  Call with the lock held. */
+static void
+drain (void)
+{
+  gint64 now = g_get_monotonic_time ();
+
+  if (standin.tx_control == DTAPI_TXCTRL_SEND && standin.ts_rate > 0) {
+    standin.load -= (now - standin.load_time) * (standin.ts_rate / 8.0) /
+        G_USEC_PER_SEC;
+    standin.load = MAX (standin.load, 0);
+  }
+  standin.load_time = now;
+}
+
+/* Brings the input FIFO load up to date, losing what doesn't fit.  Call
+   with the lock held. */
+static void
+fill (void)
+{
+  gint64 now = g_get_monotonic_time ();
+
+  if (standin.rx_control == DTAPI_RXCTRL_RCV && standin.in_rate > 0) {
+    standin.in_load += (now - standin.in_load_time) *
+        (standin.in_rate / 8.0) / G_USEC_PER_SEC;
+    if (standin.in_load > DTAPI_STANDIN_FIFO_SIZE) {
+      standin.in_load = DTAPI_STANDIN_FIFO_SIZE;
+      standin.in_latched |= DTAPI_RX_FIFO_OVF;
+    }
+  }
+  standin.in_load_time = now;
+}
+
+/* Why a call on something attached at plug can't be made, if it can't */
+static DTAPI_RESULT
+check (int plug)
+{
+  if (standin.fail)
+    return standin.fail;
+  if (plug < 0 || plug != standin.plug)
+    return DTAPI_E_NOT_ATTACHED;
+  return DTAPI_OK;
+}
+
+/* Locks the stand-in for the rest of the scope */
+class StandinLock
+{
+public:
+  StandinLock () { g_mutex_lock (&standin.lock); }
+  ~StandinLock () { g_mutex_unlock (&standin.lock); }
+};
+
+#define CHECK_ATTACHED() \
+  StandinLock locker; \
+  DTAPI_RESULT result = check (m_Plug); \
+  if (result != DTAPI_OK) \
+    return result
+
+void
+dtapi_standin_fail (guint result)
+{
+  StandinLock locker;
+
+  standin.fail = result;
+  if (result != DTAPI_OK) {
+    standin.plug++;
+    reset_output ();
+    reset_input ();
+  }
+  g_cond_broadcast (&standin.cond);
+}
+
+void
+dtapi_standin_set_input_rate (int rate)
+{
+  StandinLock locker;
+
+  fill ();
+  standin.in_rate = rate;
+  g_cond_broadcast (&standin.cond);
+}
+
+guint64
+dtapi_standin_bytes_written (void)
+{
+  StandinLock locker;
+
+  return standin.bytes_written;
+}
+
+guint64
+dtapi_standin_write_count (void)
+{
+  StandinLock locker;
+
+  return standin.write_count;
+}
+
+guint
+dtapi_standin_attach_count (void)
+{
+  StandinLock locker;
+
+  return standin.attach_count;
+}
+
+gint64
+dtapi_standin_max_write_gap (void)
+{
+  StandinLock locker;
+  gint64 gap = standin.max_write_gap;
+
+  standin.write_end = 0;
+  standin.max_write_gap = 0;
+  return gap;
+}
+
+/* DtDevice */
+
+DtDevice::DtDevice () : m_Plug (-1)
+{
+}
+
+DtDevice::~DtDevice ()
+{
+}
+
+DTAPI_RESULT
+DtDevice::AttachToSerial (int64_t SerialNumber)
+{
+  return AttachToType (STANDIN_TYPE_NUMBER);
+}
+
+DTAPI_RESULT
+DtDevice::AttachToType (int TypeNumber, int DeviceNo)
+{
+  StandinLock locker;
+
+  if (standin.fail)
+    return standin.fail;
+  if (TypeNumber != STANDIN_TYPE_NUMBER || DeviceNo != 0)
+    return DTAPI_E_NO_DTDEVICE;
+  m_Plug = standin.plug;
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtDevice::Detach ()
+{
+  m_Plug = -1;
+  return DTAPI_OK;
+}
+
+/* DtOutpChannel */
+
+DtOutpChannel::DtOutpChannel () : m_Plug (-1)
+{
+}
+
+DtOutpChannel::~DtOutpChannel ()
+{
+}
+
+DTAPI_RESULT
+DtOutpChannel::AttachToPort (DtDevice * pDtDvc, int Port, bool ProbeOnly)
+{
+  StandinLock locker;
+  DTAPI_RESULT result = check (pDtDvc->m_Plug);
+
+  if (result != DTAPI_OK)
+    return result;
+  if (Port != 1)
+    return DTAPI_E_NOT_SUPPORTED;
+  m_Plug = standin.plug;
+  standin.attach_count++;
+  reset_output ();
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtOutpChannel::Detach (int DetachMode)
+{
+  StandinLock locker;
+
+  if (m_Plug >= 0 && m_Plug == standin.plug) {
+    reset_output ();
+    g_cond_broadcast (&standin.cond);
+  }
+  m_Plug = -1;
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtOutpChannel::Write (char * pBuffer, int NumBytesToWrite, int FifoIdx)
+{
+  guint resets;
+
+  CHECK_ATTACHED ();
+  standin.write_count++;
+  if (standin.write_end != 0)
+    standin.max_write_gap = MAX (standin.max_write_gap,
+        g_get_monotonic_time () - standin.write_end);
+
+  if (NumBytesToWrite < 0 || NumBytesToWrite % 4 != 0)
+    return DTAPI_E_INVALID_SIZE;
+  if (GPOINTER_TO_SIZE (pBuffer) % 4 != 0)
+    return DTAPI_E_INVALID_BUF;
+  if (standin.tx_control == DTAPI_TXCTRL_IDLE)
+    return DTAPI_E_IDLE;
+
+  /* Wait for room, as long as the device is still there and nobody resets
+     the FIFO from under us */
+  resets = standin.resets;
+  for (drain (); standin.load + NumBytesToWrite > DTAPI_STANDIN_FIFO_SIZE;
+       drain ()) {
+    gint64 wait_us = G_USEC_PER_SEC / 100;
+
+    if (standin.tx_control == DTAPI_TXCTRL_SEND && standin.ts_rate > 0)
+      wait_us = MIN (wait_us, (standin.load + NumBytesToWrite -
+          DTAPI_STANDIN_FIFO_SIZE) * 8 * G_USEC_PER_SEC / standin.ts_rate + 1);
+    g_cond_wait_until (&standin.cond, &standin.lock,
+        g_get_monotonic_time () + wait_us);
+    if ((result = check (m_Plug)) != DTAPI_OK)
+      return result;
+    if (standin.resets != resets)
+      return DTAPI_OK;
+  }
+
+  standin.load += NumBytesToWrite;
+  standin.bytes_written += NumBytesToWrite;
+  standin.write_end = g_get_monotonic_time ();
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtOutpChannel::Reset (int ResetMode)
+{
+  CHECK_ATTACHED ();
+  standin.load = 0;
+  standin.resets++;
+  g_cond_broadcast (&standin.cond);
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtOutpChannel::GetFifoLoad (int & FifoLoad, int FifoIdx)
+{
+  CHECK_ATTACHED ();
+  drain ();
+  FifoLoad = (int) standin.load;
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtOutpChannel::GetFifoSize (int & FifoSize)
+{
+  CHECK_ATTACHED ();
+  FifoSize = DTAPI_STANDIN_FIFO_SIZE;
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtOutpChannel::GetFlags (int & Status, int & Latched)
+{
+  CHECK_ATTACHED ();
+  Status = Latched = 0;
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtOutpChannel::GetModControl (int & ModType, int & ParXtra0, int & ParXtra1,
+    int & ParXtra2, void * & pXtraPars)
+{
+  CHECK_ATTACHED ();
+  if (standin.mod_type < 0)
+    return DTAPI_E_MODPARS_NOT_SET;
+  ModType = standin.mod_type;
+  ParXtra0 = standin.par_xtra[0];
+  ParXtra1 = standin.par_xtra[1];
+  ParXtra2 = standin.par_xtra[2];
+  pXtraPars = NULL;
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtOutpChannel::GetOutputLevel (int & LeveldBm)
+{
+  CHECK_ATTACHED ();
+  LeveldBm = standin.output_level;
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtOutpChannel::GetRfControl (int64_t & RfFreq, int & LockStatus)
+{
+  CHECK_ATTACHED ();
+  RfFreq = standin.frequency;
+  LockStatus = 1;
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtOutpChannel::GetTsRateBps (int & TsRate)
+{
+  CHECK_ATTACHED ();
+  TsRate = standin.ts_rate;
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtOutpChannel::GetTxControl (int & TxControl)
+{
+  CHECK_ATTACHED ();
+  TxControl = standin.tx_control;
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtOutpChannel::GetTxMode (int & TxMode, int & StuffMode)
+{
+  CHECK_ATTACHED ();
+  TxMode = standin.tx_mode;
+  StuffMode = standin.stuff_mode;
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtOutpChannel::SetModControl (int ModType, int ParXtra0, int ParXtra1,
+    int ParXtra2)
+{
+  CHECK_ATTACHED ();
+  if (standin.tx_control != DTAPI_TXCTRL_IDLE)
+    return DTAPI_E_IDLE;
+  standin.mod_type = ModType;
+  standin.par_xtra[0] = ParXtra0;
+  standin.par_xtra[1] = ParXtra1;
+  standin.par_xtra[2] = ParXtra2;
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtOutpChannel::SetModControl (DtDvbT2Pars & T2Pars)
+{
+  return SetModControl (DTAPI_MOD_DVBT2, -1, -1, -1);
+}
+
+DTAPI_RESULT
+DtOutpChannel::SetModControl (DtDvbT2Pars & T2Pars, DtMplpPars & MplpPars)
+{
+  return SetModControl (DTAPI_MOD_DVBT2, -1, -1, -1);
+}
+
+DTAPI_RESULT
+DtOutpChannel::SetModControl (DtIsdbtPars & IsdbtPars)
+{
+  return SetModControl (DTAPI_MOD_ISDBT, -1, -1, -1);
+}
+
+DTAPI_RESULT
+DtOutpChannel::SetOutputLevel (int LeveldBm)
+{
+  CHECK_ATTACHED ();
+  standin.output_level = LeveldBm;
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtOutpChannel::SetRfControl (int64_t RfFreq)
+{
+  CHECK_ATTACHED ();
+  standin.frequency = RfFreq;
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtOutpChannel::SetRfMode (int RfMode)
+{
+  CHECK_ATTACHED ();
+  standin.rf_mode = RfMode;
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtOutpChannel::SetSymSampleRate (int SymSampleRate)
+{
+  CHECK_ATTACHED ();
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtOutpChannel::SetTsRateBps (int TsRate)
+{
+  CHECK_ATTACHED ();
+  if (TsRate <= 0)
+    return DTAPI_E_INVALID_RATE;
+  drain ();
+  standin.ts_rate = TsRate;
+  g_cond_broadcast (&standin.cond);
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtOutpChannel::SetTxControl (int TxControl)
+{
+  CHECK_ATTACHED ();
+  if (TxControl == DTAPI_TXCTRL_SEND && standin.ts_rate <= 0)
+    return DTAPI_E_NO_TSRATE;
+  if (TxControl == DTAPI_TXCTRL_SEND && standin.mod_type < 0)
+    return DTAPI_E_MODPARS_NOT_SET;
+  drain ();
+  standin.tx_control = TxControl;
+  if (TxControl == DTAPI_TXCTRL_IDLE)
+    standin.load = 0;
+  g_cond_broadcast (&standin.cond);
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtOutpChannel::SetTxMode (int TxMode, int StuffMode)
+{
+  CHECK_ATTACHED ();
+  standin.tx_mode = TxMode;
+  standin.stuff_mode = StuffMode;
+  return DTAPI_OK;
+}
+
+/* DtInpChannel */
+
+DtInpChannel::DtInpChannel () : m_Plug (-1)
+{
+}
+
+DtInpChannel::~DtInpChannel ()
+{
+}
+
+DTAPI_RESULT
+DtInpChannel::AttachToPort (DtDevice * pDtDvc, int Port, bool ProbeOnly)
+{
+  StandinLock locker;
+  DTAPI_RESULT result = check (pDtDvc->m_Plug);
+
+  if (result != DTAPI_OK)
+    return result;
+  if (Port != DTAPI_STANDIN_INPUT_PORT)
+    return DTAPI_E_NOT_SUPPORTED;
+  m_Plug = standin.plug;
+  reset_input ();
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtInpChannel::Detach (int DetachMode)
+{
+  StandinLock locker;
+
+  if (m_Plug >= 0 && m_Plug == standin.plug) {
+    reset_input ();
+    g_cond_broadcast (&standin.cond);
+  }
+  m_Plug = -1;
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtInpChannel::ClearFlags (int Latched)
+{
+  CHECK_ATTACHED ();
+  standin.in_latched &= ~Latched;
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtInpChannel::GetFifoLoad (int & FifoLoad)
+{
+  CHECK_ATTACHED ();
+  fill ();
+  FifoLoad = (int) standin.in_load;
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtInpChannel::GetFlags (int & Status, int & Latched)
+{
+  CHECK_ATTACHED ();
+  fill ();
+  Status = standin.in_load >= DTAPI_STANDIN_FIFO_SIZE ? DTAPI_RX_FIFO_OVF : 0;
+  Latched = standin.in_latched;
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtInpChannel::Read (char * pBuffer, int NumBytesToRead, int TimeOut)
+{
+  gint64 deadline;
+  int i;
+
+  CHECK_ATTACHED ();
+  if (NumBytesToRead < 0 || NumBytesToRead % 4 != 0)
+    return DTAPI_E_INVALID_SIZE;
+  if (GPOINTER_TO_SIZE (pBuffer) % 4 != 0)
+    return DTAPI_E_INVALID_BUF;
+
+  /* A negative TimeOut waits for as long as it takes */
+  deadline = TimeOut < 0 ? G_MAXINT64 :
+      g_get_monotonic_time () + (gint64) TimeOut * 1000;
+  for (fill (); standin.in_load < NumBytesToRead; fill ()) {
+    gint64 now = g_get_monotonic_time (), wait_us = G_USEC_PER_SEC / 100;
+
+    if (now >= deadline)
+      return DTAPI_E_TIMEOUT;
+    if (standin.rx_control == DTAPI_RXCTRL_RCV && standin.in_rate > 0)
+      wait_us = MIN (wait_us, (NumBytesToRead - standin.in_load) * 8 *
+          G_USEC_PER_SEC / standin.in_rate + 1);
+    g_cond_wait_until (&standin.cond, &standin.lock,
+        MIN (now + wait_us, deadline));
+    if ((result = check (m_Plug)) != DTAPI_OK)
+      return result;
+  }
+
+  /* Null packets, carrying on from where the last Read left off */
+  for (i = 0; i < NumBytesToRead; i++, standin.in_read++) {
+    switch (standin.in_read % 188) {
+    case 0: pBuffer[i] = 0x47; break;
+    case 1: pBuffer[i] = 0x1f; break;
+    case 2: pBuffer[i] = (char) 0xff; break;
+    case 3: pBuffer[i] = 0x10; break;
+    default: pBuffer[i] = (char) 0xff; break;
+    }
+  }
+  standin.in_load -= NumBytesToRead;
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtInpChannel::Reset (int ResetMode)
+{
+  CHECK_ATTACHED ();
+  fill ();
+  standin.in_load = 0;
+  /* Anything part read is gone, so the next packet starts afresh */
+  standin.in_read = 0;
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtInpChannel::SetRxControl (int RxControl)
+{
+  CHECK_ATTACHED ();
+  fill ();
+  standin.rx_control = RxControl;
+  g_cond_broadcast (&standin.cond);
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtInpChannel::SetRxMode (int RxMode)
+{
+  CHECK_ATTACHED ();
+  if (RxMode != DTAPI_RXMODE_ST188)
+    return DTAPI_E_NOT_SUPPORTED;
+  return DTAPI_OK;
+}
+
+/* DVB-T2 parameters.  There's no frame structure to work out: every PLP
+   gets 100 FEC blocks on its own, and each block is worth 300 kb/s. */
+
+void
+DtDvbT2PlpPars::Init ()
+{
+  memset (this, 0, sizeof (*this));
+}
+
+void
+DtDvbT2Pars::Init ()
+{
+  memset (this, 0, sizeof (*this));
+  m_NumPlps = 1;
+}
+
+DTAPI_RESULT
+DtDvbT2Pars::CheckValidity ()
+{
+  if (m_NumPlps < 1 || m_NumPlps > DTAPI_DVBT2_NUM_PLP_MAX)
+    return DTAPI_E_NOT_SUPPORTED;
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtDvbT2Pars::OptimisePlpNumBlocks (DtDvbT2ParamInfo & Info, int & NumBlocks,
+    int & NumDataSyms)
+{
+  NumBlocks = 100;
+  NumDataSyms = 60;
+  return DTAPI_OK;
+}
+
+DTAPI_RESULT
+DtapiModPars2TsRate (int & TsRate, DtDvbT2Pars & Pars, int PlpIdx)
+{
+  if (PlpIdx < 0 || PlpIdx >= Pars.m_NumPlps)
+    return DTAPI_E_NOT_SUPPORTED;
+  TsRate = Pars.m_Plps[PlpIdx].m_NumBlocks * 300000;
+  return DTAPI_OK;
+}
@@ -0,0 +1,68 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * dtapistandin.h: Controls for the stand-in DTAPI device
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __DTAPI_STANDIN_H__
+#define __DTAPI_STANDIN_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* There is one stand-in device, a DTU-215 on which every DtOutpChannel
+   attaches to the same output, port 1.  Its FIFO drains at the TS rate once
+   it has been told to send, so Write blocks just as it would on the real
+   thing.  Every DtInpChannel attaches to the same input, port 2, whose FIFO
+   fills with null packets at the input rate while it is receiving. */
+
+/* The stand-in's FIFO size in bytes, for the output and the input */
+#define DTAPI_STANDIN_FIFO_SIZE (1024 * 1024)
+#define DTAPI_STANDIN_INPUT_PORT 2
+
+/* From now on every call to the device (Write, attaching, getting and
+   setting anything) fails with result, as though it had been unplugged or
+   its driver had fallen over.  A Write blocked on a full FIFO fails
+   straight away.  0 plugs it back in, but whatever was attached before
+   it failed has to attach again and set everything up from scratch. */
+void dtapi_standin_fail (guint result);
+
+/* The rate in bits per second that packets arrive at the input.  0, the
+   default, leaves it silent.  Once its FIFO is full whatever arrives is
+   lost and DTAPI_RX_FIFO_OVF is latched. */
+void dtapi_standin_set_input_rate (int rate);
+
+/* Everything accepted by Write since the program started */
+guint64 dtapi_standin_bytes_written (void);
+
+/* The number of calls made to Write while attached since the program
+   started, whether they were accepted or not */
+guint64 dtapi_standin_write_count (void);
+
+/* The number of times the output has been attached to */
+guint dtapi_standin_attach_count (void);
+
+/* The longest the device has been left between one Write returning and the
+   next being made since this was last called, in microseconds.  Starts
+   again from the next Write. */
+gint64 dtapi_standin_max_write_gap (void);
+
+G_END_DECLS
+#endif /* __DTAPI_STANDIN_H__ */
@@ -0,0 +1,204 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * test-call-stats.c: dtapisink's count of the calls it makes to the device
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Streams into dtapisink on the stand-in device and checks that call-stats
+   counts nothing with profile-calls off, and with it on counts as many
+   Writes as the stand-in saw, with a histogram and times that add up.
+   Then flushes the sink, so the application thread Resets the channel
+   while the streaming thread is in Write, and checks the Reset is counted
+   too. */
+
+#include <stdio.h>
+#include <gst/gst.h>
+
+#include "dtapistandin.h"
+#include "gstdtapisink.h"
+#include "gstdtapitestsrc.h"
+
+/* profile-calls may be switched while a Write is on its way into the
+   stand-in, at either end */
+#define EDGE_WRITES 2
+
+#define TIMEOUT (5 * GST_SECOND)
+
+/* Waits for the stand-in to have taken another few FIFOs' worth of data */
+static gboolean
+wait_for_writes (void)
+{
+  guint64 from = dtapi_standin_bytes_written ();
+  gint64 deadline = g_get_monotonic_time () + TIMEOUT / GST_USECOND;
+
+  while (dtapi_standin_bytes_written () - from < 4 * DTAPI_STANDIN_FIFO_SIZE) {
+    if (g_get_monotonic_time () > deadline) {
+      g_printerr ("dtapisink isn't writing anything\n");
+      return FALSE;
+    }
+    g_usleep (10000);
+  }
+  return TRUE;
+}
+
+static gboolean
+add_bucket (GQuark field, const GValue * value, gpointer user_data)
+{
+  *(guint64 *) user_data += g_value_get_uint64 (value);
+  return TRUE;
+}
+
+/* The number of calls made to method, checking that its stats add up.  -1
+   if they don't. */
+static gint64
+get_calls (GstElement * sink, const gchar * method)
+{
+  GstStructure *stats, *calls = NULL, *histogram = NULL;
+  guint64 count = 0, total = 0, mean = 0, max = 0, in_histogram = 0;
+  gint64 ret = -1;
+
+  g_object_get (sink, "call-stats", &stats, NULL);
+  if (!gst_structure_has_field (stats, method)) {
+    gst_structure_free (stats);
+    return 0;
+  }
+  gst_structure_get (stats, method, GST_TYPE_STRUCTURE, &calls, NULL);
+  gst_structure_get (calls, "count", G_TYPE_UINT64, &count,
+      "total", G_TYPE_UINT64, &total, "mean", G_TYPE_UINT64, &mean,
+      "max", G_TYPE_UINT64, &max, "histogram", GST_TYPE_STRUCTURE,
+      &histogram, NULL);
+  if (histogram)
+    gst_structure_foreach (histogram, add_bucket, &in_histogram);
+
+  if (count == 0)
+    g_printerr ("%s is there with no calls\n", method);
+  else if (in_histogram != count)
+    g_printerr ("%s's histogram has %" G_GUINT64_FORMAT " calls, not %"
+        G_GUINT64_FORMAT "\n", method, in_histogram, count);
+  else if (max > total || mean != total / count)
+    g_printerr ("%s's times don't add up\n", method);
+  else
+    ret = (gint64) count;
+
+  if (histogram)
+    gst_structure_free (histogram);
+  gst_structure_free (calls);
+  gst_structure_free (stats);
+  return ret;
+}
+
+static gboolean
+test_off (GstElement * sink)
+{
+  GstStructure *stats;
+  gint n_fields;
+
+  if (!wait_for_writes ())
+    return FALSE;
+  g_object_get (sink, "call-stats", &stats, NULL);
+  n_fields = gst_structure_n_fields (stats);
+  gst_structure_free (stats);
+  if (n_fields != 0) {
+    g_printerr ("call-stats counted %d methods with profile-calls off\n",
+        n_fields);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static gboolean
+test_writes (GstElement * sink)
+{
+  guint64 from, writes;
+  gint64 counted;
+
+  from = dtapi_standin_write_count ();
+  g_object_set (sink, "profile-calls", TRUE, NULL);
+  if (!wait_for_writes ())
+    return FALSE;
+  g_object_set (sink, "profile-calls", FALSE, NULL);
+  writes = dtapi_standin_write_count () - from;
+
+  if ((counted = get_calls (sink, "Write")) < 0)
+    return FALSE;
+  printf ("Counted %" G_GINT64_FORMAT " Writes, the device saw %"
+      G_GUINT64_FORMAT "\n", counted, writes);
+  if ((guint64) counted + EDGE_WRITES < writes ||
+      (guint64) counted > writes + EDGE_WRITES) {
+    g_printerr ("The Write count is wrong\n");
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static gboolean
+test_flush (GstElement * sink)
+{
+  GstPad *pad = gst_element_get_static_pad (sink, "sink");
+  gint64 before, after;
+
+  if ((before = get_calls (sink, "Reset")) < 0)
+    return FALSE;
+  g_object_set (sink, "profile-calls", TRUE, NULL);
+  gst_pad_send_event (pad, gst_event_new_flush_start ());
+  gst_pad_send_event (pad, gst_event_new_flush_stop (TRUE));
+  g_object_set (sink, "profile-calls", FALSE, NULL);
+  gst_object_unref (pad);
+
+  if ((after = get_calls (sink, "Reset")) < 0)
+    return FALSE;
+  if (after <= before) {
+    g_printerr ("The Reset made by flushing wasn't counted\n");
+    return FALSE;
+  }
+  return get_calls (sink, "Write") >= 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  GstElement *pipeline, *sink;
+  GError *error = NULL;
+  gboolean ok;
+
+  gst_init (&argc, &argv);
+
+  if (!gst_dtapisink_plugin_init (NULL) ||
+      !gst_dtapitestsrc_plugin_init (NULL)) {
+    g_printerr ("Couldn't register the elements\n");
+    return 1;
+  }
+  pipeline = gst_parse_launch ("dtapitestsrc mode=null ! "
+      "dtapisink name=sink sync=false", &error);
+  if (pipeline == NULL) {
+    g_printerr ("Couldn't make the pipeline: %s\n", error->message);
+    g_error_free (error);
+    return 1;
+  }
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  ok = test_off (sink) && test_writes (sink) && test_flush (sink);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (sink);
+  gst_object_unref (pipeline);
+
+  return ok ? 0 : 1;
+}
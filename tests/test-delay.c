@@ -0,0 +1,256 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * test-delay.c: the delay line holding, skipping and releasing data
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Streams numbered packets through a delay line in odd sized writes, taking
+   out whatever is due after each, and checks that nothing comes out before
+   it has been held for the delay and that what comes out is what went in.
+   Goes round the file several times, then shortens the delay, which must
+   skip whole packets, and lengthens it again, which must hold everything
+   back until there's enough in the line.  Finally releases it, which must
+   let out everything down to the last byte, and clears it. */
+
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+
+#include "gstdtapidelay.h"
+
+#define TS_PACKET_SIZE 188
+#define HOLD (TS_PACKET_SIZE * 5000)
+#define CHUNK 1500
+
+typedef struct
+{
+  GstDTAPIDelay *delay;
+  gsize hold;
+  /* Bytes of the stream written to the line, taken out of it and skipped
+     when the delay was shortened */
+  guint64 in;
+  guint64 out;
+  guint64 skipped;
+} Stream;
+
+/* The byte at pos in the stream: packets with a sync byte, their number
+   and then a pattern that changes with it */
+static guint8
+byte_at (guint64 pos)
+{
+  guint32 packet = (guint32) (pos / TS_PACKET_SIZE);
+  guint offset = pos % TS_PACKET_SIZE;
+
+  if (offset == 0)
+    return 0x47;
+  if (offset >= 4 && offset < 8)
+    return (packet >> (8 * (offset - 4))) & 0xff;
+  return (packet + offset) & 0xff;
+}
+
+/* Takes out everything that's due, checking it is the stream carrying on
+   from where the last came out */
+static gboolean
+take_out (Stream * s)
+{
+  const guint8 *data;
+  guint64 from = s->out;
+  gsize len, i;
+
+  while ((len = gst_dtapi_delay_peek (s->delay, &data)) > 0) {
+    for (i = 0; i < len; i++) {
+      if (data[i] != byte_at (s->out + s->skipped + i)) {
+        g_printerr ("Byte %" G_GUINT64_FORMAT " out is wrong\n",
+            s->out + i);
+        return FALSE;
+      }
+    }
+    gst_dtapi_delay_consume (s->delay, len);
+    s->out += len;
+  }
+
+  if (gst_dtapi_delay_get_fill (s->delay) != s->in - s->out - s->skipped) {
+    g_printerr ("The line says it holds %" G_GSIZE_FORMAT " bytes, not %"
+        G_GUINT64_FORMAT "\n", gst_dtapi_delay_get_fill (s->delay),
+        s->in - s->out - s->skipped);
+    return FALSE;
+  }
+  /* What came out had the whole delay behind it */
+  if (s->out > from && s->in - s->out - s->skipped < s->hold) {
+    g_printerr ("Only %" G_GUINT64_FORMAT " bytes are held, not %"
+        G_GSIZE_FORMAT "\n", s->in - s->out - s->skipped, s->hold);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/* Writes another len bytes of the stream, taking out what's due as it
+   goes */
+static gboolean
+put_in (Stream * s, guint64 len)
+{
+  guint8 chunk[CHUNK];
+  guint64 end = s->in + len;
+  gchar *error = NULL;
+  gssize written;
+  gsize n, i;
+
+  while (s->in < end) {
+    n = MIN (end - s->in, CHUNK);
+    for (i = 0; i < n; i++)
+      chunk[i] = byte_at (s->in + i);
+    if ((written = gst_dtapi_delay_write (s->delay, chunk, n, &error)) < 0) {
+      g_printerr ("%s\n", error);
+      g_free (error);
+      return FALSE;
+    }
+    s->in += written;
+    if (!take_out (s))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+static gboolean
+set_hold (Stream * s, gsize hold)
+{
+  gsize before = gst_dtapi_delay_get_fill (s->delay);
+
+  if (!gst_dtapi_delay_set_hold (s->delay, hold)) {
+    g_printerr ("Couldn't change the delay to %" G_GSIZE_FORMAT "\n", hold);
+    return FALSE;
+  }
+  s->hold = hold;
+  s->skipped += before - gst_dtapi_delay_get_fill (s->delay);
+  if (s->skipped % TS_PACKET_SIZE != 0) {
+    g_printerr ("Skipped a part packet\n");
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static gboolean
+test_hold (Stream * s)
+{
+  /* Nothing comes out while it fills up */
+  if (!put_in (s, HOLD))
+    return FALSE;
+  if (s->out != 0) {
+    g_printerr ("%" G_GUINT64_FORMAT " bytes came out before the line was "
+        "full\n", s->out);
+    return FALSE;
+  }
+  /* and then it goes round and round the file */
+  return put_in (s, 10 * (gst_dtapi_delay_get_max_hold (s->delay) + HOLD));
+}
+
+static gboolean
+test_shorten (Stream * s)
+{
+  guint64 skipped = s->skipped;
+
+  /* Not a whole number of packets short, so it has to round */
+  if (!set_hold (s, HOLD / 2 + 100))
+    return FALSE;
+  if (s->skipped == skipped) {
+    g_printerr ("Nothing was skipped when the delay was shortened\n");
+    return FALSE;
+  }
+  return take_out (s) && put_in (s, 4 * HOLD);
+}
+
+static gboolean
+test_lengthen (Stream * s)
+{
+  guint64 out, skipped = s->skipped;
+
+  if (gst_dtapi_delay_set_hold (s->delay,
+          gst_dtapi_delay_get_max_hold (s->delay) + 4)) {
+    g_printerr ("The delay was made longer than there's room for\n");
+    return FALSE;
+  }
+  if (!set_hold (s, HOLD))
+    return FALSE;
+
+  /* Held back until there's enough in the line */
+  out = s->out;
+  if (!put_in (s, HOLD / 4))
+    return FALSE;
+  if (s->out != out || s->skipped != skipped) {
+    g_printerr ("Data came out or was skipped when the delay was "
+        "lengthened\n");
+    return FALSE;
+  }
+  return put_in (s, 4 * HOLD);
+}
+
+static gboolean
+test_release (Stream * s)
+{
+  gchar *error = NULL;
+  const guint8 *data;
+
+  /* A write that doesn't end on a block boundary */
+  if (!put_in (s, CHUNK + 4))
+    return FALSE;
+  if (!gst_dtapi_delay_release (s->delay, &error)) {
+    g_printerr ("%s\n", error);
+    g_free (error);
+    return FALSE;
+  }
+  s->hold = 0;
+  if (!take_out (s))
+    return FALSE;
+  if (s->out + s->skipped != s->in) {
+    g_printerr ("%" G_GUINT64_FORMAT " bytes were still held after "
+        "releasing the line\n", s->in - s->out - s->skipped);
+    return FALSE;
+  }
+
+  gst_dtapi_delay_clear (s->delay);
+  if (gst_dtapi_delay_get_fill (s->delay) != 0 ||
+      gst_dtapi_delay_peek (s->delay, &data) != 0) {
+    g_printerr ("The line isn't empty after clearing it\n");
+    return FALSE;
+  }
+  return TRUE;
+}
+
+int
+main (int argc, char **argv)
+{
+  Stream s = { NULL, HOLD, 0, 0, 0 };
+  gchar *error = NULL;
+  gboolean ok;
+
+  s.delay = gst_dtapi_delay_new (NULL, HOLD, TS_PACKET_SIZE, &error);
+  if (s.delay == NULL) {
+    g_printerr ("Couldn't make the delay line: %s\n", error);
+    g_free (error);
+    return 1;
+  }
+
+  ok = test_hold (&s) && test_shorten (&s) && test_lengthen (&s) &&
+      test_release (&s);
+  printf ("%" G_GUINT64_FORMAT " bytes in, %" G_GUINT64_FORMAT " out and %"
+      G_GUINT64_FORMAT " skipped\n", s.in, s.out, s.skipped);
+
+  gst_dtapi_delay_free (s.delay);
+  return ok ? 0 : 1;
+}
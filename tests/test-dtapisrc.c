@@ -0,0 +1,204 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * test-dtapisrc.c: dtapisrc reading from the stand-in device's input
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Feeds the stand-in's input at INPUT_RATE and checks that what dtapisrc
+   pushes through its reader thread, pool and queue is whole packets and
+   that none of it was lost.  Then holds up downstream until the pool is
+   all out and the device's FIFO has overflowed, and checks that dtapisrc
+   counts the overflow and carries on once it is let go. */
+
+#include <stdio.h>
+#include <gst/gst.h>
+
+#include "dtapistandin.h"
+#include "gstdtapisrc.h"
+
+#define INPUT_RATE 80000000
+
+/* Long enough for the FIFO to fill several times over at INPUT_RATE */
+#define STALL_MS 500
+
+#define TIMEOUT (5 * GST_SECOND)
+
+static volatile gint bad_packets;
+static volatile gint received;
+
+static GstPadProbeReturn
+check_packets (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+  GstMapInfo map;
+  gsize i;
+
+  gst_buffer_map (buffer, &map, GST_MAP_READ);
+  if (map.size % 188 != 0)
+    g_atomic_int_inc (&bad_packets);
+  for (i = 0; i < map.size; i += 188)
+    if (map.data[i] != 0x47)
+      g_atomic_int_inc (&bad_packets);
+  g_atomic_int_add (&received, (gint) map.size);
+  gst_buffer_unmap (buffer, &map);
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+stall (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+get_stats (GstElement * src, guint64 * bytes, guint64 * overflows)
+{
+  GstStructure *stats;
+
+  g_object_get (src, "stats", &stats, NULL);
+  gst_structure_get_uint64 (stats, "bytes", bytes);
+  gst_structure_get_uint64 (stats, "overflows", overflows);
+  gst_structure_free (stats);
+}
+
+/* Waits for another few FIFOs' worth of data to come out of dtapisrc */
+static gboolean
+wait_for_reads (void)
+{
+  gint from = g_atomic_int_get (&received);
+  gint64 deadline = g_get_monotonic_time () + TIMEOUT / GST_USECOND;
+
+  while (g_atomic_int_get (&received) - from < 4 * DTAPI_STANDIN_FIFO_SIZE) {
+    if (g_get_monotonic_time () > deadline) {
+      g_printerr ("dtapisrc isn't reading anything\n");
+      return FALSE;
+    }
+    g_usleep (10000);
+  }
+  if (g_atomic_int_get (&bad_packets) != 0) {
+    g_printerr ("dtapisrc pushed %d bad packets\n",
+        g_atomic_int_get (&bad_packets));
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static gboolean
+test_reading (GstElement * src)
+{
+  guint64 bytes, overflows;
+
+  if (!wait_for_reads ())
+    return FALSE;
+  get_stats (src, &bytes, &overflows);
+  printf ("Read %" G_GUINT64_FORMAT " bytes, %" G_GUINT64_FORMAT
+      " overflows\n", bytes, overflows);
+  if (bytes == 0) {
+    g_printerr ("dtapisrc's stats don't count what it read\n");
+    return FALSE;
+  }
+  if (overflows != 0) {
+    g_printerr ("The FIFO overflowed while dtapisrc was keeping up\n");
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static gboolean
+test_overflow (GstElement * src, GstPad * pad)
+{
+  guint64 bytes, overflows;
+  gint64 deadline;
+  gulong id;
+
+  id = gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BLOCK_DOWNSTREAM, stall,
+      NULL, NULL);
+  g_usleep (STALL_MS * 1000);
+  gst_pad_remove_probe (pad, id);
+
+  /* It only finds out once it gets a buffer back to read into */
+  deadline = g_get_monotonic_time () + TIMEOUT / GST_USECOND;
+  for (get_stats (src, &bytes, &overflows); overflows == 0;
+      get_stats (src, &bytes, &overflows)) {
+    if (g_get_monotonic_time () > deadline) {
+      g_printerr ("dtapisrc didn't count the overflow\n");
+      return FALSE;
+    }
+    g_usleep (10000);
+  }
+  printf ("Counted %" G_GUINT64_FORMAT " overflows after stalling for %d ms\n",
+      overflows, STALL_MS);
+
+  /* And it carries on */
+  return wait_for_reads ();
+}
+
+int
+main (int argc, char **argv)
+{
+  GstElement *pipeline, *src, *sink;
+  GstPad *pad;
+  GstBus *bus;
+  GstMessage *msg;
+  GError *error = NULL;
+  gboolean ok;
+
+  gst_init (&argc, &argv);
+
+  if (!gst_dtapisrc_plugin_init (NULL)) {
+    g_printerr ("Couldn't register the elements\n");
+    return 1;
+  }
+  pipeline = gst_parse_launch ("dtapisrc name=src device-type=215 port=2 "
+      "buffers=2 ! fakesink name=sink sync=false", &error);
+  if (pipeline == NULL) {
+    g_printerr ("Couldn't make the pipeline: %s\n", error->message);
+    g_error_free (error);
+    return 1;
+  }
+  src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  pad = gst_element_get_static_pad (sink, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, check_packets, NULL,
+      NULL);
+  bus = gst_element_get_bus (pipeline);
+
+  dtapi_standin_set_input_rate (INPUT_RATE);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  ok = test_reading (src) && test_overflow (src, pad);
+
+  msg = gst_bus_pop_filtered (bus, GST_MESSAGE_ERROR);
+  if (msg != NULL) {
+    gst_message_parse_error (msg, &error, NULL);
+    g_printerr ("dtapisrc failed: %s\n", error->message);
+    g_error_free (error);
+    gst_message_unref (msg);
+    ok = FALSE;
+  }
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (bus);
+  gst_object_unref (pad);
+  gst_object_unref (sink);
+  gst_object_unref (src);
+  gst_object_unref (pipeline);
+
+  return ok ? 0 : 1;
+}
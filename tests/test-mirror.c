@@ -0,0 +1,313 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * test-mirror.c: the air-check mirror's files and their indexes
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Mirrors TOTAL bytes, ending part way through a block, into files of at
+   most MAX_SIZE keeping MAX_FILES of them, and checks what's left on disk:
+   that only the last MAX_FILES files are there, that between them they
+   hold exactly the end of what was written, that each was only finished
+   because the next block wouldn't fit, and that each .idx has a record for
+   every block in its file at the right offset and with a believable
+   time. */
+
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "gstdtapimirror.h"
+
+#define MAX_SIZE (1024 * 1024)
+#define MAX_FILES 3
+/* Well within what the queue takes, so nothing is dropped however slow the
+   disk is */
+#define TOTAL (10 * MAX_SIZE + 1000)
+#define CHUNK 1316
+
+#define TIMEOUT_US (5 * G_USEC_PER_SEC)
+
+/* The byte at pos in what's written, different enough from one place to
+   the next that a block in the wrong place can't go unnoticed */
+static guint8
+byte_at (guint64 pos)
+{
+  guint32 x = ((guint32) pos ^ (guint32) (pos >> 32)) * 0x9e3779b1u;
+
+  return (x ^ (x >> 15) ^ (x >> 24)) & 0xff;
+}
+
+static gboolean
+write_all (GstDTAPIMirror * mirror)
+{
+  guint8 chunk[CHUNK];
+  GstDTAPIMirrorStats stats;
+  gchar *error = NULL;
+  guint64 pos = 0;
+  gint64 deadline;
+  gsize n, i;
+
+  while (pos < TOTAL) {
+    n = MIN (TOTAL - pos, CHUNK);
+    for (i = 0; i < n; i++)
+      chunk[i] = byte_at (pos + i);
+    if (!gst_dtapi_mirror_write (mirror, chunk, n, &error)) {
+      g_printerr ("%s\n", error);
+      g_free (error);
+      return FALSE;
+    }
+    pos += n;
+  }
+
+  /* Everything but the block being filled goes out without waiting for the
+     mirror to be freed, and that can't be more than a file's worth */
+  deadline = g_get_monotonic_time () + TIMEOUT_US;
+  for (gst_dtapi_mirror_get_stats (mirror, &stats);
+      stats.written + stats.dropped + MAX_SIZE < TOTAL;
+      gst_dtapi_mirror_get_stats (mirror, &stats)) {
+    if (g_get_monotonic_time () > deadline) {
+      g_printerr ("Only %" G_GUINT64_FORMAT " bytes were written\n",
+          stats.written);
+      return FALSE;
+    }
+    g_usleep (10000);
+  }
+  if (stats.dropped != 0) {
+    g_printerr ("%" G_GUINT64_FORMAT " bytes were dropped\n", stats.dropped);
+    return FALSE;
+  }
+  if (stats.files <= MAX_FILES) {
+    g_printerr ("Only %u files were started\n", stats.files);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/* The index of the last file there is, or -1 if it isn't the last of
+   MAX_FILES in a row */
+static gint
+find_files (const gchar * dir)
+{
+  GDir *d = g_dir_open (dir, 0, NULL);
+  const gchar *name;
+  guint64 index;
+  gint first = G_MAXINT, last = -1, count = 0;
+  gchar *end;
+
+  while ((name = g_dir_read_name (d)) != NULL) {
+    if (!g_str_has_prefix (name, "mirror.") ||
+        g_str_has_suffix (name, ".idx"))
+      continue;
+    index = g_ascii_strtoull (name + strlen ("mirror."), &end, 10);
+    if (*end != '\0' || strlen (name) != strlen ("mirror.000000")) {
+      g_printerr ("Unexpected file %s\n", name);
+      g_dir_close (d);
+      return -1;
+    }
+    first = MIN (first, (gint) index);
+    last = MAX (last, (gint) index);
+    count++;
+  }
+  g_dir_close (d);
+
+  if (count != MAX_FILES || last - first != MAX_FILES - 1) {
+    g_printerr ("Files %d to %d are left, %d of them, not the last %d\n",
+        first, last, count, MAX_FILES);
+    return -1;
+  }
+  return last;
+}
+
+/* Checks file index against the stream from *pos and its .idx, moving *pos
+   on past it.  Every block is *block_size long, bar the very last one
+   written, and *first_block is set to the length of the file's first, so
+   the file before can check it was right to start a new one. */
+static gboolean
+check_file (const gchar * location, gint index, guint64 * pos,
+    gint64 start_time, gint64 end_time, gsize * block_size,
+    gsize * first_block)
+{
+  gchar *name = g_strdup_printf ("%s.%06d", location, index);
+  gchar *idx_name = g_strdup_printf ("%s.idx", name);
+  gchar *data = NULL, *idx = NULL;
+  gsize len, idx_len, i, n_entries;
+  const guint64 *entries;
+  gint64 time, last_time = start_time;
+  guint64 offset, block_end;
+  gboolean ok = FALSE;
+
+  if (!g_file_get_contents (name, &data, &len, NULL) ||
+      !g_file_get_contents (idx_name, &idx, &idx_len, NULL)) {
+    g_printerr ("Can't read %s or its index\n", name);
+    goto out;
+  }
+  if (len > MAX_SIZE) {
+    g_printerr ("%s is %" G_GSIZE_FORMAT " bytes, over the maximum\n", name,
+        len);
+    goto out;
+  }
+  for (i = 0; i < len; i++) {
+    if ((guint8) data[i] != byte_at (*pos + i)) {
+      g_printerr ("Byte %" G_GSIZE_FORMAT " of %s is wrong\n", i, name);
+      goto out;
+    }
+  }
+
+  entries = (const guint64 *) idx;
+  n_entries = idx_len / (2 * sizeof (guint64));
+  if (idx_len % (2 * sizeof (guint64)) != 0 || n_entries == 0) {
+    g_printerr ("%s.idx is %" G_GSIZE_FORMAT " bytes\n", name, idx_len);
+    goto out;
+  }
+  for (i = 0; i < n_entries; i++) {
+    time = (gint64) GUINT64_FROM_LE (entries[2 * i]);
+    offset = GUINT64_FROM_LE (entries[2 * i + 1]);
+    block_end = i + 1 < n_entries ?
+        GUINT64_FROM_LE (entries[2 * i + 3]) : len;
+    if ((i == 0 && offset != 0) || offset >= block_end) {
+      g_printerr ("Record %" G_GSIZE_FORMAT " of %s.idx has offset %"
+          G_GUINT64_FORMAT "\n", i, name, offset);
+      goto out;
+    }
+    if (*block_size == 0)
+      *block_size = block_end - offset;
+    if (block_end - offset != *block_size && *pos + block_end != TOTAL) {
+      g_printerr ("Block %" G_GSIZE_FORMAT " of %s is %" G_GUINT64_FORMAT
+          " bytes, not %" G_GSIZE_FORMAT "\n", i, name, block_end - offset,
+          *block_size);
+      goto out;
+    }
+    if (time < last_time || time > end_time) {
+      g_printerr ("Record %" G_GSIZE_FORMAT " of %s.idx has time %"
+          G_GINT64_FORMAT ", not between %" G_GINT64_FORMAT " and %"
+          G_GINT64_FORMAT "\n", i, name, time, last_time, end_time);
+      goto out;
+    }
+    last_time = time;
+    if (i == 0)
+      *first_block = (gsize) block_end;
+  }
+
+  *pos += len;
+  ok = TRUE;
+
+out:
+  g_free (data);
+  g_free (idx);
+  g_free (name);
+  g_free (idx_name);
+  return ok;
+}
+
+static gboolean
+check_files (const gchar * dir, const gchar * location, gint64 start_time,
+    gint64 end_time)
+{
+  gint last = find_files (dir), index;
+  guint64 pos, size = 0;
+  gsize block_size = 0, first_block, last_len = 0;
+  gchar *name;
+
+  if (last < 0)
+    return FALSE;
+
+  /* Between them the files are the end of what was written */
+  for (index = last - MAX_FILES + 1; index <= last; index++) {
+    GStatBuf st;
+
+    name = g_strdup_printf ("%s.%06d", location, index);
+    if (g_stat (name, &st) == 0)
+      size += st.st_size;
+    g_free (name);
+  }
+  if (size > TOTAL) {
+    g_printerr ("The files hold more than was written\n");
+    return FALSE;
+  }
+  pos = TOTAL - size;
+
+  for (index = last - MAX_FILES + 1; index <= last; index++) {
+    guint64 file_start = pos;
+
+    if (!check_file (location, index, &pos, start_time, end_time,
+            &block_size, &first_block))
+      return FALSE;
+    /* The file before was only finished because this block wouldn't fit */
+    if (index > last - MAX_FILES + 1 && last_len + first_block <= MAX_SIZE) {
+      g_printerr ("File %d was started with room left in the one before\n",
+          index);
+      return FALSE;
+    }
+    last_len = pos - file_start;
+  }
+  return TRUE;
+}
+
+static void
+remove_all (const gchar * dir)
+{
+  GDir *d = g_dir_open (dir, 0, NULL);
+  const gchar *name;
+  gchar *path;
+
+  while (d && (name = g_dir_read_name (d)) != NULL) {
+    path = g_build_filename (dir, name, NULL);
+    g_unlink (path);
+    g_free (path);
+  }
+  if (d)
+    g_dir_close (d);
+  g_rmdir (dir);
+}
+
+int
+main (int argc, char **argv)
+{
+  GstDTAPIMirror *mirror;
+  gchar *dir, *location, *error = NULL;
+  gint64 start_time, end_time;
+  gboolean ok;
+
+  if ((dir = g_dir_make_tmp ("test-mirror-XXXXXX", NULL)) == NULL) {
+    g_printerr ("Couldn't make a directory for the files\n");
+    return 1;
+  }
+  location = g_build_filename (dir, "mirror", NULL);
+
+  start_time = g_get_real_time ();
+  mirror = gst_dtapi_mirror_new (location, MAX_SIZE, MAX_FILES, &error);
+  if (mirror == NULL) {
+    g_printerr ("Couldn't make the mirror: %s\n", error);
+    g_free (error);
+    remove_all (dir);
+    return 1;
+  }
+  ok = write_all (mirror);
+  /* which writes out the last, short, block */
+  gst_dtapi_mirror_free (mirror);
+  end_time = g_get_real_time ();
+
+  ok = ok && check_files (dir, location, start_time, end_time);
+
+  remove_all (dir);
+  g_free (location);
+  g_free (dir);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,353 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * test-profiles.c: dtapisink's named profiles of modulator settings
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Loads profile files with something wrong with them into a dtapisink and
+   checks each is refused with a warning saying what, leaving the profiles
+   it had.  Checks a profile that's fine on its own isn't switched to if it
+   isn't with the t2-plps the sink keeps.  Then streams into dtapisink on
+   the stand-in device, switching between profiles, and checks with
+   call-stats that only the settings that differ go to the modulator: a
+   new frequency doesn't restart it, new modulation parameters do, and
+   switching to the profile it's already on changes nothing. */
+
+#include <stdio.h>
+#include <string.h>
+#include <gst/gst.h>
+#include <glib/gstdio.h>
+
+#include "dtapistandin.h"
+#include "gstdtapisink.h"
+#include "gstdtapitestsrc.h"
+
+#define TIMEOUT (5 * GST_SECOND)
+
+/* b only moves the frequency from a, and c only the modulation from b */
+static const gchar good_profiles[] =
+    "[a]\n"
+    "frequency=482000000\n"
+    "[b]\n"
+    "frequency=490000000\n"
+    "[c]\n"
+    "frequency=490000000\n"
+    "modulation=qam-16\n"
+    "[t2]\n"
+    "standard=dvb-t2\n"
+    "modulation=qam-256\n";
+
+typedef struct
+{
+  const gchar *contents;
+  /* Part of the warning it must give */
+  const gchar *problem;
+} BadProfiles;
+
+static const BadProfiles bad_profiles[] = {
+  {NULL, "profiles.missing"},
+  {"[x]\nloudness=11\n", "unknown setting loudness"},
+  {"[x]\nfrequency=lots\n", "bad value lots for frequency"},
+  {"[x]\nt2-plps=qpsk:1/2:100\n", "t2-plps can't be part of a profile"},
+  /* The defaults are DVB-T */
+  {"[a]\nfrequency=482000000\n[x]\nmodulation=qam-256\n",
+      "DVB-T requires QPSK, QAM 16 or QAM 64"},
+};
+
+/* The sink's calls to the modulator that a profile switch can make */
+static const gchar *const set_methods[] = {
+  "SetModControl", "SetOutputLevel", "SetRfControl", "SetRfMode",
+  "SetTsRateBps", "SetTxMode"
+};
+
+#define N_SET_METHODS G_N_ELEMENTS (set_methods)
+
+static gchar *last_warning;
+
+static void
+log_handler (const gchar * domain, GLogLevelFlags level,
+    const gchar * message, gpointer user_data)
+{
+  if (level & G_LOG_LEVEL_WARNING) {
+    g_free (last_warning);
+    last_warning = g_strdup (message);
+  }
+  g_log_default_handler (domain, level, message, user_data);
+}
+
+static gchar *
+write_file (const gchar * dir, const gchar * name, const gchar * contents)
+{
+  gchar *path = g_build_filename (dir, name, NULL);
+
+  if (contents && !g_file_set_contents (path, contents, -1, NULL)) {
+    g_printerr ("Couldn't write %s\n", path);
+    g_free (path);
+    return NULL;
+  }
+  return path;
+}
+
+/* Checks that the sink's string property is value */
+static gboolean
+check_string (GstElement * sink, const gchar * property, const gchar * value)
+{
+  gchar *str;
+  gboolean ok;
+
+  g_object_get (sink, property, &str, NULL);
+  ok = g_strcmp0 (str, value) == 0;
+  if (!ok)
+    g_printerr ("%s is %s, not %s\n", property, str ? str : "unset",
+        value ? value : "unset");
+  g_free (str);
+  return ok;
+}
+
+/* Checks that the sink's enum property is the value nicknamed nick */
+static gboolean
+check_enum (GstElement * sink, const gchar * property, const gchar * nick)
+{
+  GParamSpec *pspec;
+  GEnumValue *value;
+  gint v;
+
+  pspec = g_object_class_find_property (G_OBJECT_GET_CLASS (sink), property);
+  g_object_get (sink, property, &v, NULL);
+  value = g_enum_get_value (G_PARAM_SPEC_ENUM (pspec)->enum_class, v);
+  if (value == NULL || strcmp (value->value_nick, nick) != 0) {
+    g_printerr ("%s is %s, not %s\n", property,
+        value ? value->value_nick : "unknown", nick);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static gboolean
+test_load_errors (GstElement * sink, const gchar * dir, const gchar * good)
+{
+  gchar *path;
+  guint i;
+  gboolean ok = TRUE;
+
+  for (i = 0; i < G_N_ELEMENTS (bad_profiles) && ok; i++) {
+    if ((path = write_file (dir, i == 0 ? "profiles.missing" : "bad.ini",
+                bad_profiles[i].contents)) == NULL)
+      return FALSE;
+
+    g_free (last_warning);
+    last_warning = NULL;
+    g_object_set (sink, "profile-location", path, NULL);
+    if (last_warning == NULL ||
+        strstr (last_warning, bad_profiles[i].problem) == NULL) {
+      g_printerr ("Loading %s warned %s, not about %s\n", path,
+          last_warning ? last_warning : "nothing", bad_profiles[i].problem);
+      ok = FALSE;
+    }
+    /* The profiles from before are kept */
+    ok = ok && check_string (sink, "profile-location", good);
+    g_free (path);
+  }
+  if (!ok)
+    return FALSE;
+
+  g_object_set (sink, "profile", "b", NULL);
+  return check_string (sink, "profile", "b");
+}
+
+static gboolean
+test_merged (GstElement * sink)
+{
+  /* Fine with DVB-T, which ignores it, but 7/8 isn't a DVB-T2 code rate */
+  g_object_set (sink, "t2-plps", "qam-64:7/8:50,qpsk:1/2:30", NULL);
+  g_object_set (sink, "profile", "t2", NULL);
+  if (!check_string (sink, "profile", "b") ||
+      !check_enum (sink, "standard", "dvb-t"))
+    return FALSE;
+
+  /* An unknown profile changes nothing either */
+  g_object_set (sink, "profile", "nonesuch", NULL);
+  if (!check_string (sink, "profile", "b"))
+    return FALSE;
+
+  g_object_set (sink, "t2-plps", "qam-64:2/3:50,qpsk:1/2:30", NULL);
+  g_object_set (sink, "profile", "t2", NULL);
+  return check_string (sink, "profile", "t2") &&
+      check_enum (sink, "standard", "dvb-t2");
+}
+
+/* Waits for the stand-in to have taken another few FIFOs' worth of data,
+   by when anything pending has been applied */
+static gboolean
+wait_for_writes (void)
+{
+  guint64 from = dtapi_standin_bytes_written ();
+  gint64 deadline = g_get_monotonic_time () + TIMEOUT / GST_USECOND;
+
+  while (dtapi_standin_bytes_written () - from < 4 * DTAPI_STANDIN_FIFO_SIZE) {
+    if (g_get_monotonic_time () > deadline) {
+      g_printerr ("dtapisink isn't writing anything\n");
+      return FALSE;
+    }
+    g_usleep (10000);
+  }
+  return TRUE;
+}
+
+/* The number of calls made to method so far */
+static guint64
+get_calls (GstElement * sink, const gchar * method)
+{
+  GstStructure *stats, *calls = NULL;
+  guint64 count = 0;
+
+  g_object_get (sink, "call-stats", &stats, NULL);
+  if (gst_structure_get (stats, method, GST_TYPE_STRUCTURE, &calls, NULL)) {
+    gst_structure_get (calls, "count", G_TYPE_UINT64, &count, NULL);
+    gst_structure_free (calls);
+  }
+  gst_structure_free (stats);
+  return count;
+}
+
+/* Switches to profile and checks that each of set_methods is then called
+   as many times as in expected */
+static gboolean
+switch_to (GstElement * sink, const gchar * profile, const guint * expected)
+{
+  guint64 before[N_SET_METHODS];
+  guint i;
+  gboolean ok = TRUE;
+
+  for (i = 0; i < N_SET_METHODS; i++)
+    before[i] = get_calls (sink, set_methods[i]);
+  g_object_set (sink, "profile", profile, NULL);
+  if (!wait_for_writes ())
+    return FALSE;
+
+  for (i = 0; i < N_SET_METHODS; i++) {
+    guint64 calls = get_calls (sink, set_methods[i]) - before[i];
+
+    if (calls != expected[i]) {
+      g_printerr ("Switching to profile %s made %" G_GUINT64_FORMAT
+          " calls to %s, not %u\n", profile, calls, set_methods[i],
+          expected[i]);
+      ok = FALSE;
+    }
+  }
+  return ok;
+}
+
+static gboolean
+test_pending (GstElement * sink)
+{
+  /* In the order of set_methods */
+  static const guint frequency_only[] = {0, 0, 1, 0, 0, 0};
+  static const guint modulation_only[] = {1, 0, 0, 0, 1, 0};
+  static const guint nothing[] = {0, 0, 0, 0, 0, 0};
+
+  if (!wait_for_writes ())
+    return FALSE;
+  g_object_set (sink, "profile-calls", TRUE, NULL);
+
+  /* Whatever it takes to get from the defaults the device was configured
+     with to a */
+  g_object_set (sink, "profile", "a", NULL);
+  if (!wait_for_writes ())
+    return FALSE;
+
+  return switch_to (sink, "b", frequency_only) &&
+      switch_to (sink, "c", modulation_only) &&
+      switch_to (sink, "c", nothing) &&
+      check_string (sink, "profile", "c");
+}
+
+static void
+remove_all (const gchar * dir)
+{
+  GDir *d = g_dir_open (dir, 0, NULL);
+  const gchar *name;
+  gchar *path;
+
+  while (d && (name = g_dir_read_name (d)) != NULL) {
+    path = g_build_filename (dir, name, NULL);
+    g_unlink (path);
+    g_free (path);
+  }
+  if (d)
+    g_dir_close (d);
+  g_rmdir (dir);
+}
+
+int
+main (int argc, char **argv)
+{
+  GstElement *pipeline, *sink;
+  GError *error = NULL;
+  gchar *dir, *good;
+  gboolean ok;
+
+  gst_init (&argc, &argv);
+  g_log_set_default_handler (log_handler, NULL);
+
+  if (!gst_dtapisink_plugin_init (NULL) ||
+      !gst_dtapitestsrc_plugin_init (NULL)) {
+    g_printerr ("Couldn't register the elements\n");
+    return 1;
+  }
+  if ((dir = g_dir_make_tmp ("test-profiles-XXXXXX", NULL)) == NULL) {
+    g_printerr ("Couldn't make a directory for the profiles\n");
+    return 1;
+  }
+  if ((good = write_file (dir, "good.ini", good_profiles)) == NULL) {
+    remove_all (dir);
+    return 1;
+  }
+
+  /* Loading and switching don't need the device */
+  sink = gst_element_factory_make ("dtapisink", NULL);
+  g_object_set (sink, "profile-location", good, NULL);
+  ok = check_string (sink, "profile-location", good) &&
+      test_load_errors (sink, dir, good) && test_merged (sink);
+  gst_object_unref (sink);
+
+  pipeline = gst_parse_launch ("dtapitestsrc mode=null ! "
+      "dtapisink name=sink sync=false", &error);
+  if (pipeline == NULL) {
+    g_printerr ("Couldn't make the pipeline: %s\n", error->message);
+    g_error_free (error);
+    remove_all (dir);
+    return 1;
+  }
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  g_object_set (sink, "profile-location", good, NULL);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  ok = ok && test_pending (sink);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (sink);
+  gst_object_unref (pipeline);
+
+  remove_all (dir);
+  g_free (good);
+  g_free (dir);
+  g_free (last_warning);
+  return ok ? 0 : 1;
+}
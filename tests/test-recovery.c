@@ -0,0 +1,176 @@
+/* GStreamer DTAPI
+ * Copyright (C) 2012 YouView TV Ltd.
+ * Author: William Manley <william.manley@youview.com>
+ *
+ * test-recovery.c: dtapisink getting the device back after losing it
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Streams into dtapisink on the stand-in device, pulls the device out from
+   under it for OUTAGE_MS and plugs it back in, once as a driver failure and
+   once as the channel going away.  Each time the sink has to post
+   dtapisink-outage and then dtapisink-recovered with a duration that
+   matches how long the device was really gone, and go on writing. */
+
+#include <stdio.h>
+#include <gst/gst.h>
+
+#include "DTAPI.h"
+#include "dtapistandin.h"
+#include "gstdtapisink.h"
+#include "gstdtapitestsrc.h"
+
+#define OUTAGE_MS 500
+
+/* How often dtapisink tries to attach again while the device is gone */
+#define RECOVERY_RETRY_MS 100
+
+/* Allowance for the write the outage is noticed by, the one that is waiting
+   out its airing time when the device comes back, and a busy machine */
+#define SLACK_MS 200
+
+#define TIMEOUT (5 * GST_SECOND)
+
+/* Waits for the stand-in to have taken another few FIFOs' worth of data */
+static gboolean
+wait_for_writes (void)
+{
+  guint64 from = dtapi_standin_bytes_written ();
+  gint64 deadline = g_get_monotonic_time () + TIMEOUT / GST_USECOND;
+
+  while (dtapi_standin_bytes_written () - from < 4 * DTAPI_STANDIN_FIFO_SIZE) {
+    if (g_get_monotonic_time () > deadline) {
+      g_printerr ("dtapisink isn't writing anything\n");
+      return FALSE;
+    }
+    g_usleep (10000);
+  }
+  return TRUE;
+}
+
+/* The next element message from dtapisink, which must be called name.
+   Anything else, an error included, fails the test. */
+static GstMessage *
+wait_for (GstBus * bus, const gchar * name)
+{
+  GstMessage *msg;
+  GError *error;
+
+  msg = gst_bus_timed_pop_filtered (bus, TIMEOUT,
+      (GstMessageType) (GST_MESSAGE_ELEMENT | GST_MESSAGE_ERROR));
+  if (msg == NULL) {
+    g_printerr ("No %s message\n", name);
+    return NULL;
+  }
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+    gst_message_parse_error (msg, &error, NULL);
+    g_printerr ("Waiting for %s: %s\n", name, error->message);
+    g_error_free (error);
+    gst_message_unref (msg);
+    return NULL;
+  }
+  if (!gst_message_has_name (msg, name)) {
+    g_printerr ("Waiting for %s got %s\n", name,
+        gst_structure_get_name (gst_message_get_structure (msg)));
+    gst_message_unref (msg);
+    return NULL;
+  }
+  return msg;
+}
+
+static gboolean
+test_outage (GstBus * bus, guint result)
+{
+  GstMessage *msg;
+  GstClockTime held, duration;
+  guint attaches;
+  gint64 start;
+  gboolean ok;
+
+  if (!wait_for_writes ())
+    return FALSE;
+  attaches = dtapi_standin_attach_count ();
+
+  start = g_get_monotonic_time ();
+  dtapi_standin_fail (result);
+  g_usleep (OUTAGE_MS * 1000);
+  dtapi_standin_fail (DTAPI_OK);
+  held = (g_get_monotonic_time () - start) * GST_USECOND;
+
+  if ((msg = wait_for (bus, "dtapisink-outage")) == NULL)
+    return FALSE;
+  gst_message_unref (msg);
+  if ((msg = wait_for (bus, "dtapisink-recovered")) == NULL)
+    return FALSE;
+  ok = gst_structure_get_uint64 (gst_message_get_structure (msg), "duration",
+      &duration);
+  gst_message_unref (msg);
+  if (!ok) {
+    g_printerr ("dtapisink-recovered has no duration\n");
+    return FALSE;
+  }
+
+  printf ("Device gone for %" GST_TIME_FORMAT ", dtapisink says %"
+      GST_TIME_FORMAT "\n", GST_TIME_ARGS (held), GST_TIME_ARGS (duration));
+  if (duration + SLACK_MS * GST_MSECOND < held ||
+      duration > held + (RECOVERY_RETRY_MS + SLACK_MS) * GST_MSECOND) {
+    g_printerr ("The outage duration is wrong\n");
+    return FALSE;
+  }
+  if (dtapi_standin_attach_count () == attaches) {
+    g_printerr ("dtapisink says it recovered without attaching again\n");
+    return FALSE;
+  }
+
+  /* And it carries on where it left off */
+  return wait_for_writes ();
+}
+
+int
+main (int argc, char **argv)
+{
+  GstElement *pipeline;
+  GstBus *bus;
+  GError *error = NULL;
+  gboolean ok;
+
+  gst_init (&argc, &argv);
+
+  if (!gst_dtapisink_plugin_init (NULL) ||
+      !gst_dtapitestsrc_plugin_init (NULL)) {
+    g_printerr ("Couldn't register the elements\n");
+    return 1;
+  }
+  pipeline = gst_parse_launch ("dtapitestsrc mode=null ! "
+      "dtapisink sync=false recovery-timeout=10", &error);
+  if (pipeline == NULL) {
+    g_printerr ("Couldn't make the pipeline: %s\n", error->message);
+    g_error_free (error);
+    return 1;
+  }
+  bus = gst_element_get_bus (pipeline);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  ok = test_outage (bus, DTAPI_E_DEV_DRIVER) &&
+      test_outage (bus, DTAPI_E_NOT_ATTACHED);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (bus);
+  gst_object_unref (pipeline);
+
+  return ok ? 0 : 1;
+}